@@ -5,4 +5,5 @@ CONFIG += ordered
 SUBDIRS = EksCore/QtProject/EksCore.pro \
           EksGui/QtProject/EksGui.pro \
           Eks3D/QtProject/Eks3D.pro \
+          Eks3D/benchmarkProject/benchmarkProject.pro \
           EksAdd/QtProject/EksAdd.pro
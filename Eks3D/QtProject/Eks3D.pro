@@ -44,7 +44,15 @@ SOURCES += ../src/XDoodad.cpp \
     ../src/XAbstractDelegate.cpp \
     ../src/XAbstractCanvasController.cpp \
     ../src/X3DCanvas.cpp \
-    ../src/XCameraCanvasController.cpp
+    ../src/XCameraCanvasController.cpp \
+    ../src/XMeshOptimiser.cpp \
+    ../src/XMeshContainer.cpp \
+    ../src/XEnvironmentCodec.cpp \
+    ../src/XEnvironmentDiskCache.cpp \
+    ../src/XEnvironmentVisibility.cpp \
+    ../src/XEnvironmentLOD.cpp \
+    ../src/XSoftwareRenderer.cpp \
+    ../src/XGLStateCache.cpp
 HEADERS += ../include/XDoodad.h \
     ../include/X3DGlobal.h \
     ../include/XScene.h \
@@ -80,7 +88,15 @@ HEADERS += ../include/XDoodad.h \
     ../include/XAbstractDelegate.h \
     ../include/XAbstractCanvasController.h \
     ../include/X3DCanvas.h \
-    ../include/XCameraCanvasController.h
+    ../include/XCameraCanvasController.h \
+    ../include/XMeshOptimiser.h \
+    ../include/XMeshContainer.h \
+    ../include/XEnvironmentCodec.h \
+    ../include/XEnvironmentDiskCache.h \
+    ../include/XEnvironmentVisibility.h \
+    ../include/XEnvironmentLOD.h \
+    ../include/XSoftwareRenderer.h \
+    ../include/XGLStateCache.h
 DEFINES += GLEW_STATIC
 
 INCLUDEPATH += ../include/ \
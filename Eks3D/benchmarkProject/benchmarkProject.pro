@@ -0,0 +1,32 @@
+# -------------------------------------------------
+# Eks3D benchmarks, run as "benchmarkProject [benchmark] [args]"
+# -------------------------------------------------
+TARGET = Eks3DBenchmarks
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+include("../../EksCore/GeneralOptions.pri")
+
+QT += opengl \
+    xml
+
+INCLUDEPATH += ../include \
+    $$ROOT/EksCore
+
+LIBS += -lEksCore \
+    -lEks3D
+
+DEFINES += X_BENCHMARK_DATA_DIR=\\\"$$ROOT/Tang/\\\"
+
+SOURCES += main.cpp \
+    meshOptimiserBenchmark.cpp \
+    colladaImportBenchmark.cpp \
+    meshContainerBenchmark.cpp \
+    environmentTransferBenchmark.cpp \
+    environmentVisibilityBenchmark.cpp \
+    environmentLODBenchmark.cpp \
+    softwareRendererBenchmark.cpp \
+    glStateCacheBenchmark.cpp
+
+HEADERS += benchmarks.h
@@ -0,0 +1,21 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "QStringList"
+
+// each benchmark takes the remaining command line arguments and returns an exit code.
+int meshOptimiserBenchmark(const QStringList &args);
+int colladaImportBenchmark(const QStringList &args);
+int meshContainerBenchmark(const QStringList &args);
+int environmentTransferBenchmark(const QStringList &args);
+int environmentVisibilityBenchmark(const QStringList &args);
+int environmentLODBenchmark(const QStringList &args);
+int softwareRendererBenchmark(const QStringList &args);
+int glStateCacheBenchmark(const QStringList &args);
+
+inline QString benchmarkDataFile(const QString &name)
+  {
+  return QString(X_BENCHMARK_DATA_DIR) + name;
+  }
+
+#endif // BENCHMARKS_H
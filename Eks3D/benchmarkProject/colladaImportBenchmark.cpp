@@ -0,0 +1,139 @@
+#include "benchmarks.h"
+#include "XColladaFile.h"
+#include "XGeometry.h"
+#include "XTime"
+#include "QFile"
+#include "QFileInfo"
+#include "QTextStream"
+#include "QThread"
+#include "QDir"
+#include "QDebug"
+
+namespace
+{
+// write a grid of [geometries] meshes, each [size] x [size] quads, as a polylist with positions, normals and texture coordinates.
+bool writeSyntheticFile(const QString &file, int geometries, int size)
+  {
+  QFile f(file);
+  if(!f.open(QFile::WriteOnly | QFile::Truncate))
+    {
+    return false;
+    }
+
+  QTextStream str(&f);
+  str << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+         "<COLLADA xmlns=\"http://www.collada.org/2005/11/COLLADASchema\" version=\"1.4.1\">\n"
+         "<library_geometries>\n";
+
+  int verts = (size + 1) * (size + 1);
+  for(int g=0; g<geometries; ++g)
+    {
+    QString id = QString("grid%1").arg(g);
+    str << "<geometry id=\"" << id << "\" name=\"" << id << "\"><mesh>\n";
+
+    str << "<source id=\"" << id << "-pos\"><float_array id=\"" << id << "-pos-array\" count=\"" << verts * 3 << "\">";
+    for(int y=0; y<=size; ++y)
+      {
+      for(int x=0; x<=size; ++x)
+        {
+        str << x * 0.125f << " " << 0.03125f * ((x * y) % 7) << " " << y * -0.125f << " ";
+        }
+      }
+    str << "</float_array><technique_common><accessor source=\"#" << id << "-pos-array\" count=\"" << verts << "\" stride=\"3\">"
+           "<param name=\"X\" type=\"float\"/><param name=\"Y\" type=\"float\"/><param name=\"Z\" type=\"float\"/>"
+           "</accessor></technique_common></source>\n";
+
+    str << "<source id=\"" << id << "-nor\"><float_array id=\"" << id << "-nor-array\" count=\"3\">0 1 0</float_array>"
+           "<technique_common><accessor source=\"#" << id << "-nor-array\" count=\"1\" stride=\"3\">"
+           "<param name=\"X\" type=\"float\"/><param name=\"Y\" type=\"float\"/><param name=\"Z\" type=\"float\"/>"
+           "</accessor></technique_common></source>\n";
+
+    str << "<source id=\"" << id << "-tex\"><float_array id=\"" << id << "-tex-array\" count=\"" << verts * 2 << "\">";
+    for(int y=0; y<=size; ++y)
+      {
+      for(int x=0; x<=size; ++x)
+        {
+        str << (float)x / size << " " << (float)y / size << " ";
+        }
+      }
+    str << "</float_array><technique_common><accessor source=\"#" << id << "-tex-array\" count=\"" << verts << "\" stride=\"2\">"
+           "<param name=\"S\" type=\"float\"/><param name=\"T\" type=\"float\"/>"
+           "</accessor></technique_common></source>\n";
+
+    str << "<vertices id=\"" << id << "-vtx\"><input semantic=\"POSITION\" source=\"#" << id << "-pos\"/></vertices>\n";
+
+    str << "<polylist count=\"" << size * size << "\">"
+           "<input semantic=\"VERTEX\" source=\"#" << id << "-vtx\" offset=\"0\"/>"
+           "<input semantic=\"NORMAL\" source=\"#" << id << "-nor\" offset=\"1\"/>"
+           "<input semantic=\"TEXCOORD\" source=\"#" << id << "-tex\" offset=\"2\" set=\"0\"/><vcount>";
+    for(int i=0; i<size*size; ++i)
+      {
+      str << "4 ";
+      }
+    str << "</vcount><p>";
+    for(int y=0; y<size; ++y)
+      {
+      for(int x=0; x<size; ++x)
+        {
+        int a = y * (size + 1) + x;
+        int quad[] = { a, a + 1, a + size + 2, a + size + 1 };
+        for(int c=0; c<4; ++c)
+          {
+          str << quad[c] << " 0 " << quad[c] << " ";
+          }
+        }
+      }
+    str << "</p></polylist></mesh></geometry>\n";
+    }
+
+  str << "</library_geometries>\n</COLLADA>\n";
+  return str.status() == QTextStream::Ok;
+  }
+
+void import(const QString &file, int threads)
+  {
+  XTime start = XTime::now();
+  XColladaFile col(file, threads);
+  float ms = (XTime::now() - start).milliseconds();
+
+  int triangles = 0;
+  foreach(const QString &name, col.geometryNames())
+    {
+    triangles += col.geometry(name).triangles().size() / 3;
+    }
+
+  float megabytes = QFileInfo(file).size() / (1024.0f * 1024.0f);
+  qDebug() << "threads:" << (threads > 0 ? threads : QThread::idealThreadCount())
+           << "geometries:" << col.geometryNames().size()
+           << "triangles:" << triangles
+           << "ms:" << ms
+           << "MB/s:" << (ms > 0.0f ? megabytes * 1000.0f / ms : 0.0f);
+  }
+}
+
+// colladaImport [file.dae | --synthetic geometries size]
+int colladaImportBenchmark(const QStringList &args)
+  {
+  QString file = benchmarkDataFile("duck.dae");
+  if(args.size() >= 1 && args[0] == "--synthetic")
+    {
+    int geometries = args.size() >= 2 ? args[1].toInt() : 16;
+    int size = args.size() >= 3 ? args[2].toInt() : 256;
+
+    file = QDir::temp().filePath("Eks3DColladaBenchmark.dae");
+    if(!writeSyntheticFile(file, geometries, size))
+      {
+      qWarning() << "Couldn't write" << file;
+      return EXIT_FAILURE;
+      }
+    }
+  else if(args.size())
+    {
+    file = args[0];
+    }
+
+  qDebug() << "Importing" << file << QFileInfo(file).size() / 1024 << "KB";
+  import(file, 1);
+  import(file, -1);
+  return EXIT_SUCCESS;
+  }
@@ -0,0 +1,127 @@
+#include "benchmarks.h"
+#include "XEnvironmentLOD.h"
+#include "XTime"
+#include "QDebug"
+#include "math.h"
+
+namespace
+{
+enum
+  {
+  Levels = 5,
+  Spacing = 20,
+  FrameRate = 60
+  };
+}
+
+// a camera flying low over a grid of objects, each a chain of levels. Refinements arrive a few frames after
+// they are requested, at most [bandwidth] a frame, taken from the front of the refinement list.
+int environmentLODBenchmark(const QStringList &args)
+  {
+  int size = args.size() > 0 ? args[0].toInt() : 32;
+  int frames = args.size() > 1 ? args[1].toInt() : 600;
+  int bandwidth = args.size() > 2 ? args[2].toInt() : 8;
+  const int latency = 4;
+  const xReal projectionScale = 1000.0f;
+
+  XEnvironmentLOD lod;
+  XVector<xuint32> objects;
+  for(int x=0; x<size; ++x)
+    {
+    for(int z=0; z<size; ++z)
+      {
+      XVector3D centre(x * Spacing, 0.0f, z * Spacing);
+      XCuboid bounds(centre - XVector3D(2, 2, 2), centre + XVector3D(2, 2, 2));
+
+      // the coarsest level is off by a quarter of the object, each finer level halves it.
+      xuint32 parent = XEnvironmentLOD::InvalidNode;
+      for(int l=0; l<Levels; ++l)
+        {
+        xReal error = l == Levels-1 ? 0.0f : 1.0f / (1 << l);
+        parent = lod.addNode(parent, lod.nodeCount(), bounds, error);
+        if(l == 0)
+          {
+          objects << parent;
+          }
+        }
+      }
+    }
+
+  // node -> the frame its data arrives.
+  XHash<xuint32, int> inFlight;
+  XVector<XEnvironmentLOD::Draw> draws;
+  XVector<XEnvironmentLOD::Refinement> refinements;
+  XVector<xReal> incoming(lod.nodeCount());
+  XVector<xReal> outgoing(lod.nodeCount());
+
+  xuint64 drawCount = 0;
+  xuint64 requested = 0;
+  xuint32 failures = 0;
+  double updateTime = 0.0;
+  xReal extent = size * Spacing;
+  for(int f=0; f<frames; ++f)
+    {
+    for(XHash<xuint32, int>::iterator it = inFlight.begin(); it != inFlight.end(); )
+      {
+      if(it.value() <= f)
+        {
+        lod.setResident(it.key(), true);
+        it = inFlight.erase(it);
+        }
+      else
+        {
+        ++it;
+        }
+      }
+
+    xReal t = (xReal)f / frames;
+    XVector3D position(t * extent, 3.0f, extent * 0.5f + sinf(t * 6.28f) * extent * 0.25f);
+
+    XTime start = XTime::now();
+    lod.update(position, projectionScale, 1.0f / FrameRate, draws, refinements);
+    updateTime += (XTime::now() - start).milliseconds();
+    drawCount += draws.size();
+
+    int sent = 0;
+    foreach(const XEnvironmentLOD::Refinement &r, refinements)
+      {
+      if(sent == bandwidth)
+        {
+        break;
+        }
+      if(!inFlight.contains(r.node))
+        {
+        inFlight.insert(r.node, f + latency);
+        ++requested;
+        ++sent;
+        }
+      }
+
+    // every object with a resident level must be fully covered, by an incoming level and the level it replaces.
+    incoming.fill(0.0f);
+    outgoing.fill(0.0f);
+    foreach(const XEnvironmentLOD::Draw &d, draws)
+      {
+      xuint32 root = d.node - (d.node % Levels);
+      XVector<xReal> &cover = d.invertDither ? outgoing : incoming;
+      cover[root] = xMax(cover[root], d.fade);
+      }
+    foreach(xuint32 root, objects)
+      {
+      if(lod.node(root).resident && incoming[root] + outgoing[root] < 0.999f)
+        {
+        ++failures;
+        }
+      }
+    }
+
+  qDebug() << objects.size() << "objects," << frames << "frames, update" << updateTime / frames << "ms a frame,"
+           << (double)drawCount / frames << "draws a frame," << requested << "levels streamed";
+
+  if(failures)
+    {
+    qWarning() << failures << "frames left an object partly uncovered";
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
@@ -0,0 +1,121 @@
+#include "benchmarks.h"
+#include "XEnvironment.h"
+#include "XEnvironmentArea.h"
+#include "XEnvironmentRequest.h"
+#include "XEnvironmentCodec.h"
+#include "XTime"
+#include "QDataStream"
+#include "QDebug"
+
+namespace
+{
+typedef XVector<XEnvironmentArea::MeshPair> MeshPairList;
+
+enum
+  {
+  MeshesPerGroup = 250,
+  // the length prefix on every message.
+  FrameSize = sizeof(xuint64)
+  };
+
+// an area's data as the server holds it, the meshes split into shading groups.
+QByteArray saveArea(const MeshPairList &meshes)
+  {
+  XEnvironmentArea area;
+  for(int i=0; i<meshes.size(); i+=MeshesPerGroup)
+    {
+    // groups only stream their meshes in, so build each through its stream format.
+    QByteArray groupData;
+    QDataStream out(&groupData, QIODevice::WriteOnly);
+    out << (XEnvironmentID)(i / MeshesPerGroup) << meshes.mid(i, MeshesPerGroup);
+
+    XEnvironmentArea::ShadingGroup group;
+    QDataStream in(groupData);
+    in >> group;
+    area.shadingGroups() << group;
+    }
+
+  QByteArray data;
+  QDataStream str(&data, QIODevice::WriteOnly);
+  area.save(str);
+  return data;
+  }
+
+xuint64 messageSize(int payload)
+  {
+  return FrameSize + XEnvironmentRequest::StaticSaveSize + payload;
+  }
+}
+
+int environmentTransferBenchmark(const QStringList &args)
+  {
+  int meshCount = args.size() > 0 ? args[0].toInt() : 5000;
+  int edits = args.size() > 1 ? args[1].toInt() : 100;
+
+  qsrand(1);
+  MeshPairList meshes;
+  for(int i=0; i<meshCount; ++i)
+    {
+    XEnvironmentArea::MeshPair pair;
+    pair.setMesh(qrand() % 64);
+    pair.transform() = XTransform::Identity();
+    pair.transform().translate(XVector3D(qrand() % 1000, qrand() % 1000, qrand() % 1000) * 0.1f);
+    pair.transform().rotate(Eigen::AngleAxisf((qrand() % 360) * 0.0174533f, XVector3D::UnitY()));
+    meshes << pair;
+    }
+
+  QByteArray current = saveArea(meshes);
+  qDebug() << meshCount << "meshes," << current.size() << "bytes per area," << edits << "edits";
+
+  xuint64 fullBytes = 0;
+  xuint64 compressedBytes = 0;
+  xuint64 deltaBytes = 0;
+  XTime encodeTime;
+  XTime decodeTime;
+  int failures = 0;
+
+  for(int i=0; i<edits; ++i)
+    {
+    // nudge one transform, as an edit in the viewer would.
+    XEnvironmentArea::MeshPair &pair = meshes[qrand() % meshes.size()];
+    pair.transform().translate(XVector3D(0.1f, 0.0f, 0.0f));
+
+    QByteArray next = saveArea(meshes);
+
+    fullBytes += messageSize(next.size() + sizeof(quint32));
+    compressedBytes += messageSize(XEnvironmentCodec::compress(next).size() + sizeof(quint32));
+
+    XTime start = XTime::now();
+    XEnvironmentCodec::Encoding encoding;
+    QByteArray encoded = XEnvironmentCodec::encode(next, current, &encoding);
+    encodeTime += XTime::now() - start;
+    deltaBytes += messageSize(encoded.size() + sizeof(quint32));
+
+    start = XTime::now();
+    QByteArray decoded;
+    bool ok = XEnvironmentCodec::decode(encoded, encoding, current, decoded);
+    decodeTime += XTime::now() - start;
+    if(!ok || decoded != next)
+      {
+      ++failures;
+      }
+
+    current = next;
+    }
+
+  qDebug() << "Bytes on the wire per client, full:" << fullBytes << "compressed:" << compressedBytes << "delta:" << deltaBytes;
+  qDebug() << "Delta encode ms:" << encodeTime.milliseconds() / xMax(edits, 1) << "decode ms:" << decodeTime.milliseconds() / xMax(edits, 1);
+
+  // many small requests, sent one message each or as one batch.
+  const int requests = 64;
+  xuint64 single = requests * messageSize(sizeof(quint32));
+  qDebug() << requests << "requests, separately:" << requests << "messages" << single << "bytes,"
+           << "batched: 1 message" << messageSize(single + sizeof(quint32)) << "bytes";
+
+  if(failures)
+    {
+    qWarning() << failures << "edits didn't decode to their data";
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
@@ -0,0 +1,111 @@
+#include "benchmarks.h"
+#include "XEnvironmentVisibility.h"
+#include "XTime"
+#include "QDataStream"
+#include "QDebug"
+
+namespace
+{
+enum
+  {
+  BlockSize = 10,
+  StreetWidth = 10,
+  BlockHeight = 30
+  };
+
+// a square city of [blocks] x [blocks] solid blocks, split by streets.
+XEnvironmentVisibility::ItemList makeCity(int blocks)
+  {
+  XEnvironmentVisibility::ItemList items;
+  for(int x=0; x<blocks; ++x)
+    {
+    for(int z=0; z<blocks; ++z)
+      {
+      XVector3D minimum(x * (BlockSize + StreetWidth), 0, z * (BlockSize + StreetWidth));
+      XCuboid bounds(minimum, minimum + XVector3D(BlockSize, BlockHeight, BlockSize));
+      items << XEnvironmentVisibility::Item(items.size(), bounds);
+      }
+    }
+  return items;
+  }
+}
+
+int environmentVisibilityBenchmark(const QStringList &args)
+  {
+  int blocks = args.size() > 0 ? args[0].toInt() : 40;
+  xuint32 samples = args.size() > 1 ? args[1].toUInt() : 8;
+  xuint32 rays = args.size() > 2 ? args[2].toUInt() : 128;
+
+  XEnvironmentVisibility::ItemList items = makeCity(blocks);
+  xReal extent = blocks * (BlockSize + StreetWidth);
+  XCuboid bounds(XVector3D(-StreetWidth, -1, -StreetWidth), XVector3D(extent, BlockHeight + 10, extent));
+
+  XTime start = XTime::now();
+  XEnvironmentVisibility visibility;
+  visibility.build(bounds, items);
+  qDebug() << items.size() << "blocks, built" << visibility.nodeCount() << "nodes" << visibility.leafCount() << "leaves in" << (XTime::now() - start).milliseconds() << "ms";
+
+  start = XTime::now();
+  visibility.computeVisibility(samples, rays);
+  qDebug() << "Sampled" << samples << "x" << rays << "rays per leaf in" << (XTime::now() - start).milliseconds() << "ms";
+
+  // the dense visboxes at the size of the smallest leaf, each holding an item list.
+  xuint32 cells = 1;
+  while(cells * cells * cells < visibility.leafCount())
+    {
+    cells *= 2;
+    }
+  qDebug() << "Sparse:" << visibility.memoryUsage() / 1024 << "KB," << visibility.visibleSetCount() << "sets."
+           << "Dense grid of" << cells * cells * cells << "visboxes holds at least" << (cells * cells * cells * sizeof(quint32)) / 1024 << "KB of list sizes alone";
+
+  const int queries = 1000000;
+  xuint64 visible = 0;
+  xuint32 failures = 0;
+  start = XTime::now();
+  for(int i=0; i<queries; ++i)
+    {
+    XVector3D point((xuint32)(i * 7919u) % (xuint32)extent, 1.0f, (xuint32)(i * 104729u) % (xuint32)extent);
+    visible += visibility.visibleFrom(point).size();
+    }
+  double queryTime = (XTime::now() - start).milliseconds();
+  qDebug() << queries << "point queries in" << queryTime << "ms," << (double)visible / queries << "of" << items.size() << "items visible on average";
+
+  // standing at the corner of a block, it has to be visible.
+  for(int i=0; i<items.size(); i+=xMax(1, items.size() / 100))
+    {
+    XVector3D point = items[i].bounds().minimum() + XVector3D(0.0f, 1.0f, 0.0f);
+    if(!visibility.visibleFrom(point).contains(i))
+      {
+      ++failures;
+      }
+    }
+
+  QByteArray data;
+    {
+    QDataStream str(&data, QIODevice::WriteOnly);
+    str << visibility;
+    }
+
+  XEnvironmentVisibility restored;
+    {
+    QDataStream str(data);
+    str >> restored;
+    }
+  qDebug() << "Serialised to" << data.size() / 1024 << "KB";
+
+  for(int i=0; i<1000; ++i)
+    {
+    XVector3D point((xuint32)(i * 7919u) % (xuint32)extent, 1.0f, (xuint32)(i * 104729u) % (xuint32)extent);
+    if(restored.visibleFrom(point) != visibility.visibleFrom(point))
+      {
+      ++failures;
+      }
+    }
+
+  if(failures)
+    {
+    qWarning() << failures << "visibility checks failed";
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
@@ -0,0 +1,319 @@
+#include "benchmarks.h"
+#include "XGLStateCache.h"
+#include "XTime"
+#include "QDebug"
+#include "string.h"
+
+namespace
+{
+enum
+  {
+  Programs = 4,
+  Textures = 8,
+  Attributes = 3,
+  // GL_TRIANGLES
+  TrianglesMode = 4
+  };
+
+// a model of the GL state, fed by the cache's function table. Counts every call, and the calls which
+// wouldn't have changed anything.
+class MockGL
+  {
+public:
+  void reset()
+    {
+    memset(this, 0, sizeof(MockGL));
+    // GL starts uniforms at 0, the cache doesn't assume that, so the first upload of 0 wouldn't be redundant.
+    for(int p=0; p<=Programs; ++p)
+      {
+      for(int u=0; u<8; ++u)
+        {
+        uniforms[p][u] = -1.0f;
+        }
+      }
+    }
+
+  xuint64 calls;
+  xuint64 redundant;
+  xuint64 draws;
+  xuint64 queries;
+  xuint64 toggles;
+
+  unsigned int program;
+  int activeUnit;
+  unsigned int textures[XGLStateCache::MaximumTextureUnits];
+  unsigned int arrayBuffer;
+  unsigned int elementBuffer;
+  bool enabled[XGLStateCache::MaximumAttributes];
+  unsigned int attributeBuffers[XGLStateCache::MaximumAttributes];
+  xsize attributeOffsets[XGLStateCache::MaximumAttributes];
+  // the first float of each uniform, enough to tell the values used here apart.
+  float uniforms[Programs + 1][8];
+  };
+
+MockGL gl;
+
+void change(bool changed)
+  {
+  ++gl.calls;
+  if(!changed)
+    {
+    ++gl.redundant;
+    }
+  }
+
+void useProgram(unsigned int program)
+  {
+  change(gl.program != program);
+  gl.program = program;
+  }
+
+int uniformLocation(unsigned int, const char *name)
+  {
+  ++gl.calls;
+  ++gl.queries;
+  return name[0] - 'a';
+  }
+
+int attributeLocation(unsigned int, const char *name)
+  {
+  ++gl.calls;
+  ++gl.queries;
+  return name[0] - 'a';
+  }
+
+void setUniform(int location, float value)
+  {
+  change(gl.uniforms[gl.program][location] != value);
+  gl.uniforms[gl.program][location] = value;
+  }
+
+void uniformInts(int location, int, const int *values)
+  {
+  setUniform(location, values[0]);
+  }
+
+void uniformFloats(int location, int, int, const float *values)
+  {
+  setUniform(location, values[0]);
+  }
+
+void uniformMatrices(int location, int, int, int, const float *values)
+  {
+  setUniform(location, values[0]);
+  }
+
+void activeTexture(int unit)
+  {
+  change(gl.activeUnit != unit);
+  gl.activeUnit = unit;
+  }
+
+void bindTexture(unsigned int texture)
+  {
+  change(gl.textures[gl.activeUnit] != texture);
+  gl.textures[gl.activeUnit] = texture;
+  }
+
+void bindArrayBuffer(unsigned int buffer)
+  {
+  change(gl.arrayBuffer != buffer);
+  gl.arrayBuffer = buffer;
+  }
+
+void bindElementBuffer(unsigned int buffer)
+  {
+  change(gl.elementBuffer != buffer);
+  gl.elementBuffer = buffer;
+  }
+
+void enableAttribute(int location)
+  {
+  ++gl.toggles;
+  change(!gl.enabled[location]);
+  gl.enabled[location] = true;
+  }
+
+void disableAttribute(int location)
+  {
+  ++gl.toggles;
+  change(gl.enabled[location]);
+  gl.enabled[location] = false;
+  }
+
+void attributePointer(int location, int, int, xsize offset)
+  {
+  change(gl.attributeBuffers[location] != gl.arrayBuffer || gl.attributeOffsets[location] != offset);
+  gl.attributeBuffers[location] = gl.arrayBuffer;
+  gl.attributeOffsets[location] = offset;
+  }
+
+void drawElements(int, int)
+  {
+  ++gl.calls;
+  ++gl.draws;
+  }
+
+const XGLStateCache::Functions mockFunctions =
+  {
+  useProgram,
+  uniformLocation,
+  attributeLocation,
+  uniformInts,
+  uniformFloats,
+  uniformMatrices,
+  activeTexture,
+  bindTexture,
+  bindArrayBuffer,
+  bindElementBuffer,
+  enableAttribute,
+  disableAttribute,
+  attributePointer,
+  drawElements
+  };
+
+// what XGLRenderer does for an object: bind its shader, its texture, then draw its geometry.
+void drawObject(XGLStateCache &state, int object)
+  {
+  // programs are numbered from 1, buffers from 1, leaving 0 as GL's "none".
+  unsigned int program = 1 + (object % Programs);
+  unsigned int buffer = 1 + object;
+
+  state.useProgram(program);
+
+  int unit = 0;
+  state.bindTexture(unit, 1 + (object % Textures));
+  state.setUniform(program, state.uniformLocation(program, "a"), &unit, 1);
+
+  float colour[4] = { (float)(object % 3), 0.5f, 0.5f, 1.0f };
+  state.setUniform(program, state.uniformLocation(program, "b"), colour, 4, 1);
+
+  static const char *attributes[Attributes] = { "a", "b", "c" };
+  state.beginAttributes();
+  for(int i=0; i<Attributes; ++i)
+    {
+    state.setAttribute(state.attributeLocation(program, attributes[i]), buffer, 3, 0, i * 1024);
+    }
+  state.endAttributes();
+
+  state.bindElementBuffer(buffer);
+  state.drawElements(TrianglesMode, 36);
+  }
+
+// after drawObject, exactly the arrays it uses are enabled.
+bool arraysEnabled()
+  {
+  for(int i=0; i<XGLStateCache::MaximumAttributes; ++i)
+    {
+    if(gl.enabled[i] != (i < Attributes))
+      {
+      return false;
+      }
+    }
+  return true;
+  }
+}
+
+// drives XGLStateCache with a model of GL, checking it never makes a call which leaves GL unchanged, and that
+// drawing the same object again only issues the draw.
+int glStateCacheBenchmark(const QStringList &args)
+  {
+  int objects = args.size() > 0 ? args[0].toInt() : 1000;
+  int frames = args.size() > 1 ? args[1].toInt() : 100;
+
+  gl.reset();
+  XGLStateCache state(mockFunctions);
+
+  int failures = 0;
+
+  // the first draw sets everything up, including disabling arrays the cache can't know are disabled, repeats
+  // should be just the draw.
+  drawObject(state, 0);
+  xuint64 firstCalls = gl.calls;
+  if(!arraysEnabled())
+    {
+    qWarning() << "The first draw didn't enable exactly the arrays it uses";
+    ++failures;
+    }
+
+  gl.calls = 0;
+  gl.redundant = 0;
+  gl.toggles = 0;
+  for(int i=0; i<100; ++i)
+    {
+    drawObject(state, 0);
+    }
+  if(gl.calls != 100)
+    {
+    qWarning() << "Repeated draws made" << gl.calls - 100 << "state calls";
+    ++failures;
+    }
+  if(gl.toggles)
+    {
+    qWarning() << "Repeated draws enabled or disabled arrays" << gl.toggles << "times";
+    ++failures;
+    }
+
+  // a scene of different objects, drawn in the same order each frame.
+  gl.calls = 0;
+  state.resetStats();
+  XTime start = XTime::now();
+  for(int f=0; f<frames; ++f)
+    {
+    for(int o=0; o<objects; ++o)
+      {
+      drawObject(state, o);
+      }
+    }
+  double elapsed = (XTime::now() - start).milliseconds();
+
+  const XGLStateCache::Stats &stats = state.stats();
+  qDebug() << "first draw" << firstCalls << "calls, then" << (double)(gl.calls - gl.draws) / (frames * objects) << "state calls a draw,"
+           << elapsed * 1000000.0 / (frames * objects) << "ns a draw";
+  qDebug() << "skipped" << stats.redundantProgramBinds << "program binds," << stats.redundantUniformUploads << "uniform uploads,"
+           << stats.redundantTextureBinds << "texture binds," << stats.redundantBufferBinds << "buffer binds,"
+           << stats.redundantAttributeChanges << "attribute changes," << gl.queries << "location queries";
+
+  if(gl.redundant)
+    {
+    qWarning() << gl.redundant << "calls left GL unchanged";
+    ++failures;
+    }
+
+  // deleting a buffer unbinds it, forgetting it must make the next draw using its name bind it again.
+  drawObject(state, 0);
+  state.forgetBuffer(1);
+  gl.elementBuffer = 0;
+  for(int i=0; i<XGLStateCache::MaximumAttributes; ++i)
+    {
+    if(gl.attributeBuffers[i] == 1)
+      {
+      gl.attributeBuffers[i] = 0;
+      }
+    }
+  if(gl.arrayBuffer == 1)
+    {
+    gl.arrayBuffer = 0;
+    }
+  drawObject(state, 0);
+  if(gl.attributeBuffers[0] != 1 || gl.elementBuffer != 1)
+    {
+    qWarning() << "A forgotten buffer wasn't rebound";
+    ++failures;
+    }
+
+  // after invalidating, the cache can't know which arrays are enabled, as if other code had changed them.
+  state.invalidate();
+  for(int i=0; i<XGLStateCache::MaximumAttributes; ++i)
+    {
+    gl.enabled[i] = i >= Attributes;
+    }
+  drawObject(state, 0);
+  if(!arraysEnabled())
+    {
+    qWarning() << "A draw after invalidating didn't enable exactly the arrays it uses";
+    ++failures;
+    }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
@@ -0,0 +1,61 @@
+#include "QCoreApplication"
+#include "QStringList"
+#include "QDebug"
+#include "benchmarks.h"
+
+typedef int (*Benchmark)(const QStringList &);
+
+struct BenchmarkEntry
+  {
+  const char *name;
+  Benchmark function;
+  };
+
+static const BenchmarkEntry benchmarks[] =
+  {
+  { "meshOptimiser", meshOptimiserBenchmark },
+  { "colladaImport", colladaImportBenchmark },
+  { "meshContainer", meshContainerBenchmark },
+  { "environmentTransfer", environmentTransferBenchmark },
+  { "environmentVisibility", environmentVisibilityBenchmark },
+  { "environmentLOD", environmentLODBenchmark },
+  { "softwareRenderer", softwareRendererBenchmark },
+  { "glStateCache", glStateCacheBenchmark },
+  };
+
+int main(int argc, char *argv[])
+  {
+  QCoreApplication app(argc, argv);
+
+  QStringList args = app.arguments();
+  args.removeFirst();
+
+  QString selected;
+  if(args.size())
+    {
+    selected = args.takeFirst();
+    }
+
+  int result = EXIT_SUCCESS;
+  bool found = false;
+  for(xsize i=0; i<sizeof(benchmarks)/sizeof(benchmarks[0]); ++i)
+    {
+    if(selected.isEmpty() || selected == benchmarks[i].name)
+      {
+      qDebug() << "Running" << benchmarks[i].name;
+      found = true;
+      if(benchmarks[i].function(args) != EXIT_SUCCESS)
+        {
+        result = EXIT_FAILURE;
+        }
+      }
+    }
+
+  if(!found)
+    {
+    qWarning() << "Unknown benchmark" << selected;
+    return EXIT_FAILURE;
+    }
+
+  return result;
+  }
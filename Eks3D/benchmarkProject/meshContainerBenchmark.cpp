@@ -0,0 +1,158 @@
+#include "benchmarks.h"
+#include "XGeometry.h"
+#include "XMeshContainer.h"
+#include "XTime"
+#include "QDataStream"
+#include "QDebug"
+#include "math.h"
+
+namespace
+{
+XGeometry makeGrid(int size)
+  {
+  XVector<XVector3D> positions;
+  XVector<XVector3D> normals;
+  XVector<XVector2D> textures;
+  XVector<unsigned int> triangles;
+
+  for(int y=0; y<=size; ++y)
+    {
+    for(int x=0; x<=size; ++x)
+      {
+      float height = sinf(x * 0.1f) * cosf(y * 0.1f);
+      positions << XVector3D(x * 0.25f, height, y * -0.25f);
+      normals << XVector3D(-cosf(x * 0.1f) * cosf(y * 0.1f) * 0.4f, 1.0f, -sinf(x * 0.1f) * sinf(y * 0.1f) * 0.4f).normalized();
+      textures << XVector2D((float)x / size, (float)y / size);
+      }
+    }
+
+  for(int y=0; y<size; ++y)
+    {
+    for(int x=0; x<size; ++x)
+      {
+      unsigned int a = y * (size + 1) + x;
+      triangles << a << a + 1 << a + size + 2 << a << a + size + 2 << a + size + 1;
+      }
+    }
+
+  XGeometry geo;
+  geo.setAttribute("vertex", positions);
+  geo.setAttribute("normal", normals);
+  geo.setAttribute("texture", textures);
+  geo.setTriangles(triangles);
+  return geo;
+  }
+
+float maxError(const XVector<XVector3D> &a, const XVector<XVector3D> &b)
+  {
+  float error = 0.0f;
+  for(int i=0; i<a.size(); ++i)
+    {
+    error = xMax(error, (a[i] - b[i]).norm());
+    }
+  return error;
+  }
+
+void report(const char *stage, const XTime &time, int iterations, int bytes)
+  {
+  qDebug() << stage << "ms:" << time.milliseconds() / iterations << "bytes:" << bytes;
+  }
+}
+
+// meshContainer [grid size] [iterations]
+int meshContainerBenchmark(const QStringList &args)
+  {
+  int size = args.size() >= 1 ? args[0].toInt() : 512;
+  int iterations = args.size() >= 2 ? args[1].toInt() : 10;
+
+  XGeometry geo(makeGrid(size));
+  qDebug() << "Vertices:" << geo.attributes3D()["vertex"].size() << "triangles:" << geo.triangles().size() / 3;
+
+  // QDataStream path
+  QByteArray streamed;
+  XTime start = XTime::now();
+  for(int i=0; i<iterations; ++i)
+    {
+    streamed.clear();
+    QDataStream str(&streamed, QIODevice::WriteOnly);
+    str << geo;
+    }
+  report("QDataStream write", XTime::now() - start, iterations, streamed.size());
+
+  start = XTime::now();
+  for(int i=0; i<iterations; ++i)
+    {
+    XGeometry read;
+    QDataStream str(&streamed, QIODevice::ReadOnly);
+    str >> read;
+    }
+  report("QDataStream read", XTime::now() - start, iterations, streamed.size());
+
+  // container path
+  XMeshContainer container;
+  start = XTime::now();
+  for(int i=0; i<iterations; ++i)
+    {
+    container = XMeshContainer::create(geo);
+    }
+  report("Container write", XTime::now() - start, iterations, container.data().size());
+
+  // receiving a copy of the bytes, as the network would give us.
+  QByteArray received(container.data().constData(), container.data().size());
+  start = XTime::now();
+  for(int i=0; i<iterations; ++i)
+    {
+    XMeshContainer in;
+    in.setData(received);
+    XGeometry wrapped(in);
+    }
+  report("Container wrap", XTime::now() - start, iterations, received.size());
+
+  start = XTime::now();
+  for(int i=0; i<iterations; ++i)
+    {
+    XMeshContainer in;
+    in.setData(received, false);
+    XGeometry wrapped(in);
+    }
+  report("Container wrap (no checksum)", XTime::now() - start, iterations, received.size());
+
+  start = XTime::now();
+  for(int i=0; i<iterations; ++i)
+    {
+    XMeshContainer in;
+    in.setData(received);
+    XGeometry wrapped(in);
+    wrapped.triangles();
+    }
+  report("Container wrap and unpack", XTime::now() - start, iterations, received.size());
+
+  // quantised
+  XMeshContainer quantised = XMeshContainer::create(geo, XMeshContainer::QuantiseAll);
+  XGeometry unpacked(quantised);
+  qDebug() << "Quantised bytes:" << quantised.data().size()
+           << "position error:" << maxError(geo.attributes3D()["vertex"], unpacked.attributes3D()["vertex"])
+           << "normal error:" << maxError(geo.attributes3D()["normal"], unpacked.attributes3D()["normal"]);
+
+  if(unpacked.triangles() != geo.triangles())
+    {
+    qWarning() << "Container round trip changed the triangles";
+    return EXIT_FAILURE;
+    }
+
+  // damaged headers from the network, an attribute count large enough to wrap the descriptors' size, and
+  // moved indices, must be rejected, even without the checksum for the first.
+  QByteArray wrapping(received);
+  reinterpret_cast<XMeshContainer::Header *>(wrapping.data())->attributeCount = 0x10000000;
+  QByteArray moved(received);
+  reinterpret_cast<XMeshContainer::Header *>(moved.data())->indexOffset[XMeshContainer::Triangles] -= XMeshContainer::Alignment;
+
+  XMeshContainer damaged;
+  if(damaged.setData(wrapping, false) || damaged.setData(moved))
+    {
+    qWarning() << "A damaged container header was accepted";
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+  }
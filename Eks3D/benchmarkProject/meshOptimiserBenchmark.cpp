@@ -0,0 +1,70 @@
+#include "benchmarks.h"
+#include "XColladaFile.h"
+#include "XGeometry.h"
+#include "XMeshOptimiser.h"
+#include "XTime"
+#include "QDebug"
+
+namespace
+{
+int vertexCount(const XGeometry &geo)
+  {
+  return geo.attributes3D()["vertex"].size();
+  }
+
+void report(const char *stage, const XGeometry &geo, const XTime &time)
+  {
+  qDebug() << stage
+           << "vertices:" << vertexCount(geo)
+           << "triangles:" << geo.triangles().size() / 3
+           << "ACMR(16):" << XMeshOptimiser::averageCacheMissRatio(geo.triangles(), 16)
+           << "ACMR(32):" << XMeshOptimiser::averageCacheMissRatio(geo.triangles(), 32)
+           << "ms:" << time.milliseconds();
+  }
+}
+
+int meshOptimiserBenchmark(const QStringList &args)
+  {
+  QString file = args.size() ? args.front() : benchmarkDataFile("duck.dae");
+
+  XColladaFile col(file);
+  if(col.geometryNames().isEmpty())
+    {
+    qWarning() << "No geometry found in" << file;
+    return EXIT_FAILURE;
+    }
+
+  XGeometry geo(col.geometry(col.geometryNames().front()));
+  report("Imported", geo, XTime());
+  int importedVertices = vertexCount(geo);
+
+  XTime start = XTime::now();
+  XMeshOptimiser::weldVertices(&geo);
+  report("Welded", geo, XTime::now() - start);
+
+  start = XTime::now();
+  XMeshOptimiser::optimiseVertexCache(&geo);
+  report("Vertex cache", geo, XTime::now() - start);
+
+  start = XTime::now();
+  XMeshOptimiser::optimiseVertexFetch(&geo);
+  report("Vertex fetch", geo, XTime::now() - start);
+
+  qDebug() << "Vertex reduction:" << 100.0f * (1.0f - (float)vertexCount(geo) / importedVertices) << "%";
+
+  start = XTime::now();
+  XVector<XMeshOptimiser::LOD> lods = XMeshOptimiser::generateLODs(geo, 5);
+  qDebug() << "Generated" << lods.size() << "LODs in" << (XTime::now() - start).milliseconds() << "ms";
+
+  foreach(const XMeshOptimiser::LOD &lod, lods)
+    {
+    qDebug() << "  LOD"
+             << "triangles:" << lod.geometry.triangles().size() / 3
+             << "vertices:" << vertexCount(lod.geometry)
+             << "error:" << lod.error
+             << "distance:" << lod.minimumDistance << "-" << lod.maximumDistance
+             << "ACMR(32):" << XMeshOptimiser::averageCacheMissRatio(lod.geometry.triangles(), 32);
+    }
+
+  return EXIT_SUCCESS;
+  }
@@ -0,0 +1,219 @@
+#include "benchmarks.h"
+#include "XSoftwareRenderer.h"
+#include "XGeometry.h"
+#include "XShader.h"
+#include "XTexture.h"
+#include "XTime"
+#include "QDebug"
+#include "math.h"
+
+namespace
+{
+enum
+  {
+  CountShader = 100,
+  FanSegments = 36
+  };
+
+void countVertex(const XSoftwareRenderer::ShaderState &, const XVector4D *attributes, XVector4D &position, float *)
+  {
+  position = XVector4D(attributes[0].x(), attributes[0].y(), 0.0f, 1.0f);
+  }
+
+// adds one step of red each time a pixel is drawn.
+bool countFragment(const XSoftwareRenderer::ShaderState &, const float *, xReal, xReal, XVector4D &colour)
+  {
+  colour = XVector4D(1.0f / 255.0f, 0.0f, 0.0f, 1.0f);
+  return true;
+  }
+
+// a fan of thin triangles around an off centre point, covering the whole viewport.
+XGeometry makeFan()
+  {
+  XVector<XVector3D> points;
+  XVector<unsigned int> triangles;
+  points << XVector3D(0.123f, -0.377f, 0.0f);
+  for(int i=0; i<FanSegments; ++i)
+    {
+    // walk around the edge of the [-1, 1] square, passing each corner.
+    xReal s = 8.0f * i / FanSegments;
+    xReal side = s - 2.0f * floorf(s / 2.0f);
+    switch((int)(s / 2.0f))
+      {
+    case 0: points << XVector3D(-1.0f + side, -1.0f, 0.0f); break;
+    case 1: points << XVector3D(1.0f, -1.0f + side, 0.0f); break;
+    case 2: points << XVector3D(1.0f - side, 1.0f, 0.0f); break;
+    default: points << XVector3D(-1.0f, 1.0f - side, 0.0f); break;
+      }
+    triangles << 0 << 1 + i << 1 + (i + 1) % FanSegments;
+    }
+
+  XGeometry fan;
+  fan.setAttribute("vertex", points);
+  fan.setTriangles(triangles);
+  return fan;
+  }
+
+// a rolling ground plane of [size] x [size] quads, running from behind the camera into the distance.
+XGeometry makeTerrain(int size)
+  {
+  XVector<XVector3D> points;
+  XVector<XVector3D> normals;
+  XVector<XVector2D> uvs;
+  XVector<unsigned int> triangles;
+  for(int z=0; z<=size; ++z)
+    {
+    for(int x=0; x<=size; ++x)
+      {
+      xReal height = 0.3f * sinf(x * 0.3f) * cosf(z * 0.2f);
+      points << XVector3D(x - size * 0.5f, height - 1.0f, 5.0f - z);
+      normals << XVector3D(-0.09f * cosf(x * 0.3f) * cosf(z * 0.2f), 1.0f, 0.06f * sinf(x * 0.3f) * sinf(z * 0.2f)).normalized();
+      uvs << XVector2D(x * 0.1f, z * 0.1f);
+      }
+    }
+
+  for(int z=0; z<size; ++z)
+    {
+    for(int x=0; x<size; ++x)
+      {
+      unsigned int a = z * (size + 1) + x;
+      triangles << a << a + 1 << a + size + 1;
+      triangles << a + 1 << a + size + 2 << a + size + 1;
+      }
+    }
+
+  XGeometry terrain;
+  terrain.setAttribute("vertex", points);
+  terrain.setAttribute("normals", normals);
+  terrain.setAttribute("normal", normals);
+  terrain.setAttribute("texture", uvs);
+  terrain.setTriangles(triangles);
+  return terrain;
+  }
+
+XComplexTransform perspective(int width, int height)
+  {
+  const xReal nearPlane = 0.1f;
+  const xReal farPlane = 100.0f;
+  const xReal f = 1.0f / tanf(0.5f);
+
+  XComplexTransform proj = XComplexTransform::Identity();
+  proj.matrix() << f * height / width, 0, 0, 0,
+                   0, f, 0, 0,
+                   0, 0, (farPlane + nearPlane) / (nearPlane - farPlane), 2.0f * farPlane * nearPlane / (nearPlane - farPlane),
+                   0, 0, -1, 0;
+  return proj;
+  }
+
+QImage renderTerrain(XSoftwareRenderer &r, const XGeometry &terrain, const XShader &shader, int frames, double &time)
+  {
+  XTime start = XTime::now();
+  for(int f=0; f<frames; ++f)
+    {
+    r.clear();
+    r.setShader(&shader);
+    r.drawGeometry(terrain);
+    r.flush();
+    }
+  time = (XTime::now() - start).milliseconds() / frames;
+  return r.colour();
+  }
+}
+
+// renders a terrain with the Default and AmbientShader programs, checks tiles drawn on several threads match
+// one thread, and that triangles sharing edges neither overlap nor leave gaps.
+int softwareRendererBenchmark(const QStringList &args)
+  {
+  int width = args.size() > 0 ? args[0].toInt() : 1280;
+  int height = args.size() > 1 ? args[1].toInt() : 720;
+  int frames = args.size() > 2 ? args[2].toInt() : 20;
+  int size = args.size() > 3 ? args[3].toInt() : 200;
+
+  xuint32 failures = 0;
+
+  XSoftwareRenderer single(1);
+  XSoftwareRenderer threaded;
+  XSoftwareRenderer *renderers[] = { &single, &threaded };
+
+  QImage checker(64, 64, QImage::Format_ARGB32);
+  for(int y=0; y<checker.height(); ++y)
+    {
+    for(int x=0; x<checker.width(); ++x)
+      {
+      checker.setPixel(x, y, ((x / 8 + y / 8) & 1) ? qRgb(255, 255, 255) : qRgb(40, 90, 200));
+      }
+    }
+
+  QImage images[2][2];
+  for(int i=0; i<2; ++i)
+    {
+    // geometry and shaders belong to one renderer.
+    XGeometry terrain = makeTerrain(size);
+    XShader def(XShader::Default);
+    XShader blinn(XShader::AmbientShader);
+    blinn.getVariable("ambientTexture")->setValue(XTexture(checker));
+
+    XSoftwareRenderer &r = *renderers[i];
+    r.setViewportSize(QSize(width, height));
+    r.setProjectionTransform(perspective(width, height));
+    r.setRenderFlags(XRenderer::DepthTest|XRenderer::BackfaceCulling);
+
+    double defaultTime = 0.0;
+    double blinnTime = 0.0;
+    images[i][0] = renderTerrain(r, terrain, def, frames, defaultTime);
+    images[i][1] = renderTerrain(r, terrain, blinn, frames, blinnTime);
+
+    qDebug() << (i ? "Threaded:" : "Single thread:") << width << "x" << height << "," << terrain.triangles().size() / 3 << "triangles,"
+             << defaultTime << "ms a frame with the default shader," << blinnTime << "ms with ambient";
+    }
+
+  for(int s=0; s<2; ++s)
+    {
+    if(images[0][s] != images[1][s])
+      {
+      qWarning() << "Threaded render differs from single threaded render";
+      ++failures;
+      }
+    }
+
+  // every pixel under the fan must be drawn exactly once.
+  XSoftwareRenderer::Program count;
+  count.attributes << "vertex";
+  count.vertex = countVertex;
+  count.fragment = countFragment;
+  threaded.setProgram(CountShader, count);
+  threaded.setProjectionTransform(XComplexTransform::Identity());
+  threaded.setRenderFlags(XRenderer::AlphaBlending);
+  threaded.setViewportSize(QSize(width + 13, height + 7));
+  threaded.clear();
+
+  XShader countShader(CountShader);
+  XGeometry fan = makeFan();
+  threaded.setShader(&countShader);
+  threaded.drawGeometry(fan);
+
+  QImage coverage = threaded.colour();
+  xuint32 wrong = 0;
+  for(int y=0; y<coverage.height(); ++y)
+    {
+    for(int x=0; x<coverage.width(); ++x)
+      {
+      if(qRed(coverage.pixel(x, y)) != 1)
+        {
+        ++wrong;
+        }
+      }
+    }
+
+  if(wrong)
+    {
+    qWarning() << wrong << "pixels under the fan were not drawn exactly once";
+    ++failures;
+    }
+
+  if(failures)
+    {
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
@@ -14,6 +14,12 @@ public:
   virtual void update(const XAbstractCanvas *, const XAbstractRenderModel::Iterator *, const XAbstractRenderModel *) const { };
   virtual void paint(xuint32 pass, XAbstractCanvas *, const XAbstractRenderModel::Iterator *, const XAbstractRenderModel *) const = 0;
   virtual xuint32 maxNumberOfPasses(XAbstractCanvas *, const XAbstractRenderModel::Iterator *, const XAbstractRenderModel *) const { return 1; }
+
+  // called once on each delegate painting in a canvas, before and after each of its passes. A delegate which paints
+  // the whole pass itself returns true from beginPass, if every delegate does the items aren't visited, otherwise
+  // it is still given its items, and should skip them.
+  virtual bool beginPass(xuint32, XAbstractCanvas *, const XAbstractRenderModel *) const { return false; }
+  virtual void endPass(xuint32, XAbstractCanvas *, const XAbstractRenderModel *) const { }
   };
 
 #endif // XABSTRACTDELEGATE_H
@@ -3,6 +3,7 @@
 
 #include "XGlobal"
 #include "XProperty"
+#include "XList"
 #include "XEnvironmentRequest.h"
 
 class XEnvironmentItemDefinition;
@@ -23,7 +24,12 @@ public:
   virtual void poll();
 
   virtual void requestItem( const ItemRequest & ) = 0;
+  // request many items at once, implementations can send them together. Calls requestItem by default.
+  virtual void requestItems( const XList<ItemRequest> & );
   virtual void syncItem( const ItemRequest & ) = 0;
+  // the controller no longer needs a request which has been sent. Its reply must still be delivered, the
+  // controller discards it, so this is only a hint, does nothing by default.
+  virtual void cancelItem( const ItemRequest & );
   };
 
 #endif // XABSTRACTENVIRONMENTINTERFACE_H
@@ -36,6 +36,12 @@ public:
 
   virtual void resetIterator(Iterator *) const = 0;
 
+  // reset [it] to visit the items which may paint in [canvas], models which can find those cheaply should
+  // skip the rest. By default every item is visited.
+  virtual void resetPaintIterator(Iterator *it, const XAbstractCanvas *canvas) const;
+  // reset [it] to visit the items an update of [canvas] should lay out again, by default every item.
+  virtual void resetUpdateIterator(Iterator *it, const XAbstractCanvas *canvas) const;
+
   virtual const XAbstractDelegate *delegateFor(Iterator *, const XAbstractCanvas *) const = 0;
 
 private:
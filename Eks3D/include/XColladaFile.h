@@ -2,25 +2,22 @@
 #define XCOLLADAFILE_H
 
 #include "X3DGlobal.h"
-#include "QDomDocument"
 #include "XHash"
+#include "XGeometry.h"
 #include "QStringList"
 
-class XGeometry;
-class QDomElement;
-
 class EKS3D_EXPORT XColladaFile
     {
 public:
-    XColladaFile( QString );
-    
+    // parses all geometry in the file, each <geometry> element is parsed on its own thread.
+    XColladaFile( QString, int maxThreads = -1 );
+
     bool geometryExists( QString );
     QStringList geometryNames() const;
     XGeometry geometry( QString ) const;
 
 private:
-    XHash <QString, QDomElement> _geometries;
-    QDomDocument _document;
+    XHash <QString, XGeometry> _geometries;
     };
 
 #endif // XCOLLADA_H
@@ -3,7 +3,10 @@
 
 #include "XProperty"
 #include "QMutex"
+#include "QThreadPool"
 #include "XHash"
+#include "XSet"
+#include "XVector"
 #include "XTexture.h"
 #include "XShader.h"
 #include "XEnvironmentArea.h"
@@ -11,7 +14,9 @@
 
 class XRenderer;
 class XAbstractEnvironmentInterface;
+class XEnvironmentDiskCache;
 class XPerspectiveCamera;
+class XCuboid;
 
 class EKS3D_EXPORT XEnvironment
   {
@@ -90,23 +95,43 @@ public:
 
   enum SpecialIdentifier
     {
-    CreateItem
+    CreateItem,
+    // the extra data is a run of framed requests, sent as one message.
+    Batch
     };
 
 XProperties:
   XROProperty(XAbstractEnvironmentInterface *, environmentInterface);
+  // the most requests which can be sent to the interface and not yet complete, queued requests wait for a slot.
+  XProperty(xuint32, maximumInFlight, setMaximumInFlight);
 
 public:
   class EKS3D_EXPORT Listener
     {
   public:
+    // called from update(), on the thread which owns the environment.
     virtual void onRequestComplete(const Request &request) = 0;
+    // called on a decode thread when decoded requests are waiting, use it to schedule an update().
+    virtual void onRequestsDecoded() { }
     };
 
   XEnvironment(XAbstractEnvironmentInterface *i, Listener *l);
-
-
-  void requestComplete(xuint32 requestID);
+  ~XEnvironment();
+
+  // called by the interface when a request's data arrives, the data is decoded on a worker thread
+  // and installed by the next update().
+  void receive(const Request &req);
+  // install decoded data, notify the listener and send queued requests. Call regularly (ie. each frame).
+  void update();
+
+  // keep received items in [directory] between runs. Cached items are loaded from disk once the server
+  // has confirmed their version, and before that the server only sends them if they've changed.
+  void setDiskCache(const QString &directory);
+  XEnvironmentDiskCache *diskCache() const { return _diskCache; }
+  // check the version of every cached item with the server, in one batch.
+  void validateDiskCache();
+  // the cached data for [req] at [version], if there is a disk cache which has it.
+  bool cachedData(const Request &req, xuint32 version, QByteArray &data) const;
 
   bool dataExists(const Request &req) const;
   QByteArray getData(const Request &req, bool *correct = 0) const;
@@ -125,23 +150,107 @@ public:
   Area *area(ItemID id) { return _areas.value(id, 0); }
   XGeometry *mesh(ItemID id) { return _meshes.value(id, 0); }
 
-  void requestItem( Request &, bool block=false );
+  // queue a request, more important requests are sent first. A request for data which is already
+  // pending takes the pending request's ID, and raises its importance if higher.
+  // Blocking requests are sent immediately and wait for the data, use them only for editing operations.
+  void requestItem( Request &, bool block=false, xReal importance=0.0f );
+  // change the importance of a queued request.
+  void setImportance( xuint32 requestID, xReal importance );
+  // drop a request that is no longer needed, any data which arrives for it is discarded.
+  void cancelRequest( xuint32 requestID );
+  // cancel every queued or in flight request below [importance].
+  void cancelRequestsBelow( xReal importance );
+
+  // projected size of [bounds] in pixels, for a camera at [position] with [projectionScale]
+  // (viewport height / (2 * tan(fov / 2))). Items which aren't visible are made less important.
+  static xReal importance(const XCuboid &bounds, const XVector3D &position, xReal projectionScale, bool visible);
+
+  // request the child areas of [area] which could be seen from [position], using the area's visibility
+  // (every child, if it has none). Areas which are already loaded are skipped, returns the number requested.
+  xsize requestVisibleAreas(const Area &area, const XVector3D &position, xReal projectionScale);
 
   ItemID createItem(ItemType type);
 
 private:
   Request requestSpecialItem( ItemID id, SpecialIdentifier type, bool block );
 
+  enum RequestState
+    {
+    Queued,
+    InFlight,
+    Cancelled
+    };
+
+  struct PendingRequest
+    {
+    Request request;
+    xReal importance;
+    RequestState state;
+    };
+
+  struct RequestKey
+    {
+    xuint16 type;
+    ItemID ID;
+    xuint16 subType;
+
+    RequestKey(const Request &r) : type(r.type()), ID(r.ID()), subType(r.subType()) { }
+    bool operator==(const RequestKey &k) const { return type == k.type && ID == k.ID && subType == k.subType; }
+    friend uint qHash(const RequestKey &k) { return qHash(k.ID) ^ (k.type << 16) ^ k.subType; }
+    };
+
+  struct QueueEntry
+    {
+    xReal importance;
+    xuint32 requestID;
+    bool operator<(const QueueEntry &e) const { return importance < e.importance; }
+    };
+
+  // the result of decoding a request's data, before it is installed.
+  struct DecodedItem
+    {
+    DecodedItem() : container(0), textureInfo(0), mesh(0), area(0) { }
+    Request request;
+    Container *container;
+    TextureInfo *textureInfo;
+    XGeometry *mesh;
+    Area *area;
+    QByteArray special;
+    };
+  class DecodeJob;
+
+  static void decode(DecodedItem &item);
+  static void discard(DecodedItem &item);
+  void install(DecodedItem &item);
+  void onDecoded(const DecodedItem &item);
+  void send(PendingRequest &request);
+  void sendQueued();
+  void removePending(xuint32 requestID);
+
   ByteArrayHash _specials;
   ContainerHash _containers;
   TextureInfoHash _textureInfos;
   ShaderHash _shaders;
   GeomtryHash _meshes;
   AreaHash _areas;
-  XList<Request> _pendingRequests;
+
+  // pending requests are only accessed from the owning thread, decoded items are handed back under _decodedLock.
+  XHash<xuint32, PendingRequest> _pendingRequests;
+  XHash<RequestKey, xuint32> _pendingData;
+  // max heap of queued requests, entries for cancelled or reprioritised requests are skipped when popped.
+  XVector<QueueEntry> _queue;
+  xuint32 _inFlight;
+
+  QThreadPool _decodePool;
+  QMutex _decodedLock;
+  XVector<DecodedItem> _decoded;
 
   Listener *_listener;
 
+  XEnvironmentDiskCache *_diskCache;
+  // requests only checking a cached version, their replies update the cache but aren't installed.
+  XSet<xuint32> _validating;
+
   xuint32 _requestID;
   };
 
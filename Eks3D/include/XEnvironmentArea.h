@@ -3,6 +3,7 @@
 
 #include "XGlobal"
 #include "XCuboid.h"
+#include "XEnvironmentVisibility.h"
 #include "XVector"
 #include "XMap"
 
@@ -17,6 +18,8 @@ public:
     Item,
     CubeMap,
     Name,
+    // the area's XEnvironmentVisibility, sparse and computed offline, areas with one don't need visboxes.
+    Visibility,
     VisBoxBegin = 100,
     Maximum,
     };
@@ -59,6 +62,9 @@ XProperties:
   XRefProperty(VisBox, permanentVisBox);
   XRefProperty(VisBoxHash, spatialVisBoxes);
 
+  // indexes the child areas.
+  XRefProperty(XEnvironmentVisibility, visibility);
+
 public:
   XEnvironmentArea();
 
@@ -73,6 +79,9 @@ public:
 
   void saveVisBox(QDataStream &stream, xuint32 id) const;
   void restoreVisBox(QDataStream &stream, xuint32 id);
+
+  void saveVisibility(QDataStream &stream) const;
+  void restoreVisibility(QDataStream &stream);
   };
 
 #endif // XENVIRONMENTITEM_H
@@ -0,0 +1,38 @@
+#ifndef XENVIRONMENTCODEC_H
+#define XENVIRONMENTCODEC_H
+
+#include "X3DGlobal.h"
+#include "QByteArray"
+
+// Encodes item data for transfer. Data is sent raw, compressed with a fast LZ77 codec in the style
+// of LZ4, or as a delta: the same codec with a version of the item the receiver already holds as
+// its dictionary, so unchanged runs become back references into the old version.
+class EKS3D_EXPORT XEnvironmentCodec
+  {
+public:
+  enum Encoding
+    {
+    Raw,
+    Compressed,
+    Delta,
+    // the receiver's version is current, there is no payload.
+    Unchanged
+    };
+
+  enum
+    {
+    // data smaller than this is always sent raw.
+    MinimumCompressSize = 64
+    };
+
+  // the smallest encoding of [data], as a delta against [base] if it isn't empty.
+  static QByteArray encode(const QByteArray &data, const QByteArray &base, Encoding *encoding);
+  // decode [encoded] into [data], [base] is the receiver's version for Delta and Unchanged.
+  static bool decode(const QByteArray &encoded, Encoding encoding, const QByteArray &base, QByteArray &data);
+
+  // compress [data], matches can refer back into [dictionary] as if it preceded the data.
+  static QByteArray compress(const QByteArray &data, const QByteArray &dictionary = QByteArray());
+  static bool decompress(const QByteArray &compressed, const QByteArray &dictionary, QByteArray &data);
+  };
+
+#endif // XENVIRONMENTCODEC_H
@@ -0,0 +1,73 @@
+#ifndef XENVIRONMENTDISKCACHE_H
+#define XENVIRONMENTDISKCACHE_H
+
+#include "X3DGlobal.h"
+#include "XHash"
+#include "XList"
+#include "QMutex"
+#include "XEnvironmentRequest.h"
+
+class QFile;
+
+// Item data kept on disk between runs, a file per (type, ID, subType) holding its latest version.
+// Files are memory mapped when first read, and the mapping is kept for the life of the cache, so
+// data found here (and geometry decoded from it) must not outlive the cache.
+// All functions are thread safe.
+class EKS3D_EXPORT XEnvironmentDiskCache
+  {
+public:
+  typedef XEnvironmentRequest Request;
+
+  XEnvironmentDiskCache(const QString &directory);
+  ~XEnvironmentDiskCache();
+
+  // index the cached files, removing superseded versions and interrupted writes.
+  bool open();
+
+  // the cached version of [req]'s item, 0 if it isn't cached.
+  xuint32 version(const Request &req) const;
+  // true if the server has confirmed the cached version is current since the cache was opened.
+  bool isValidated(const Request &req) const;
+
+  // the cached data for [req] at [version].
+  bool find(const Request &req, xuint32 version, QByteArray &data) const;
+  // cache [req]'s data as [req].version(), which the server has just sent so is validated.
+  // If that version is already cached only the validation is recorded.
+  void store(const Request &req);
+
+  // a request for each cached item, carrying its cached version.
+  XList<Request> entries() const;
+
+private:
+  struct Key
+    {
+    xuint16 type;
+    XEnvironmentID ID;
+    xuint16 subType;
+
+    Key(const Request &r) : type(r.type()), ID(r.ID()), subType(r.subType()) { }
+    Key(xuint16 t, XEnvironmentID id, xuint16 s) : type(t), ID(id), subType(s) { }
+    bool operator==(const Key &k) const { return type == k.type && ID == k.ID && subType == k.subType; }
+    friend uint qHash(const Key &k) { return qHash(k.ID) ^ (k.type << 16) ^ k.subType; }
+    };
+
+  struct Entry
+    {
+    xuint32 version;
+    bool validated;
+    QFile *file;
+    const uchar *map;
+    xuint64 size;
+    };
+
+  QString path(const Key &key, xuint32 version) const;
+  void retire(const Key &key, Entry &entry);
+
+  QString _directory;
+  mutable QMutex _lock;
+  mutable XHash<Key, Entry> _entries;
+  // replaced files, their mappings may still be in use.
+  XList<QFile *> _retired;
+  };
+
+#endif // XENVIRONMENTDISKCACHE_H
@@ -0,0 +1,108 @@
+#ifndef XENVIRONMENTLOD_H
+#define XENVIRONMENTLOD_H
+
+#include "X3DGlobal.h"
+#include "XProperty"
+#include "XVector"
+#include "XHash"
+#include "XCuboid.h"
+#include "XMeshOptimiser.h"
+
+class XEnvironment;
+
+// A hierarchy of mesh levels, each a coarser stand in for its children, and the choice of which to draw.
+// A level is refined once its geometric error, projected to the screen, is more than maximumScreenError
+// pixels. Levels are only refined once all their children are resident, until then the level (or the
+// coarsest resident level above it) is drawn and the children are requested, most visible error first.
+// Levels swapping in or out fade over transitionTime, with complementary dither patterns, so they don't pop.
+class EKS3D_EXPORT XEnvironmentLOD
+  {
+public:
+  typedef XEnvironmentID ItemID;
+
+  enum
+    {
+    InvalidNode = X_UINT32_SENTINEL
+    };
+
+  class Node
+    {
+  public:
+    ItemID mesh;
+    XCuboid bounds;
+    // the largest distance, in world units, between this level and the finest geometry.
+    xReal error;
+    xuint32 parent;
+    XVector<xuint32> children;
+
+    bool resident;
+    bool selected;
+    // how much of this level is drawn, from 0 to 1.
+    xReal fade;
+    };
+
+  class Draw
+    {
+  public:
+    xuint32 node;
+    ItemID mesh;
+    // keep a fragment if its dither threshold is below fade, or above (1 - fade) if invertDither is set.
+    // Levels fading out use the inverted pattern, so they cover exactly what the incoming level doesn't.
+    xReal fade;
+    bool invertDither;
+    };
+
+  class Refinement
+    {
+  public:
+    xuint32 node;
+    ItemID mesh;
+    // the projected error it will remove, in pixels.
+    xReal importance;
+
+    // sorts the most important first.
+    bool operator<(const Refinement &r) const { return importance > r.importance; }
+    };
+
+XProperties:
+  XProperty(xReal, maximumScreenError, setMaximumScreenError);
+  XProperty(xReal, transitionTime, setTransitionTime);
+
+public:
+  XEnvironmentLOD();
+
+  // add a level below [parent] (InvalidNode for a root).
+  xuint32 addNode(xuint32 parent, ItemID mesh, const XCuboid &bounds, xReal error);
+  // add the levels from XMeshOptimiser::generateLODs(), stored as [meshes] (finest first), as a chain
+  // with the coarsest level below [parent]. Returns the coarsest level.
+  xuint32 addChain(xuint32 parent, const XVector<XMeshOptimiser::LOD> &lods, const XVector<ItemID> &meshes, const XCuboid &bounds);
+  void clear();
+
+  const Node &node(xuint32 i) const { return _nodes[i]; }
+  xsize nodeCount() const { return _nodes.size(); }
+  xuint32 nodeForMesh(ItemID mesh) const { return _meshNodes.value(mesh, InvalidNode); }
+
+  void setResident(xuint32 node, bool resident);
+
+  // projected error of [node] in pixels for a viewer at [position], see XEnvironment::importance for [projectionScale].
+  xReal screenError(xuint32 node, const XVector3D &position, xReal projectionScale) const;
+
+  // choose the levels to draw, advancing the transitions by [elapsed] seconds. [refinements] are the
+  // levels which should be loaded, sorted most important first.
+  void update(const XVector3D &position, xReal projectionScale, xReal elapsed, XVector<Draw> &draws, XVector<Refinement> &refinements);
+  // as above, with residency taken from the meshes [env] has loaded, and the refinements requested from it.
+  void update(XEnvironment *env, const XVector3D &position, xReal projectionScale, xReal elapsed, XVector<Draw> &draws);
+
+private:
+  void select(xuint32 node, const XVector3D &position, xReal projectionScale, XVector<Refinement> &refinements);
+  void request(xuint32 node, xReal importance, XVector<Refinement> &refinements) const;
+  // the largest fade of the levels below [node].
+  xReal fadeBelow(xuint32 node) const;
+
+  XVector<Node> _nodes;
+  XVector<xuint32> _roots;
+  XHash<ItemID, xuint32> _meshNodes;
+  XVector<Refinement> _refinements;
+  };
+
+#endif // XENVIRONMENTLOD_H
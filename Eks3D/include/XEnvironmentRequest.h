@@ -17,6 +17,9 @@ public:
                      sizeof(xuint16) + // the type
                      sizeof(ItemID) + // the item id
                      sizeof(xuint32) + // the request id
+                     sizeof(xuint32) + // the version
+                     sizeof(xuint32) + // the base version
+                     sizeof(xuint8) + // the encoding
                      sizeof(quint32) // the size of the extra data
     };
 
@@ -26,6 +29,12 @@ XProperties:
   XROProperty( SubType, subType );
   XRORefProperty( QByteArray, extraData );
   XProperty( xuint32, requestID, setRequestID );
+  // asking for an item, the version already held (0 for none). Replying, the version of the data.
+  XProperty( xuint32, version, setVersion );
+  // for Delta and Unchanged replies, the version the extra data is relative to.
+  XProperty( xuint32, baseVersion, setBaseVersion );
+  // how the extra data is encoded, an XEnvironmentCodec::Encoding.
+  XProperty( xuint8, encoding, setEncoding );
 
 public:
   XEnvironmentRequest();
@@ -0,0 +1,118 @@
+#ifndef XENVIRONMENTVISIBILITY_H
+#define XENVIRONMENTVISIBILITY_H
+
+#include "X3DGlobal.h"
+#include "XProperty"
+#include "XVector"
+#include "XCuboid.h"
+
+class QDataStream;
+
+// A sparse octree over the bounds of the items in an area, with a potentially visible set for each leaf.
+// Cells are only split where they hold more than a few items, so empty space costs one leaf, and leaves
+// which see the same items share one set. The sets are computed offline by computeVisibility(), after
+// which visibleFrom() answers "what could be seen from here" by descending the tree, O(log n) in the items.
+class EKS3D_EXPORT XEnvironmentVisibility
+  {
+public:
+  typedef XEnvironmentID ItemID;
+  typedef XVector<xuint32> IndexList;
+
+  enum
+    {
+    Version = 1,
+    InvalidIndex = X_UINT32_SENTINEL
+    };
+
+  class EKS3D_EXPORT Item
+    {
+  XProperties:
+    XProperty(ItemID, ID, setID);
+    XRefProperty(XCuboid, bounds);
+    // whether the bounds block sight, items which don't occlude are only ever seen.
+    XProperty(bool, occluder, setOccluder);
+
+  public:
+    Item(ItemID id = 0, const XCuboid &bounds = XCuboid(), bool occluder = true);
+
+    friend EKS3D_EXPORT QDataStream &operator<<(QDataStream &stream, const Item &item);
+    friend EKS3D_EXPORT QDataStream &operator>>(QDataStream &stream, Item &item);
+    };
+  typedef XVector<Item> ItemList;
+
+  XEnvironmentVisibility();
+
+  // build the octree over [items] inside [bounds], leaves with more than [maxItemsPerCell] items are split
+  // until [maxDepth]. Until computeVisibility() is called every item is visible from every cell.
+  void build(const XCuboid &bounds, const ItemList &items, xuint32 maxItemsPerCell = 16, xuint32 maxDepth = 8);
+
+  // fill each leaf's potentially visible set by casting [raysPerSample] rays from [samplesPerCell] points
+  // in the leaf, an item is visible if a ray reaches it before any occluder. Items overlapping a leaf are
+  // always visible from it. Leaves are sampled on up to [maxThreads] threads, the result only depends on [seed].
+  void computeVisibility(xuint32 samplesPerCell = 16, xuint32 raysPerSample = 256, xuint32 seed = 0, int maxThreads = -1);
+
+  void clear();
+  bool isEmpty() const { return _items.isEmpty(); }
+
+  const XCuboid &bounds() const { return _bounds; }
+  const ItemList &items() const { return _items; }
+  const Item &item(xuint32 index) const { return _items[index]; }
+
+  // indices of the items potentially visible from [point], every item if the point is outside the bounds.
+  const IndexList &visibleFrom(const XVector3D &point) const;
+  // indices of the items whose bounds intersect [cuboid], without duplicates.
+  void itemsIn(const XCuboid &cuboid, IndexList &out) const;
+  // the first occluder hit by the ray from [position] along [direction], InvalidIndex if nothing is hit.
+  // Occluders containing [position] are ignored.
+  xuint32 raycast(const XVector3D &position, const XVector3D &direction, xReal *distance = 0) const;
+
+  xsize nodeCount() const { return _nodes.size(); }
+  xsize leafCount() const;
+  xsize visibleSetCount() const { return _visibleSets.size(); }
+  // bytes used by the tree and the sets.
+  xsize memoryUsage() const;
+
+  friend EKS3D_EXPORT QDataStream &operator<<(QDataStream &stream, const XEnvironmentVisibility &vis);
+  friend EKS3D_EXPORT QDataStream &operator>>(QDataStream &stream, XEnvironmentVisibility &vis);
+
+private:
+  // children are allocated in runs of eight, child i has the upper half on the x axis if (i&1),
+  // on y if (i&2) and on z if (i&4).
+  struct Node
+    {
+    XVector3D minimum;
+    XVector3D maximum;
+    xuint32 firstChild;
+    // leaves only, the range of _nodeItems overlapping the leaf, and its set in _visibleSets.
+    xuint32 firstItem;
+    xuint32 itemCount;
+    xuint32 visibleSet;
+
+    bool isLeaf() const { return firstChild == InvalidIndex; }
+    };
+
+  // a non occluding item crossed by a ray, it is seen if it is nearer than the first occluder.
+  struct Hit
+    {
+    xuint32 index;
+    xReal distance;
+    };
+
+  class SampleJob;
+  friend class SampleJob;
+
+  void split(xuint32 node, const IndexList &items, xuint32 depth, xuint32 maxItemsPerCell, xuint32 maxDepth);
+  xuint32 findLeaf(const XVector3D &point) const;
+  void sampleLeaf(xuint32 leaf, xuint32 samples, xuint32 rays, xuint32 seed, IndexList &visible) const;
+  void raycast(xuint32 node, const XVector3D &position, const XVector3D &inverseDirection,
+               xReal &best, xuint32 &hit, XVector<Hit> *passed) const;
+
+  XCuboid _bounds;
+  ItemList _items;
+  XVector<Node> _nodes;
+  IndexList _nodeItems;
+  XVector<IndexList> _visibleSets;
+  IndexList _allItems;
+  };
+
+#endif // XENVIRONMENTVISIBILITY_H
@@ -2,6 +2,7 @@
 #define XGLRENDERER_H
 
 #include "XRenderer.h"
+#include "XGLStateCache.h"
 #include "QSize"
 
 class QGLContext;
@@ -21,7 +22,7 @@ public:
     void intialise();
 
     virtual XAbstractShader *getShader( );
-    virtual XAbstractGeometry *getGeometry( XGeometry::BufferType );
+    virtual XAbstractGeometry *getGeometry( XGeometry::BufferType, XGeometry::VertexLayout );
     virtual XAbstractTexture *getTexture();
     virtual XAbstractFramebuffer *getFramebuffer( int options, int cf, int df, int width, int heightg );
 
@@ -49,12 +50,18 @@ public:
 
 
     QSize viewportSize();
+
+    // the GL state the renderer has set, and counts of the changes it skipped. Call invalidate() on it
+    // when something else has drawn with the context.
+    XGLStateCache &stateCache();
+    const XGLStateCache &stateCache() const;
+
 private:
     QGLContext *_context;
     XGLShader *_currentShader;
     QSize _size;
     XGLFramebuffer *_currentFramebuffer;
-    XVector <int> m_ids;
+    XGLStateCache _state;
     };
 
 #endif // XGLRENDERER_H
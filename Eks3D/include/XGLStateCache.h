@@ -0,0 +1,171 @@
+#ifndef XGLSTATECACHE_H
+#define XGLSTATECACHE_H
+
+#include "X3DGlobal.h"
+#include "XHash"
+#include "XVector"
+#include "QString"
+
+// Shadows the GL state XGLRenderer changes for each draw: the bound program, its uniform values, the textures
+// bound to each unit, and the vertex attribute arrays, so a change matching what GL already holds is skipped.
+// Uniform and attribute locations are asked of GL once per program and name. Calls are made through a
+// Functions table, which is the GL entry points by default, so the cache can be driven without a context.
+class EKS3D_EXPORT XGLStateCache
+    {
+public:
+    enum
+        {
+        MaximumAttributes = 16,
+        MaximumTextureUnits = 16
+        };
+
+    class Functions
+        {
+    public:
+        void (*useProgram)( unsigned int program );
+        int (*uniformLocation)( unsigned int program, const char *name );
+        int (*attributeLocation)( unsigned int program, const char *name );
+        void (*uniformInts)( int location, int count, const int *values );
+        // [components] floats for each of [count] elements.
+        void (*uniformFloats)( int location, int components, int count, const float *values );
+        // [count] column major matrices, of [columns] x [rows].
+        void (*uniformMatrices)( int location, int columns, int rows, int count, const float *values );
+        void (*activeTexture)( int unit );
+        void (*bindTexture)( unsigned int texture );
+        void (*bindArrayBuffer)( unsigned int buffer );
+        void (*bindElementBuffer)( unsigned int buffer );
+        void (*enableAttribute)( int location );
+        void (*disableAttribute)( int location );
+        void (*attributePointer)( int location, int components, int stride, xsize offset );
+        // draw [count] indices from the bound element buffer, as GL_POINTS, GL_LINES or GL_TRIANGLES.
+        void (*drawElements)( int mode, int count );
+        };
+
+    // the real GL entry points, usable once glew is initialised.
+    static const Functions &glFunctions();
+
+    // counts of state changes asked for, and of those skipped as GL already held the state.
+    class Stats
+        {
+    public:
+        Stats();
+
+        xuint64 programBinds;
+        xuint64 redundantProgramBinds;
+        xuint64 uniformUploads;
+        xuint64 redundantUniformUploads;
+        xuint64 textureBinds;
+        xuint64 redundantTextureBinds;
+        xuint64 bufferBinds;
+        xuint64 redundantBufferBinds;
+        xuint64 attributeChanges;
+        xuint64 redundantAttributeChanges;
+        xuint64 locationQueries;
+        xuint64 draws;
+        };
+
+    XGLStateCache( const Functions &functions = glFunctions() );
+
+    const Functions &functions() const { return _functions; }
+    const Stats &stats() const { return _stats; }
+    void resetStats();
+
+    // forget everything, for when something else has changed GL state, ie. a QPainter.
+    void invalidate();
+    // forget the state of a program, texture or buffer which has been deleted, GL may reuse its name.
+    void forgetProgram( unsigned int program );
+    void forgetTexture( unsigned int texture );
+    void forgetBuffer( unsigned int buffer );
+    // the texture bound to the active unit has been changed outside the cache.
+    void textureBindingChanged();
+
+    void useProgram( unsigned int program );
+    unsigned int program() const { return _program; }
+
+    // a number identifying [program] until it is forgotten, GL may reuse the name of a deleted program.
+    xuint32 programSerial( unsigned int program );
+    int uniformLocation( unsigned int program, const QString &name );
+    int attributeLocation( unsigned int program, const QString &name );
+
+    // set a uniform of [program], it is sent when the program is next used, or now if it is in use.
+    // Values matching those last sent are skipped.
+    void setUniform( unsigned int program, int location, const int *values, int count );
+    void setUniform( unsigned int program, int location, const float *values, int components, int count );
+    void setUniformMatrix( unsigned int program, int location, const float *values, int columns, int rows, int count );
+
+    void bindTexture( int unit, unsigned int texture );
+    void bindArrayBuffer( unsigned int buffer );
+    void bindElementBuffer( unsigned int buffer );
+
+    // the attributes of a draw are given between beginAttributes and endAttributes, arrays enabled for the
+    // previous draw but not this one are disabled in endAttributes.
+    void beginAttributes();
+    void setAttribute( int location, unsigned int buffer, int components, int stride, xsize offset );
+    void endAttributes();
+
+    void drawElements( int mode, int count );
+
+private:
+    enum UniformType
+        {
+        Ints,
+        Floats,
+        Matrices
+        };
+
+    struct Uniform
+        {
+        int type;
+        int shape;
+        int count;
+        bool dirty;
+        XVector<char> data;
+        };
+
+    struct Program
+        {
+        xuint32 serial;
+        XHash<QString, int> uniformLocations;
+        XHash<QString, int> attributeLocations;
+        XHash<int, Uniform> uniforms;
+        XVector<int> dirtyUniforms;
+        };
+
+    enum ArrayState
+        {
+        ArrayDisabled,
+        ArrayEnabled,
+        // after invalidate, the array may be either, so is set either way on next use.
+        ArrayUnknown
+        };
+
+    struct Attribute
+        {
+        ArrayState state;
+        unsigned int buffer;
+        int components;
+        int stride;
+        xsize offset;
+        };
+
+    Program &programData( unsigned int program );
+    void setUniformData( unsigned int program, int location, int type, int shape, int count, const void *data, int size );
+    void upload( int location, const Uniform & );
+
+    Functions _functions;
+    Stats _stats;
+
+    XHash<unsigned int, Program> _programs;
+    xuint32 _programSerial;
+    unsigned int _program;
+
+    int _activeUnit;
+    unsigned int _textures[MaximumTextureUnits];
+    unsigned int _arrayBuffer;
+    unsigned int _elementBuffer;
+
+    Attribute _attributes[MaximumAttributes];
+    xuint32 _usedAttributes;
+    };
+
+#endif // XGLSTATECACHE_H
@@ -12,6 +12,7 @@
 #include "XVector4D"
 #include "XObject"
 #include "XTransform.h"
+#include "XMeshContainer.h"
 
 class XAbstractGeometry;
 class XRenderer;
@@ -22,7 +23,12 @@ class EKS3D_EXPORT XGeometry
     {
 public:
     enum BufferType { Static, Dynamic, Stream };
-    XGeometry( BufferType=Static );
+    // Planar stores each attribute in its own block of the vertex buffer, Interleaved packs
+    // all attributes for a vertex together (position/normal/uv...).
+    enum VertexLayout { Planar, Interleaved };
+    XGeometry( BufferType=Static, VertexLayout=Planar );
+    // use the blocks in [container] in place, they are only unpacked if the geometry is read or edited.
+    explicit XGeometry( const XMeshContainer &container, BufferType=Static, VertexLayout=Planar );
     XGeometry( const XGeometry & );
     XGeometry& operator=( const XGeometry & );
 
@@ -53,8 +59,20 @@ public:
     void setAttribute( const QString &, const XVector<XVector3D> & );
     void setAttribute( const QString &, const XVector<XVector4D> & );
 
+    // overwrite part of an existing attribute, starting at vertex [first], only the changed range is uploaded.
+    void setAttributeRange( const QString &, int first, const XVector<xReal> & );
+    void setAttributeRange( const QString &, int first, const XVector<XVector2D> & );
+    void setAttributeRange( const QString &, int first, const XVector<XVector3D> & );
+    void setAttributeRange( const QString &, int first, const XVector<XVector4D> & );
+
     void removeAttribute( const QString & );
 
+    BufferType bufferType() const;
+    VertexLayout vertexLayout() const;
+
+    // the container this geometry still wraps, invalid once it has been unpacked.
+    const XMeshContainer &meshContainer() const;
+
     XCuboid computeBounds() const;
 
     void prepareInternal( XRenderer * ) const;
@@ -63,12 +81,30 @@ public:
     friend QDataStream EKS3D_EXPORT &operator<<( QDataStream &s, const XGeometry &geo );
     friend QDataStream EKS3D_EXPORT &operator>>( QDataStream &s, XGeometry &geo );
 
+    struct DirtyRange
+      {
+      DirtyRange() : first( 0 ), last( -1 ) { }
+      DirtyRange( int f, int l ) : first( f ), last( l ) { }
+      void unite( int f, int l );
+      int count() const { return last - first + 1; }
+      int first;
+      int last;
+      };
+
 private:
+    template <typename T> void setAttributeInternal( XHash <QString, XVector<T> > &, XHash <QString, DirtyRange> &, const QString &, const XVector<T> & );
+    template <typename T> void setAttributeRangeInternal( XHash <QString, XVector<T> > &, XHash <QString, DirtyRange> &, const QString &, int, const XVector<T> & );
+    template <typename T> bool diffAttributes( const XHash <QString, XVector<T> > &, const XHash <QString, XVector<T> > &, XHash <QString, DirtyRange> & );
+    template <typename T> void uploadAttributes( const XHash <QString, XVector<T> > &, XHash <QString, DirtyRange> & ) const;
+    void clearChanges() const;
+    void unpack() const;
+    void prepareContainer() const;
+
     mutable XAbstractGeometry *_internal;
-    XSet <QString> _changedA1;
-    XSet <QString> _changedA2;
-    XSet <QString> _changedA3;
-    XSet <QString> _changedA4;
+    mutable XHash <QString, DirtyRange> _changedA1;
+    mutable XHash <QString, DirtyRange> _changedA2;
+    mutable XHash <QString, DirtyRange> _changedA3;
+    mutable XHash <QString, DirtyRange> _changedA4;
     mutable bool _changedP;
     mutable bool _changedL;
     mutable bool _changedT;
@@ -83,8 +119,10 @@ private:
     XVector <unsigned int> _lines;
     XVector <unsigned int> _triangles;
     mutable XRenderer *_renderer;
+    mutable XMeshContainer _container;
 
     BufferType _type;
+    VertexLayout _layout;
     };
 X_DECLARE_SERIALISABLE_METATYPE(XGeometry);
 
@@ -96,12 +134,24 @@ public:
     virtual void setLines( const XVector<unsigned int> & ) = 0;
     virtual void setTriangles( const XVector<unsigned int> & ) = 0;
 
+    // raw forms, used to upload from memory not owned by an XVector (ie. an XMeshContainer).
+    virtual void setPoints( const unsigned int *, int count ) = 0;
+    virtual void setLines( const unsigned int *, int count ) = 0;
+    virtual void setTriangles( const unsigned int *, int count ) = 0;
+
     virtual void setAttributesSize( int, int, int, int, int ) = 0;
 
     virtual void setAttribute( QString, const XVector<xReal> & ) = 0;
     virtual void setAttribute( QString, const XVector<XVector2D> & ) = 0;
     virtual void setAttribute( QString, const XVector<XVector3D> & ) = 0;
     virtual void setAttribute( QString, const XVector<XVector4D> & ) = 0;
+    virtual void setAttribute( QString, const xReal *, int components, int count ) = 0;
+
+    // upload [count] elements of the attribute starting at [first], the attribute must already have been set.
+    virtual void setAttributeRange( QString, const XVector<xReal> &, int first, int count ) = 0;
+    virtual void setAttributeRange( QString, const XVector<XVector2D> &, int first, int count ) = 0;
+    virtual void setAttributeRange( QString, const XVector<XVector3D> &, int first, int count ) = 0;
+    virtual void setAttributeRange( QString, const XVector<XVector4D> &, int first, int count ) = 0;
     };
 
 namespace XMeshUtilities
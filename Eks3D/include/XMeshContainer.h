@@ -0,0 +1,116 @@
+#ifndef XMESHCONTAINER_H
+#define XMESHCONTAINER_H
+
+#include "X3DGlobal.h"
+#include "QByteArray"
+#include "QSharedPointer"
+
+class XGeometry;
+class QFile;
+
+// A flat binary form of an XGeometry, which can be written to disk or sent over the network and used
+// again without parsing. The layout is a Header, an AttributeDescriptor per attribute, then 16 byte
+// aligned attribute and index blocks. Float attribute and index blocks can be used straight from the
+// buffer, so an XGeometry built from a container shares its memory (see XGeometry( const XMeshContainer & )).
+class EKS3D_EXPORT XMeshContainer
+  {
+public:
+  enum
+    {
+    Magic = 0x48534D58, // "XMSH"
+    // 2 sums the header into the checksum.
+    Version = 2,
+    Alignment = 16,
+    MaxNameLength = 31
+    };
+
+  enum Encoding
+    {
+    Float32,
+    // 16 bit unsigned normalised per component, decoded as offset + value * scale.
+    UNorm16,
+    // unit vectors as two 16 bit signed normalised octahedral coordinates.
+    Octahedral16
+    };
+
+  enum Quantisation
+    {
+    NoQuantisation = 0,
+    QuantisePositions = 1,
+    QuantiseNormals = 2,
+    QuantiseAll = QuantisePositions | QuantiseNormals
+    };
+
+  enum IndexType
+    {
+    Points,
+    Lines,
+    Triangles,
+
+    IndexTypeCount
+    };
+
+  struct Header
+    {
+    xuint32 magic;
+    xuint16 version;
+    xuint16 headerSize;
+    xuint32 totalSize;
+    xuint32 checksum;
+    xuint32 vertexCount;
+    xuint32 attributeCount;
+    xuint32 indexCount[IndexTypeCount];
+    xuint32 indexOffset[IndexTypeCount];
+    xuint32 reserved[2];
+    };
+
+  struct AttributeDescriptor
+    {
+    char name[MaxNameLength+1];
+    xuint32 components;
+    xuint32 encoding;
+    xuint32 offset;
+    xuint32 size;
+    float decodeOffset[4];
+    float decodeScale[4];
+    };
+
+  XMeshContainer();
+
+  // pack geo, quantising the [positionSemantic] and [normalSemantic] attributes as requested.
+  static XMeshContainer create( const XGeometry &geo,
+                                int quantisation = NoQuantisation,
+                                const QString &positionSemantic = "vertex",
+                                const QString &normalSemantic = "normal" );
+
+  // use [data] as a container, the array is shared, not copied. Returns false if it isn't a valid container.
+  bool setData( const QByteArray &data, bool verifyChecksum = true );
+  // map [file] and use it in place, the mapping is kept while any copy of this container exists.
+  bool map( const QString &file, bool verifyChecksum = true );
+
+  bool isValid() const { return _header != 0; }
+  const QByteArray &data() const { return _data; }
+
+  xuint32 vertexCount() const;
+  xuint32 attributeCount() const;
+  const AttributeDescriptor &attribute( xuint32 i ) const;
+  // the raw encoded block for attribute [i]
+  const void *attributeData( xuint32 i ) const;
+  // decode attribute [i] into [components] * vertexCount() floats at out.
+  void decodeAttribute( xuint32 i, float *out ) const;
+
+  xuint32 indexCount( IndexType ) const;
+  const xuint32 *indices( IndexType ) const;
+
+  // Adler-32 of [data], continuing from [running], the checksum of the data before it.
+  static xuint32 checksum( const char *data, xsize size, xuint32 running = 1 );
+
+private:
+  bool validate( bool verifyChecksum );
+
+  QByteArray _data;
+  QSharedPointer<QFile> _file;
+  const Header *_header;
+  };
+
+#endif // XMESHCONTAINER_H
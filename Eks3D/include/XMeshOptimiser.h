@@ -0,0 +1,49 @@
+#ifndef XMESHOPTIMISER_H
+#define XMESHOPTIMISER_H
+
+#include "X3DGlobal.h"
+#include "XVector"
+#include "XGeometry.h"
+
+namespace XMeshOptimiser
+{
+// Merge vertices whose attributes are all within [tolerance] of each other, points,
+// lines and triangles are remapped to the welded vertices.
+EKS3D_EXPORT void weldVertices( XGeometry *geo, xReal tolerance = 1e-5f, const QString &semantic = "vertex" );
+
+// Reorder triangles to maximise post-transform vertex cache hits (Forsyth's linear speed algorithm).
+EKS3D_EXPORT void optimiseVertexCache( XGeometry *geo, xuint32 cacheSize = 32 );
+
+// Reorder vertices into the order they are first used by the index lists, so fetches are sequential.
+EKS3D_EXPORT void optimiseVertexFetch( XGeometry *geo );
+
+// Weld, then optimise the vertex cache and fetch order.
+EKS3D_EXPORT void optimise( XGeometry *geo, xReal weldTolerance = 1e-5f, xuint32 cacheSize = 32 );
+
+// Average cache misses per triangle for a FIFO cache of [cacheSize] entries (0.5 is ideal, 3.0 is worst).
+EKS3D_EXPORT float averageCacheMissRatio( const XVector<unsigned int> &triangles, xuint32 cacheSize = 32 );
+
+// Simplify the triangles of geo to around [targetTriangles] by quadric error edge collapse,
+// returns the maximum quadric error of the collapses performed in [error].
+EKS3D_EXPORT XGeometry simplify( const XGeometry &geo, xuint32 targetTriangles, xReal *error = 0, const QString &semantic = "vertex" );
+
+class EKS3D_EXPORT LOD
+  {
+public:
+  XGeometry geometry;
+  xReal error;
+  // the distance band this level should be visible in. The distance banded environment children are compiled
+  // out of XEnvironmentRenderer, so nothing selects by these, XEnvironmentLOD::addChain uses the error instead.
+  xReal minimumDistance;
+  xReal maximumDistance;
+
+  xReal minimumDistanceSquared() const { return minimumDistance * minimumDistance; }
+  xReal maximumDistanceSquared() const { return maximumDistance * maximumDistance; }
+  };
+
+// Generate [levels] LODs, each with [reduction] of the triangles of the previous. The first level is the
+// optimised input. Levels switch at the distance where their error drops below [errorPerUnitDistance].
+EKS3D_EXPORT XVector<LOD> generateLODs( const XGeometry &geo, xuint32 levels, xReal reduction = 0.5f, xReal errorPerUnitDistance = 0.001f, const QString &semantic = "vertex" );
+}
+
+#endif // XMESHOPTIMISER_H
@@ -35,7 +35,7 @@ public:
 
     // creation accessors for abstract types
     virtual XAbstractShader *getShader( ) = 0;
-    virtual XAbstractGeometry *getGeometry( XGeometry::BufferType ) = 0;
+    virtual XAbstractGeometry *getGeometry( XGeometry::BufferType, XGeometry::VertexLayout ) = 0;
     virtual XAbstractTexture *getTexture() = 0;
     virtual XAbstractFramebuffer *getFramebuffer( int options, int colourFormat, int depthFormat, int width, int height ) = 0;
 
@@ -0,0 +1,188 @@
+#ifndef XSOFTWARERENDERER_H
+#define XSOFTWARERENDERER_H
+
+#include "XRenderer.h"
+#include "XVector4D"
+#include "XHash"
+#include "QSize"
+#include "QImage"
+#include "QStringList"
+#include "QThreadPool"
+
+class XSoftwareShader;
+class XSoftwareFramebuffer;
+
+// A renderer which rasterises on the CPU, so scenes can be drawn without a GL context.
+// Draws are transformed and binned into TileSize square tiles as they are issued, and rasterised in flush(),
+// one tile at a time on up to maxThreads threads, so each pixel is only ever touched by one thread and
+// primitives land in the order they were drawn. Shaders are C++ callbacks (a Program) chosen by the XShader
+// type, Default and AmbientShader have programs matching the GL shaders.
+class EKS3D_EXPORT XSoftwareRenderer : public XRenderer
+    {
+public:
+    enum
+        {
+        MaximumAttributes = 8,
+        MaximumVaryings = 16,
+        TileSize = 64
+        };
+
+    // everything a program can read during one draw.
+    class ShaderState
+        {
+    public:
+        XTransform modelView;
+        XComplexTransform projection;
+        // values of the program's uniforms and textures, in the order the Program lists them. Missing
+        // uniforms are empty, missing textures are null images.
+        XVector< XVector<float> > uniforms;
+        XVector<QImage> textures;
+        };
+
+    // transform one vertex, [attributes] holds four components for each attribute the program lists, unset
+    // components are (0, 0, 0, 1). Write the clip space [position] and the program's varyings.
+    typedef void (*VertexFunction)( const ShaderState &, const XVector4D *attributes, XVector4D &position, float *varyings );
+    // shade the fragment at [x, y], like gl_FragCoord, from its interpolated varyings. Return false to discard it.
+    typedef bool (*FragmentFunction)( const ShaderState &, const float *varyings, xReal x, xReal y, XVector4D &colour );
+
+    class EKS3D_EXPORT Program
+        {
+    public:
+        Program();
+
+        QStringList attributes;
+        QStringList uniforms;
+        QStringList textures;
+        int varyingCount;
+        VertexFunction vertex;
+        FragmentFunction fragment;
+        };
+
+    XSoftwareRenderer( int maxThreads = -1 );
+    ~XSoftwareRenderer();
+
+    // the program used to draw XShaders of [type].
+    void setProgram( int type, const Program & );
+    const Program &program( int type ) const;
+
+    // rasterise every draw since the last flush, this happens before anything reads or changes the target.
+    void flush();
+
+    // the colour of the bound framebuffer, or of the viewport when none is bound.
+    QImage colour();
+    // bilinearly filtered, repeating texture lookup, as GL does for textures bound from a QImage.
+    static XVector4D sample( const QImage &, xReal u, xReal v );
+
+    virtual XAbstractShader *getShader( );
+    virtual XAbstractGeometry *getGeometry( XGeometry::BufferType, XGeometry::VertexLayout );
+    virtual XAbstractTexture *getTexture();
+    virtual XAbstractFramebuffer *getFramebuffer( int options, int cf, int df, int width, int height );
+
+    virtual void destroyShader( XAbstractShader * );
+    virtual void destroyGeometry( XAbstractGeometry * );
+    virtual void destroyTexture( XAbstractTexture * );
+    virtual void destroyFramebuffer( XAbstractFramebuffer * );
+
+    virtual void pushTransform( const XTransform & );
+    virtual void popTransform( );
+
+    virtual void clear();
+
+    virtual void setViewportSize( QSize );
+    virtual void setProjectionTransform( const XComplexTransform & );
+
+    virtual void setShader( const XShader * );
+
+    virtual void drawGeometry( const XGeometry & );
+
+    virtual void setFramebuffer( const XFramebuffer * );
+
+    QSize viewportSize() const;
+
+protected:
+    virtual void enableRenderFlag( RenderFlags );
+    virtual void disableRenderFlag( RenderFlags );
+
+private:
+    // a vertex after the vertex function, in clip space.
+    struct ClipVertex
+        {
+        float position[4];
+        float varyings[MaximumVaryings];
+        };
+
+    // a vertex in pixels, y down, with the depth in [0, 1] and 1/w for perspective correct varyings.
+    struct ScreenVertex
+        {
+        float x;
+        float y;
+        float z;
+        float invW;
+        float varyings[MaximumVaryings];
+        };
+
+    struct Draw
+        {
+        Program program;
+        ShaderState state;
+        int flags;
+        };
+
+    // [count] is 1, 2 or 3 for points, lines and triangles.
+    struct Primitive
+        {
+        xuint32 draw;
+        xuint32 count;
+        xuint32 vertices[3];
+        };
+
+    class TileJob;
+    friend class TileJob;
+
+    XSoftwareFramebuffer *target() const;
+    void begin( XSoftwareFramebuffer * );
+    void drawPrimitive( xuint32 count, const ClipVertex **vertices );
+    void clipTriangle( const ClipVertex **vertices );
+    xuint32 addVertex( const ClipVertex & );
+    xuint32 screenVertex( const ClipVertex * );
+    void addPrimitive( xuint32 count, xuint32 *vertices );
+    void bin( xuint32 primitive, float minX, float minY, float maxX, float maxY );
+
+    void rasterise( int tile ) const;
+    void rasteriseTriangle( const Primitive &, int x0, int y0, int x1, int y1 ) const;
+    void rasteriseLine( const Primitive &, int x0, int y0, int x1, int y1 ) const;
+    void shade( const Draw &, const ScreenVertex **vertices, const float *weights, int count, int x, int y, float depth ) const;
+
+    XVector<XTransform> _transforms;
+    XComplexTransform _projection;
+    QSize _size;
+
+    XHash<int, Program> _programs;
+    XSoftwareShader *_currentShader;
+    XSoftwareFramebuffer *_screen;
+    XSoftwareFramebuffer *_currentFramebuffer;
+    QThreadPool _pool;
+
+    // pending work, rasterised by flush()
+    XVector<Draw> _draws;
+    XVector<ScreenVertex> _vertices;
+    XVector<Primitive> _primitives;
+    XVector< XVector<xuint32> > _bins;
+    XVector<int> _activeTiles;
+    XVector<ClipVertex> _clipVertices;
+    XVector<xuint32> _screenIndices;
+
+    // the area being drawn to, and its buffers while flushing
+    int _viewportWidth;
+    int _viewportHeight;
+    int _width;
+    int _height;
+    int _tilesX;
+    int _tilesY;
+    uchar *_colourBits;
+    int _colourStride;
+    float *_depthBits;
+    int _depthStride;
+    };
+
+#endif // XSOFTWARERENDERER_H
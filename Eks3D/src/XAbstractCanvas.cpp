@@ -2,6 +2,7 @@
 #include "XAbstractRenderModel.h"
 #include "XAbstractDelegate.h"
 #include "XAbstractCanvasController.h"
+#include "XVector"
 
 XAbstractCanvas::XAbstractCanvas(XAbstractRenderModel *m, XAbstractCanvasController *c) : _model(0), _controller(c), _iterator(0)
   {
@@ -18,7 +19,7 @@ void XAbstractCanvas::update(XAbstractRenderModel::UpdateMode)
   xAssert(!_model || (_model && _iterator));
   if(_model && _iterator)
     {
-    _model->resetIterator(_iterator);
+    _model->resetUpdateIterator(_iterator, this);
     while(_iterator->next())
       {
       const XAbstractDelegate *delegate = _model->delegateFor(_iterator, this);
@@ -36,14 +37,19 @@ void XAbstractCanvas::paint()
   if(_model && _iterator)
     {
     xuint32 numPasses = 1;
+    XVector<const XAbstractDelegate *> delegates;
 
-    _model->resetIterator(_iterator);
+    _model->resetPaintIterator(_iterator, this);
     while(_iterator->next())
       {
       const XAbstractDelegate *delegate = _model->delegateFor(_iterator, this);
       if(delegate)
         {
         numPasses = qMax(numPasses, delegate->maxNumberOfPasses(this, _iterator, _model));
+        if(!delegates.contains(delegate))
+          {
+          delegates << delegate;
+          }
         }
       }
     if(_controller)
@@ -53,16 +59,30 @@ void XAbstractCanvas::paint()
 
     for(xuint32 passIndex=0; passIndex<numPasses; ++passIndex)
       {
-      _model->resetIterator(_iterator);
-      while(_iterator->next())
+      bool painted = !delegates.isEmpty();
+      foreach(const XAbstractDelegate *delegate, delegates)
+        {
+        painted = delegate->beginPass(passIndex, this, _model) && painted;
+        }
+
+      if(!painted)
         {
-        const XAbstractDelegate *delegate = _model->delegateFor(_iterator, this);
-        if(delegate)
+        _model->resetPaintIterator(_iterator, this);
+        while(_iterator->next())
           {
-          delegate->paint(passIndex, this, _iterator, _model);
+          const XAbstractDelegate *delegate = _model->delegateFor(_iterator, this);
+          if(delegate)
+            {
+            delegate->paint(passIndex, this, _iterator, _model);
+            }
           }
         }
 
+      foreach(const XAbstractDelegate *delegate, delegates)
+        {
+        delegate->endPass(passIndex, this, _model);
+        }
+
       if(_controller)
         {
         _controller->paint(passIndex);
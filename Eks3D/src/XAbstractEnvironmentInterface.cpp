@@ -8,3 +8,15 @@ void XAbstractEnvironmentInterface::poll()
   {
 
   }
+
+void XAbstractEnvironmentInterface::requestItems( const XList<ItemRequest> &requests )
+  {
+  foreach(const ItemRequest &request, requests)
+    {
+    requestItem(request);
+    }
+  }
+
+void XAbstractEnvironmentInterface::cancelItem( const ItemRequest & )
+  {
+  }
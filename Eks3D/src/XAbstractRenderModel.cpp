@@ -20,3 +20,13 @@ void XAbstractRenderModel::update(UpdateMode m) const
     canvas->update(m);
     }
   }
+
+void XAbstractRenderModel::resetPaintIterator(Iterator *it, const XAbstractCanvas *) const
+  {
+  resetIterator(it);
+  }
+
+void XAbstractRenderModel::resetUpdateIterator(Iterator *it, const XAbstractCanvas *) const
+  {
+  resetIterator(it);
+  }
@@ -2,405 +2,758 @@
 #include "XGeometry.h"
 #include "QFile"
 #include "QDebug"
+#include "QXmlStreamReader"
+#include "QThreadPool"
+#include "QRunnable"
+#include "math.h"
+#include "string.h"
+
+namespace
+{
+// powers of ten which are exactly representable as doubles.
+const double g_powersOfTen[] =
+  {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+template <typename Char> inline bool isSpace( Char c )
+  {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+template <typename Char> inline bool isDigit( Char c )
+  {
+  return (unsigned)( c - '0' ) < 10;
+  }
+
+// fast path for the plain decimal numbers exporters write, returns false for anything unusual (nan, inf...)
+template <typename Char> bool parseNumber( const Char *p, const Char *end, xReal &out )
+  {
+  bool negative = *p == '-';
+  if( *p == '-' || *p == '+' )
+    {
+    ++p;
+    }
 
-XList<int> getListInt( QString data )
+  // up to 19 significant digits fit in the 64 bit mantissa, any after that only change the exponent.
+  xuint64 mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool anyDigits = false;
+  for( ; p < end && isDigit( *p ); ++p )
     {
-    QTextStream stream( &data, QIODevice::ReadOnly );
-    XList<int> ret;
+    anyDigits = true;
+    if( digits < 19 )
+      {
+      mantissa = ( mantissa * 10 ) + ( *p - '0' );
+      digits += mantissa != 0;
+      }
+    else
+      {
+      ++exponent;
+      }
+    }
 
-    int oldPos( -1 );
-    while( !stream.atEnd() && oldPos != stream.pos() )
+  if( p < end && *p == '.' )
+    {
+    for( ++p; p < end && isDigit( *p ); ++p )
+      {
+      anyDigits = true;
+      if( digits < 19 )
         {
-        oldPos = stream.pos();
-
-        int x;
-        stream >> x;
-        ret << x;
+        mantissa = ( mantissa * 10 ) + ( *p - '0' );
+        digits += mantissa != 0;
+        --exponent;
         }
-    return ret;
+      }
     }
 
-XList<xReal> getList1D( QString data, int count )
+  if( anyDigits && p < end && ( *p == 'e' || *p == 'E' ) )
     {
-    QTextStream stream( &data, QIODevice::ReadOnly );
-    XList<xReal> ret;
+    ++p;
+    bool negativeExponent = p < end && *p == '-';
+    if( p < end && ( *p == '-' || *p == '+' ) )
+      {
+      ++p;
+      }
+
+    int e = 0;
+    bool anyExponentDigits = false;
+    for( ; p < end && isDigit( *p ); ++p )
+      {
+      anyExponentDigits = true;
+      e = xMin( ( e * 10 ) + ( *p - '0' ), 10000 );
+      }
+    if( !anyExponentDigits )
+      {
+      return false;
+      }
+    exponent += negativeExponent ? -e : e;
+    }
 
-    for( int i=0; i<count; i++ )
-        {
-        float x;
-        stream >> x;
-        ret << x;
-        }
-    return ret;
+  if( !anyDigits || p != end )
+    {
+    return false;
     }
 
-XList<XVector2D> getList2D( QString data, int count )
+  double value = (double)mantissa;
+  if( mantissa != 0 )
     {
-    QTextStream stream( &data, QIODevice::ReadOnly );
-    XList<XVector2D> ret;
+    if( exponent < 0 )
+      {
+      value = exponent >= -22 ? value / g_powersOfTen[-exponent] : value * pow( 10.0, exponent );
+      }
+    else if( exponent > 0 )
+      {
+      value = exponent <= 22 ? value * g_powersOfTen[exponent] : value * pow( 10.0, exponent );
+      }
+    }
 
-    for( int i=0; i<count; i++ )
-        {
-        float x, y;
-        stream >> x >> y;
-        ret << XVector2D( x, y );
-        }
-    return ret;
+  out = (xReal)( negative ? -value : value );
+  return true;
+  }
+
+template <typename Char> bool parseNumber( const Char *p, const Char *end, int &out )
+  {
+  bool negative = *p == '-';
+  if( *p == '-' || *p == '+' )
+    {
+    ++p;
     }
 
-XList<XVector3D> getList3D( QString data, int count )
+  if( p == end )
     {
-    QTextStream stream( &data, QIODevice::ReadOnly );
-    XList<XVector3D> ret;
+    return false;
+    }
 
-    for( int i=0; i<count; i++ )
-        {
-        float x, y, z;
-        stream >> x >> y >> z;
-        ret << XVector3D( x, y, z );
-        }
-    return ret;
+  int value = 0;
+  for( ; p < end && isDigit( *p ); ++p )
+    {
+    value = ( value * 10 ) + ( *p - '0' );
     }
 
-XList<XVector4D> getList4D( QString data, int count )
+  out = negative ? -value : value;
+  return p == end;
+  }
+
+bool parseFallback( const ushort *begin, const ushort *end, xReal &out )
+  {
+  bool ok = false;
+  out = QString::fromUtf16( begin, end - begin ).toFloat( &ok );
+  return ok;
+  }
+
+bool parseFallback( const ushort *begin, const ushort *end, int &out )
+  {
+  bool ok = false;
+  out = QString::fromUtf16( begin, end - begin ).toInt( &ok );
+  return ok;
+  }
+
+// Parses whitespace separated numbers straight into a buffer. The XML reader can hand us the
+// text of an element in several chunks, so a number split between chunks is carried over.
+template <typename T> class NumberReader
+  {
+public:
+  // when growable, output is resized if it turns out to be too small, otherwise extra numbers are dropped.
+  NumberReader( XVector<T> &output, bool growable ) : _output( output ), _count( 0 ), _growable( growable ), _partialSize( 0 )
     {
-    QTextStream stream( &data, QIODevice::ReadOnly );
-    XList<XVector4D> ret;
+    }
 
-    for( int i=0; i<count; i++ )
+  void append( const ushort *p, int length )
+    {
+    const ushort *end = p + length;
+
+    if( _partialSize )
+      {
+      // finish the number the last chunk ended in
+      while( p < end && !isSpace( *p ) && _partialSize < PartialCapacity )
         {
-        float x, y, z, w;
-        stream >> x >> y >> z >> w;
-        ret << XVector4D( x, y, z, w );
+        _partial[_partialSize++] = *p++;
         }
-    return ret;
-    }
 
-XColladaFile::XColladaFile( QString name ) : _document( "COLLADA" )
-    {
-    QFile f( name );
-    if( !f.open( QFile::ReadOnly ) )
+      if( p == end )
         {
         return;
         }
-    _document.setContent( f.readAll() );
 
-    QDomElement docElement( _document.documentElement() );
+      pushToken( _partial, _partial + _partialSize );
+      _partialSize = 0;
+      }
 
-    int num;
-    if( !docElement.isNull() && docElement.tagName() == "COLLADA" )
+    for( ;; )
+      {
+      while( p < end && isSpace( *p ) )
         {
-        QDomElement colladaElement = docElement.firstChildElement("library_geometries");
-        if( !colladaElement.isNull() )
-            {
-            QDomElement geometryElement = colladaElement.firstChildElement("geometry");
-            while( !geometryElement.isNull() )
-                {
-                QString str( geometryElement.attribute("name") );
-                if( str == "" )
-                    {
-                    str = QString::number( num );
-                    }
-
-                QDomElement meshElement( geometryElement.firstChildElement() );
-                if( !meshElement.isNull() && meshElement.tagName() == "mesh" )
-                    {
-                    _geometries.insert( str, meshElement );
-                    }
-
-                num++;
-                geometryElement = geometryElement.nextSiblingElement("geometry");
-                }
-            }
+        ++p;
         }
-    }
 
-bool XColladaFile::geometryExists( QString in )
-    {
-    return _geometries.contains( in );
+      const ushort *token = p;
+      while( p < end && !isSpace( *p ) )
+        {
+        ++p;
+        }
+
+      if( token == p )
+        {
+        return;
+        }
+
+      if( p == end )
+        {
+        // may continue in the next chunk
+        _partialSize = xMin( (int)( p - token ), (int)PartialCapacity );
+        memcpy( _partial, token, _partialSize * sizeof(ushort) );
+        return;
+        }
+
+      pushToken( token, p );
+      }
     }
 
-QStringList XColladaFile::geometryNames() const
+  // returns the number of values read, and trims a growable output to that size.
+  int finish()
     {
-    return _geometries.keys();
+    if( _partialSize )
+      {
+      pushToken( _partial, _partial + _partialSize );
+      _partialSize = 0;
+      }
+
+    if( _growable )
+      {
+      _output.resize( _count );
+      }
+    return _count;
     }
 
-XGeometry XColladaFile::geometry( QString name ) const
+private:
+  void pushToken( const ushort *begin, const ushort *end )
     {
-    XGeometry ret;
-
-    XHash <QString, XList<xReal> > attr1D;
-    XHash <QString, XList<XVector2D> > attr2D;
-    XHash <QString, XList<XVector3D> > attr3D;
-    XHash <QString, XList<XVector4D> > attr4D;
-
-    if( !_geometries.contains( name ) )
+    if( _count == _output.size() )
+      {
+      if( !_growable )
         {
-        return ret;
+        ++_count;
+        return;
         }
+      _output.resize( ( _output.size() * 2 ) + 64 );
+      }
+
+    T &out = _output.data()[_count];
+    if( !parseNumber( begin, end, out ) && !parseFallback( begin, end, out ) )
+      {
+      qWarning() << "Invalid number in COLLADA array" << QString::fromUtf16( begin, end - begin );
+      out = T();
+      }
+    ++_count;
+    }
 
-    QDomElement mesh( _geometries[name] );
+  enum { PartialCapacity = 64 };
 
-    QDomElement sourceElement( mesh.firstChildElement("source") );
-    while( !sourceElement.isNull() )
-        {
-        QString name( sourceElement.attribute("id") );
+  XVector<T> &_output;
+  int _count;
+  bool _growable;
+  ushort _partial[PartialCapacity];
+  int _partialSize;
+  };
 
-        QDomElement arrayElement( sourceElement.firstChildElement("float_array") );
+// read the text of the current element into output, leaves the reader on the end element.
+template <typename T> int readNumbers( QXmlStreamReader &reader, XVector<T> &output, bool growable )
+  {
+  NumberReader<T> numbers( output, growable );
+  while( !reader.atEnd() )
+    {
+    QXmlStreamReader::TokenType token = reader.readNext();
+    if( token == QXmlStreamReader::Characters )
+      {
+      const QStringRef &text = reader.text();
+      numbers.append( reinterpret_cast<const ushort *>( text.unicode() ), text.size() );
+      }
+    else if( token == QXmlStreamReader::EndElement )
+      {
+      break;
+      }
+    }
 
-        int count( arrayElement.attribute("count").toInt() );
+  int count = numbers.finish();
+  if( !growable && count != output.size() )
+    {
+    qWarning() << "COLLADA array has" << count << "values, expected" << output.size();
+    }
+  return count;
+  }
+
+struct Source
+  {
+  Source() : stride( 0 ) { }
+  XVector<xReal> data;
+  int stride;
+  };
+
+struct Input
+  {
+  Input() : offset( -1 ), source( 0 ) { }
+  int offset;
+  const Source *source;
+  };
+
+class MeshParser
+  {
+public:
+  MeshParser() : _vertexSize( 0 ), _primitiveCount( 0 )
+    {
+    }
 
-        int size = 0;
+  XGeometry parse( const QByteArray &data );
 
-        // Analyse Array Contents
-            {
-            QDomElement techniqueElement( sourceElement.firstChildElement("technique_common") );
-            if( !techniqueElement.isNull() )
-                {
-                QDomElement accessorElement( techniqueElement.firstChildElement("accessor") );
-                if( !accessorElement.isNull() )
-                    {
-
-                    QDomElement paramElement( accessorElement.firstChildElement("param") );
-                    while( !paramElement.isNull() )
-                        {
-                        paramElement = paramElement.nextSiblingElement("param");
-                        size++;
-                        }
-                    }
-                }
-            }
+private:
+  enum PrimitiveType { Triangles, Polylist, Polygons };
 
-        xAssert( ( count % size ) == 0 );
+  void beginPrimitives( const QXmlStreamReader & );
+  void addInput( const QXmlStreamAttributes & );
+  void readIndices( QXmlStreamReader &reader, PrimitiveType type );
+  void appendCorners( const int *indices, int corners );
 
-        if( size == 1 )
-            {
-            XList<xReal> floats( getList1D( arrayElement.text(), count/size ) );
-            attr1D.insert( name, floats );
-            }
-        else if( size == 2 )
-            {
-            XList<XVector2D> floats( getList2D( arrayElement.text(), count/size ) );
-            attr2D.insert( name, floats );
-            }
-        else if( size == 3 )
-            {
-            XList<XVector3D> floats( getList3D( arrayElement.text(), count/size ) );
-            attr3D.insert( name, floats );
-            }
-        else if( size == 4 )
-            {
-            XList<XVector4D> floats( getList4D( arrayElement.text(), count/size ) );
-            attr4D.insert( name, floats );
-            }
+  XHash <QString, Source> _sources;
+  XHash <QString, QString> _vertexInputs;
 
-        sourceElement = sourceElement.nextSiblingElement("source");
-        }
+  Input _position;
+  Input _normal;
+  Input _texture;
+  int _vertexSize;
+  int _primitiveCount;
+  XVector<int> _vcount;
+  XVector<int> _p;
 
-    unsigned int inputNum = 0;
-    unsigned int maxOffset = 0;
+  XVector<XVector3D> _positions;
+  XVector<XVector3D> _normals;
+  XVector<XVector2D> _textures;
+  XVector<unsigned int> _triangles;
+  };
 
-    int posOff = -1;
-    XList<XVector3D> *posPtr = 0;
-    int norOff = -1;
-    XList<XVector3D> *norPtr = 0;
-    int texOff = -1;
-    XList<XVector2D> *texPtr = 0;
+XGeometry MeshParser::parse( const QByteArray &data )
+  {
+  QXmlStreamReader reader( data );
 
-    QDomElement inputParent;
+  QString currentSource;
+  int accessorParams = 0;
+  bool inVertices = false;
+  PrimitiveType primitive = Triangles;
 
-    // could search for different polygon sections here
-    if( !mesh.firstChildElement("polylist").isNull() )
+  while( !reader.atEnd() )
+    {
+    QXmlStreamReader::TokenType token = reader.readNext();
+    if( token == QXmlStreamReader::StartElement )
+      {
+      QStringRef name = reader.name();
+      if( name == "source" )
         {
-        inputParent = mesh.firstChildElement("polylist");
+        currentSource = reader.attributes().value( "id" ).toString();
         }
-    else if( !mesh.firstChildElement("triangles").isNull() )
+      else if( name == "float_array" )
         {
-        inputParent = mesh.firstChildElement("triangles");
+        Source &src = _sources[currentSource];
+        src.data.resize( reader.attributes().value( "count" ).toString().toInt() );
+        readNumbers( reader, src.data, false );
         }
-    else
+      else if( name == "accessor" )
         {
-        inputParent = mesh.firstChildElement("polygons");
+        _sources[currentSource].stride = reader.attributes().value( "stride" ).toString().toInt();
+        accessorParams = 0;
         }
-
-    QDomElement inputElement = inputParent.firstChildElement("input");
-    while( !inputElement.isNull() )
+      else if( name == "param" )
+        {
+        ++accessorParams;
+        }
+      else if( name == "vertices" )
+        {
+        inVertices = true;
+        currentSource = reader.attributes().value( "id" ).toString();
+        }
+      else if( name == "input" )
+        {
+        if( inVertices )
+          {
+          // inputs of <vertices> are used by any VERTEX input later
+          _vertexInputs.insert( reader.attributes().value( "semantic" ).toString(),
+                                reader.attributes().value( "source" ).toString().mid( 1 ) );
+          }
+        else
+          {
+          addInput( reader.attributes() );
+          }
+        }
+      else if( name == "triangles" || name == "polylist" || name == "polygons" )
+        {
+        primitive = name == "triangles" ? Triangles : ( name == "polylist" ? Polylist : Polygons );
+        beginPrimitives( reader );
+        }
+      else if( name == "vcount" )
+        {
+        _vcount.resize( _primitiveCount );
+        readNumbers( reader, _vcount, false );
+        }
+      else if( name == "p" )
         {
-        QString semantic = inputElement.attribute("semantic");
-        unsigned int offset = inputElement.attribute("offset").toUInt();
-        QString location;
+        readIndices( reader, primitive );
+        }
+      }
+    else if( token == QXmlStreamReader::EndElement )
+      {
+      QStringRef name = reader.name();
+      if( name == "accessor" )
+        {
+        Source &src = _sources[currentSource];
+        if( src.stride == 0 )
+          {
+          src.stride = accessorParams;
+          }
+        }
+      else if( name == "vertices" )
+        {
+        inVertices = false;
+        }
+      }
+    }
 
-        if( offset > maxOffset )
-            {
-            maxOffset = offset;
-            }
+  if( reader.hasError() )
+    {
+    qWarning() << "Error parsing COLLADA geometry" << reader.errorString() << "at line" << reader.lineNumber();
+    }
 
-        if( semantic == "VERTEX" )
-            {
-            QDomElement vertivesElement( mesh.firstChildElement("vertices").firstChildElement("input") );
-            xAssert( vertivesElement.attribute("semantic") == "POSITION" );
-            semantic = "POSITION";
-            location = vertivesElement.attribute("source");
-            }
-        else
-            {
-            location = inputElement.attribute("source");
-            }
+  XGeometry ret;
+  ret.setAttribute( "vertex", _positions );
+  ret.setAttribute( "normal", _normals );
+  ret.setAttribute( "texture", _textures );
+  ret.setTriangles( _triangles );
+  return ret;
+  }
+
+void MeshParser::beginPrimitives( const QXmlStreamReader &reader )
+  {
+  _position = Input();
+  _normal = Input();
+  _texture = Input();
+  _vertexSize = 0;
+  _primitiveCount = reader.attributes().value( "count" ).toString().toInt();
+  }
+
+void MeshParser::addInput( const QXmlStreamAttributes &attrs )
+  {
+  QString semantic = attrs.value( "semantic" ).toString();
+  QString location = attrs.value( "source" ).toString().mid( 1 );
+  int offset = attrs.value( "offset" ).toString().toInt();
+  _vertexSize = xMax( _vertexSize, offset + 1 );
+
+  XHash <QString, Source>::const_iterator src = _sources.find( location );
+  XHash <QString, Source>::const_iterator end = _sources.end();
+
+  if( semantic == "VERTEX" )
+    {
+    XHash <QString, Source>::const_iterator pos = _sources.find( _vertexInputs.value( "POSITION" ) );
+    xAssert( pos != end );
+    _position.offset = offset;
+    _position.source = pos != end ? &pos.value() : 0;
+
+    XHash <QString, Source>::const_iterator nor = _sources.find( _vertexInputs.value( "NORMAL" ) );
+    if( nor != end )
+      {
+      _normal.offset = offset;
+      _normal.source = &nor.value();
+      }
+    }
+  else if( semantic == "NORMAL" && src != end )
+    {
+    _normal.offset = offset;
+    _normal.source = &src.value();
+    }
+  else if( semantic == "TEXCOORD" && src != end && _texture.source == 0 )
+    {
+    // only the first texture coordinate set is used
+    _texture.offset = offset;
+    _texture.source = &src.value();
+    }
+  }
 
-        location = location.mid(1);
+void MeshParser::readIndices( QXmlStreamReader &reader, PrimitiveType type )
+  {
+  if( _vertexSize == 0 || !_position.source )
+    {
+    reader.skipCurrentElement();
+    return;
+    }
 
-        if( semantic == "POSITION" )
-            {
-            foreach( QString name, attr3D.keys() )
-                {
-                if( name == location )
-                    {
-                    posPtr = &(attr3D[name]);
-                    posOff = offset;
-                    }
-                }
-            }
-        if( semantic == "NORMAL" )
-            {
-            foreach( QString name, attr3D.keys() )
-                {
-                if( name == location )
-                    {
-                    norPtr = &(attr3D[name]);
-                    norOff = offset;
-                    }
-                }
-            }
-        if( semantic == "TEXCOORD" )
-            {
-            foreach( QString name, attr2D.keys() )
-                {
-                if( name == location )
-                    {
-                    texPtr = &(attr2D[name]);
-                    texOff = offset;
-                    }
-                }
-            }
+  // size the index buffer up front when the element tells us how big it is.
+  int expected = 0;
+  if( type == Triangles )
+    {
+    expected = _primitiveCount * 3 * _vertexSize;
+    }
+  else if( type == Polylist )
+    {
+    foreach( int size, _vcount )
+      {
+      expected += size * _vertexSize;
+      }
+    }
+
+  _p.resize( expected );
+  int read = readNumbers( reader, _p, type == Polygons );
+  if( read % _vertexSize != 0 )
+    {
+    qWarning() << "COLLADA index list is not a multiple of the vertex size";
+    return;
+    }
 
-        ++inputNum;
-        inputElement = inputElement.nextSiblingElement("input");
+  int firstVertex = _positions.size();
+  int corners = xMin( read, _p.size() ) / _vertexSize;
+  appendCorners( _p.constData(), corners );
+
+  // fan triangulate each polygon
+  if( type == Triangles )
+    {
+    int triangles = corners / 3;
+    int offset = _triangles.size();
+    _triangles.resize( offset + triangles * 3 );
+    unsigned int *tri = _triangles.data() + offset;
+    for( int i=0; i<triangles*3; ++i )
+      {
+      tri[i] = firstVertex + i;
+      }
+    }
+  else
+    {
+    XVector<int> polygonSizes;
+    const XVector<int> *sizes = &_vcount;
+    if( type == Polygons )
+      {
+      // each <p> of a <polygons> is a single polygon
+      polygonSizes << corners;
+      sizes = &polygonSizes;
+      }
+
+    int triangleIndices = 0;
+    foreach( int size, *sizes )
+      {
+      triangleIndices += xMax( size - 2, 0 ) * 3;
+      }
+
+    int offset = _triangles.size();
+    _triangles.resize( offset + triangleIndices );
+    unsigned int *tri = _triangles.data() + offset;
+    int polygonStart = firstVertex;
+    foreach( int size, *sizes )
+      {
+      for( int y=0; y<size-2; ++y )
+        {
+        *tri++ = polygonStart;
+        *tri++ = polygonStart + y + 1;
+        *tri++ = polygonStart + y + 2;
         }
+      polygonStart += size;
+      }
+    }
+  }
+
+void MeshParser::appendCorners( const int *indices, int corners )
+  {
+  int first = _positions.size();
+
+  // write every corner straight into the pre-sized output
+  _positions.resize( first + corners );
+  XVector3D *positions = _positions.data() + first;
+  XVector3D *normals = 0;
+  XVector2D *textures = 0;
+  if( _normal.source )
+    {
+    _normals.resize( first + corners );
+    normals = _normals.data() + first;
+    }
+  if( _texture.source )
+    {
+    _textures.resize( first + corners );
+    textures = _textures.data() + first;
+    }
 
-    xAssert( posOff != -1 );
+  const xReal *positionData = _position.source->data.constData();
+  int positionStride = _position.source->stride;
+  int positionMax = _position.source->data.size() - 3;
+  for( int i=0; i<corners; ++i, indices += _vertexSize )
+    {
+    int index = indices[_position.offset] * positionStride;
+    xAssert( index >= 0 && index <= positionMax );
+    if( index < 0 || index > positionMax )
+      {
+      index = 0;
+      }
+    positions[i] = XVector3D( positionData[index], positionData[index+1], positionData[index+2] );
+
+    if( normals )
+      {
+      const Source *src = _normal.source;
+      int nIndex = indices[_normal.offset] * src->stride;
+      xAssert( nIndex >= 0 && nIndex + 2 < src->data.size() );
+      const xReal *n = src->data.constData() + nIndex;
+      normals[i] = XVector3D( n[0], n[1], n[2] );
+      }
+
+    if( textures )
+      {
+      const Source *src = _texture.source;
+      int tIndex = indices[_texture.offset] * src->stride;
+      xAssert( tIndex >= 0 && tIndex + 1 < src->data.size() );
+      const xReal *t = src->data.constData() + tIndex;
+      textures[i] = XVector2D( t[0], t[1] );
+      }
+    }
+  }
+
+// find the byte ranges of each <geometry> element, so they can be parsed independently.
+struct GeometryRange
+  {
+  QString name;
+  int begin;
+  int end;
+  };
+
+XVector<GeometryRange> findGeometries( const char *data, int size )
+  {
+  XVector<GeometryRange> ranges;
+  QByteArray raw( QByteArray::fromRawData( data, size ) );
+
+  const QByteArray openTag( "<geometry" );
+  const QByteArray closeTag( "</geometry>" );
+
+  int num = 0;
+  int position = 0;
+  while( ( position = raw.indexOf( openTag, position ) ) != -1 )
+    {
+    int tagEnd = raw.indexOf( '>', position );
+    char next = position + openTag.size() < size ? data[position + openTag.size()] : 0;
+    if( tagEnd == -1 || !( isSpace( next ) || next == '>' || next == '/' ) )
+      {
+      // some other tag which starts with geometry.
+      position += openTag.size();
+      continue;
+      }
+
+    int end = raw.indexOf( closeTag, tagEnd );
+    if( end == -1 )
+      {
+      break;
+      }
+    end += closeTag.size();
+
+    GeometryRange range;
+    range.begin = position;
+    range.end = end;
+
+    // the geometry is named by its name attribute, or its index if it has none.
+    QXmlStreamReader tag( QByteArray::fromRawData( data + position, tagEnd + 1 - position ) );
+    while( !tag.atEnd() && tag.readNext() != QXmlStreamReader::StartElement )
+      {
+      }
+    range.name = tag.attributes().value( "name" ).toString();
+    if( range.name.isEmpty() )
+      {
+      range.name = QString::number( num );
+      }
+
+    ranges << range;
+    ++num;
+    position = end;
+    }
 
-    XList <XVector3D> positions;
-    XList <XVector3D> normals;
-    XList <XVector2D> textures;
+  return ranges;
+  }
 
-    XList <unsigned int> indices;
+class GeometryJob : public QRunnable
+  {
+public:
+  GeometryJob( const char *data, const GeometryRange &range, XGeometry *output )
+      : _data( data ), _range( range ), _output( output )
+    {
+    }
 
-    int vertexSize = maxOffset + 1;
+  void run()
+    {
+    MeshParser parser;
+    *_output = parser.parse( QByteArray::fromRawData( _data + _range.begin, _range.end - _range.begin ) );
+    }
+
+private:
+  const char *_data;
+  GeometryRange _range;
+  XGeometry *_output;
+  };
+}
 
-    if( !mesh.firstChildElement("triangles").isNull() )
+XColladaFile::XColladaFile( QString name, int maxThreads )
+    {
+    QFile f( name );
+    if( !f.open( QFile::ReadOnly ) )
         {
-        QDomElement triangles = mesh.firstChildElement("triangles");
-        unsigned int triangleSize = 3 * vertexSize;
+        return;
+        }
 
-        XList <int> triIndexes = getListInt( triangles.firstChildElement("p").text() );
-        xAssert( ( triIndexes.size()%triangleSize ) == 0 );
+    // map the file if we can, so the source text is never copied.
+    QByteArray contents;
+    const char *data = reinterpret_cast<const char *>( f.map( 0, f.size() ) );
+    int size = f.size();
+    if( !data )
+        {
+        contents = f.readAll();
+        data = contents.constData();
+        size = contents.size();
+        }
 
-        unsigned int triNum = 0;
-        for( int x=0; x<triIndexes.size(); x+=triangleSize )
+    XVector<GeometryRange> ranges = findGeometries( data, size );
+    XVector<XGeometry> geometries( ranges.size() );
+
+    if( ranges.size() == 1 || maxThreads == 1 )
+        {
+        for( int i=0; i<ranges.size(); ++i )
             {
-            for( unsigned int y=0; y<3; y++ )
-                {
-                indices << positions.size();
-                positions << (*posPtr)[triIndexes[x+(y*vertexSize)+posOff]];
-                if( norPtr )
-                    {
-                    normals << (*norPtr)[triIndexes[x+(y*vertexSize)+norOff]];
-                    }
-                if( texPtr )
-                    {
-                    textures << (*texPtr)[triIndexes[x+(y*vertexSize)+texOff]];
-                    }
-                }
-            triNum++;
+            GeometryJob( data, ranges[i], &geometries[i] ).run();
             }
         }
-    else if( !mesh.firstChildElement("polylist").isNull() )
+    else
         {
-        QDomElement polygons = mesh.firstChildElement("polylist");
-
-        QDomElement pE = polygons.firstChildElement("p");
-        QDomElement vcount = polygons.firstChildElement("vcount");
-        if( !pE.isNull() && !vcount.isNull() )
+        QThreadPool pool;
+        if( maxThreads > 0 )
             {
-            XList <int> polySizes = getListInt( vcount.text() );
-            XList <int> polyIndices = getListInt( pE.text() );
-
-            int startPoly=0;
-
-            for( int x=0; x<polySizes.size(); x++ )
-                {
-                int firstVertex = positions.size();
-
-                for( int y=0; y<polySizes[x]; y++ )
-                    {
-                    positions << (*posPtr)[polyIndices[startPoly]];
-                    if( norPtr )
-                        {
-                        normals << (*norPtr)[polyIndices[startPoly+1]];
-                        }
-                    if( texPtr )
-                        {
-                        textures << (*texPtr)[polyIndices[startPoly+2]];
-                        }
-                    startPoly += vertexSize;
-                    }
-
-                for( int y=0; y<polySizes[x]-2; y++ )
-                    {
-                    indices << firstVertex << firstVertex+y+1 << firstVertex+y+2;
-                    }
-                }
+            pool.setMaxThreadCount( maxThreads );
             }
 
-            pE = pE.nextSiblingElement("p");
+        for( int i=0; i<ranges.size(); ++i )
+            {
+            pool.start( new GeometryJob( data, ranges[i], &geometries[i] ) );
+            }
+        pool.waitForDone();
         }
-    else
-        {
-        QDomElement polygons = mesh.firstChildElement("polygons");
 
-        QDomElement pE = polygons.firstChildElement("p");
-        while( !pE.isNull() )
+    for( int i=0; i<ranges.size(); ++i )
+        {
+        if( !geometries[i].triangles().isEmpty() )
             {
-            XList <int> polyIndices = getListInt( pE.text() );
-
-            int firstVertex = positions.size();
-            for( int x=0; x<polyIndices.size(); x+=vertexSize )
-                {
-                positions << (*posPtr)[polyIndices[x]];
-                if( norPtr )
-                    {
-                    normals << (*norPtr)[polyIndices[x+1]];
-                    }
-                if( texPtr )
-                    {
-                    textures << (*texPtr)[polyIndices[x+2]];
-                    }
-                }
-
-            for( int x=0; x<(polyIndices.size()/vertexSize)-2; x++ )
-                {
-                indices << firstVertex << firstVertex+x+1 << firstVertex+x+2;
-                }
-
-            pE = pE.nextSiblingElement("p");
+            _geometries.insert( ranges[i].name, geometries[i] );
             }
         }
+    }
 
-    ret.setAttribute( "vertex", positions );
-    ret.setAttribute( "normal", normals );
-    ret.setAttribute( "texture", textures );
+bool XColladaFile::geometryExists( QString in )
+    {
+    return _geometries.contains( in );
+    }
 
-    ret.setTriangles( indices );
+QStringList XColladaFile::geometryNames() const
+    {
+    return _geometries.keys();
+    }
 
-    return ret;
+XGeometry XColladaFile::geometry( QString name ) const
+    {
+    return _geometries.value( name );
     }
@@ -1,13 +1,110 @@
 #include "XEnvironment.h"
 #include "XAbstractEnvironmentInterface.h"
+#include "XEnvironmentDiskCache.h"
+#include "XGeometry.h"
+#include "XCuboid.h"
 #include "QDataStream"
+#include "QRunnable"
+#include "algorithm"
+
+class XEnvironment::DecodeJob : public QRunnable
+  {
+public:
+  // [install] is false for replies which only update the disk cache.
+  DecodeJob(XEnvironment *env, const Request &req, bool install=true) : _environment(env), _install(install)
+    {
+    _item.request = req;
+    }
+
+  void run()
+    {
+    const Request &req = _item.request;
+    if(_environment->_diskCache && req.type() != SpecialType && req.version())
+      {
+      _environment->_diskCache->store(req);
+      }
+
+    if(_install)
+      {
+      XEnvironment::decode(_item);
+      _environment->onDecoded(_item);
+      }
+    }
+
+private:
+  XEnvironment *_environment;
+  DecodedItem _item;
+  bool _install;
+  };
+
+void XEnvironment::discard(DecodedItem &item)
+  {
+  delete item.container;
+  delete item.textureInfo;
+  delete item.mesh;
+  delete item.area;
+  item.container = 0;
+  item.textureInfo = 0;
+  item.mesh = 0;
+  item.area = 0;
+  }
 
 XEnvironment::XEnvironment(XAbstractEnvironmentInterface *iface, Listener *l) :
-    XInitProperty(environmentInterface, iface), _listener(l), _requestID(0)
+    XInitProperty(environmentInterface, iface), _maximumInFlight(8), _inFlight(0), _listener(l), _diskCache(0), _requestID(0)
   {
   environmentInterface()->setController(this);
   }
 
+XEnvironment::~XEnvironment()
+  {
+  _decodePool.waitForDone();
+  for(int i=0; i<_decoded.size(); ++i)
+    {
+    discard(_decoded[i]);
+    }
+
+  delete _diskCache;
+  }
+
+void XEnvironment::setDiskCache(const QString &directory)
+  {
+  _decodePool.waitForDone();
+  delete _diskCache;
+
+  _diskCache = new XEnvironmentDiskCache(directory);
+  if(!_diskCache->open())
+    {
+    qWarning() << "Couldn't open the environment cache in" << directory;
+    delete _diskCache;
+    _diskCache = 0;
+    }
+  }
+
+void XEnvironment::validateDiskCache()
+  {
+  if(!_diskCache)
+    {
+    return;
+    }
+
+  XList<Request> checks = _diskCache->entries();
+  for(int i=0; i<checks.size(); ++i)
+    {
+    checks[i].setRequestID(_requestID++);
+    _validating << checks[i].requestID();
+    }
+
+  if(checks.size())
+    {
+    environmentInterface()->requestItems(checks);
+    }
+  }
+
+bool XEnvironment::cachedData(const Request &req, xuint32 version, QByteArray &data) const
+  {
+  return _diskCache && _diskCache->find(req, version, data);
+  }
+
 XEnvironment::ItemID XEnvironment::createItem(ItemType type)
   {
   Request item = requestSpecialItem(type, CreateItem, true);
@@ -20,23 +117,75 @@ XEnvironment::ItemID XEnvironment::createItem(ItemType type)
   return id;
   }
 
-void XEnvironment::requestComplete(xuint32 requestID)
+void XEnvironment::receive(const Request &req)
   {
-  Request r;
+  if(_validating.remove(req.requestID()))
     {
-    for(int i=0; i<_pendingRequests.size(); ++i)
+    // a version check, the cache is brought up to date but nothing is installed.
+    _decodePool.start(new DecodeJob(this, req, false));
+    return;
+    }
+
+  XHash<xuint32, PendingRequest>::const_iterator it = _pendingRequests.find(req.requestID());
+  if(it != _pendingRequests.end() && it->state == Cancelled)
+    {
+    // nobody wants this any more, don't waste time decoding it. Its slot was freed when it was cancelled.
+    removePending(req.requestID());
+    return;
+    }
+
+  _decodePool.start(new DecodeJob(this, req));
+  }
+
+void XEnvironment::onDecoded(const DecodedItem &item)
+  {
+    {
+    QMutexLocker l(&_decodedLock);
+    _decoded << item;
+    }
+
+  xAssert(_listener);
+  _listener->onRequestsDecoded();
+  }
+
+void XEnvironment::update()
+  {
+  XVector<DecodedItem> decoded;
+    {
+    QMutexLocker l(&_decodedLock);
+    decoded = _decoded;
+    _decoded.clear();
+    }
+
+  for(int i=0; i<decoded.size(); ++i)
+    {
+    DecodedItem &item = decoded[i];
+    xuint32 id = item.request.requestID();
+
+    XHash<xuint32, PendingRequest>::const_iterator it = _pendingRequests.find(id);
+    bool pending = it != _pendingRequests.end();
+    if(pending && it->state == Cancelled)
       {
-      if(_pendingRequests[i].requestID() == requestID)
-        {
-        r = _pendingRequests[i];
-        _pendingRequests.removeAt(i);
-        }
+      discard(item);
+      removePending(id);
+      continue;
       }
+
+    install(item);
+
+    Request r = item.request;
+    if(pending)
+      {
+      r = it->request;
+      removePending(id);
+      --_inFlight;
+      }
+
+    xAssert(_listener);
+    _listener->onRequestComplete(r);
     }
 
-  xAssert(_listener);
-  _listener->onRequestComplete(r);
-  qDebug() << "Request Complete" << requestID;
+  sendQueued();
   }
 
 QByteArray XEnvironment::getData(const Request &req, bool *correct) const
@@ -56,6 +205,14 @@ QByteArray XEnvironment::getData(const Request &req, bool *correct) const
     QDataStream str(&arr, QIODevice::WriteOnly);
     str << *_textureInfos[req.ID()];
 
+    correct ? *correct = true : true;
+    }
+  else if(req.type() == MeshType && _meshes.contains(req.ID()))
+    {
+    // meshes are sent as mesh containers, which the receiver uses without parsing.
+    const XGeometry *geo = _meshes[req.ID()];
+    arr = geo->meshContainer().isValid() ? geo->meshContainer().data() : XMeshContainer::create(*geo).data();
+
     correct ? *correct = true : true;
     }
   else if(req.type() == SpecialType && _specials.contains(req.ID()))
@@ -72,8 +229,62 @@ QByteArray XEnvironment::getData(const Request &req, bool *correct) const
   return arr;
   }
 
-void XEnvironment::setData(const Request &req, const QByteArray &arr)
+void XEnvironment::decode(DecodedItem &item)
   {
+  const Request &req = item.request;
+  const QByteArray &arr = req.extraData();
+  if(arr.isEmpty())
+    {
+    return;
+    }
+
+  if(req.type() == ContainerType)
+    {
+    item.container = new Container(req.ID());
+
+    // cast because we are not going to change to contents due to ReadOnly, but IODevice expects a non-const ptr.
+    QDataStream str((QByteArray*)&arr, QIODevice::ReadOnly);
+    str >> *item.container;
+    }
+  else if(req.type() == TextureType && req.subType() == InfoSubType)
+    {
+    item.textureInfo = new TextureInfo(req.ID());
+
+    QDataStream str((QByteArray*)&arr, QIODevice::ReadOnly);
+    str >> *item.textureInfo;
+    }
+  else if(req.type() == MeshType)
+    {
+    XMeshContainer container;
+    if(container.setData(arr))
+      {
+      item.mesh = new XGeometry(container);
+      }
+    }
+  else if(req.type() == WorldType)
+    {
+    item.area = new Area;
+
+    QDataStream str((QByteArray*)&arr, QIODevice::ReadOnly);
+    if(req.subType() == Area::Item)
+      {
+      item.area->restore(str);
+      }
+    else if(req.subType() == Area::Visibility)
+      {
+      item.area->restoreVisibility(str);
+      }
+    }
+  else if(req.type() == SpecialType)
+    {
+    item.special = arr;
+    }
+  }
+
+void XEnvironment::install(DecodedItem &item)
+  {
+  // the existing objects are updated in place, as callers hold pointers to them.
+  const Request &req = item.request;
   if(req.type() == ContainerType)
     {
     Container *&ctr = _containers[req.ID()];
@@ -82,12 +293,9 @@ void XEnvironment::setData(const Request &req, const QByteArray &arr)
       ctr = new Container(req.ID());
       }
 
-    if(arr.length())
+    if(item.container)
       {
-      // cast because we are not going to change to contents due to ReadOnly, but IODevice expects a non-const ptr.
-      QDataStream str((QByteArray*)&arr, QIODevice::ReadOnly);
-
-      str >> *ctr;
+      *ctr = *item.container;
       }
     }
   else if(req.type() == TextureType && req.subType() == InfoSubType)
@@ -98,12 +306,42 @@ void XEnvironment::setData(const Request &req, const QByteArray &arr)
       ctr = new TextureInfo(req.ID());
       }
 
-    if(arr.length())
+    if(item.textureInfo)
+      {
+      *ctr = *item.textureInfo;
+      }
+    }
+  else if(req.type() == MeshType)
+    {
+    XGeometry *&geo = _meshes[req.ID()];
+    if(!geo)
+      {
+      geo = new XGeometry;
+      }
+
+    if(item.mesh)
       {
-      // cast because we are not going to change to contents due to ReadOnly, but IODevice expects a non-const ptr.
-      QDataStream str((QByteArray*)&arr, QIODevice::ReadOnly);
+      *geo = *item.mesh;
+      }
+    }
+  else if(req.type() == WorldType)
+    {
+    Area *&area = _areas[req.ID()];
+    if(!area)
+      {
+      area = new Area;
+      }
 
-      str >> *ctr;
+    if(item.area && req.subType() == Area::Item)
+      {
+      // the visibility arrives separately, keep it.
+      XEnvironmentVisibility visibility = area->visibility();
+      *area = *item.area;
+      area->visibility() = visibility;
+      }
+    else if(item.area && req.subType() == Area::Visibility)
+      {
+      area->visibility() = item.area->visibility();
       }
     }
   else if(req.type() == SpecialType)
@@ -114,12 +352,24 @@ void XEnvironment::setData(const Request &req, const QByteArray &arr)
       spe = new QByteArray;
       }
 
-    *spe = arr;
+    *spe = item.special;
     }
   else
     {
     xAssertFail();
     }
+
+  discard(item);
+  }
+
+void XEnvironment::setData(const Request &req, const QByteArray &arr)
+  {
+  DecodedItem item;
+  item.request = req;
+  item.request.setExtraData(arr);
+
+  decode(item);
+  install(item);
   }
 
 void XEnvironment::syncData(const Request &req)
@@ -127,49 +377,261 @@ void XEnvironment::syncData(const Request &req)
   environmentInterface()->syncItem( req );
   }
 
-void XEnvironment::requestItem(Request &request, bool block)
+void XEnvironment::requestItem(Request &request, bool block, xReal importance)
   {
   qDebug() << "Request Item" << request.type() << request.ID() << request.subType();
 
-  if(!hasUncompleteRequestForSameData(request))
+  XHash<RequestKey, xuint32>::const_iterator existing = _pendingData.find(RequestKey(request));
+  if(existing != _pendingData.end())
+    {
+    xuint32 id = existing.value();
+    request.setRequestID(id);
+
+    PendingRequest &pending = _pendingRequests[id];
+    if(importance > pending.importance)
+      {
+      setImportance(id, importance);
+      }
+
+    if(block && pending.state == Queued)
+      {
+      send(pending);
+      }
+    }
+  else
     {
     request.setRequestID(_requestID++);
-    _pendingRequests << request;
-    environmentInterface()->requestItem( request );
+
+    PendingRequest pending;
+    pending.request = request;
+    pending.importance = importance;
+    pending.state = Queued;
+    _pendingRequests.insert(request.requestID(), pending);
+    _pendingData.insert(RequestKey(request), request.requestID());
+
+    if(block)
+      {
+      // blocking requests skip the queue, or we could wait behind a full set of in flight requests.
+      send(_pendingRequests[request.requestID()]);
+      }
+    else
+      {
+      QueueEntry entry = { importance, request.requestID() };
+      _queue << entry;
+      std::push_heap(_queue.begin(), _queue.end());
+      sendQueued();
+      }
     }
 
   if(block)
     {
     while(hasUncompleteRequest(request))
       {
-      // now refresh the data interface until it has our item
+      // now refresh the data interface until it has our item, and install it once decoded
       environmentInterface()->poll();
+      update();
       }
     }
   }
 
-bool XEnvironment::hasUncompleteRequest(const Request &r) const
+void XEnvironment::setImportance(xuint32 requestID, xReal importance)
   {
-  foreach(const Request &req, _pendingRequests)
+  XHash<xuint32, PendingRequest>::iterator it = _pendingRequests.find(requestID);
+  if(it == _pendingRequests.end() || it->importance == importance)
+    {
+    return;
+    }
+
+  it->importance = importance;
+  if(it->state != Queued)
+    {
+    return;
+    }
+
+  // the old entry is skipped when popped, rebuild the heap if stale entries start to dominate.
+  QueueEntry entry = { importance, requestID };
+  _queue << entry;
+  std::push_heap(_queue.begin(), _queue.end());
+
+  if(_queue.size() > 64 && _queue.size() > _pendingRequests.size() * 2)
     {
-    if(req.requestID() == r.requestID())
+    XVector<QueueEntry> queue;
+    queue.reserve(_pendingRequests.size());
+    for(XHash<xuint32, PendingRequest>::const_iterator p = _pendingRequests.begin(); p != _pendingRequests.end(); ++p)
       {
-      return true;
+      if(p->state == Queued)
+        {
+        QueueEntry e = { p->importance, p.key() };
+        queue << e;
+        }
       }
+    std::make_heap(queue.begin(), queue.end());
+    _queue = queue;
     }
-  return false;
   }
 
-bool XEnvironment::hasUncompleteRequestForSameData(const Request &req) const
+void XEnvironment::cancelRequest(xuint32 requestID)
+  {
+  XHash<xuint32, PendingRequest>::iterator it = _pendingRequests.find(requestID);
+  if(it == _pendingRequests.end())
+    {
+    return;
+    }
+
+  if(it->state == Queued)
+    {
+    // its queue entry is skipped when popped.
+    removePending(requestID);
+    }
+  else if(it->state == InFlight)
+    {
+    // the reply will still arrive, keep the request to discard it then. Its slot is freed now, so nothing
+    // depends on the reply arriving, and is taken by a queued request on the next update.
+    it->state = Cancelled;
+    if(_pendingData.value(RequestKey(it->request), X_UINT32_SENTINEL) == requestID)
+      {
+      _pendingData.remove(RequestKey(it->request));
+      }
+    xAssert(_inFlight);
+    --_inFlight;
+    environmentInterface()->cancelItem(it->request);
+    }
+  }
+
+void XEnvironment::cancelRequestsBelow(xReal importance)
   {
-  foreach(const Request &r, _pendingRequests)
+  XVector<xuint32> cancel;
+  for(XHash<xuint32, PendingRequest>::const_iterator it = _pendingRequests.begin(); it != _pendingRequests.end(); ++it)
     {
-    if(req.type() == r.type() && req.ID() == r.ID() && req.subType() == r.subType())
+    if(it->state != Cancelled && it->importance < importance)
       {
-      return true;
+      cancel << it.key();
       }
     }
-  return false;
+
+  foreach(xuint32 id, cancel)
+    {
+    cancelRequest(id);
+    }
+  }
+
+xReal XEnvironment::importance(const XCuboid &bounds, const XVector3D &position, xReal projectionScale, bool visible)
+  {
+  XVector3D centre = bounds.centre();
+  xReal radius = (bounds.maximum() - bounds.minimum()).norm() * 0.5f;
+
+  // clamp the distance to the radius, so a camera inside the bounds sees it at its largest.
+  xReal distance = xMax((centre - position).norm(), radius);
+  if(distance <= 0.0f)
+    {
+    return 0.0f;
+    }
+
+  xReal projected = projectionScale * radius / distance;
+  return visible ? projected : projected * 0.1f;
+  }
+
+xsize XEnvironment::requestVisibleAreas(const Area &area, const XVector3D &position, xReal projectionScale)
+  {
+  const XEnvironmentVisibility &visibility = area.visibility();
+  xsize requested = 0;
+  if(visibility.isEmpty())
+    {
+    foreach(ItemID id, area.childAreas())
+      {
+      if(!_areas.contains(id))
+        {
+        Request req(WorldType, id, Area::Item);
+        requestItem(req);
+        ++requested;
+        }
+      }
+    return requested;
+    }
+
+  foreach(xuint32 index, visibility.visibleFrom(position))
+    {
+    const XEnvironmentVisibility::Item &item = visibility.item(index);
+    if(!_areas.contains(item.ID()))
+      {
+      Request req(WorldType, item.ID(), Area::Item);
+      requestItem(req, false, importance(item.bounds(), position, projectionScale, true));
+      ++requested;
+      }
+    }
+  return requested;
+  }
+
+void XEnvironment::send(PendingRequest &pending)
+  {
+  xAssert(pending.state == Queued);
+  pending.state = InFlight;
+  ++_inFlight;
+
+  if(_diskCache && pending.request.type() != SpecialType)
+    {
+    xuint32 version = _diskCache->version(pending.request);
+    QByteArray data;
+    if(version && _diskCache->isValidated(pending.request) && _diskCache->find(pending.request, version, data))
+      {
+      // the server has confirmed this version, and pushes us any change to it.
+      Request local = pending.request;
+      local.setVersion(version);
+      local.setExtraData(data);
+      _decodePool.start(new DecodeJob(this, local));
+      return;
+      }
+
+    // if ours is still current the server only confirms it.
+    pending.request.setVersion(version);
+    }
+
+  environmentInterface()->requestItem( pending.request );
+  }
+
+void XEnvironment::sendQueued()
+  {
+  while(_inFlight < _maximumInFlight && !_queue.isEmpty())
+    {
+    std::pop_heap(_queue.begin(), _queue.end());
+    QueueEntry entry = _queue.back();
+    _queue.pop_back();
+
+    XHash<xuint32, PendingRequest>::iterator it = _pendingRequests.find(entry.requestID);
+    if(it == _pendingRequests.end() || it->state != Queued || it->importance != entry.importance)
+      {
+      // cancelled, already sent or reprioritised.
+      continue;
+      }
+
+    send(it.value());
+    }
+  }
+
+void XEnvironment::removePending(xuint32 requestID)
+  {
+  XHash<xuint32, PendingRequest>::iterator it = _pendingRequests.find(requestID);
+  if(it == _pendingRequests.end())
+    {
+    return;
+    }
+
+  RequestKey key(it->request);
+  if(_pendingData.value(key, X_UINT32_SENTINEL) == requestID)
+    {
+    _pendingData.remove(key);
+    }
+  _pendingRequests.erase(it);
+  }
+
+bool XEnvironment::hasUncompleteRequest(const Request &r) const
+  {
+  return _pendingRequests.contains(r.requestID());
+  }
+
+bool XEnvironment::hasUncompleteRequestForSameData(const Request &req) const
+  {
+  return _pendingData.contains(RequestKey(req));
   }
 
 XEnvironment::Request XEnvironment::requestSpecialItem(ItemID id, SpecialIdentifier type, bool block)
@@ -12,7 +12,7 @@ void XEnvironmentArea::save(QDataStream &stream) const
 
 void XEnvironmentArea::restore(QDataStream &stream)
   {
-  stream >> bounds() >> childAreas() << shadingGroups() << _visBoxWidth << _visBoxHeight << _visBoxDepth;
+  stream >> bounds() >> childAreas() >> shadingGroups() >> _visBoxWidth >> _visBoxHeight >> _visBoxDepth;
   }
 
 xuint32 XEnvironmentArea::getVisBoxID(xuint32 w, xuint32 h, xuint32 d) const
@@ -31,6 +31,16 @@ void XEnvironmentArea::restoreVisBox(QDataStream &stream, xuint32 id)
   stream >> spatialVisBoxes()[id];
   }
 
+void XEnvironmentArea::saveVisibility(QDataStream &stream) const
+  {
+  stream << visibility();
+  }
+
+void XEnvironmentArea::restoreVisibility(QDataStream &stream)
+  {
+  stream >> visibility();
+  }
+
 QDataStream &operator<<(QDataStream &stream, const XEnvironmentArea::ShadingGroup &s)
   {
   return stream << s._shader << s._meshes;
@@ -0,0 +1,374 @@
+#include "XEnvironmentCodec.h"
+#include "string.h"
+
+// A compressed block is the uncompressed size as a varint, then a list of sequences. Each sequence is a
+// token byte, holding the literal count in its high nibble and the match length - MinimumMatch in its
+// low nibble, with 15 meaning the rest of the length follows as a varint. Then the literals,
+// then the match offset as a varint. The last sequence is only literals.
+
+namespace
+{
+enum
+  {
+  HashBits = 16,
+  MinimumMatch = 4,
+  // skip ahead faster through data which doesn't match.
+  SkipTrigger = 6
+  };
+
+inline xuint32 read32(const uchar *p)
+  {
+  xuint32 v;
+  memcpy(&v, p, sizeof(xuint32));
+  return v;
+  }
+
+inline xuint32 hash(xuint32 v)
+  {
+  return (v * 2654435761U) >> (32 - HashBits);
+  }
+
+void writeVarint(QByteArray &out, xuint32 v)
+  {
+  while(v >= 0x80)
+    {
+    out.append((char)((v & 0x7F) | 0x80));
+    v >>= 7;
+    }
+  out.append((char)v);
+  }
+
+bool readVarint(const uchar *&p, const uchar *end, xuint32 &v)
+  {
+  v = 0;
+  for(int shift = 0; shift < 35; shift += 7)
+    {
+    if(p >= end)
+      {
+      return false;
+      }
+    uchar b = *p++;
+    v |= (xuint32)(b & 0x7F) << shift;
+    if(!(b & 0x80))
+      {
+      return true;
+      }
+    }
+  return false;
+  }
+
+// the dictionary followed by the data, addressed as one run of bytes.
+class Window
+  {
+public:
+  Window(const QByteArray &dictionary, const QByteArray &data)
+      : _dict((const uchar *)dictionary.constData()), _data((const uchar *)data.constData()),
+        _dictSize(dictionary.size()), _size(dictionary.size() + data.size())
+    {
+    }
+
+  int size() const { return _size; }
+  int dictionarySize() const { return _dictSize; }
+  const uchar *at(int i) const { return i < _dictSize ? _dict + i : _data + (i - _dictSize); }
+
+  // the length of the match between [from] and the data at [to], up to [limit] in the window.
+  int matchLength(int from, int to, int limit) const
+    {
+    int length = 0;
+    // compare within the dictionary, then carry on into the data.
+    while(from + length < _dictSize && to + length < limit && *at(from + length) == *at(to + length))
+      {
+      ++length;
+      }
+    if(from + length < _dictSize)
+      {
+      return length;
+      }
+
+    const uchar *a = at(from + length);
+    const uchar *b = at(to + length);
+    int remaining = limit - (to + length);
+    int extra = 0;
+    while(extra + (int)sizeof(xuint32) <= remaining && read32(a + extra) == read32(b + extra))
+      {
+      extra += sizeof(xuint32);
+      }
+    while(extra < remaining && a[extra] == b[extra])
+      {
+      ++extra;
+      }
+    return length + extra;
+    }
+
+  bool matches4(int from, int to) const
+    {
+    if(from + MinimumMatch <= _dictSize || from >= _dictSize)
+      {
+      return read32(at(from)) == read32(at(to));
+      }
+    return matchLength(from, to, to + MinimumMatch) == MinimumMatch;
+    }
+
+private:
+  const uchar *_dict;
+  const uchar *_data;
+  int _dictSize;
+  int _size;
+  };
+
+void writeSequence(QByteArray &out, const uchar *literals, xuint32 literalCount, xuint32 matchLength, xuint32 offset)
+  {
+  xuint32 matchCode = matchLength ? matchLength - MinimumMatch : 0;
+  uchar token = (uchar)((xMin(literalCount, 15U) << 4) | xMin(matchCode, 15U));
+  out.append((char)token);
+  if(literalCount >= 15)
+    {
+    writeVarint(out, literalCount - 15);
+    }
+  out.append((const char *)literals, literalCount);
+
+  if(matchLength)
+    {
+    if(matchCode >= 15)
+      {
+      writeVarint(out, matchCode - 15);
+      }
+    writeVarint(out, offset);
+    }
+  }
+}
+
+QByteArray XEnvironmentCodec::encode(const QByteArray &data, const QByteArray &base, Encoding *encoding)
+  {
+  xAssert(encoding);
+  if(!base.isEmpty() && base == data)
+    {
+    *encoding = Unchanged;
+    return QByteArray();
+    }
+
+  *encoding = Raw;
+  if(data.size() < MinimumCompressSize)
+    {
+    return data;
+    }
+
+  // a delta is never much bigger than plain compression, there is no need to try both.
+  QByteArray encoded = compress(data, base);
+  if(!base.isEmpty() && encoded.size() < data.size())
+    {
+    *encoding = Delta;
+    return encoded;
+    }
+
+  // only worth the decode if it saves an eighth.
+  if(base.isEmpty() && encoded.size() < data.size() - (data.size() >> 3))
+    {
+    *encoding = Compressed;
+    return encoded;
+    }
+
+  return data;
+  }
+
+bool XEnvironmentCodec::decode(const QByteArray &encoded, Encoding encoding, const QByteArray &base, QByteArray &data)
+  {
+  if(encoding == Raw)
+    {
+    data = encoded;
+    return true;
+    }
+  else if(encoding == Compressed)
+    {
+    return decompress(encoded, QByteArray(), data);
+    }
+  else if(encoding == Delta)
+    {
+    return decompress(encoded, base, data);
+    }
+  else if(encoding == Unchanged)
+    {
+    data = base;
+    return true;
+    }
+  return false;
+  }
+
+QByteArray XEnvironmentCodec::compress(const QByteArray &data, const QByteArray &dictionary)
+  {
+  QByteArray out;
+  out.reserve(data.size() / 2 + 16);
+  writeVarint(out, data.size());
+
+  Window window(dictionary, data);
+  const int start = window.dictionarySize();
+  const int end = window.size();
+  // matches can't start in the last few bytes.
+  const int matchLimit = end - MinimumMatch;
+
+  QVector<int> table(1 << HashBits, -1);
+  int *hashTable = table.data();
+  for(int i = 0; i + MinimumMatch <= start; ++i)
+    {
+    hashTable[hash(read32(window.at(i)))] = i;
+    }
+
+  int anchor = start;
+  int position = start;
+  // the offset of the last match, data edited in place carries on matching the dictionary at the same offset.
+  int repeatOffset = start;
+
+  while(position <= matchLimit)
+    {
+    int bestLength = 0;
+    int bestFrom = 0;
+
+    int repeatFrom = position - repeatOffset;
+    if(repeatOffset > 0 && repeatFrom >= 0 && window.matches4(repeatFrom, position))
+      {
+      bestLength = window.matchLength(repeatFrom, position, end);
+      bestFrom = repeatFrom;
+      }
+
+    xuint32 h = hash(read32(window.at(position)));
+    int candidate = hashTable[h];
+    hashTable[h] = position;
+    if(candidate >= 0 && (!bestLength || candidate != bestFrom) && window.matches4(candidate, position))
+      {
+      int length = window.matchLength(candidate, position, end);
+      if(length > bestLength)
+        {
+        bestLength = length;
+        bestFrom = candidate;
+        }
+      }
+
+    if(bestLength < MinimumMatch)
+      {
+      position += 1 + ((position - anchor) >> SkipTrigger);
+      continue;
+      }
+
+    // pull the match back over any literals that also match.
+    while(position > anchor && bestFrom > 0 && *window.at(bestFrom - 1) == *window.at(position - 1))
+      {
+      --position;
+      --bestFrom;
+      ++bestLength;
+      }
+
+    writeSequence(out, window.at(anchor), position - anchor, bestLength, position - bestFrom);
+    repeatOffset = position - bestFrom;
+
+    int matchEnd = position + bestLength;
+    for(int i = position + 1; i < matchEnd && i <= matchLimit; i += 2)
+      {
+      hashTable[hash(read32(window.at(i)))] = i;
+      }
+    position = matchEnd;
+    anchor = position;
+    }
+
+  writeSequence(out, window.at(anchor), end - anchor, 0, 0);
+  return out;
+  }
+
+bool XEnvironmentCodec::decompress(const QByteArray &compressed, const QByteArray &dictionary, QByteArray &data)
+  {
+  const uchar *p = (const uchar *)compressed.constData();
+  const uchar *end = p + compressed.size();
+
+  xuint32 size = 0;
+  if(!readVarint(p, end, size))
+    {
+    return false;
+    }
+
+  data.resize(size);
+  uchar *out = (uchar *)data.data();
+  xuint32 written = 0;
+
+  const uchar *dict = (const uchar *)dictionary.constData();
+  const xuint32 dictSize = dictionary.size();
+
+  for(;;)
+    {
+    if(p >= end)
+      {
+      return false;
+      }
+    uchar token = *p++;
+
+    xuint32 literals = token >> 4;
+    xuint32 extra = 0;
+    if(literals == 15)
+      {
+      if(!readVarint(p, end, extra))
+        {
+        return false;
+        }
+      literals += extra;
+      }
+    if(literals > (xuint32)(end - p) || literals > size - written)
+      {
+      return false;
+      }
+    memcpy(out + written, p, literals);
+    p += literals;
+    written += literals;
+
+    // the last sequence is only literals.
+    if(p == end)
+      {
+      break;
+      }
+
+    xuint32 length = token & 0xF;
+    if(length == 15)
+      {
+      if(!readVarint(p, end, extra))
+        {
+        return false;
+        }
+      length += extra;
+      }
+    length += MinimumMatch;
+
+    xuint32 offset = 0;
+    if(!readVarint(p, end, offset) || offset == 0 || offset > written + dictSize || length > size - written)
+      {
+      return false;
+      }
+
+    if(offset <= written)
+      {
+      const uchar *from = out + written - offset;
+      if(offset >= length)
+        {
+        memcpy(out + written, from, length);
+        }
+      else
+        {
+        // overlapping, the match repeats bytes it is writing.
+        for(xuint32 i = 0; i < length; ++i)
+          {
+          out[written + i] = from[i];
+          }
+        }
+      }
+    else
+      {
+      // starts in the dictionary, and may run on into the data.
+      xuint32 from = dictSize - (offset - written);
+      xuint32 fromDictionary = xMin(length, dictSize - from);
+      memcpy(out + written, dict + from, fromDictionary);
+      for(xuint32 i = fromDictionary; i < length; ++i)
+        {
+        out[written + i] = out[i - fromDictionary];
+        }
+      }
+    written += length;
+    }
+
+  return written == size;
+  }
@@ -0,0 +1,210 @@
+#include "XEnvironmentDiskCache.h"
+#include "QFile"
+#include "QDir"
+#include "QStringList"
+#include "QDebug"
+
+XEnvironmentDiskCache::XEnvironmentDiskCache(const QString &directory) : _directory(directory)
+  {
+  }
+
+XEnvironmentDiskCache::~XEnvironmentDiskCache()
+  {
+  for(XHash<Key, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+    {
+    delete it->file;
+    }
+
+  foreach(QFile *file, _retired)
+    {
+    QString name = file->fileName();
+    delete file;
+    QFile::remove(name);
+    }
+  }
+
+QString XEnvironmentDiskCache::path(const Key &key, xuint32 version) const
+  {
+  return _directory + QDir::separator() +
+      QString("%1-%2-%3-%4.item").arg(key.type).arg(key.ID).arg(key.subType).arg(version);
+  }
+
+bool XEnvironmentDiskCache::open()
+  {
+  QMutexLocker l(&_lock);
+  QDir dir(_directory);
+  if(!dir.exists() && !QDir::root().mkpath(_directory))
+    {
+    return false;
+    }
+
+  // writes which didn't finish.
+  foreach(const QString &name, dir.entryList(QStringList() << "*.tmp", QDir::Files))
+    {
+    dir.remove(name);
+    }
+
+  foreach(const QString &name, dir.entryList(QStringList() << "*.item", QDir::Files))
+    {
+    QStringList parts = name.left(name.length() - 5).split('-');
+    bool ok[4] = { false, false, false, false };
+    if(parts.size() != 4)
+      {
+      continue;
+      }
+
+    Key key(parts[0].toUShort(&ok[0]), parts[1].toULongLong(&ok[1]), parts[2].toUShort(&ok[2]));
+    xuint32 version = parts[3].toUInt(&ok[3]);
+    if(!ok[0] || !ok[1] || !ok[2] || !ok[3] || !version)
+      {
+      continue;
+      }
+
+    XHash<Key, Entry>::iterator it = _entries.find(key);
+    if(it != _entries.end())
+      {
+      // keep the newest version only.
+      if(it->version > version)
+        {
+        dir.remove(name);
+        continue;
+        }
+      QFile::remove(path(key, it->version));
+      }
+
+    Entry entry = { version, false, 0, 0, 0 };
+    _entries.insert(key, entry);
+    }
+
+  return true;
+  }
+
+xuint32 XEnvironmentDiskCache::version(const Request &req) const
+  {
+  QMutexLocker l(&_lock);
+  XHash<Key, Entry>::const_iterator it = _entries.find(Key(req));
+  return it != _entries.end() ? it->version : 0;
+  }
+
+bool XEnvironmentDiskCache::isValidated(const Request &req) const
+  {
+  QMutexLocker l(&_lock);
+  XHash<Key, Entry>::const_iterator it = _entries.find(Key(req));
+  return it != _entries.end() && it->validated;
+  }
+
+bool XEnvironmentDiskCache::find(const Request &req, xuint32 version, QByteArray &data) const
+  {
+  QMutexLocker l(&_lock);
+  Key key(req);
+  XHash<Key, Entry>::iterator it = _entries.find(key);
+  if(it == _entries.end() || it->version != version)
+    {
+    return false;
+    }
+
+  Entry &entry = it.value();
+  if(!entry.file)
+    {
+    entry.file = new QFile(path(key, version));
+    if(!entry.file->open(QIODevice::ReadOnly))
+      {
+      delete entry.file;
+      entry.file = 0;
+      return false;
+      }
+
+    entry.size = entry.file->size();
+    entry.map = entry.size ? entry.file->map(0, entry.size) : 0;
+    if(entry.size && !entry.map)
+      {
+      delete entry.file;
+      entry.file = 0;
+      return false;
+      }
+    }
+
+  // refers to the mapping rather than copying it.
+  data = QByteArray::fromRawData((const char *)entry.map, entry.size);
+  return true;
+  }
+
+void XEnvironmentDiskCache::store(const Request &req)
+  {
+  Key key(req);
+  xuint32 version = req.version();
+  if(!version)
+    {
+    return;
+    }
+
+    {
+    QMutexLocker l(&_lock);
+    XHash<Key, Entry>::iterator it = _entries.find(key);
+    if(it != _entries.end() && it->version >= version)
+      {
+      it->validated = it->validated || it->version == version;
+      return;
+      }
+    }
+
+  // written beside the final name, so a crash never leaves a partial item.
+  QString finalPath = path(key, version);
+  QString tempPath = finalPath + ".tmp";
+    {
+    QFile file(tempPath);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(req.extraData()) != req.extraData().size())
+      {
+      qWarning() << "Failed to cache item" << req.type() << req.ID() << req.subType();
+      file.close();
+      QFile::remove(tempPath);
+      return;
+      }
+    }
+  QFile::remove(finalPath);
+  QFile::rename(tempPath, finalPath);
+
+  QMutexLocker l(&_lock);
+  XHash<Key, Entry>::iterator it = _entries.find(key);
+  if(it != _entries.end())
+    {
+    if(it->version >= version)
+      {
+      // another thread stored a newer version while we wrote.
+      QFile::remove(finalPath);
+      return;
+      }
+    retire(key, it.value());
+    }
+
+  Entry entry = { version, true, 0, 0, 0 };
+  _entries.insert(key, entry);
+  }
+
+void XEnvironmentDiskCache::retire(const Key &key, Entry &entry)
+  {
+  if(entry.file)
+    {
+    // mapped, so something may still be using it. It goes when the cache does.
+    _retired << entry.file;
+    entry.file = 0;
+    entry.map = 0;
+    }
+  else
+    {
+    QFile::remove(path(key, entry.version));
+    }
+  }
+
+XList<XEnvironmentDiskCache::Request> XEnvironmentDiskCache::entries() const
+  {
+  QMutexLocker l(&_lock);
+  XList<Request> requests;
+  for(XHash<Key, Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it)
+    {
+    Request request(it.key().type, it.key().ID, it.key().subType);
+    request.setVersion(it->version);
+    requests << request;
+    }
+  return requests;
+  }
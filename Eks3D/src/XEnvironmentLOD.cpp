@@ -0,0 +1,235 @@
+#include "XEnvironmentLOD.h"
+#include "XEnvironment.h"
+#include "QtAlgorithms"
+#include "float.h"
+
+XEnvironmentLOD::XEnvironmentLOD() : XInitProperty(maximumScreenError, 1.0f), XInitProperty(transitionTime, 0.25f)
+  {
+  }
+
+xuint32 XEnvironmentLOD::addNode(xuint32 parent, ItemID mesh, const XCuboid &bounds, xReal error)
+  {
+  xuint32 index = _nodes.size();
+
+  Node node;
+  node.mesh = mesh;
+  node.bounds = bounds;
+  node.error = error;
+  node.parent = parent;
+  node.resident = false;
+  node.selected = false;
+  node.fade = 0.0f;
+  _nodes << node;
+
+  if(parent == InvalidNode)
+    {
+    _roots << index;
+    }
+  else
+    {
+    _nodes[parent].children << index;
+    }
+
+  _meshNodes.insert(mesh, index);
+  return index;
+  }
+
+xuint32 XEnvironmentLOD::addChain(xuint32 parent, const XVector<XMeshOptimiser::LOD> &lods, const XVector<ItemID> &meshes, const XCuboid &bounds)
+  {
+  xAssert(lods.size() == meshes.size());
+
+  xuint32 coarsest = InvalidNode;
+  for(int i=lods.size()-1; i>=0; --i)
+    {
+    parent = addNode(parent, meshes[i], bounds, lods[i].error);
+    if(coarsest == InvalidNode)
+      {
+      coarsest = parent;
+      }
+    }
+  return coarsest;
+  }
+
+void XEnvironmentLOD::clear()
+  {
+  _nodes.clear();
+  _roots.clear();
+  _meshNodes.clear();
+  _refinements.clear();
+  }
+
+void XEnvironmentLOD::setResident(xuint32 node, bool resident)
+  {
+  Node &n = _nodes[node];
+  n.resident = resident;
+  if(!resident)
+    {
+    // nothing left to fade out with.
+    n.fade = 0.0f;
+    }
+  }
+
+xReal XEnvironmentLOD::screenError(xuint32 index, const XVector3D &position, xReal projectionScale) const
+  {
+  const Node &node = _nodes[index];
+
+  // distance to the nearest point of the bounds, the nearest geometry can be no closer.
+  XVector3D nearest = position.cwiseMax(node.bounds.minimum()).cwiseMin(node.bounds.maximum());
+  xReal distance = (nearest - position).norm();
+  if(distance <= 0.0f)
+    {
+    return node.error > 0.0f ? FLT_MAX : 0.0f;
+    }
+
+  return node.error * projectionScale / distance;
+  }
+
+void XEnvironmentLOD::request(xuint32 index, xReal importance, XVector<Refinement> &refinements) const
+  {
+  Refinement r;
+  r.node = index;
+  r.mesh = _nodes[index].mesh;
+  r.importance = importance;
+  refinements << r;
+  }
+
+void XEnvironmentLOD::select(xuint32 index, const XVector3D &position, xReal projectionScale, XVector<Refinement> &refinements)
+  {
+  Node &node = _nodes[index];
+  xAssert(node.resident);
+
+  xReal error = screenError(index, position, projectionScale);
+  if(error <= maximumScreenError() || node.children.isEmpty())
+    {
+    node.selected = true;
+    return;
+    }
+
+  // refine only once every child can be drawn, a partly refined level would leave holes.
+  bool childrenResident = true;
+  foreach(xuint32 child, node.children)
+    {
+    if(!_nodes[child].resident)
+      {
+      childrenResident = false;
+      request(child, error, refinements);
+      }
+    }
+
+  if(!childrenResident)
+    {
+    node.selected = true;
+    return;
+    }
+
+  foreach(xuint32 child, node.children)
+    {
+    select(child, position, projectionScale, refinements);
+    }
+  }
+
+xReal XEnvironmentLOD::fadeBelow(xuint32 index) const
+  {
+  xReal fade = 0.0f;
+  foreach(xuint32 child, _nodes[index].children)
+    {
+    fade = xMax(fade, xMax(_nodes[child].fade, fadeBelow(child)));
+    }
+  return fade;
+  }
+
+void XEnvironmentLOD::update(const XVector3D &position, xReal projectionScale, xReal elapsed, XVector<Draw> &draws, XVector<Refinement> &refinements)
+  {
+  draws.clear();
+  refinements.clear();
+
+  for(int i=0; i<_nodes.size(); ++i)
+    {
+    _nodes[i].selected = false;
+    }
+
+  foreach(xuint32 root, _roots)
+    {
+    if(_nodes[root].resident)
+      {
+      select(root, position, projectionScale, refinements);
+      }
+    else
+      {
+      // nothing is drawn, so the error is the whole object.
+      request(root, XEnvironment::importance(_nodes[root].bounds, position, projectionScale, true) + maximumScreenError(), refinements);
+      }
+    }
+
+  qSort(refinements.begin(), refinements.end());
+
+  // levels going out fade first, so those replacing them know how much is still covered.
+  xReal step = transitionTime() > 0.0f ? elapsed / transitionTime() : 1.0f;
+  for(int i=0; i<_nodes.size(); ++i)
+    {
+    Node &node = _nodes[i];
+    if(node.resident && !node.selected)
+      {
+      node.fade = xMax(node.fade - step, 0.0f);
+      }
+    }
+
+  for(int i=0; i<_nodes.size(); ++i)
+    {
+    Node &node = _nodes[i];
+    if(!node.resident)
+      {
+      continue;
+      }
+
+    if(node.selected)
+      {
+      if(node.fade > 0.0f)
+        {
+        node.fade = xMin(node.fade + step, 1.0f);
+        }
+      else
+        {
+        // start where the levels it replaces leave off, so between them they always cover the object.
+        // A level with nothing to replace, ie. the first level of an object, appears at once.
+        xReal replaced = fadeBelow(i);
+        for(xuint32 p=node.parent; p != InvalidNode; p=_nodes[p].parent)
+          {
+          replaced = xMax(replaced, _nodes[p].fade);
+          }
+        node.fade = 1.0f - replaced;
+        }
+      }
+
+    if(node.fade > 0.0f)
+      {
+      Draw draw;
+      draw.node = i;
+      draw.mesh = node.mesh;
+      draw.fade = node.fade;
+      draw.invertDither = !node.selected;
+      draws << draw;
+      }
+    }
+  }
+
+void XEnvironmentLOD::update(XEnvironment *env, const XVector3D &position, xReal projectionScale, xReal elapsed, XVector<Draw> &draws)
+  {
+  for(int i=0; i<_nodes.size(); ++i)
+    {
+    bool resident = env->mesh(_nodes[i].mesh) != 0;
+    if(resident != _nodes[i].resident)
+      {
+      setResident(i, resident);
+      }
+    }
+
+  update(position, projectionScale, elapsed, draws, _refinements);
+
+  // the environment queue keeps the highest importance given to a pending request.
+  foreach(const Refinement &r, _refinements)
+    {
+    XEnvironment::Request req(XEnvironment::MeshType, r.mesh);
+    env->requestItem(req, false, r.importance);
+    }
+  }
@@ -1,10 +1,11 @@
 #include "XEnvironmentRequest.h"
 
-XEnvironmentRequest::XEnvironmentRequest() : _type(0), _ID(-1), _subType(0), _requestID(0)
+XEnvironmentRequest::XEnvironmentRequest() : _type(0), _ID(-1), _subType(0), _requestID(0), _version(0), _baseVersion(0), _encoding(0)
   {
   }
 
-XEnvironmentRequest::XEnvironmentRequest(xuint16 type, ItemID id, xuint16 subType, xuint32 rID) : _type(type), _ID(id), _subType(subType), _requestID(rID)
+XEnvironmentRequest::XEnvironmentRequest(xuint16 type, ItemID id, xuint16 subType, xuint32 rID) : _type(type), _ID(id), _subType(subType), _requestID(rID),
+    _version(0), _baseVersion(0), _encoding(0)
   {
   }
 
@@ -20,10 +21,12 @@ void XEnvironmentRequest::setExtraData(const QByteArray &in)
 
 QDataStream &operator<<(QDataStream &stream, const XEnvironmentRequest &itemRequest)
   {
-  return stream << itemRequest._type << itemRequest._ID << itemRequest._subType << itemRequest._requestID << itemRequest._extraData;
+  return stream << itemRequest._type << itemRequest._ID << itemRequest._subType << itemRequest._requestID
+                << itemRequest._version << itemRequest._baseVersion << itemRequest._encoding << itemRequest._extraData;
   }
 
 QDataStream &operator>>(QDataStream &stream, XEnvironmentRequest &itemRequest)
   {
-  return stream >> itemRequest._type >> itemRequest._ID >> itemRequest._subType >> itemRequest._requestID >> itemRequest._extraData;
+  return stream >> itemRequest._type >> itemRequest._ID >> itemRequest._subType >> itemRequest._requestID
+                >> itemRequest._version >> itemRequest._baseVersion >> itemRequest._encoding >> itemRequest._extraData;
   }
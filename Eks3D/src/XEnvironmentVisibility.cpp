@@ -0,0 +1,557 @@
+#include "XEnvironmentVisibility.h"
+#include "QDataStream"
+#include "QThreadPool"
+#include "QRunnable"
+#include "QHash"
+#include "QtAlgorithms"
+#include "float.h"
+#include "math.h"
+#include <algorithm>
+
+namespace
+{
+bool overlaps(const XVector3D &minimum, const XVector3D &maximum, const XCuboid &cub)
+  {
+  return cub.minimum().x() <= maximum.x() && cub.maximum().x() >= minimum.x() &&
+         cub.minimum().y() <= maximum.y() && cub.maximum().y() >= minimum.y() &&
+         cub.minimum().z() <= maximum.z() && cub.maximum().z() >= minimum.z();
+  }
+
+bool contains(const XVector3D &minimum, const XVector3D &maximum, const XVector3D &pt)
+  {
+  return pt.x() >= minimum.x() && pt.x() <= maximum.x() &&
+         pt.y() >= minimum.y() && pt.y() <= maximum.y() &&
+         pt.z() >= minimum.z() && pt.z() <= maximum.z();
+  }
+
+// slab test of the ray against a box, [entry] and [leave] are the distances along the ray where it enters and leaves.
+bool intersect(const XVector3D &minimum, const XVector3D &maximum, const XVector3D &position, const XVector3D &inverseDirection, xReal &entry, xReal &leave)
+  {
+  entry = -FLT_MAX;
+  leave = FLT_MAX;
+  for(int i=0; i<3; ++i)
+    {
+    xReal a = (minimum(i) - position(i)) * inverseDirection(i);
+    xReal b = (maximum(i) - position(i)) * inverseDirection(i);
+    entry = xMax(entry, xMin(a, b));
+    leave = xMin(leave, xMax(a, b));
+    }
+  return entry <= leave && leave >= 0.0f;
+  }
+
+// xorshift, so sampling is repeatable and each thread has its own state.
+class Random
+  {
+public:
+  Random(xuint32 seed) : _state(seed ? seed : 0x9E3779B9) { }
+
+  xuint32 next()
+    {
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    return _state;
+    }
+
+  // [0, 1)
+  xReal unit()
+    {
+    return (next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+  xuint32 _state;
+  };
+
+void sortUnique(XVector<xuint32> &list)
+  {
+  qSort(list.begin(), list.end());
+  list.erase(std::unique(list.begin(), list.end()), list.end());
+  }
+}
+
+class XEnvironmentVisibility::SampleJob : public QRunnable
+  {
+public:
+  SampleJob(const XEnvironmentVisibility *vis, const IndexList &leaves, XVector<IndexList> &results,
+            xuint32 begin, xuint32 end, xuint32 samples, xuint32 rays, xuint32 seed)
+      : _vis(vis), _leaves(leaves), _results(results), _begin(begin), _end(end),
+        _samples(samples), _rays(rays), _seed(seed)
+    {
+    }
+
+  void run()
+    {
+    for(xuint32 i=_begin; i<_end; ++i)
+      {
+      _vis->sampleLeaf(_leaves[i], _samples, _rays, _seed, _results[i]);
+      }
+    }
+
+private:
+  const XEnvironmentVisibility *_vis;
+  const IndexList &_leaves;
+  XVector<IndexList> &_results;
+  xuint32 _begin;
+  xuint32 _end;
+  xuint32 _samples;
+  xuint32 _rays;
+  xuint32 _seed;
+  };
+
+XEnvironmentVisibility::Item::Item(ItemID id, const XCuboid &bounds, bool occluder)
+    : XInitProperty(ID, id), XInitProperty(bounds, bounds), XInitProperty(occluder, occluder)
+  {
+  }
+
+XEnvironmentVisibility::XEnvironmentVisibility()
+  {
+  }
+
+void XEnvironmentVisibility::clear()
+  {
+  _bounds = XCuboid();
+  _items.clear();
+  _nodes.clear();
+  _nodeItems.clear();
+  _visibleSets.clear();
+  _allItems.clear();
+  }
+
+void XEnvironmentVisibility::build(const XCuboid &bounds, const ItemList &items, xuint32 maxItemsPerCell, xuint32 maxDepth)
+  {
+  clear();
+  _bounds = bounds;
+  _items = items;
+
+  IndexList placed;
+  _allItems.reserve(items.size());
+  for(xuint32 i=0; i<(xuint32)items.size(); ++i)
+    {
+    _allItems << i;
+    if(items[i].bounds().isValid() && overlaps(bounds.minimum(), bounds.maximum(), items[i].bounds()))
+      {
+      placed << i;
+      }
+    }
+
+  // the root is a cube around the bounds so cells stay cubic, a flat area would otherwise be split
+  // into thin slices, all holding the same items.
+  XVector3D size = bounds.maximum() - bounds.minimum();
+  XVector3D halfCube = XVector3D::Constant(xMax(size.x(), xMax(size.y(), size.z())) * 0.5f);
+  Node root;
+  root.minimum = bounds.centre() - halfCube;
+  root.maximum = bounds.centre() + halfCube;
+  root.firstChild = InvalidIndex;
+  _nodes << root;
+
+  split(0, placed, 0, xMax(maxItemsPerCell, (xuint32)1), maxDepth);
+
+  // until the sets are computed, everything is visible from everywhere.
+  _visibleSets << _allItems;
+  }
+
+void XEnvironmentVisibility::split(xuint32 node, const IndexList &items, xuint32 depth, xuint32 maxItemsPerCell, xuint32 maxDepth)
+  {
+  const XVector3D minimum = _nodes[node].minimum;
+  const XVector3D maximum = _nodes[node].maximum;
+  const XVector3D centre = (minimum + maximum) * 0.5f;
+
+  IndexList childItems[8];
+  XVector3D childMin[8];
+  XVector3D childMax[8];
+  bool separates = false;
+  if(xuint32(items.size()) > maxItemsPerCell && depth < maxDepth)
+    {
+    for(xuint32 c=0; c<8; ++c)
+      {
+      for(int i=0; i<3; ++i)
+        {
+        bool upper = (c & (1<<i)) != 0;
+        childMin[c](i) = upper ? centre(i) : minimum(i);
+        childMax[c](i) = upper ? maximum(i) : centre(i);
+        }
+
+      foreach(xuint32 item, items)
+        {
+        if(overlaps(childMin[c], childMax[c], _items[item].bounds()))
+          {
+          childItems[c] << item;
+          }
+        }
+
+      separates |= childItems[c].size() < items.size();
+      }
+    }
+
+  // a leaf if it is small enough, or if every item straddles the split and splitting would only copy them.
+  if(!separates)
+    {
+    Node &leaf = _nodes[node];
+    leaf.firstItem = _nodeItems.size();
+    leaf.itemCount = items.size();
+    leaf.visibleSet = 0;
+    _nodeItems << items;
+    return;
+    }
+
+  xuint32 first = _nodes.size();
+  _nodes[node].firstChild = first;
+  _nodes[node].firstItem = 0;
+  _nodes[node].itemCount = 0;
+  _nodes[node].visibleSet = InvalidIndex;
+  for(xuint32 c=0; c<8; ++c)
+    {
+    Node child;
+    child.minimum = childMin[c];
+    child.maximum = childMax[c];
+    child.firstChild = InvalidIndex;
+    _nodes << child;
+    }
+
+  for(xuint32 c=0; c<8; ++c)
+    {
+    split(first + c, childItems[c], depth + 1, maxItemsPerCell, maxDepth);
+    }
+  }
+
+void XEnvironmentVisibility::computeVisibility(xuint32 samplesPerCell, xuint32 raysPerSample, xuint32 seed, int maxThreads)
+  {
+  IndexList leaves;
+  for(xuint32 i=0; i<(xuint32)_nodes.size(); ++i)
+    {
+    if(_nodes[i].isLeaf())
+      {
+      leaves << i;
+      }
+    }
+
+  XVector<IndexList> results(leaves.size());
+  if(maxThreads == 1 || leaves.size() == 1)
+    {
+    SampleJob job(this, leaves, results, 0, leaves.size(), samplesPerCell, raysPerSample, seed);
+    job.run();
+    }
+  else
+    {
+    QThreadPool pool;
+    if(maxThreads > 0)
+      {
+      pool.setMaxThreadCount(maxThreads);
+      }
+
+    // a few jobs per thread, as leaves near dense geometry cost more than empty ones.
+    xuint32 jobs = xMax(1, pool.maxThreadCount()) * 4;
+    xuint32 perJob = xMax((xuint32)1, (xuint32)(leaves.size() + jobs - 1) / jobs);
+    for(xuint32 begin=0; begin<(xuint32)leaves.size(); begin+=perJob)
+      {
+      xuint32 end = xMin(begin + perJob, (xuint32)leaves.size());
+      pool.start(new SampleJob(this, leaves, results, begin, end, samplesPerCell, raysPerSample, seed));
+      }
+    pool.waitForDone();
+    }
+
+  // leaves which see the same items share a set.
+  _visibleSets.clear();
+  QHash<QByteArray, xuint32> sets;
+  for(xuint32 i=0; i<(xuint32)leaves.size(); ++i)
+    {
+    const IndexList &visible = results[i];
+    QByteArray key((const char *)visible.constData(), visible.size() * sizeof(xuint32));
+
+    xuint32 set = sets.value(key, InvalidIndex);
+    if(set == InvalidIndex)
+      {
+      set = _visibleSets.size();
+      _visibleSets << visible;
+      sets.insert(key, set);
+      }
+    _nodes[leaves[i]].visibleSet = set;
+    }
+  }
+
+void XEnvironmentVisibility::sampleLeaf(xuint32 leaf, xuint32 samples, xuint32 rays, xuint32 seed, IndexList &visible) const
+  {
+  const Node &node = _nodes[leaf];
+  for(xuint32 i=0; i<node.itemCount; ++i)
+    {
+    visible << _nodeItems[node.firstItem + i];
+    }
+
+  Random random(seed ^ ((leaf + 1) * 0x9E3779B9));
+  const XVector3D size = node.maximum - node.minimum;
+  XVector<Hit> passed;
+  for(xuint32 s=0; s<samples; ++s)
+    {
+    XVector3D position(node.minimum.x() + random.unit() * size.x(),
+                       node.minimum.y() + random.unit() * size.y(),
+                       node.minimum.z() + random.unit() * size.z());
+
+    for(xuint32 r=0; r<rays; ++r)
+      {
+      // uniform over the sphere
+      xReal z = 1.0f - 2.0f * random.unit();
+      xReal phi = 2.0f * (xReal)M_PI * random.unit();
+      xReal radius = sqrtf(xMax(0.0f, 1.0f - z * z));
+      XVector3D direction(radius * cosf(phi), radius * sinf(phi), z);
+
+      XVector3D inverseDirection(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+      xReal best = FLT_MAX;
+      xuint32 hit = InvalidIndex;
+      passed.clear();
+      raycast(0, position, inverseDirection, best, hit, &passed);
+
+      if(hit != InvalidIndex)
+        {
+        visible << hit;
+        }
+
+      foreach(const Hit &p, passed)
+        {
+        if(p.distance < best)
+          {
+          visible << p.index;
+          }
+        }
+      }
+    }
+
+  sortUnique(visible);
+  }
+
+xuint32 XEnvironmentVisibility::findLeaf(const XVector3D &point) const
+  {
+  if(_nodes.isEmpty() || !contains(_nodes[0].minimum, _nodes[0].maximum, point))
+    {
+    return InvalidIndex;
+    }
+
+  xuint32 index = 0;
+  while(!_nodes[index].isLeaf())
+    {
+    const Node &node = _nodes[index];
+    XVector3D centre = (node.minimum + node.maximum) * 0.5f;
+    index = node.firstChild +
+        (point.x() >= centre.x() ? 1 : 0) +
+        (point.y() >= centre.y() ? 2 : 0) +
+        (point.z() >= centre.z() ? 4 : 0);
+    }
+  return index;
+  }
+
+const XEnvironmentVisibility::IndexList &XEnvironmentVisibility::visibleFrom(const XVector3D &point) const
+  {
+  xuint32 leaf = findLeaf(point);
+  if(leaf == InvalidIndex)
+    {
+    return _allItems;
+    }
+  return _visibleSets[_nodes[leaf].visibleSet];
+  }
+
+void XEnvironmentVisibility::itemsIn(const XCuboid &cuboid, IndexList &out) const
+  {
+  out.clear();
+  if(_nodes.isEmpty())
+    {
+    return;
+    }
+
+  IndexList stack;
+  stack << 0;
+  while(!stack.isEmpty())
+    {
+    const Node &node = _nodes[stack.last()];
+    stack.pop_back();
+
+    if(!overlaps(node.minimum, node.maximum, cuboid))
+      {
+      continue;
+      }
+
+    if(!node.isLeaf())
+      {
+      for(xuint32 c=0; c<8; ++c)
+        {
+        stack << node.firstChild + c;
+        }
+      continue;
+      }
+
+    for(xuint32 i=0; i<node.itemCount; ++i)
+      {
+      xuint32 item = _nodeItems[node.firstItem + i];
+      const XCuboid &bounds = _items[item].bounds();
+      if(overlaps(bounds.minimum(), bounds.maximum(), cuboid))
+        {
+        out << item;
+        }
+      }
+    }
+
+  sortUnique(out);
+  }
+
+xuint32 XEnvironmentVisibility::raycast(const XVector3D &position, const XVector3D &direction, xReal *distance) const
+  {
+  xuint32 hit = InvalidIndex;
+  xReal best = FLT_MAX;
+  if(!_nodes.isEmpty())
+    {
+    XVector3D inverseDirection(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+    raycast(0, position, inverseDirection, best, hit, 0);
+    }
+
+  if(distance)
+    {
+    *distance = best;
+    }
+  return hit;
+  }
+
+void XEnvironmentVisibility::raycast(xuint32 index, const XVector3D &position, const XVector3D &inverseDirection,
+                                     xReal &best, xuint32 &hit, XVector<Hit> *passed) const
+  {
+  const Node &node = _nodes[index];
+  if(node.isLeaf())
+    {
+    for(xuint32 i=0; i<node.itemCount; ++i)
+      {
+      xuint32 item = _nodeItems[node.firstItem + i];
+      const Item &it = _items[item];
+
+      xReal entry, leave;
+      if(!intersect(it.bounds().minimum(), it.bounds().maximum(), position, inverseDirection, entry, leave) || entry > best)
+        {
+        continue;
+        }
+
+      if(!it.occluder())
+        {
+        if(passed)
+          {
+          Hit p = { item, xMax(entry, 0.0f) };
+          *passed << p;
+          }
+        }
+      // an occluder around the ray's start doesn't hide anything from it.
+      else if(entry > 0.0f)
+        {
+        best = entry;
+        hit = item;
+        }
+      }
+    return;
+    }
+
+  // visit the children nearest first, so further ones are culled by the closest hit.
+  xuint32 order[8];
+  xReal distances[8];
+  xuint32 count = 0;
+  for(xuint32 c=0; c<8; ++c)
+    {
+    const Node &child = _nodes[node.firstChild + c];
+    xReal entry, leave;
+    if(!intersect(child.minimum, child.maximum, position, inverseDirection, entry, leave) || entry > best)
+      {
+      continue;
+      }
+
+    xuint32 i = count++;
+    for(; i>0 && distances[i-1] > entry; --i)
+      {
+      order[i] = order[i-1];
+      distances[i] = distances[i-1];
+      }
+    order[i] = node.firstChild + c;
+    distances[i] = entry;
+    }
+
+  for(xuint32 i=0; i<count; ++i)
+    {
+    if(distances[i] <= best)
+      {
+      raycast(order[i], position, inverseDirection, best, hit, passed);
+      }
+    }
+  }
+
+xsize XEnvironmentVisibility::leafCount() const
+  {
+  xsize count = 0;
+  foreach(const Node &node, _nodes)
+    {
+    count += node.isLeaf() ? 1 : 0;
+    }
+  return count;
+  }
+
+xsize XEnvironmentVisibility::memoryUsage() const
+  {
+  xsize size = _nodes.size() * sizeof(Node) + _nodeItems.size() * sizeof(xuint32) + _items.size() * sizeof(Item);
+  foreach(const IndexList &set, _visibleSets)
+    {
+    size += set.size() * sizeof(xuint32);
+    }
+  return size;
+  }
+
+QDataStream &operator<<(QDataStream &stream, const XEnvironmentVisibility::Item &item)
+  {
+  return stream << item._ID << item._bounds << item._occluder;
+  }
+
+QDataStream &operator>>(QDataStream &stream, XEnvironmentVisibility::Item &item)
+  {
+  return stream >> item._ID >> item._bounds >> item._occluder;
+  }
+
+QDataStream &operator<<(QDataStream &stream, const XEnvironmentVisibility &vis)
+  {
+  stream << (xuint32)XEnvironmentVisibility::Version << vis._bounds << vis._items;
+
+  stream << (xuint32)vis._nodes.size();
+  foreach(const XEnvironmentVisibility::Node &node, vis._nodes)
+    {
+    stream << node.minimum << node.maximum << node.firstChild << node.firstItem << node.itemCount << node.visibleSet;
+    }
+
+  return stream << vis._nodeItems << vis._visibleSets;
+  }
+
+QDataStream &operator>>(QDataStream &stream, XEnvironmentVisibility &vis)
+  {
+  vis.clear();
+
+  xuint32 version = 0;
+  stream >> version;
+  if(version != XEnvironmentVisibility::Version)
+    {
+    return stream;
+    }
+
+  stream >> vis._bounds >> vis._items;
+
+  xuint32 nodes = 0;
+  stream >> nodes;
+  vis._nodes.resize(nodes);
+  for(xuint32 i=0; i<nodes; ++i)
+    {
+    XEnvironmentVisibility::Node &node = vis._nodes[i];
+    stream >> node.minimum >> node.maximum >> node.firstChild >> node.firstItem >> node.itemCount >> node.visibleSet;
+    }
+
+  stream >> vis._nodeItems >> vis._visibleSets;
+
+  vis._allItems.reserve(vis._items.size());
+  for(xuint32 i=0; i<(xuint32)vis._items.size(); ++i)
+    {
+    vis._allItems << i;
+    }
+
+  if(stream.status() != QDataStream::Ok)
+    {
+    vis.clear();
+    }
+  return stream;
+  }
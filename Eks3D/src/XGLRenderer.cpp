@@ -105,8 +105,13 @@ class XGLShader : public XAbstractShader
     {
 public:
     XGLShader( XGLRenderer * );
+    ~XGLShader( );
 
     void setType( int );
+
+    XGLStateCache &state();
+    unsigned int programId() const;
+
 private:
     virtual XAbstractShaderVariable *createVariable( QString, XAbstractShader * );
     virtual void destroyVariable( XAbstractShaderVariable * );
@@ -167,10 +172,14 @@ public:
 
 private:
     void clear();
+    void setInts( const int *values, int count );
+    void setFloats( const float *values, int components, int count );
+    template <int N, int M> void setMatrices( const QGenericMatrix<N, M, qreal> *values, int count );
+    void setMatrices( const QMatrix4x4 *values, int count );
+
     QString _name;
     int _location;
     XTexture *_texture;
-    QVariant _value;
     friend class XGLRenderer;
     };
 
@@ -181,19 +190,32 @@ private:
 class XGLGeometryCache : public XAbstractGeometry
     {
 public:
-    XGLGeometryCache( XGLRenderer *, XGeometry::BufferType );
+    XGLGeometryCache( XGLRenderer *, XGeometry::BufferType, XGeometry::VertexLayout );
     ~XGLGeometryCache( );
 
     virtual void setPoints( const XVector<unsigned int> & );
     virtual void setLines( const XVector<unsigned int> & );
     virtual void setTriangles( const XVector<unsigned int> & );
 
+    virtual void setPoints( const unsigned int *, int count );
+    virtual void setLines( const unsigned int *, int count );
+    virtual void setTriangles( const unsigned int *, int count );
+
     virtual void setAttributesSize( int, int, int, int, int );
 
     virtual void setAttribute( QString, const XVector<xReal> & );
     virtual void setAttribute( QString, const XVector<XVector2D> & );
     virtual void setAttribute( QString, const XVector<XVector3D> & );
     virtual void setAttribute( QString, const XVector<XVector4D> & );
+    virtual void setAttribute( QString, const xReal *, int components, int count );
+
+    virtual void setAttributeRange( QString, const XVector<xReal> &, int first, int count );
+    virtual void setAttributeRange( QString, const XVector<XVector2D> &, int first, int count );
+    virtual void setAttributeRange( QString, const XVector<XVector3D> &, int first, int count );
+    virtual void setAttributeRange( QString, const XVector<XVector4D> &, int first, int count );
+
+    // upload any vertex data written since the last draw.
+    void flush();
 
 private:
     unsigned int _vertexArray;
@@ -206,8 +228,30 @@ private:
     unsigned int _triangleSize;
 
     int _type;
-
-    int getCacheOffset( const QString &name, int components, int attrSize );
+    bool _interleaved;
+    bool _ring;
+
+    // number of vertices, bytes in one copy of the vertex data, and bytes between vertices (0 when planar)
+    int _attributeCount;
+    int _vertexDataSize;
+    int _stride;
+
+    // Stream buffers hold RingSegments copies of the vertex data, each update is written to the next copy
+    // so we never write to the copy the GPU may still be reading from. Assumes one update per frame.
+    enum { RingSegments = 3 };
+    int _ringSegment;
+    int _baseOffset;
+
+    // Interleaved and stream data is written to a client side copy, and uploaded as one range in flush()
+    XVector<char> _shadow;
+    int _dirtyBegin;
+    int _dirtyEnd;
+
+    bool usesShadow() const { return _interleaved || _ring; }
+    void setIndices( unsigned int &array, unsigned int &size, const unsigned int *data, int count );
+    void writeAttribute( const QString &name, const float *data, int components, int first, int count );
+
+    int getCacheOffset( const QString &name, int components );
     struct DrawCache
         {
         QString name;
@@ -217,6 +261,10 @@ private:
     XList <DrawCache> _cache;
     int _usedCacheSize;
 
+    // attribute locations of _cache in the program drawn with last, by its state cache serial.
+    xuint32 _locationProgram;
+    XVector <int> _locations;
+
     XGLRenderer *_renderer;
     friend class XGLRenderer;
     };
@@ -228,7 +276,6 @@ private:
 
 XGLRenderer::XGLRenderer() : _currentShader( 0 ), _currentFramebuffer(0)
   {
-  m_ids.reserve(8);
   }
 
 void XGLRenderer::setContext(QGLContext *ctx)
@@ -333,65 +380,69 @@ void XGLRenderer::drawGeometry( const XGeometry &cache )
     {
     cache.prepareInternal( this );
     XGLGeometryCache *gC = static_cast<XGLGeometryCache*>((&cache)->internal());
+    gC->flush();
 
-    glBindBuffer( GL_ARRAY_BUFFER, gC->_vertexArray ) GLE;
+    // locations are looked up when the geometry is drawn with a different program, not for every draw.
+    unsigned int program = _currentShader->programId();
+    xuint32 serial = _state.programSerial( program );
+    if( gC->_locationProgram != serial )
+      {
+      gC->_locations.clear();
+      foreach( const XGLGeometryCache::DrawCache &ref, gC->_cache )
+        {
+        gC->_locations << _state.attributeLocation( program, ref.name );
+        }
+      gC->_locationProgram = serial;
+      }
 
-    m_ids.clear();
-    foreach( const XGLGeometryCache::DrawCache &ref, gC->_cache )
+    _state.beginAttributes();
+    for( int i=0; i<gC->_cache.size(); ++i )
       {
-      int location( _currentShader->shader.attributeLocation(ref.name) );
+      int location = gC->_locations[i];
       if( location >= 0 )
         {
-        m_ids << location;
-        glEnableVertexAttribArray( location ) GLE;
-        glVertexAttribPointer( location, ref.components, GL_FLOAT, GL_FALSE, 0, (GLvoid*)ref.offset ) GLE;
+        const XGLGeometryCache::DrawCache &ref = gC->_cache[i];
+        _state.setAttribute( location, gC->_vertexArray, ref.components, gC->_stride, gC->_baseOffset + ref.offset );
         }
       }
+    _state.endAttributes() GLE;
 
     if( gC->_pointArray )
       {
-      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, gC->_pointArray ) GLE;
-      glDrawElements( GL_POINTS, gC->_pointSize, GL_UNSIGNED_INT, (GLvoid*)((char*)NULL)) GLE;
-      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 ) GLE;
+      _state.bindElementBuffer( gC->_pointArray );
+      _state.drawElements( GL_POINTS, gC->_pointSize ) GLE;
       }
 
     if( gC->_lineArray )
       {
-      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, gC->_lineArray ) GLE;
-      glDrawElements( GL_LINES, gC->_lineSize, GL_UNSIGNED_INT, (GLvoid*)((char*)NULL)) GLE;
-      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 ) GLE;
+      _state.bindElementBuffer( gC->_lineArray );
+      _state.drawElements( GL_LINES, gC->_lineSize ) GLE;
       }
 
     if( gC->_triangleArray )
       {
-      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, gC->_triangleArray ) GLE;
-      glDrawElements( GL_TRIANGLES, gC->_triangleSize, GL_UNSIGNED_INT, (GLvoid*)((char*)NULL)) GLE;
-      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 ) GLE;
-      }
-
-    foreach( int id, m_ids )
-      {
-      glDisableVertexAttribArray( id ) GLE;
+      _state.bindElementBuffer( gC->_triangleArray );
+      _state.drawElements( GL_TRIANGLES, gC->_triangleSize ) GLE;
       }
-
-    glBindBuffer( GL_ARRAY_BUFFER, 0 ) GLE;
     }
   }
 
-XAbstractGeometry *XGLRenderer::getGeometry( XGeometry::BufferType t )
+XAbstractGeometry *XGLRenderer::getGeometry( XGeometry::BufferType t, XGeometry::VertexLayout l )
     {
-    return new XGLGeometryCache( this, t );
+    return new XGLGeometryCache( this, t, l );
     }
 
 void XGLRenderer::setShader( const XShader *shader )
   {
-  if( shader && ( _currentShader == 0 || _currentShader != shader->internal() ) )
+  if( shader )
     {
     shader->prepareInternal( this );
     _currentShader = static_cast<XGLShader*>(shader->internal());
-    _currentShader->shader.bind() GLE;
+    unsigned int program = _currentShader->programId();
+    _state.useProgram( program ) GLE;
 
-    int x=0;
+    // textures take units in the order of the shader's variables, units already holding them aren't rebound.
+    int unit = 0;
     foreach( XShaderVariable *var, shader->variables() )
       {
       XGLShaderVariable *glVar( static_cast<XGLShaderVariable*>(var->internal()) );
@@ -401,16 +452,15 @@ void XGLRenderer::setShader( const XShader *shader )
         tex->prepareInternal( this );
         const XGLTexture *glTex( static_cast<const XGLTexture*>(tex->internal()) );
         xAssert( glTex );
-        glActiveTexture( GL_TEXTURE0 + x ) GLE;
-        glBindTexture( GL_TEXTURE_2D, glTex->_id ) GLE;
-        _currentShader->shader.setUniformValue( glVar->_location, x );
+        _state.bindTexture( unit, glTex->_id ) GLE;
+        _state.setUniform( program, glVar->_location, &unit, 1 ) GLE;
+        unit++;
         }
-      x++;
       }
     }
-  else if( shader == 0 && _currentShader != 0 )
+  else if( _currentShader != 0 )
     {
-    _currentShader->shader.release() GLE;
+    _state.useProgram( 0 ) GLE;
     _currentShader = 0;
     }
   }
@@ -454,6 +504,16 @@ QSize XGLRenderer::viewportSize()
   return _size;
   }
 
+XGLStateCache &XGLRenderer::stateCache()
+  {
+  return _state;
+  }
+
+const XGLStateCache &XGLRenderer::stateCache() const
+  {
+  return _state;
+  }
+
 void XGLRenderer::destroyShader( XAbstractShader *shader )
   {
   delete shader;
@@ -545,6 +605,7 @@ XGLTexture::XGLTexture( XGLRenderer *r, int format, int width, int height ) : _r
   glTexImage2D( GL_TEXTURE_2D, 0, getInternalFormat( format ), width, height, 0, getFormat( format ), GL_UNSIGNED_BYTE, (const GLvoid *)0 ) GLE;
 
   glBindTexture( GL_TEXTURE_2D, 0 ) GLE;
+  r->stateCache().textureBindingChanged();
   }
 
 XGLTexture::~XGLTexture()
@@ -556,6 +617,7 @@ void XGLTexture::load( const QImage &im )
   {
   clear();
   _id = _renderer->context()->bindTexture( im ) GLE;
+  _renderer->stateCache().textureBindingChanged();
   }
 
 QImage XGLTexture::save( )
@@ -574,6 +636,7 @@ QImage XGLTexture::save( )
 
 void XGLTexture::clear()
   {
+  _renderer->stateCache().forgetTexture( _id );
   _renderer->context()->deleteTexture( _id ) GLE;
   }
 
@@ -709,12 +772,27 @@ XGLShader::XGLShader( XGLRenderer *renderer ) : XAbstractShader( renderer ), sha
     {
     }
 
+XGLShader::~XGLShader( )
+    {
+    state().forgetProgram( programId() );
+    }
+
 void XGLShader::setType( int type )
     {
+    // the program is only bound through the state cache, so it knows what is bound.
     shader.addShaderFromSourceCode( QGLShader::Vertex, getVertex( type ) ) GLE;
     shader.addShaderFromSourceCode( QGLShader::Fragment, getFragment( type ) ) GLE;
     shader.link() GLE;
-    shader.bind() GLE;
+    }
+
+XGLStateCache &XGLShader::state()
+    {
+    return static_cast<XGLRenderer*>(renderer())->stateCache();
+    }
+
+unsigned int XGLShader::programId() const
+    {
+    return shader.programId();
     }
 
 XAbstractShaderVariable *XGLShader::createVariable( QString in, XAbstractShader *s )
@@ -756,97 +834,98 @@ XGLShaderVariable::~XGLShaderVariable( )
 void XGLShaderVariable::setValue( int value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setInts( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( xReal value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setFloats( &value, 1, 1 );
   }
 
 void XGLShaderVariable::setValue( unsigned int value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  int v = value;
+  setInts( &v, 1 );
   }
 
 void XGLShaderVariable::setValue( const XColour &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, toQt(value) ) GLE;
+  setFloats( value.data(), 4, 1 );
   }
 
 void XGLShaderVariable::setValue( const XVector2D &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, toQt(value) ) GLE;
+  setFloats( value.data(), 2, 1 );
   }
 
 void XGLShaderVariable::setValue( const XVector3D &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, toQt(value) ) GLE;
+  setFloats( value.data(), 3, 1 );
   }
 
 void XGLShaderVariable::setValue( const XVector4D &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, toQt(value) ) GLE;
+  setFloats( value.data(), 4, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix2x2 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix2x3 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix2x4 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix3x2 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix3x3 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix3x4 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix4x2 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix4x3 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const QMatrix4x4 &value )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, value ) GLE;
+  setMatrices( &value, 1 );
   }
 
 void XGLShaderVariable::setValue( const XTexture &value )
@@ -854,108 +933,154 @@ void XGLShaderVariable::setValue( const XTexture &value )
   clear();
   _texture = new XTexture( value );
   _texture->prepareInternal( abstractShader()->renderer() );
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValue( _location, static_cast<XGLTexture*>(_texture->internal())->_id) GLE;
+  // the sampler is given the texture's unit when the shader is bound.
   }
 
 void XGLShaderVariable::setValueArray( const XVector<int> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setInts( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<xReal> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size(), 1 ) GLE;
+  setFloats( values.constData(), 1, values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<unsigned int> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setInts( reinterpret_cast<const int *>(values.constData()), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<XColour> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, values.front().data(), values.size(), 4 ) GLE;
+  setFloats( values.isEmpty() ? 0 : values.front().data(), 4, values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<XVector2D> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, values.front().data(), values.size(), 2 ) GLE;
+  setFloats( values.isEmpty() ? 0 : values.front().data(), 2, values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<XVector3D> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, values.front().data(), values.size(), 3 ) GLE;
+  setFloats( values.isEmpty() ? 0 : values.front().data(), 3, values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<XVector4D> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, values.front().data(), values.size(), 4 ) GLE;
+  setFloats( values.isEmpty() ? 0 : values.front().data(), 4, values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix2x2> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix2x3> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix2x4> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix3x2> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix3x3> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix3x4> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix4x2> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix4x3> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
   }
 
 void XGLShaderVariable::setValueArray( const XVector<QMatrix4x4> &values )
   {
   clear();
-  GL_SHADER_VARIABLE_PARENT->shader.setUniformValueArray( _location, &(values.front()), values.size() ) GLE;
+  setMatrices( values.constData(), values.size() );
+  }
+
+void XGLShaderVariable::setInts( const int *values, int count )
+  {
+  XGLShader *shader = GL_SHADER_VARIABLE_PARENT;
+  shader->state().setUniform( shader->programId(), _location, values, count ) GLE;
+  }
+
+void XGLShaderVariable::setFloats( const float *values, int components, int count )
+  {
+  XGLShader *shader = GL_SHADER_VARIABLE_PARENT;
+  shader->state().setUniform( shader->programId(), _location, values, components, count ) GLE;
+  }
+
+template <int N, int M> void XGLShaderVariable::setMatrices( const QGenericMatrix<N, M, qreal> *values, int count )
+  {
+  // Qt matrices may hold doubles, GL takes floats, both are column major.
+  XVector<float> data( N * M * count );
+  for( int i=0; i<count; ++i )
+    {
+    const qreal *src = values[i].constData();
+    for( int j=0; j<N*M; ++j )
+      {
+      data[( i * N * M ) + j] = src[j];
+      }
+    }
+
+  XGLShader *shader = GL_SHADER_VARIABLE_PARENT;
+  shader->state().setUniformMatrix( shader->programId(), _location, data.constData(), N, M, count ) GLE;
+  }
+
+void XGLShaderVariable::setMatrices( const QMatrix4x4 *values, int count )
+  {
+  XVector<float> data( 16 * count );
+  for( int i=0; i<count; ++i )
+    {
+    const qreal *src = values[i].constData();
+    for( int j=0; j<16; ++j )
+      {
+      data[( i * 16 ) + j] = src[j];
+      }
+    }
+
+  XGLShader *shader = GL_SHADER_VARIABLE_PARENT;
+  shader->state().setUniformMatrix( shader->programId(), _location, data.constData(), 4, 4, count ) GLE;
   }
 
 void XGLShaderVariable::rebind()
   {
-  _location = GL_SHADER_VARIABLE_PARENT->shader.uniformLocation( _name ) GLE;
+  XGLShader *shader = GL_SHADER_VARIABLE_PARENT;
+  _location = shader->state().uniformLocation( shader->programId(), _name );
   }
 
 void XGLShaderVariable::clear()
@@ -973,7 +1098,8 @@ void XGLShaderVariable::clear()
 // GEOMETRY CACHE
 //----------------------------------------------------------------------------------------------------------------------
 
-XGLGeometryCache::XGLGeometryCache( XGLRenderer *r, XGeometry::BufferType type ) : _renderer( r )
+XGLGeometryCache::XGLGeometryCache( XGLRenderer *r, XGeometry::BufferType type, XGeometry::VertexLayout layout )
+    : _interleaved( layout == XGeometry::Interleaved ), _ring( type == XGeometry::Stream ), _renderer( r )
   {
   _pointArray = 0;
   _lineArray = 0;
@@ -983,6 +1109,14 @@ XGLGeometryCache::XGLGeometryCache( XGLRenderer *r, XGeometry::BufferType type )
   _lineSize = 0;
   _triangleSize = 0;
 
+  _attributeCount = 0;
+  _vertexDataSize = 0;
+  _stride = 0;
+  _ringSegment = 0;
+  _baseOffset = 0;
+  _dirtyBegin = 0;
+  _dirtyEnd = 0;
+
   glGenBuffers( 1, &_vertexArray ) GLE;
   if( type == XGeometry::Dynamic )
     {
@@ -997,83 +1131,81 @@ XGLGeometryCache::XGLGeometryCache( XGLRenderer *r, XGeometry::BufferType type )
     _type = GL_STATIC_DRAW;
     }
   _usedCacheSize = 0;
+  _locationProgram = 0;
   }
 
 XGLGeometryCache::~XGLGeometryCache( )
     {
+    XGLStateCache &state = _renderer->stateCache();
+    state.forgetBuffer( _vertexArray );
     glDeleteBuffers( 1, &_vertexArray ) GLE;
 
     if( _pointArray )
         {
+        state.forgetBuffer( _pointArray );
         glDeleteBuffers( 1, &_pointArray ) GLE;
         }
     if( _lineArray )
         {
+        state.forgetBuffer( _lineArray );
         glDeleteBuffers( 1, &_lineArray ) GLE;
         }
     if( _triangleArray )
         {
+        state.forgetBuffer( _triangleArray );
         glDeleteBuffers( 1, &_triangleArray ) GLE;
         }
     }
 
 void XGLGeometryCache::setPoints( const XVector<unsigned int> &poi )
     {
-    if( poi.size() )
-        {
-        _pointSize = poi.size();
-        if( !_pointArray )
-            {
-            glGenBuffers( 1, &_pointArray );
-            }
-
-        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, _pointArray ) GLE;
-        glBufferData( GL_ELEMENT_ARRAY_BUFFER, poi.size()*sizeof(unsigned int), &(poi.front()), _type ) GLE;
-        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 ) GLE;
-        }
-    else if( _pointArray )
-        {
-        glDeleteBuffers( 1, &_pointArray ) GLE;
-        }
+    setPoints( poi.constData(), poi.size() );
     }
 
 void XGLGeometryCache::setLines( const XVector<unsigned int> &lin )
     {
-    if( lin.size() )
-        {
-        _lineSize = lin.size();
-        if( !_lineArray )
-            {
-            glGenBuffers( 1, &_lineArray ) GLE;
-            }
-
-        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, _lineArray ) GLE;
-        glBufferData( GL_ELEMENT_ARRAY_BUFFER, lin.size()*sizeof(unsigned int), &(lin.front()), _type ) GLE;
-        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 ) GLE;
-        }
-    else if( _lineArray )
-        {
-        glDeleteBuffers( 1, &_lineArray ) GLE;
-        }
+    setLines( lin.constData(), lin.size() );
     }
 
 void XGLGeometryCache::setTriangles( const XVector<unsigned int> &tri )
     {
-    if( tri.size() )
+    setTriangles( tri.constData(), tri.size() );
+    }
+
+void XGLGeometryCache::setPoints( const unsigned int *poi, int count )
+    {
+    setIndices( _pointArray, _pointSize, poi, count );
+    }
+
+void XGLGeometryCache::setLines( const unsigned int *lin, int count )
+    {
+    setIndices( _lineArray, _lineSize, lin, count );
+    }
+
+void XGLGeometryCache::setTriangles( const unsigned int *tri, int count )
+    {
+    setIndices( _triangleArray, _triangleSize, tri, count );
+    }
+
+void XGLGeometryCache::setIndices( unsigned int &array, unsigned int &size, const unsigned int *data, int count )
+    {
+    if( count )
         {
-        _triangleSize = tri.size();
-        if( !_triangleArray )
+        size = count;
+        if( !array )
             {
-            glGenBuffers( 1, &_triangleArray ) GLE;
+            glGenBuffers( 1, &array ) GLE;
             }
 
-        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, _triangleArray ) GLE;
-        glBufferData( GL_ELEMENT_ARRAY_BUFFER, tri.size()*sizeof(unsigned int), &(tri.front()), _type ) GLE;
-        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 ) GLE;
+        _renderer->stateCache().bindElementBuffer( array ) GLE;
+        glBufferData( GL_ELEMENT_ARRAY_BUFFER, count*sizeof(unsigned int), data, _type ) GLE;
         }
-    else if( _triangleArray )
+    else if( array )
         {
-        glDeleteBuffers( 1, &_triangleArray );
+        _renderer->stateCache().forgetBuffer( array );
+        glDeleteBuffers( 1, &array ) GLE;
+        array = 0;
+        size = 0;
         }
     }
 
@@ -1081,60 +1213,171 @@ void XGLGeometryCache::setAttributesSize( int s, int num1D, int num2D, int num3D
     {
     _usedCacheSize = 0;
     _cache.clear();
-    glBindBuffer( GL_ARRAY_BUFFER, _vertexArray ) GLE;
-    glBufferData( GL_ARRAY_BUFFER, (sizeof(float)*s*num1D)
-                                   + (sizeof(float)*2*s*num2D)
-                                   + (sizeof(float)*3*s*num3D)
-                                   + (sizeof(float)*4*s*num4D), 0, _type ) GLE;
-    glBindBuffer( GL_ARRAY_BUFFER, 0 ) GLE;
+    _locationProgram = 0;
+
+    int vertexSize = sizeof(float) * ( num1D + (2*num2D) + (3*num3D) + (4*num4D) );
+    _attributeCount = s;
+    _stride = _interleaved ? vertexSize : 0;
+    _vertexDataSize = vertexSize * s;
+    _ringSegment = 0;
+    _baseOffset = 0;
+
+    int segments = _ring ? RingSegments : 1;
+    _renderer->stateCache().bindArrayBuffer( _vertexArray ) GLE;
+    glBufferData( GL_ARRAY_BUFFER, _vertexDataSize * segments, 0, _type ) GLE;
+
+    _dirtyBegin = _vertexDataSize;
+    _dirtyEnd = 0;
+    if( usesShadow() )
+        {
+        _shadow.fill( 0, _vertexDataSize );
+        }
+    else
+        {
+        _shadow.clear();
+        }
     }
 
 void XGLGeometryCache::setAttribute( QString name, const XVector<xReal> &attr )
     {
-    int offset( getCacheOffset( name, 1, attr.size() ) );
-
-    //insert data
-    glBindBuffer( GL_ARRAY_BUFFER, _vertexArray ) GLE;
-    glBufferSubData( GL_ARRAY_BUFFER, offset, attr.size()*1*sizeof(float), &attr.front() ) GLE;
-    glBindBuffer( GL_ARRAY_BUFFER, 0 ) GLE;
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 1, 0, attr.size() );
     }
 
 void XGLGeometryCache::setAttribute( QString name, const XVector<XVector2D> &attr )
     {
-    int offset( getCacheOffset( name, 2, attr.size() ) );
-
-    //insert data
-    glBindBuffer( GL_ARRAY_BUFFER, _vertexArray ) GLE;
-    glBufferSubData( GL_ARRAY_BUFFER, offset, attr.size()*2*sizeof(float), &attr.front() ) GLE;
-    glBindBuffer( GL_ARRAY_BUFFER, 0 ) GLE;
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 2, 0, attr.size() );
     }
 
 void XGLGeometryCache::setAttribute( QString name, const XVector<XVector3D> &attr )
     {
-    int offset( getCacheOffset( name, 3, attr.size() ) );
-
-    //insert data
-    glBindBuffer( GL_ARRAY_BUFFER, _vertexArray ) GLE;
-    glBufferSubData( GL_ARRAY_BUFFER, offset, attr.size()*3*sizeof(float), &attr.front() ) GLE;
-    glBindBuffer( GL_ARRAY_BUFFER, 0 ) GLE;
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 3, 0, attr.size() );
     }
 
 void XGLGeometryCache::setAttribute( QString name, const XVector<XVector4D> &attr )
     {
-    int offset( getCacheOffset( name, 4, attr.size() ) );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 4, 0, attr.size() );
+    }
+
+void XGLGeometryCache::setAttribute( QString name, const xReal *attr, int components, int count )
+    {
+    writeAttribute( name, attr, components, 0, count );
+    }
+
+void XGLGeometryCache::setAttributeRange( QString name, const XVector<xReal> &attr, int first, int count )
+    {
+    xAssert( first >= 0 && first + count <= attr.size() );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 1, first, count );
+    }
+
+void XGLGeometryCache::setAttributeRange( QString name, const XVector<XVector2D> &attr, int first, int count )
+    {
+    xAssert( first >= 0 && first + count <= attr.size() );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 2, first, count );
+    }
+
+void XGLGeometryCache::setAttributeRange( QString name, const XVector<XVector3D> &attr, int first, int count )
+    {
+    xAssert( first >= 0 && first + count <= attr.size() );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 3, first, count );
+    }
+
+void XGLGeometryCache::setAttributeRange( QString name, const XVector<XVector4D> &attr, int first, int count )
+    {
+    xAssert( first >= 0 && first + count <= attr.size() );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 4, first, count );
+    }
+
+void XGLGeometryCache::writeAttribute( const QString &name, const float *data, int components, int first, int count )
+    {
+    if( count <= 0 )
+        {
+        return;
+        }
+
+    xAssert( first + count <= _attributeCount );
+    int offset( getCacheOffset( name, components ) );
+    int elementSize = components * sizeof(float);
+    const float *src = data + ( first * components );
+
+    if( !usesShadow() )
+        {
+        //insert data
+        _renderer->stateCache().bindArrayBuffer( _vertexArray ) GLE;
+        glBufferSubData( GL_ARRAY_BUFFER, offset + ( first * elementSize ), count * elementSize, src ) GLE;
+        return;
+        }
+
+    char *dest = _shadow.data();
+    int begin, end;
+    if( _interleaved )
+        {
+        begin = ( first * _stride ) + offset;
+        end = ( ( first + count - 1 ) * _stride ) + offset + elementSize;
+
+        char *vtx = dest + begin;
+        for( int i=0; i<count; ++i, vtx += _stride, src += components )
+            {
+            memcpy( vtx, src, elementSize );
+            }
+        }
+    else
+        {
+        begin = offset + ( first * elementSize );
+        end = begin + ( count * elementSize );
+        memcpy( dest + begin, src, count * elementSize );
+        }
+
+    _dirtyBegin = xMin( _dirtyBegin, begin );
+    _dirtyEnd = xMax( _dirtyEnd, end );
+    }
+
+void XGLGeometryCache::flush()
+    {
+    if( _dirtyBegin >= _dirtyEnd )
+        {
+        return;
+        }
 
-    //insert data
-    glBindBuffer( GL_ARRAY_BUFFER, _vertexArray ) GLE;
-    glBufferSubData( GL_ARRAY_BUFFER, offset, attr.size()*4*sizeof(float), &attr.front() ) GLE;
-    glBindBuffer( GL_ARRAY_BUFFER, 0 ) GLE;
+    _renderer->stateCache().bindArrayBuffer( _vertexArray ) GLE;
+    if( _ring )
+        {
+        // the next segment holds an old frame, so all of it is rewritten, not just the dirty range.
+        _ringSegment = ( _ringSegment + 1 ) % RingSegments;
+        _baseOffset = _ringSegment * _vertexDataSize;
+
+        void *mem = 0;
+        if( GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range )
+            {
+            mem = glMapBufferRange( GL_ARRAY_BUFFER, _baseOffset, _vertexDataSize,
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT ) GLE;
+            }
+
+        if( mem )
+            {
+            memcpy( mem, _shadow.constData(), _vertexDataSize );
+            glUnmapBuffer( GL_ARRAY_BUFFER ) GLE;
+            }
+        else
+            {
+            glBufferSubData( GL_ARRAY_BUFFER, _baseOffset, _vertexDataSize, _shadow.constData() ) GLE;
+            }
+        }
+    else
+        {
+        glBufferSubData( GL_ARRAY_BUFFER, _dirtyBegin, _dirtyEnd - _dirtyBegin, _shadow.constData() + _dirtyBegin ) GLE;
+        }
+
+    _dirtyBegin = _vertexDataSize;
+    _dirtyEnd = 0;
     }
 
-int XGLGeometryCache::getCacheOffset( const QString &name, int components, int attrSize )
+int XGLGeometryCache::getCacheOffset( const QString &name, int components )
     {
     foreach( const DrawCache &ref, _cache )
         {
         if( ref.name == name )
             {
+            xAssert( ref.components == components );
             return ref.offset;
             }
         }
@@ -1144,7 +1387,17 @@ int XGLGeometryCache::getCacheOffset( const QString &name, int components, int a
     c.name = name;
     c.offset = _usedCacheSize;
     _cache << c;
-    _usedCacheSize += sizeof(float) * components * attrSize;
+    _locationProgram = 0;
+
+    // interleaved offsets are within a single vertex, planar offsets are to the start of each attribute block.
+    if( _interleaved )
+        {
+        _usedCacheSize += sizeof(float) * components;
+        }
+    else
+        {
+        _usedCacheSize += sizeof(float) * components * _attributeCount;
+        }
 
     return c.offset;
     }
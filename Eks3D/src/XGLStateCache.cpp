@@ -0,0 +1,450 @@
+#include "XGLStateCache.h"
+#include "GL/glew.h"
+#include "string.h"
+
+namespace
+{
+// a binding the cache doesn't know, so the next change is always made.
+const unsigned int Unknown = X_UINT32_SENTINEL;
+
+void glUseProgramFunction( unsigned int program )
+    {
+    glUseProgram( program );
+    }
+
+int glUniformLocationFunction( unsigned int program, const char *name )
+    {
+    return glGetUniformLocation( program, name );
+    }
+
+int glAttributeLocationFunction( unsigned int program, const char *name )
+    {
+    return glGetAttribLocation( program, name );
+    }
+
+void glUniformIntsFunction( int location, int count, const int *values )
+    {
+    glUniform1iv( location, count, values );
+    }
+
+void glUniformFloatsFunction( int location, int components, int count, const float *values )
+    {
+    switch( components )
+        {
+    case 1: glUniform1fv( location, count, values ); break;
+    case 2: glUniform2fv( location, count, values ); break;
+    case 3: glUniform3fv( location, count, values ); break;
+    case 4: glUniform4fv( location, count, values ); break;
+    default: xAssertFail();
+        }
+    }
+
+void glUniformMatricesFunction( int location, int columns, int rows, int count, const float *values )
+    {
+    switch( ( columns * 10 ) + rows )
+        {
+    case 22: glUniformMatrix2fv( location, count, GL_FALSE, values ); break;
+    case 23: glUniformMatrix2x3fv( location, count, GL_FALSE, values ); break;
+    case 24: glUniformMatrix2x4fv( location, count, GL_FALSE, values ); break;
+    case 32: glUniformMatrix3x2fv( location, count, GL_FALSE, values ); break;
+    case 33: glUniformMatrix3fv( location, count, GL_FALSE, values ); break;
+    case 34: glUniformMatrix3x4fv( location, count, GL_FALSE, values ); break;
+    case 42: glUniformMatrix4x2fv( location, count, GL_FALSE, values ); break;
+    case 43: glUniformMatrix4x3fv( location, count, GL_FALSE, values ); break;
+    case 44: glUniformMatrix4fv( location, count, GL_FALSE, values ); break;
+    default: xAssertFail();
+        }
+    }
+
+void glActiveTextureFunction( int unit )
+    {
+    glActiveTexture( GL_TEXTURE0 + unit );
+    }
+
+void glBindTextureFunction( unsigned int texture )
+    {
+    glBindTexture( GL_TEXTURE_2D, texture );
+    }
+
+void glBindArrayBufferFunction( unsigned int buffer )
+    {
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    }
+
+void glBindElementBufferFunction( unsigned int buffer )
+    {
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffer );
+    }
+
+void glEnableAttributeFunction( int location )
+    {
+    glEnableVertexAttribArray( location );
+    }
+
+void glDisableAttributeFunction( int location )
+    {
+    glDisableVertexAttribArray( location );
+    }
+
+void glAttributePointerFunction( int location, int components, int stride, xsize offset )
+    {
+    glVertexAttribPointer( location, components, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offset );
+    }
+
+void glDrawElementsFunction( int mode, int count )
+    {
+    glDrawElements( mode, count, GL_UNSIGNED_INT, (const GLvoid *)0 );
+    }
+}
+
+const XGLStateCache::Functions &XGLStateCache::glFunctions()
+    {
+    static Functions fns =
+        {
+        glUseProgramFunction,
+        glUniformLocationFunction,
+        glAttributeLocationFunction,
+        glUniformIntsFunction,
+        glUniformFloatsFunction,
+        glUniformMatricesFunction,
+        glActiveTextureFunction,
+        glBindTextureFunction,
+        glBindArrayBufferFunction,
+        glBindElementBufferFunction,
+        glEnableAttributeFunction,
+        glDisableAttributeFunction,
+        glAttributePointerFunction,
+        glDrawElementsFunction
+        };
+    return fns;
+    }
+
+XGLStateCache::Stats::Stats() : programBinds( 0 ), redundantProgramBinds( 0 ), uniformUploads( 0 ),
+    redundantUniformUploads( 0 ), textureBinds( 0 ), redundantTextureBinds( 0 ), bufferBinds( 0 ),
+    redundantBufferBinds( 0 ), attributeChanges( 0 ), redundantAttributeChanges( 0 ), locationQueries( 0 ),
+    draws( 0 )
+    {
+    }
+
+XGLStateCache::XGLStateCache( const Functions &functions ) : _functions( functions ), _programSerial( 0 )
+    {
+    invalidate();
+    }
+
+void XGLStateCache::resetStats()
+    {
+    _stats = Stats();
+    }
+
+void XGLStateCache::invalidate()
+    {
+    _program = Unknown;
+    _activeUnit = -1;
+    for( int i=0; i<MaximumTextureUnits; ++i )
+        {
+        _textures[i] = Unknown;
+        }
+    _arrayBuffer = Unknown;
+    _elementBuffer = Unknown;
+
+    for( int i=0; i<MaximumAttributes; ++i )
+        {
+        Attribute &attr = _attributes[i];
+        attr.state = ArrayUnknown;
+        attr.buffer = Unknown;
+        attr.components = 0;
+        attr.stride = 0;
+        attr.offset = 0;
+        }
+    _usedAttributes = 0;
+
+    // uniform values are part of the program, so are only lost if the program is.
+    }
+
+void XGLStateCache::forgetProgram( unsigned int program )
+    {
+    _programs.remove( program );
+    if( _program == program )
+        {
+        _program = Unknown;
+        }
+    }
+
+void XGLStateCache::forgetTexture( unsigned int texture )
+    {
+    for( int i=0; i<MaximumTextureUnits; ++i )
+        {
+        if( _textures[i] == texture )
+            {
+            _textures[i] = Unknown;
+            }
+        }
+    }
+
+void XGLStateCache::forgetBuffer( unsigned int buffer )
+    {
+    // deleting a buffer unbinds it, from the attribute arrays too.
+    if( _arrayBuffer == buffer )
+        {
+        _arrayBuffer = Unknown;
+        }
+    if( _elementBuffer == buffer )
+        {
+        _elementBuffer = Unknown;
+        }
+    for( int i=0; i<MaximumAttributes; ++i )
+        {
+        if( _attributes[i].buffer == buffer )
+            {
+            _attributes[i].buffer = Unknown;
+            }
+        }
+    }
+
+void XGLStateCache::textureBindingChanged()
+    {
+    if( _activeUnit >= 0 )
+        {
+        _textures[_activeUnit] = Unknown;
+        }
+    else
+        {
+        for( int i=0; i<MaximumTextureUnits; ++i )
+            {
+            _textures[i] = Unknown;
+            }
+        }
+    }
+
+void XGLStateCache::useProgram( unsigned int program )
+    {
+    if( _program == program )
+        {
+        ++_stats.redundantProgramBinds;
+        return;
+        }
+
+    ++_stats.programBinds;
+    _functions.useProgram( program );
+    _program = program;
+
+    if( program )
+        {
+        Program &prog = programData( program );
+        foreach( int location, prog.dirtyUniforms )
+            {
+            Uniform &u = prog.uniforms[location];
+            upload( location, u );
+            u.dirty = false;
+            }
+        prog.dirtyUniforms.clear();
+        }
+    }
+
+XGLStateCache::Program &XGLStateCache::programData( unsigned int program )
+    {
+    XHash<unsigned int, Program>::iterator it = _programs.find( program );
+    if( it == _programs.end() )
+        {
+        it = _programs.insert( program, Program() );
+        it->serial = ++_programSerial;
+        }
+    return it.value();
+    }
+
+xuint32 XGLStateCache::programSerial( unsigned int program )
+    {
+    return programData( program ).serial;
+    }
+
+int XGLStateCache::uniformLocation( unsigned int program, const QString &name )
+    {
+    Program &prog = programData( program );
+    XHash<QString, int>::const_iterator it = prog.uniformLocations.constFind( name );
+    if( it != prog.uniformLocations.constEnd() )
+        {
+        return it.value();
+        }
+
+    ++_stats.locationQueries;
+    int location = _functions.uniformLocation( program, name.toAscii().constData() );
+    prog.uniformLocations.insert( name, location );
+    return location;
+    }
+
+int XGLStateCache::attributeLocation( unsigned int program, const QString &name )
+    {
+    Program &prog = programData( program );
+    XHash<QString, int>::const_iterator it = prog.attributeLocations.constFind( name );
+    if( it != prog.attributeLocations.constEnd() )
+        {
+        return it.value();
+        }
+
+    ++_stats.locationQueries;
+    int location = _functions.attributeLocation( program, name.toAscii().constData() );
+    prog.attributeLocations.insert( name, location );
+    return location;
+    }
+
+void XGLStateCache::setUniform( unsigned int program, int location, const int *values, int count )
+    {
+    setUniformData( program, location, Ints, 1, count, values, count * sizeof(int) );
+    }
+
+void XGLStateCache::setUniform( unsigned int program, int location, const float *values, int components, int count )
+    {
+    setUniformData( program, location, Floats, components, count, values, components * count * sizeof(float) );
+    }
+
+void XGLStateCache::setUniformMatrix( unsigned int program, int location, const float *values, int columns, int rows, int count )
+    {
+    setUniformData( program, location, Matrices, ( columns * 10 ) + rows, count, values, columns * rows * count * sizeof(float) );
+    }
+
+void XGLStateCache::setUniformData( unsigned int program, int location, int type, int shape, int count, const void *data, int size )
+    {
+    if( location < 0 || count <= 0 )
+        {
+        return;
+        }
+
+    Program &prog = programData( program );
+    bool known = prog.uniforms.contains( location );
+    Uniform &u = prog.uniforms[location];
+    if( known && u.type == type && u.shape == shape && u.count == count && memcmp( u.data.constData(), data, size ) == 0 )
+        {
+        ++_stats.redundantUniformUploads;
+        return;
+        }
+
+    u.type = type;
+    u.shape = shape;
+    u.count = count;
+    u.data.resize( size );
+    memcpy( u.data.data(), data, size );
+
+    if( _program == program )
+        {
+        upload( location, u );
+        }
+    else if( !known || !u.dirty )
+        {
+        u.dirty = true;
+        prog.dirtyUniforms << location;
+        }
+    }
+
+void XGLStateCache::upload( int location, const Uniform &u )
+    {
+    ++_stats.uniformUploads;
+    if( u.type == Ints )
+        {
+        _functions.uniformInts( location, u.count, reinterpret_cast<const int *>(u.data.constData()) );
+        }
+    else if( u.type == Floats )
+        {
+        _functions.uniformFloats( location, u.shape, u.count, reinterpret_cast<const float *>(u.data.constData()) );
+        }
+    else
+        {
+        _functions.uniformMatrices( location, u.shape / 10, u.shape % 10, u.count, reinterpret_cast<const float *>(u.data.constData()) );
+        }
+    }
+
+void XGLStateCache::bindTexture( int unit, unsigned int texture )
+    {
+    xAssert( unit >= 0 && unit < MaximumTextureUnits );
+    if( _textures[unit] == texture )
+        {
+        ++_stats.redundantTextureBinds;
+        return;
+        }
+
+    ++_stats.textureBinds;
+    if( _activeUnit != unit )
+        {
+        _functions.activeTexture( unit );
+        _activeUnit = unit;
+        }
+    _functions.bindTexture( texture );
+    _textures[unit] = texture;
+    }
+
+void XGLStateCache::bindArrayBuffer( unsigned int buffer )
+    {
+    if( _arrayBuffer == buffer )
+        {
+        ++_stats.redundantBufferBinds;
+        return;
+        }
+
+    ++_stats.bufferBinds;
+    _functions.bindArrayBuffer( buffer );
+    _arrayBuffer = buffer;
+    }
+
+void XGLStateCache::bindElementBuffer( unsigned int buffer )
+    {
+    if( _elementBuffer == buffer )
+        {
+        ++_stats.redundantBufferBinds;
+        return;
+        }
+
+    ++_stats.bufferBinds;
+    _functions.bindElementBuffer( buffer );
+    _elementBuffer = buffer;
+    }
+
+void XGLStateCache::beginAttributes()
+    {
+    _usedAttributes = 0;
+    }
+
+void XGLStateCache::setAttribute( int location, unsigned int buffer, int components, int stride, xsize offset )
+    {
+    xAssert( location >= 0 && location < MaximumAttributes );
+    _usedAttributes |= 1 << location;
+
+    Attribute &attr = _attributes[location];
+    if( attr.buffer == buffer && attr.components == components && attr.stride == stride && attr.offset == offset )
+        {
+        ++_stats.redundantAttributeChanges;
+        }
+    else
+        {
+        ++_stats.attributeChanges;
+        bindArrayBuffer( buffer );
+        _functions.attributePointer( location, components, stride, offset );
+        attr.buffer = buffer;
+        attr.components = components;
+        attr.stride = stride;
+        attr.offset = offset;
+        }
+
+    if( attr.state != ArrayEnabled )
+        {
+        _functions.enableAttribute( location );
+        attr.state = ArrayEnabled;
+        }
+    }
+
+void XGLStateCache::endAttributes()
+    {
+    for( int i=0; i<MaximumAttributes; ++i )
+        {
+        Attribute &attr = _attributes[i];
+        if( attr.state != ArrayDisabled && ( _usedAttributes & ( 1 << i ) ) == 0 )
+            {
+            _functions.disableAttribute( i );
+            attr.state = ArrayDisabled;
+            }
+        }
+    }
+
+void XGLStateCache::drawElements( int mode, int count )
+    {
+    ++_stats.draws;
+    _functions.drawElements( mode, count );
+    }
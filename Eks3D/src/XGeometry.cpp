@@ -2,18 +2,42 @@
 #include "XRenderer.h"
 #include "XTriangle.h"
 #include "XCuboid.h"
+#include "string.h"
 
 XAbstractGeometry::~XAbstractGeometry()
   {
   }
 
-XGeometry::XGeometry( BufferType type ) : _internal( 0 ), _changedP( false ), _changedL( false ),
-    _changedT( false ), _attributeSizeChanged( false ), _changedAttrs(false), _attributeSize( 0 ), _renderer( 0 ), _type( type )
+void XGeometry::DirtyRange::unite( int f, int l )
   {
+  if( last < first )
+    {
+    first = f;
+    last = l;
+    }
+  else
+    {
+    first = xMin( first, f );
+    last = xMax( last, l );
+    }
+  }
+
+XGeometry::XGeometry( BufferType type, VertexLayout layout ) : _internal( 0 ), _changedP( false ), _changedL( false ),
+    _changedT( false ), _attributeSizeChanged( false ), _changedAttrs(false), _attributeSize( 0 ), _renderer( 0 ),
+    _type( type ), _layout( layout )
+  {
+  }
+
+XGeometry::XGeometry( const XMeshContainer &container, BufferType type, VertexLayout layout ) : _internal( 0 ),
+    _changedP( true ), _changedL( true ), _changedT( true ), _attributeSizeChanged( true ), _changedAttrs( true ),
+    _attributeSize( container.vertexCount() ), _renderer( 0 ), _container( container ), _type( type ), _layout( layout )
+  {
+  xAssert( container.isValid() );
   }
 
 XGeometry::XGeometry( const XGeometry &cpy ) : _internal( 0 ), _changedP( false ), _changedL( false ),
-    _changedT( false ), _renderer( 0 ), _type( cpy._type )
+    _changedT( false ), _attributeSizeChanged( false ), _changedAttrs( false ), _renderer( 0 ), _type( cpy._type ),
+    _layout( cpy._layout )
   {
   _attributeSize = cpy._attributeSize;
   _attr1 = cpy._attr1;
@@ -23,17 +47,87 @@ XGeometry::XGeometry( const XGeometry &cpy ) : _internal( 0 ), _changedP( false
   _points = cpy._points;
   _lines = cpy._lines;
   _triangles = cpy._triangles;
+  _container = cpy._container;
+  }
+
+template <typename T> bool XGeometry::diffAttributes( const XHash <QString, XVector<T> > &oldAttrs,
+                                                      const XHash <QString, XVector<T> > &newAttrs,
+                                                      XHash <QString, DirtyRange> &changes )
+  {
+  if( oldAttrs.size() != newAttrs.size() )
+    {
+    return false;
+    }
+
+  typename XHash <QString, XVector<T> >::const_iterator it = newAttrs.begin();
+  typename XHash <QString, XVector<T> >::const_iterator end = newAttrs.end();
+  for( ; it != end; ++it )
+    {
+    typename XHash <QString, XVector<T> >::const_iterator old = oldAttrs.find( it.key() );
+    if( old == oldAttrs.end() || old.value().size() != it.value().size() )
+      {
+      return false;
+      }
+
+    // shared data cant have changed.
+    const T *oldData = old.value().constData();
+    const T *newData = it.value().constData();
+    if( oldData == newData )
+      {
+      continue;
+      }
+
+    int size = it.value().size();
+    int first = 0;
+    while( first < size && oldData[first] == newData[first] )
+      {
+      ++first;
+      }
+
+    if( first < size )
+      {
+      int last = size - 1;
+      while( last > first && oldData[last] == newData[last] )
+        {
+        --last;
+        }
+      changes[it.key()].unite( first, last );
+      _changedAttrs = true;
+      }
+    }
+  return true;
   }
 
 XGeometry& XGeometry::operator=( const XGeometry &cpy )
   {
   if( _internal )
     {
-    xAssert(_renderer);
-    _renderer->destroyGeometry(_internal);
-    _internal = 0;
+    // if the buffer layout is unchanged, keep the uploaded buffers and only mark the ranges which differ.
+    // wrapped containers are uploaded whole, so can't be diffed.
+    bool compatible = !_container.isValid() && !cpy._container.isValid();
+    compatible = compatible && cpy._type == _type && cpy._layout == _layout && cpy._attributeSize == _attributeSize;
+    compatible = compatible && diffAttributes( _attr1, cpy._attr1, _changedA1 );
+    compatible = compatible && diffAttributes( _attr2, cpy._attr2, _changedA2 );
+    compatible = compatible && diffAttributes( _attr3, cpy._attr3, _changedA3 );
+    compatible = compatible && diffAttributes( _attr4, cpy._attr4, _changedA4 );
+
+    if( compatible )
+      {
+      _changedP = _changedP || _points != cpy._points;
+      _changedL = _changedL || _lines != cpy._lines;
+      _changedT = _changedT || _triangles != cpy._triangles;
+      }
+    else
+      {
+      xAssert(_renderer);
+      _renderer->destroyGeometry(_internal);
+      _internal = 0;
+      clearChanges();
+      }
     }
 
+  _type = cpy._type;
+  _layout = cpy._layout;
   _attributeSize = cpy._attributeSize;
   _attr1 = cpy._attr1;
   _attr2 = cpy._attr2;
@@ -42,173 +136,289 @@ XGeometry& XGeometry::operator=( const XGeometry &cpy )
   _points = cpy._points;
   _lines = cpy._lines;
   _triangles = cpy._triangles;
+  _container = cpy._container;
+
+  if( _container.isValid() )
+    {
+    _changedP = true;
+    _changedL = true;
+    _changedT = true;
+    _attributeSizeChanged = true;
+    _changedAttrs = true;
+    }
 
   return *this;
   }
 
 const XVector<unsigned int> &XGeometry::points() const
   {
+  unpack();
   return _points;
   }
 
 const XVector<unsigned int> &XGeometry::lines() const
   {
+  unpack();
   return _lines;
   }
 
 const XVector<unsigned int> &XGeometry::triangles() const
   {
+  unpack();
   return _triangles;
   }
 
 const XHash <QString, XVector<xReal> > &XGeometry::attributes1D() const
   {
+  unpack();
   return _attr1;
   }
 
 const XHash <QString, XVector<XVector2D> > &XGeometry::attributes2D() const
   {
+  unpack();
   return _attr2;
   }
 
 const XHash <QString, XVector<XVector3D> > &XGeometry::attributes3D() const
   {
+  unpack();
   return _attr3;
   }
 
 const XHash <QString, XVector<XVector4D> > &XGeometry::attributes4D() const
   {
+  unpack();
   return _attr4;
   }
 
 void XGeometry::setPoints( const XVector<unsigned int> &v )
   {
+  unpack();
   _points = v;
   _changedP = true;
   }
 
 void XGeometry::setLines( const XVector<unsigned int> &v )
   {
+  unpack();
   _lines = v;
   _changedL = true;
   }
 
 void XGeometry::setTriangles( const XVector<unsigned int> &v )
   {
+  unpack();
   _triangles = v;
   _changedT = true;
   }
 
-void XGeometry::setAttribute( const QString &n, const XVector<xReal> &v )
+template <typename T> void XGeometry::setAttributeInternal( XHash <QString, XVector<T> > &attrs,
+                                                           XHash <QString, DirtyRange> &changes,
+                                                           const QString &n,
+                                                           const XVector<T> &v )
   {
+  unpack();
   if( v.size() )
     {
-    _attr1[n] = v;
-    if( _attr1[n].size() != _attributeSize )
+    if( !attrs.contains( n ) )
       {
-      _attributeSize = _attr1[n].size();
+      // a new attribute changes the buffer layout
       _attributeSizeChanged = true;
       }
-    }
-  else
-    {
-    _attr1.remove(n);
-    }
-  _changedA1 << n;
-  _changedAttrs = true;
-  }
 
-void XGeometry::setAttribute( const QString &n, const XVector<XVector2D> &v )
-  {
-  if( v.size() )
-    {
-    _attr2[n] = v;
-    if( _attr2[n].size() != _attributeSize )
+    XVector<T> &attr = attrs[n];
+    attr = v;
+    if( attr.size() != _attributeSize )
       {
-      _attributeSize = _attr2[n].size();
+      _attributeSize = attr.size();
       _attributeSizeChanged = true;
       }
+    changes[n] = DirtyRange( 0, attr.size() - 1 );
     }
   else
     {
-    _attr1.remove(n);
+    if( attrs.remove(n) )
+      {
+      _attributeSizeChanged = true;
+      }
+    changes.remove(n);
     }
-  _changedA2 << n;
   _changedAttrs = true;
   }
 
-void XGeometry::setAttribute( const QString &n, const XVector<XVector3D> &v )
+template <typename T> void XGeometry::setAttributeRangeInternal( XHash <QString, XVector<T> > &attrs,
+                                                                XHash <QString, DirtyRange> &changes,
+                                                                const QString &n,
+                                                                int first,
+                                                                const XVector<T> &v )
   {
-  if( v.size() )
+  unpack();
+  typename XHash <QString, XVector<T> >::iterator it = attrs.find( n );
+  xAssert( it != attrs.end() );
+  if( it == attrs.end() || v.isEmpty() )
     {
-    _attr3[n] = v;
-    if( _attr3[n].size() != _attributeSize )
-      {
-      _attributeSize = _attr3[n].size();
-      _attributeSizeChanged = true;
-      }
+    return;
     }
-  else
+
+  XVector<T> &attr = it.value();
+  xAssert( first >= 0 && ( first + v.size() ) <= attr.size() );
+
+  T *data = attr.data() + first;
+  const T *src = v.constData();
+  for( int i=0, s=v.size(); i<s; ++i )
     {
-    _attr1.remove(n);
+    data[i] = src[i];
     }
-  _changedA3 << n;
+
+  changes[n].unite( first, first + v.size() - 1 );
   _changedAttrs = true;
   }
 
+void XGeometry::setAttribute( const QString &n, const XVector<xReal> &v )
+  {
+  setAttributeInternal( _attr1, _changedA1, n, v );
+  }
+
+void XGeometry::setAttribute( const QString &n, const XVector<XVector2D> &v )
+  {
+  setAttributeInternal( _attr2, _changedA2, n, v );
+  }
+
+void XGeometry::setAttribute( const QString &n, const XVector<XVector3D> &v )
+  {
+  setAttributeInternal( _attr3, _changedA3, n, v );
+  }
+
 void XGeometry::setAttribute( const QString &n, const XVector<XVector4D> &v )
   {
-  if( v.size() )
-    {
-    _attr4[n] = v;
-    if( _attr4[n].size() != _attributeSize )
-      {
-      _attributeSize = _attr4[n].size();
-      _attributeSizeChanged = true;
-      }
-    }
-  else
-    {
-    _attr1.remove(n);
-    }
-  _changedA4 << n;
-  _changedAttrs = true;
+  setAttributeInternal( _attr4, _changedA4, n, v );
+  }
+
+void XGeometry::setAttributeRange( const QString &n, int first, const XVector<xReal> &v )
+  {
+  setAttributeRangeInternal( _attr1, _changedA1, n, first, v );
+  }
+
+void XGeometry::setAttributeRange( const QString &n, int first, const XVector<XVector2D> &v )
+  {
+  setAttributeRangeInternal( _attr2, _changedA2, n, first, v );
+  }
+
+void XGeometry::setAttributeRange( const QString &n, int first, const XVector<XVector3D> &v )
+  {
+  setAttributeRangeInternal( _attr3, _changedA3, n, first, v );
+  }
+
+void XGeometry::setAttributeRange( const QString &n, int first, const XVector<XVector4D> &v )
+  {
+  setAttributeRangeInternal( _attr4, _changedA4, n, first, v );
   }
 
 void XGeometry::removeAttribute( const QString &in )
   {
+  unpack();
   if( _attr1.contains(in) )
     {
     _attr1.remove( in );
-    _changedA1 << in;
+    _changedA1.remove( in );
     _attributeSizeChanged = true;
     _changedAttrs = true;
     }
   if( _attr2.contains(in) )
     {
     _attr2.remove( in );
-    _changedA2 << in;
+    _changedA2.remove( in );
     _attributeSizeChanged = true;
     _changedAttrs = true;
     }
   if( _attr3.contains(in) )
     {
     _attr3.remove( in );
-    _changedA3 << in;
+    _changedA3.remove( in );
     _attributeSizeChanged = true;
     _changedAttrs = true;
     }
   if( _attr4.contains(in) )
     {
     _attr4.remove( in );
-    _changedA4 << in;
+    _changedA4.remove( in );
     _attributeSizeChanged = true;
     _changedAttrs = true;
     }
   }
 
+XGeometry::BufferType XGeometry::bufferType() const
+  {
+  return _type;
+  }
+
+XGeometry::VertexLayout XGeometry::vertexLayout() const
+  {
+  return _layout;
+  }
+
+const XMeshContainer &XGeometry::meshContainer() const
+  {
+  return _container;
+  }
+
+void XGeometry::unpack() const
+  {
+  if( !_container.isValid() )
+    {
+    return;
+    }
+
+  // unpacking doesn't change the geometry, the uploaded data is still correct.
+  XGeometry *self = const_cast<XGeometry *>( this );
+  XMeshContainer container = _container;
+  _container = XMeshContainer();
+
+  xuint32 count = container.vertexCount();
+  self->_attributeSize = count;
+  for( xuint32 i=0; i<container.attributeCount(); ++i )
+    {
+    const XMeshContainer::AttributeDescriptor &desc = container.attribute( i );
+    QString name = QString::fromUtf8( desc.name );
+    if( desc.components == 1 )
+      {
+      XVector<xReal> &attr = self->_attr1[name];
+      attr.resize( count );
+      container.decodeAttribute( i, attr.data() );
+      }
+    else if( desc.components == 2 )
+      {
+      XVector<XVector2D> &attr = self->_attr2[name];
+      attr.resize( count );
+      container.decodeAttribute( i, reinterpret_cast<float *>( attr.data() ) );
+      }
+    else if( desc.components == 3 )
+      {
+      XVector<XVector3D> &attr = self->_attr3[name];
+      attr.resize( count );
+      container.decodeAttribute( i, reinterpret_cast<float *>( attr.data() ) );
+      }
+    else
+      {
+      XVector<XVector4D> &attr = self->_attr4[name];
+      attr.resize( count );
+      container.decodeAttribute( i, reinterpret_cast<float *>( attr.data() ) );
+      }
+    }
+
+  XVector<unsigned int> *indices[XMeshContainer::IndexTypeCount] = { &self->_points, &self->_lines, &self->_triangles };
+  for( int i=0; i<XMeshContainer::IndexTypeCount; ++i )
+    {
+    XMeshContainer::IndexType type = (XMeshContainer::IndexType)i;
+    indices[i]->resize( container.indexCount( type ) );
+    memcpy( indices[i]->data(), container.indices( type ), container.indexCount( type ) * sizeof(unsigned int) );
+    }
+  }
+
 XCuboid XGeometry::computeBounds() const
   {
+  unpack();
   const XVector<XVector3D> &vtxList = _attr3["XVector"];
 
   XCuboid ret;
@@ -272,36 +482,61 @@ void XGeometry::setTriangles( const XList<unsigned int> &in )
   setTriangles( in.toVector() );
   }
 
-void XGeometry::prepareInternal( XRenderer *r ) const
+template <typename T> void XGeometry::uploadAttributes( const XHash <QString, XVector<T> > &attrs,
+                                                       XHash <QString, DirtyRange> &changes ) const
   {
-  xAssert(_renderer == 0 || r == _renderer);
-  _renderer = r;
-  if( !_internal )
+  typename XHash <QString, DirtyRange>::const_iterator it = changes.begin();
+  typename XHash <QString, DirtyRange>::const_iterator end = changes.end();
+  for( ; it != end; ++it )
     {
-    _internal = _renderer->getGeometry( _type );
-    _internal->setPoints( _points );
-    _internal->setLines( _lines );
-    _internal->setTriangles( _triangles );
-
-    _internal->setAttributesSize( _attributeSize, _attr1.size(), _attr2.size(), _attr3.size(), _attr4.size() );
-
-    foreach( QString na, _attr1.keys() )
-      {
-      _internal->setAttribute( na, _attr1[na] );
-      }
-    foreach( QString na, _attr2.keys() )
+    typename XHash <QString, XVector<T> >::const_iterator attr = attrs.find( it.key() );
+    const DirtyRange &range = it.value();
+    if( attr == attrs.end() || range.count() <= 0 )
       {
-      _internal->setAttribute( na, _attr2[na] );
+      continue;
       }
-    foreach( QString na, _attr3.keys() )
+
+    const XVector<T> &data = attr.value();
+    if( range.first == 0 && range.count() >= data.size() )
       {
-      _internal->setAttribute( na, _attr3[na] );
+      _internal->setAttribute( it.key(), data );
       }
-    foreach( QString na, _attr4.keys() )
+    else
       {
-      _internal->setAttribute( na, _attr4[na] );
+      _internal->setAttributeRange( it.key(), data, range.first, range.count() );
       }
     }
+  changes.clear();
+  }
+
+void XGeometry::clearChanges() const
+  {
+  _changedA1.clear();
+  _changedA2.clear();
+  _changedA3.clear();
+  _changedA4.clear();
+  _changedAttrs = false;
+  }
+
+void XGeometry::prepareInternal( XRenderer *r ) const
+  {
+  xAssert(_renderer == 0 || r == _renderer);
+  _renderer = r;
+  if( !_internal )
+    {
+    _internal = _renderer->getGeometry( _type, _layout );
+    _changedP = true;
+    _changedL = true;
+    _changedT = true;
+    _attributeSizeChanged = true;
+    _changedAttrs = true;
+    }
+
+  if( _container.isValid() )
+    {
+    prepareContainer();
+    return;
+    }
 
   if( _changedP )
     {
@@ -325,57 +560,73 @@ void XGeometry::prepareInternal( XRenderer *r ) const
       {
       _internal->setAttributesSize( _attributeSize, _attr1.size(), _attr2.size(), _attr3.size(), _attr4.size() );
 
-      foreach( QString na, _attr1.keys() )
+      for( XHash <QString, XVector<xReal> >::const_iterator it = _attr1.begin(); it != _attr1.end(); ++it )
         {
-        _internal->setAttribute( na, _attr1[na] );
+        _internal->setAttribute( it.key(), it.value() );
         }
-      foreach( QString na, _attr2.keys() )
+      for( XHash <QString, XVector<XVector2D> >::const_iterator it = _attr2.begin(); it != _attr2.end(); ++it )
         {
-        _internal->setAttribute( na, _attr2[na] );
+        _internal->setAttribute( it.key(), it.value() );
         }
-      foreach( QString na, _attr3.keys() )
+      for( XHash <QString, XVector<XVector3D> >::const_iterator it = _attr3.begin(); it != _attr3.end(); ++it )
         {
-        _internal->setAttribute( na, _attr3[na] );
+        _internal->setAttribute( it.key(), it.value() );
         }
-      foreach( QString na, _attr4.keys() )
+      for( XHash <QString, XVector<XVector4D> >::const_iterator it = _attr4.begin(); it != _attr4.end(); ++it )
         {
-        _internal->setAttribute( na, _attr4[na] );
+        _internal->setAttribute( it.key(), it.value() );
         }
       _attributeSizeChanged = false;
       }
     else
       {
-      foreach( QString na, _changedA1 )
-        {
-        if( _attr1.contains( na ) )
-          {
-          _internal->setAttribute( na, _attr1[na] );
-          }
-        }
-      foreach( QString na, _changedA2 )
-        {
-        if( _attr2.contains( na ) )
-          {
-          _internal->setAttribute( na, _attr2[na] );
-          }
-        }
-      foreach( QString na, _changedA3 )
-        {
-        if( _attr3.contains( na ) )
-          {
-          _internal->setAttribute( na, _attr3[na] );
-          }
-        }
-      foreach( QString na, _changedA4 )
-        {
-        if( _attr4.contains( na ) )
-          {
-          _internal->setAttribute( na, _attr4[na] );
-          }
-        }
+      uploadAttributes( _attr1, _changedA1 );
+      uploadAttributes( _attr2, _changedA2 );
+      uploadAttributes( _attr3, _changedA3 );
+      uploadAttributes( _attr4, _changedA4 );
+      }
+    clearChanges();
+    }
+  }
+
+void XGeometry::prepareContainer() const
+  {
+  if( !_changedP && !_changedL && !_changedT && !_changedAttrs )
+    {
+    return;
+    }
+
+  // indices and float attributes are uploaded straight from the container, quantised attributes are decoded first.
+  _internal->setPoints( _container.indices( XMeshContainer::Points ), _container.indexCount( XMeshContainer::Points ) );
+  _internal->setLines( _container.indices( XMeshContainer::Lines ), _container.indexCount( XMeshContainer::Lines ) );
+  _internal->setTriangles( _container.indices( XMeshContainer::Triangles ), _container.indexCount( XMeshContainer::Triangles ) );
+
+  int count[4] = { 0, 0, 0, 0 };
+  for( xuint32 i=0; i<_container.attributeCount(); ++i )
+    {
+    ++count[_container.attribute( i ).components - 1];
+    }
+  _internal->setAttributesSize( _container.vertexCount(), count[0], count[1], count[2], count[3] );
+
+  XVector<float> decoded;
+  for( xuint32 i=0; i<_container.attributeCount(); ++i )
+    {
+    const XMeshContainer::AttributeDescriptor &desc = _container.attribute( i );
+    const float *data = reinterpret_cast<const float *>( _container.attributeData( i ) );
+    if( desc.encoding != XMeshContainer::Float32 )
+      {
+      decoded.resize( _container.vertexCount() * desc.components );
+      _container.decodeAttribute( i, decoded.data() );
+      data = decoded.constData();
       }
-    _changedAttrs = 0;
+    _internal->setAttribute( QString::fromUtf8( desc.name ), data, desc.components, _container.vertexCount() );
     }
+
+  _changedP = false;
+  _changedL = false;
+  _changedT = false;
+  _attributeSizeChanged = false;
+  clearChanges();
   }
 
 XAbstractGeometry *XGeometry::internal() const
@@ -385,6 +636,7 @@ XAbstractGeometry *XGeometry::internal() const
 
 QDataStream EKS3D_EXPORT &operator<<( QDataStream &s, const XGeometry &geo )
   {
+  geo.unpack();
   return s << geo._attr1 << geo._attr2 << geo._attr3 << geo._attr4 << geo._points << geo._lines << geo._triangles;
   }
 
@@ -401,6 +653,8 @@ QDataStream EKS3D_EXPORT &operator>>( QDataStream &s, XGeometry &geo )
   geo._changedL = true;
   geo._changedT = true;
   geo._attributeSizeChanged = true;
+  geo._changedAttrs = true;
+  geo._container = XMeshContainer();
 
   s >> geo._attr1 >> geo._attr2 >> geo._attr3 >> geo._attr4 >> geo._points >> geo._lines >> geo._triangles;
 
@@ -0,0 +1,447 @@
+#include "XMeshContainer.h"
+#include "XGeometry.h"
+#include "QFile"
+#include "QStringList"
+#include "QDebug"
+#include "math.h"
+#include "string.h"
+
+namespace
+{
+xuint32 alignSize( xuint32 size )
+  {
+  return ( size + XMeshContainer::Alignment - 1 ) & ~( XMeshContainer::Alignment - 1 );
+  }
+
+// 64 bit, so a vertex count read from a container can't wrap it to a size that looks valid.
+xuint64 encodedSize( xuint32 encoding, xuint32 components, xuint32 count )
+  {
+  if( encoding == XMeshContainer::UNorm16 )
+    {
+    return (xuint64)count * components * sizeof(xuint16);
+    }
+  else if( encoding == XMeshContainer::Octahedral16 )
+    {
+    return (xuint64)count * 2 * sizeof(xint16);
+    }
+  return (xuint64)count * components * sizeof(float);
+  }
+
+// the checksum of the whole container, including the header with its checksum field zeroed.
+xuint32 containerChecksum( const char *base, xuint32 headerSize, xuint32 totalSize )
+  {
+  QByteArray header( base, headerSize );
+  reinterpret_cast<XMeshContainer::Header *>( header.data() )->checksum = 0;
+
+  xuint32 sum = XMeshContainer::checksum( header.constData(), headerSize );
+  return XMeshContainer::checksum( base + headerSize, totalSize - headerSize, sum );
+  }
+
+inline float signNotZero( float f )
+  {
+  return f >= 0.0f ? 1.0f : -1.0f;
+  }
+
+inline xint16 toSNorm16( float f )
+  {
+  f = xMin( xMax( f, -1.0f ), 1.0f );
+  return (xint16)floorf( ( f * 32767.0f ) + 0.5f );
+  }
+
+void encodeOctahedral( const XVector3D &n, xint16 *out )
+  {
+  float length = fabsf( n.x() ) + fabsf( n.y() ) + fabsf( n.z() );
+  float x = length > 0.0f ? n.x() / length : 0.0f;
+  float y = length > 0.0f ? n.y() / length : 0.0f;
+  if( n.z() < 0.0f )
+    {
+    // fold the lower hemisphere over the diagonals
+    float foldedX = ( 1.0f - fabsf( y ) ) * signNotZero( x );
+    y = ( 1.0f - fabsf( x ) ) * signNotZero( y );
+    x = foldedX;
+    }
+  out[0] = toSNorm16( x );
+  out[1] = toSNorm16( y );
+  }
+
+void decodeOctahedral( const xint16 *in, float *out )
+  {
+  float x = xMax( in[0] / 32767.0f, -1.0f );
+  float y = xMax( in[1] / 32767.0f, -1.0f );
+  float z = 1.0f - fabsf( x ) - fabsf( y );
+  if( z < 0.0f )
+    {
+    float unfoldedX = ( 1.0f - fabsf( y ) ) * signNotZero( x );
+    y = ( 1.0f - fabsf( x ) ) * signNotZero( y );
+    x = unfoldedX;
+    }
+
+  float length = sqrtf( x*x + y*y + z*z );
+  float invLength = length > 0.0f ? 1.0f / length : 0.0f;
+  out[0] = x * invLength;
+  out[1] = y * invLength;
+  out[2] = z * invLength;
+  }
+
+struct PendingAttribute
+  {
+  QString name;
+  xuint32 components;
+  xuint32 encoding;
+  const float *data;
+  };
+
+template <typename T> void collectAttributes( const XHash <QString, XVector<T> > &attrs, xuint32 components, XVector<PendingAttribute> &out )
+  {
+  QStringList names = attrs.keys();
+  names.sort();
+  foreach( const QString &name, names )
+    {
+    PendingAttribute attr;
+    attr.name = name;
+    attr.components = components;
+    attr.encoding = XMeshContainer::Float32;
+    attr.data = reinterpret_cast<const float *>( attrs.find( name ).value().constData() );
+    out << attr;
+    }
+  }
+
+void writeAttribute( const PendingAttribute &attr, xuint32 count, XMeshContainer::AttributeDescriptor &desc, char *block )
+  {
+  xuint32 components = attr.components;
+  const float *src = attr.data;
+
+  if( attr.encoding == XMeshContainer::Float32 )
+    {
+    memcpy( block, src, count * components * sizeof(float) );
+    }
+  else if( attr.encoding == XMeshContainer::UNorm16 )
+    {
+    float minimum[4] = { 0, 0, 0, 0 };
+    float maximum[4] = { 0, 0, 0, 0 };
+    for( xuint32 c=0; c<components && count; ++c )
+      {
+      minimum[c] = maximum[c] = src[c];
+      }
+    for( xuint32 i=0; i<count; ++i )
+      {
+      for( xuint32 c=0; c<components; ++c )
+        {
+        minimum[c] = xMin( minimum[c], src[i*components+c] );
+        maximum[c] = xMax( maximum[c], src[i*components+c] );
+        }
+      }
+
+    float invScale[4] = { 0, 0, 0, 0 };
+    for( xuint32 c=0; c<components; ++c )
+      {
+      float range = maximum[c] - minimum[c];
+      desc.decodeOffset[c] = minimum[c];
+      desc.decodeScale[c] = range / 65535.0f;
+      invScale[c] = range > 0.0f ? 65535.0f / range : 0.0f;
+      }
+
+    xuint16 *dest = reinterpret_cast<xuint16 *>( block );
+    for( xuint32 i=0; i<count*components; ++i )
+      {
+      xuint32 c = i % components;
+      *dest++ = (xuint16)xMin( floorf( ( ( src[i] - minimum[c] ) * invScale[c] ) + 0.5f ), 65535.0f );
+      }
+    }
+  else if( attr.encoding == XMeshContainer::Octahedral16 )
+    {
+    xAssert( components == 3 );
+    xint16 *dest = reinterpret_cast<xint16 *>( block );
+    for( xuint32 i=0; i<count; ++i, dest += 2 )
+      {
+      encodeOctahedral( XVector3D( src[i*3], src[i*3+1], src[i*3+2] ), dest );
+      }
+    }
+  }
+}
+
+XMeshContainer::XMeshContainer() : _header( 0 )
+  {
+  }
+
+XMeshContainer XMeshContainer::create( const XGeometry &geo, int quantisation, const QString &positionSemantic, const QString &normalSemantic )
+  {
+  XVector<PendingAttribute> attrs;
+  collectAttributes( geo.attributes1D(), 1, attrs );
+  collectAttributes( geo.attributes2D(), 2, attrs );
+  collectAttributes( geo.attributes3D(), 3, attrs );
+  collectAttributes( geo.attributes4D(), 4, attrs );
+
+  xuint32 vertexCount = 0;
+  for( int i=0; i<attrs.size(); ++i )
+    {
+    PendingAttribute &attr = attrs[i];
+    if( attr.components == 3 && ( quantisation & QuantisePositions ) && attr.name == positionSemantic )
+      {
+      attr.encoding = UNorm16;
+      }
+    else if( attr.components == 3 && ( quantisation & QuantiseNormals ) && attr.name == normalSemantic )
+      {
+      attr.encoding = Octahedral16;
+      }
+    }
+
+  const XVector<unsigned int> *indices[IndexTypeCount] = { &geo.points(), &geo.lines(), &geo.triangles() };
+
+  if( attrs.size() )
+    {
+    const XHash <QString, XVector<xReal> > &a1 = geo.attributes1D();
+    const XHash <QString, XVector<XVector2D> > &a2 = geo.attributes2D();
+    const XHash <QString, XVector<XVector3D> > &a3 = geo.attributes3D();
+    const XHash <QString, XVector<XVector4D> > &a4 = geo.attributes4D();
+    vertexCount = a1.size() ? a1.begin()->size() : ( a2.size() ? a2.begin()->size() : ( a3.size() ? a3.begin()->size() : a4.begin()->size() ) );
+    }
+
+  // lay out the blocks
+  xuint32 headerSize = alignSize( sizeof(Header) );
+  xuint32 size = headerSize + ( attrs.size() * alignSize( sizeof(AttributeDescriptor) ) );
+
+  XVector<xuint32> attributeOffsets( attrs.size() );
+  for( int i=0; i<attrs.size(); ++i )
+    {
+    attributeOffsets[i] = size;
+    size += alignSize( (xuint32)encodedSize( attrs[i].encoding, attrs[i].components, vertexCount ) );
+    }
+
+  xuint32 indexOffsets[IndexTypeCount];
+  for( int i=0; i<IndexTypeCount; ++i )
+    {
+    indexOffsets[i] = size;
+    size += alignSize( indices[i]->size() * sizeof(xuint32) );
+    }
+
+  QByteArray data( size, '\0' );
+  char *base = data.data();
+
+  Header *header = reinterpret_cast<Header *>( base );
+  header->magic = Magic;
+  header->version = Version;
+  header->headerSize = headerSize;
+  header->totalSize = size;
+  header->vertexCount = vertexCount;
+  header->attributeCount = attrs.size();
+  for( int i=0; i<IndexTypeCount; ++i )
+    {
+    header->indexCount[i] = indices[i]->size();
+    header->indexOffset[i] = indexOffsets[i];
+    memcpy( base + indexOffsets[i], indices[i]->constData(), indices[i]->size() * sizeof(xuint32) );
+    }
+
+  AttributeDescriptor *descriptors = reinterpret_cast<AttributeDescriptor *>( base + headerSize );
+  for( int i=0; i<attrs.size(); ++i )
+    {
+    const PendingAttribute &attr = attrs[i];
+    AttributeDescriptor &desc = descriptors[i];
+
+    QByteArray name = attr.name.toUtf8();
+    xAssert( name.size() <= MaxNameLength );
+    memcpy( desc.name, name.constData(), xMin( name.size(), (int)MaxNameLength ) );
+
+    desc.components = attr.components;
+    desc.encoding = attr.encoding;
+    desc.offset = attributeOffsets[i];
+    desc.size = (xuint32)encodedSize( attr.encoding, attr.components, vertexCount );
+    for( int c=0; c<4; ++c )
+      {
+      desc.decodeOffset[c] = 0.0f;
+      desc.decodeScale[c] = 1.0f;
+      }
+
+    writeAttribute( attr, vertexCount, desc, base + desc.offset );
+    }
+
+  header->checksum = containerChecksum( base, headerSize, size );
+
+  XMeshContainer ret;
+  ret._data = data;
+  ret._header = header;
+  return ret;
+  }
+
+bool XMeshContainer::setData( const QByteArray &data, bool verifyChecksum )
+  {
+  _file.clear();
+  _data = data;
+  return validate( verifyChecksum );
+  }
+
+bool XMeshContainer::map( const QString &file, bool verifyChecksum )
+  {
+  _data.clear();
+  _file = QSharedPointer<QFile>( new QFile( file ) );
+  if( !_file->open( QFile::ReadOnly ) )
+    {
+    _file.clear();
+    _header = 0;
+    return false;
+    }
+
+  uchar *mem = _file->map( 0, _file->size() );
+  if( mem )
+    {
+    _data = QByteArray::fromRawData( reinterpret_cast<const char *>( mem ), _file->size() );
+    }
+  else
+    {
+    // no mapping available, fall back to reading it in.
+    _data = _file->readAll();
+    _file.clear();
+    }
+
+  return validate( verifyChecksum );
+  }
+
+bool XMeshContainer::validate( bool verifyChecksum )
+  {
+  _header = 0;
+
+  // the blocks are read in place, so need at least float alignment.
+  if( ( reinterpret_cast<quintptr>( _data.constData() ) % sizeof(float) ) != 0 )
+    {
+    _data = QByteArray( _data.constData(), _data.size() );
+    }
+
+  const char *base = _data.constData();
+  xuint32 size = _data.size();
+  const Header *header = reinterpret_cast<const Header *>( base );
+  if( size < sizeof(Header) || header->magic != Magic || header->version != Version )
+    {
+    qWarning() << "Invalid mesh container header";
+    return false;
+    }
+
+  // in 64 bits, so a large attribute count can't wrap the descriptors' size to something which fits.
+  if( header->totalSize > size || header->headerSize < sizeof(Header) ||
+      header->headerSize + ( (xuint64)header->attributeCount * alignSize( sizeof(AttributeDescriptor) ) ) > header->totalSize )
+    {
+    qWarning() << "Truncated mesh container";
+    return false;
+    }
+
+  const AttributeDescriptor *descriptors = reinterpret_cast<const AttributeDescriptor *>( base + header->headerSize );
+  for( xuint32 i=0; i<header->attributeCount; ++i )
+    {
+    const AttributeDescriptor &desc = descriptors[i];
+    if( desc.name[MaxNameLength] != '\0' || desc.components < 1 || desc.components > 4 || desc.encoding > Octahedral16 ||
+        desc.size != encodedSize( desc.encoding, desc.components, header->vertexCount ) ||
+        (xuint64)desc.offset + desc.size > header->totalSize || ( desc.offset % Alignment ) != 0 )
+      {
+      qWarning() << "Invalid mesh container attribute" << i;
+      return false;
+      }
+    }
+
+  for( int i=0; i<IndexTypeCount; ++i )
+    {
+    if( (xuint64)header->indexOffset[i] + ( (xuint64)header->indexCount[i] * sizeof(xuint32) ) > header->totalSize ||
+        ( header->indexOffset[i] % Alignment ) != 0 )
+      {
+      qWarning() << "Invalid mesh container indices";
+      return false;
+      }
+    }
+
+  if( verifyChecksum && containerChecksum( base, header->headerSize, header->totalSize ) != header->checksum )
+    {
+    qWarning() << "Mesh container checksum mismatch";
+    return false;
+    }
+
+  _header = header;
+  return true;
+  }
+
+xuint32 XMeshContainer::vertexCount() const
+  {
+  return _header ? _header->vertexCount : 0;
+  }
+
+xuint32 XMeshContainer::attributeCount() const
+  {
+  return _header ? _header->attributeCount : 0;
+  }
+
+const XMeshContainer::AttributeDescriptor &XMeshContainer::attribute( xuint32 i ) const
+  {
+  xAssert( _header && i < _header->attributeCount );
+  const char *base = _data.constData() + _header->headerSize;
+  return reinterpret_cast<const AttributeDescriptor *>( base )[i];
+  }
+
+const void *XMeshContainer::attributeData( xuint32 i ) const
+  {
+  return _data.constData() + attribute( i ).offset;
+  }
+
+void XMeshContainer::decodeAttribute( xuint32 i, float *out ) const
+  {
+  const AttributeDescriptor &desc = attribute( i );
+  xuint32 count = _header->vertexCount;
+  xuint32 components = desc.components;
+  const void *data = attributeData( i );
+
+  if( desc.encoding == Float32 )
+    {
+    memcpy( out, data, count * components * sizeof(float) );
+    }
+  else if( desc.encoding == UNorm16 )
+    {
+    const xuint16 *src = reinterpret_cast<const xuint16 *>( data );
+    for( xuint32 v=0; v<count; ++v )
+      {
+      for( xuint32 c=0; c<components; ++c )
+        {
+        *out++ = desc.decodeOffset[c] + ( *src++ * desc.decodeScale[c] );
+        }
+      }
+    }
+  else if( desc.encoding == Octahedral16 )
+    {
+    const xint16 *src = reinterpret_cast<const xint16 *>( data );
+    for( xuint32 v=0; v<count; ++v, src += 2, out += 3 )
+      {
+      decodeOctahedral( src, out );
+      }
+    }
+  }
+
+xuint32 XMeshContainer::indexCount( IndexType t ) const
+  {
+  return _header ? _header->indexCount[t] : 0;
+  }
+
+const xuint32 *XMeshContainer::indices( IndexType t ) const
+  {
+  xAssert( _header );
+  return reinterpret_cast<const xuint32 *>( _data.constData() + _header->indexOffset[t] );
+  }
+
+xuint32 XMeshContainer::checksum( const char *data, xsize size, xuint32 running )
+  {
+  // Adler-32, summed in blocks small enough that the 32 bit sums can't overflow before the modulo.
+  const xuint32 modulus = 65521;
+  const xsize blockSize = 5552;
+
+  const uchar *p = reinterpret_cast<const uchar *>( data );
+  xuint32 a = running & 0xFFFF;
+  xuint32 b = running >> 16;
+  while( size )
+    {
+    xsize block = xMin( size, blockSize );
+    size -= block;
+    for( xsize i=0; i<block; ++i )
+      {
+      a += p[i];
+      b += a;
+      }
+    p += block;
+    a %= modulus;
+    b %= modulus;
+    }
+  return ( b << 16 ) | a;
+  }
@@ -0,0 +1,913 @@
+#include "XMeshOptimiser.h"
+#include "XHash"
+#include "cfloat"
+#include "algorithm"
+
+namespace
+{
+// a view of one attribute as a flat array of floats.
+struct AttributeStream
+  {
+  const xReal *data;
+  int components;
+  };
+
+template <typename T> void gatherStreams( const XHash <QString, XVector<T> > &attrs, int components, XVector<AttributeStream> &streams )
+  {
+  typename XHash <QString, XVector<T> >::const_iterator it = attrs.begin();
+  typename XHash <QString, XVector<T> >::const_iterator end = attrs.end();
+  for( ; it != end; ++it )
+    {
+    AttributeStream s;
+    s.data = reinterpret_cast<const xReal *>(it.value().constData());
+    s.components = components;
+    streams << s;
+    }
+  }
+
+XVector<AttributeStream> gatherStreams( const XGeometry &geo )
+  {
+  XVector<AttributeStream> streams;
+  gatherStreams( geo.attributes1D(), 1, streams );
+  gatherStreams( geo.attributes2D(), 2, streams );
+  gatherStreams( geo.attributes3D(), 3, streams );
+  gatherStreams( geo.attributes4D(), 4, streams );
+  return streams;
+  }
+
+int attributeCount( const XGeometry &geo )
+  {
+  // all attributes have the same size.
+  if( !geo.attributes3D().isEmpty() )
+    {
+    return geo.attributes3D().begin().value().size();
+    }
+  if( !geo.attributes2D().isEmpty() )
+    {
+    return geo.attributes2D().begin().value().size();
+    }
+  if( !geo.attributes1D().isEmpty() )
+    {
+    return geo.attributes1D().begin().value().size();
+    }
+  if( !geo.attributes4D().isEmpty() )
+    {
+    return geo.attributes4D().begin().value().size();
+    }
+  return 0;
+  }
+
+int maximumIndex( const XVector<unsigned int> &indices )
+  {
+  int max = -1;
+  foreach( unsigned int i, indices )
+    {
+    max = xMax( max, (int)i );
+    }
+  return max;
+  }
+
+int vertexCount( const XGeometry &geo )
+  {
+  int count = attributeCount( geo );
+  count = xMax( count, maximumIndex( geo.points() ) + 1 );
+  count = xMax( count, maximumIndex( geo.lines() ) + 1 );
+  count = xMax( count, maximumIndex( geo.triangles() ) + 1 );
+  return count;
+  }
+
+template <typename T> void remapAttributes( XGeometry *geo, XHash <QString, XVector<T> > attrs, const XVector<unsigned int> &newToOld )
+  {
+  // attrs is a copy, geo's hash changes as we set the remapped attributes.
+  typename XHash <QString, XVector<T> >::const_iterator it = attrs.begin();
+  typename XHash <QString, XVector<T> >::const_iterator end = attrs.end();
+  for( ; it != end; ++it )
+    {
+    const XVector<T> &src = it.value();
+    XVector<T> dst( newToOld.size() );
+    for( int i=0, s=newToOld.size(); i<s; ++i )
+      {
+      dst[i] = src[newToOld[i]];
+      }
+    geo->setAttribute( it.key(), dst );
+    }
+  }
+
+XVector<unsigned int> remapIndices( const XVector<unsigned int> &indices, const XVector<unsigned int> &oldToNew )
+  {
+  XVector<unsigned int> ret( indices.size() );
+  for( int i=0, s=indices.size(); i<s; ++i )
+    {
+    ret[i] = oldToNew[indices[i]];
+    }
+  return ret;
+  }
+
+void applyRemap( XGeometry *geo, const XVector<unsigned int> &oldToNew, const XVector<unsigned int> &newToOld )
+  {
+  remapAttributes( geo, geo->attributes1D(), newToOld );
+  remapAttributes( geo, geo->attributes2D(), newToOld );
+  remapAttributes( geo, geo->attributes3D(), newToOld );
+  remapAttributes( geo, geo->attributes4D(), newToOld );
+
+  geo->setPoints( remapIndices( geo->points(), oldToNew ) );
+  geo->setLines( remapIndices( geo->lines(), oldToNew ) );
+  geo->setTriangles( remapIndices( geo->triangles(), oldToNew ) );
+  }
+
+void assignFirstUse( const XVector<unsigned int> &indices, XVector<unsigned int> &oldToNew, XVector<unsigned int> &newToOld )
+  {
+  foreach( unsigned int i, indices )
+    {
+    if( oldToNew[i] == X_UINT32_SENTINEL )
+      {
+      oldToNew[i] = newToOld.size();
+      newToOld << i;
+      }
+    }
+  }
+
+// put vertices in first use order, optionally dropping vertices no primitive uses.
+void reorderVertices( XGeometry *geo, bool dropUnused )
+  {
+  int count = vertexCount( *geo );
+  XVector<unsigned int> oldToNew( count, X_UINT32_SENTINEL );
+  XVector<unsigned int> newToOld;
+  newToOld.reserve( count );
+
+  assignFirstUse( geo->triangles(), oldToNew, newToOld );
+  assignFirstUse( geo->lines(), oldToNew, newToOld );
+  assignFirstUse( geo->points(), oldToNew, newToOld );
+
+  if( !dropUnused )
+    {
+    for( int i=0; i<count; ++i )
+      {
+      if( oldToNew[i] == X_UINT32_SENTINEL )
+        {
+        oldToNew[i] = newToOld.size();
+        newToOld << i;
+        }
+      }
+    }
+
+  bool identity = newToOld.size() == count;
+  for( int i=0, s=newToOld.size(); identity && i<s; ++i )
+    {
+    identity = newToOld[i] == (unsigned int)i;
+    }
+
+  if( !identity )
+    {
+    applyRemap( geo, oldToNew, newToOld );
+    }
+  }
+
+struct CellKey
+  {
+  xint64 x;
+  xint64 y;
+  xint64 z;
+
+  bool operator==( const CellKey &k ) const { return x == k.x && y == k.y && z == k.z; }
+  };
+
+inline uint qHash( const CellKey &k )
+  {
+  return (uint)( ( k.x * 73856093 ) ^ ( k.y * 19349663 ) ^ ( k.z * 83492791 ) );
+  }
+
+bool attributesEqual( const XVector<AttributeStream> &streams, int a, int b, xReal tolerance )
+  {
+  foreach( const AttributeStream &s, streams )
+    {
+    const xReal *dA = s.data + ( a * s.components );
+    const xReal *dB = s.data + ( b * s.components );
+    for( int c=0; c<s.components; ++c )
+      {
+      if( fabs( dA[c] - dB[c] ) > tolerance )
+        {
+        return false;
+        }
+      }
+    }
+  return true;
+  }
+
+// Forsyth's vertex scoring, see "Linear-Speed Vertex Cache Optimisation", Tom Forsyth 2006.
+float vertexScore( int cachePosition, int remainingValence, int cacheSize )
+  {
+  if( remainingValence == 0 )
+    {
+    return -1.0f;
+    }
+
+  const float cacheDecayPower = 1.5f;
+  const float lastTriangleScore = 0.75f;
+  const float valenceBoostScale = 2.0f;
+  const float valenceBoostPower = 0.5f;
+
+  float score = 0.0f;
+  if( cachePosition >= 0 )
+    {
+    if( cachePosition < 3 )
+      {
+      // the vertices of the last triangle get a fixed score, so we dont favour strips of one winding.
+      score = lastTriangleScore;
+      }
+    else
+      {
+      const float scaler = 1.0f / ( cacheSize - 3 );
+      score = 1.0f - ( cachePosition - 3 ) * scaler;
+      score = pow( score, cacheDecayPower );
+      }
+    }
+
+  score += valenceBoostScale * pow( (float)remainingValence, -valenceBoostPower );
+  return score;
+  }
+
+// symmetric 4x4 quadric, normalised by the total plane weight when evaluated.
+struct Quadric
+  {
+  double a[10];
+  double weight;
+
+  Quadric()
+    {
+    memset( a, 0, sizeof(a) );
+    weight = 0.0;
+    }
+
+  void addPlane( const XVector3D &n, double d, double w )
+    {
+    double x = n.x(), y = n.y(), z = n.z();
+    a[0] += w*x*x; a[1] += w*x*y; a[2] += w*x*z; a[3] += w*x*d;
+    a[4] += w*y*y; a[5] += w*y*z; a[6] += w*y*d;
+    a[7] += w*z*z; a[8] += w*z*d;
+    a[9] += w*d*d;
+    weight += w;
+    }
+
+  Quadric &operator+=( const Quadric &q )
+    {
+    for( int i=0; i<10; ++i )
+      {
+      a[i] += q.a[i];
+      }
+    weight += q.weight;
+    return *this;
+    }
+
+  double evaluate( const XVector3D &p ) const
+    {
+    double x = p.x(), y = p.y(), z = p.z();
+    double e = a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+             + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+             + a[7]*z*z + 2*a[8]*z
+             + a[9];
+    if( weight > 0.0 )
+      {
+      e /= weight;
+      }
+    return xMax( e, 0.0 );
+    }
+  };
+
+struct Collapse
+  {
+  double cost;
+  int from;
+  int to;
+  xuint32 fromVersion;
+  xuint32 toVersion;
+
+  // inverted so the std heap functions produce a min-heap
+  bool operator<( const Collapse &c ) const { return cost > c.cost; }
+  };
+
+// collapse towards whichever end point has the lower error, so attributes never need interpolating.
+void pushCollapse( XVector<Collapse> &heap,
+                   const XVector<Quadric> &quadrics,
+                   const XVector<XVector3D> &positions,
+                   const XVector<xuint32> &versions,
+                   int u,
+                   int v )
+  {
+  Quadric q( quadrics[u] );
+  q += quadrics[v];
+  double toV = q.evaluate( positions[v] );
+  double toU = q.evaluate( positions[u] );
+
+  Collapse c;
+  c.from = toV <= toU ? u : v;
+  c.to = toV <= toU ? v : u;
+  c.cost = xMin( toV, toU );
+  c.fromVersion = versions[c.from];
+  c.toVersion = versions[c.to];
+
+  heap << c;
+  std::push_heap( heap.begin(), heap.end() );
+  }
+
+quint64 edgeKey( unsigned int a, unsigned int b )
+  {
+  if( a > b )
+    {
+    std::swap( a, b );
+    }
+  return ( (quint64)a << 32 ) | b;
+  }
+
+XVector3D triangleNormal( const XVector3D &a, const XVector3D &b, const XVector3D &c )
+  {
+  return ( b - a ).cross( c - a );
+  }
+}
+
+namespace XMeshOptimiser
+{
+void weldVertices( XGeometry *geo, xReal tolerance, const QString &semantic )
+  {
+  xAssert( geo );
+  if( !geo->attributes3D().contains( semantic ) )
+    {
+    return;
+    }
+
+  const XVector<XVector3D> &positions = geo->attributes3D()[semantic];
+  int count = positions.size();
+  if( count == 0 )
+    {
+    return;
+    }
+
+  XVector<AttributeStream> streams = gatherStreams( *geo );
+
+  // vertices within tolerance are at most one cell apart, so each search checks the 27 surrounding cells.
+  const xReal invCellSize = 1.0f / xMax( tolerance, FLT_EPSILON );
+  XHash <CellKey, int> cells;
+  cells.reserve( count );
+  XVector<int> nextInCell( count, -1 );
+
+  XVector<unsigned int> oldToNew( count );
+  XVector<unsigned int> newToOld;
+  newToOld.reserve( count );
+
+  for( int v=0; v<count; ++v )
+    {
+    const XVector3D &p = positions[v];
+    CellKey key = { (xint64)floor( p.x() * invCellSize ),
+                    (xint64)floor( p.y() * invCellSize ),
+                    (xint64)floor( p.z() * invCellSize ) };
+
+    int match = -1;
+    for( int i=0; i<27 && match == -1; ++i )
+      {
+      CellKey search = { key.x + ( i % 3 ) - 1, key.y + ( ( i / 3 ) % 3 ) - 1, key.z + ( i / 9 ) - 1 };
+      XHash <CellKey, int>::const_iterator cell = cells.find( search );
+      if( cell == cells.end() )
+        {
+        continue;
+        }
+
+      for( int u = cell.value(); u != -1; u = nextInCell[u] )
+        {
+        if( attributesEqual( streams, u, v, tolerance ) )
+          {
+          match = u;
+          break;
+          }
+        }
+      }
+
+    if( match != -1 )
+      {
+      oldToNew[v] = oldToNew[match];
+      }
+    else
+      {
+      oldToNew[v] = newToOld.size();
+      newToOld << v;
+
+      XHash <CellKey, int>::iterator cell = cells.find( key );
+      if( cell == cells.end() )
+        {
+        cells.insert( key, v );
+        }
+      else
+        {
+        nextInCell[v] = cell.value();
+        cell.value() = v;
+        }
+      }
+    }
+
+  if( newToOld.size() == count )
+    {
+    return;
+    }
+
+  applyRemap( geo, oldToNew, newToOld );
+
+  // welding can collapse small triangles, remove them.
+  const XVector<unsigned int> &tris = geo->triangles();
+  XVector<unsigned int> cleanTris;
+  cleanTris.reserve( tris.size() );
+  for( int i=0, s=tris.size(); i<s; i+=3 )
+    {
+    if( tris[i] != tris[i+1] && tris[i] != tris[i+2] && tris[i+1] != tris[i+2] )
+      {
+      cleanTris << tris[i] << tris[i+1] << tris[i+2];
+      }
+    }
+  if( cleanTris.size() != tris.size() )
+    {
+    geo->setTriangles( cleanTris );
+    }
+  }
+
+void optimiseVertexCache( XGeometry *geo, xuint32 cacheSize )
+  {
+  xAssert( geo );
+  xAssert( cacheSize > 3 );
+  const XVector<unsigned int> &tris = geo->triangles();
+  int triangleCount = tris.size() / 3;
+  if( triangleCount < 2 )
+    {
+    return;
+    }
+
+  int count = maximumIndex( tris ) + 1;
+
+  // triangle adjacency for each vertex, the live triangles for v are
+  // adjacency[offsets[v]] to adjacency[offsets[v] + remaining[v]]
+  XVector<int> remaining( count, 0 );
+  foreach( unsigned int i, tris )
+    {
+    remaining[i]++;
+    }
+
+  XVector<int> offsets( count + 1, 0 );
+  for( int v=0; v<count; ++v )
+    {
+    offsets[v+1] = offsets[v] + remaining[v];
+    }
+
+  XVector<int> adjacency( tris.size() );
+  XVector<int> filled( count, 0 );
+  for( int t=0; t<triangleCount; ++t )
+    {
+    for( int c=0; c<3; ++c )
+      {
+      unsigned int v = tris[t*3+c];
+      adjacency[offsets[v] + filled[v]++] = t;
+      }
+    }
+
+  XVector<int> cachePosition( count, -1 );
+  XVector<float> score( count );
+  for( int v=0; v<count; ++v )
+    {
+    score[v] = vertexScore( -1, remaining[v], cacheSize );
+    }
+
+  XVector<float> triangleScore( triangleCount );
+  XVector<char> added( triangleCount, false );
+  int best = 0;
+  for( int t=0; t<triangleCount; ++t )
+    {
+    triangleScore[t] = score[tris[t*3]] + score[tris[t*3+1]] + score[tris[t*3+2]];
+    if( triangleScore[t] > triangleScore[best] )
+      {
+      best = t;
+      }
+    }
+
+  // cache entries past cacheSize are kept so their scores can be reset once they fall out.
+  XVector<int> cache;
+  XVector<int> newCache;
+  cache.reserve( cacheSize + 3 );
+  newCache.reserve( cacheSize + 3 );
+
+  XVector<unsigned int> output;
+  output.reserve( tris.size() );
+
+  int scanPosition = 0;
+  for( int emitted=0; emitted<triangleCount; ++emitted )
+    {
+    if( best < 0 )
+      {
+      // nothing adjacent to the cache, take the next unused triangle.
+      while( added[scanPosition] )
+        {
+        ++scanPosition;
+        }
+      best = scanPosition;
+      }
+
+    added[best] = true;
+    newCache.clear();
+    for( int c=0; c<3; ++c )
+      {
+      unsigned int v = tris[best*3+c];
+      output << v;
+      newCache << v;
+
+      // remove the triangle from v's live adjacency
+      int *adj = adjacency.data() + offsets[v];
+      int last = remaining[v] - 1;
+      for( int i=0; i<=last; ++i )
+        {
+        if( adj[i] == best )
+          {
+          std::swap( adj[i], adj[last] );
+          break;
+          }
+        }
+      remaining[v]--;
+      }
+
+    foreach( int v, cache )
+      {
+      if( v != (int)tris[best*3] && v != (int)tris[best*3+1] && v != (int)tris[best*3+2] )
+        {
+        newCache << v;
+        }
+      }
+    cache.swap( newCache );
+
+    // update scores of vertices in (or just dropped from) the cache, and find the best adjacent triangle.
+    best = -1;
+    float bestScore = -1.0f;
+    for( int i=0, s=cache.size(); i<s; ++i )
+      {
+      int v = cache[i];
+      cachePosition[v] = i < (int)cacheSize ? i : -1;
+      score[v] = vertexScore( cachePosition[v], remaining[v], cacheSize );
+      }
+
+    for( int i=0, s=cache.size(); i<s; ++i )
+      {
+      int v = cache[i];
+      const int *adj = adjacency.constData() + offsets[v];
+      for( int j=0; j<remaining[v]; ++j )
+        {
+        int t = adj[j];
+        float tScore = score[tris[t*3]] + score[tris[t*3+1]] + score[tris[t*3+2]];
+        triangleScore[t] = tScore;
+        if( tScore > bestScore )
+          {
+          bestScore = tScore;
+          best = t;
+          }
+        }
+      }
+
+    if( cache.size() > (int)cacheSize )
+      {
+      cache.resize( cacheSize );
+      }
+    }
+
+  geo->setTriangles( output );
+  }
+
+void optimiseVertexFetch( XGeometry *geo )
+  {
+  xAssert( geo );
+  reorderVertices( geo, false );
+  }
+
+void optimise( XGeometry *geo, xReal weldTolerance, xuint32 cacheSize )
+  {
+  weldVertices( geo, weldTolerance );
+  optimiseVertexCache( geo, cacheSize );
+  optimiseVertexFetch( geo );
+  }
+
+float averageCacheMissRatio( const XVector<unsigned int> &triangles, xuint32 cacheSize )
+  {
+  int triangleCount = triangles.size() / 3;
+  if( triangleCount == 0 )
+    {
+    return 0.0f;
+    }
+
+  // a vertex is in a FIFO cache if it was inserted less than cacheSize misses ago.
+  XVector<xint64> insertedAt( maximumIndex( triangles ) + 1, -(xint64)cacheSize - 1 );
+  xint64 misses = 0;
+  foreach( unsigned int v, triangles )
+    {
+    if( misses - insertedAt[v] >= (xint64)cacheSize )
+      {
+      ++misses;
+      insertedAt[v] = misses;
+      }
+    }
+
+  return (float)misses / triangleCount;
+  }
+
+XGeometry simplify( const XGeometry &geo, xuint32 targetTriangles, xReal *errorOut, const QString &semantic )
+  {
+  XGeometry ret( geo );
+  if( errorOut )
+    {
+    *errorOut = 0.0f;
+    }
+
+  if( !geo.attributes3D().contains( semantic ) )
+    {
+    return ret;
+    }
+
+  const XVector<XVector3D> &positions = geo.attributes3D()[semantic];
+  XVector<unsigned int> tris = geo.triangles();
+  int triangleCount = tris.size() / 3;
+  int count = positions.size();
+  if( (xuint32)triangleCount <= targetTriangles )
+    {
+    return ret;
+    }
+
+  XVector<Quadric> quadrics( count );
+  XVector<XVector<int> > vertexTriangles( count );
+  XHash <quint64, int> edgeUses;
+  edgeUses.reserve( tris.size() );
+
+  for( int t=0; t<triangleCount; ++t )
+    {
+    const unsigned int *idx = tris.constData() + t*3;
+    XVector3D n = triangleNormal( positions[idx[0]], positions[idx[1]], positions[idx[2]] );
+    xReal length = n.norm();
+    if( length > 0.0f )
+      {
+      n /= length;
+      }
+    double d = -n.dot( positions[idx[0]] );
+
+    for( int c=0; c<3; ++c )
+      {
+      quadrics[idx[c]].addPlane( n, d, length * 0.5f );
+      vertexTriangles[idx[c]] << t;
+      edgeUses[edgeKey( idx[c], idx[(c+1)%3] )]++;
+      }
+    }
+
+  // border edges (including attribute seams) get a plane perpendicular to their face, so they keep their shape.
+  const double borderWeight = 10.0;
+  for( int t=0; t<triangleCount; ++t )
+    {
+    const unsigned int *idx = tris.constData() + t*3;
+    XVector3D faceNormal = triangleNormal( positions[idx[0]], positions[idx[1]], positions[idx[2]] );
+    for( int c=0; c<3; ++c )
+      {
+      unsigned int a = idx[c], b = idx[(c+1)%3];
+      if( edgeUses[edgeKey( a, b )] != 1 )
+        {
+        continue;
+        }
+
+      XVector3D edge = positions[b] - positions[a];
+      XVector3D n = edge.cross( faceNormal );
+      xReal length = n.norm();
+      if( length <= 0.0f )
+        {
+        continue;
+        }
+      n /= length;
+      double d = -n.dot( positions[a] );
+      double w = borderWeight * edge.squaredNorm();
+      quadrics[a].addPlane( n, d, w );
+      quadrics[b].addPlane( n, d, w );
+      }
+    }
+
+  XVector<xuint32> versions( count, 0 );
+  XVector<char> collapsed( count, false );
+  XVector<char> alive( triangleCount, true );
+
+  XVector<Collapse> heap;
+  heap.reserve( edgeUses.size() );
+
+  for( XHash <quint64, int>::const_iterator it = edgeUses.begin(); it != edgeUses.end(); ++it )
+    {
+    int u = (int)( it.key() >> 32 );
+    int v = (int)( it.key() & 0xFFFFFFFF );
+    pushCollapse( heap, quadrics, positions, versions, u, v );
+    }
+
+  double maxError = 0.0;
+  int liveTriangles = triangleCount;
+  XVector<int> neighbours;
+  while( (xuint32)liveTriangles > targetTriangles && !heap.isEmpty() )
+    {
+    std::pop_heap( heap.begin(), heap.end() );
+    Collapse c = heap.back();
+    heap.pop_back();
+
+    if( collapsed[c.from] || collapsed[c.to] )
+      {
+      continue;
+      }
+
+    if( versions[c.from] != c.fromVersion || versions[c.to] != c.toVersion )
+      {
+      // stale, one of the end points has moved on since this was queued.
+      pushCollapse( heap, quadrics, positions, versions, c.from, c.to );
+      continue;
+      }
+
+    // reject collapses which flip a remaining triangle
+    bool flips = false;
+    foreach( int t, vertexTriangles[c.from] )
+      {
+      const unsigned int *idx = tris.constData() + t*3;
+      if( !alive[t] || idx[0] == (unsigned int)c.to || idx[1] == (unsigned int)c.to || idx[2] == (unsigned int)c.to )
+        {
+        continue;
+        }
+
+      XVector3D p[3];
+      for( int i=0; i<3; ++i )
+        {
+        p[i] = positions[idx[i] == (unsigned int)c.from ? c.to : idx[i]];
+        }
+      XVector3D before = triangleNormal( positions[idx[0]], positions[idx[1]], positions[idx[2]] );
+      if( before.dot( triangleNormal( p[0], p[1], p[2] ) ) <= 0.0f )
+        {
+        flips = true;
+        break;
+        }
+      }
+
+    if( flips )
+      {
+      continue;
+      }
+
+    collapsed[c.from] = true;
+    quadrics[c.to] += quadrics[c.from];
+    versions[c.to]++;
+    maxError = xMax( maxError, c.cost );
+
+    foreach( int t, vertexTriangles[c.from] )
+      {
+      if( !alive[t] )
+        {
+        continue;
+        }
+
+      unsigned int *idx = tris.data() + t*3;
+      for( int i=0; i<3; ++i )
+        {
+        if( idx[i] == (unsigned int)c.from )
+          {
+          idx[i] = c.to;
+          }
+        }
+
+      if( idx[0] == idx[1] || idx[0] == idx[2] || idx[1] == idx[2] )
+        {
+        alive[t] = false;
+        --liveTriangles;
+        }
+      else
+        {
+        vertexTriangles[c.to] << t;
+        }
+      }
+    vertexTriangles[c.from].clear();
+
+    neighbours.clear();
+    foreach( int t, vertexTriangles[c.to] )
+      {
+      if( !alive[t] )
+        {
+        continue;
+        }
+      for( int i=0; i<3; ++i )
+        {
+        int n = tris[t*3+i];
+        if( n != c.to && !neighbours.contains( n ) )
+          {
+          neighbours << n;
+          }
+        }
+      }
+
+    foreach( int n, neighbours )
+      {
+      pushCollapse( heap, quadrics, positions, versions, c.to, n );
+      }
+    }
+
+  XVector<unsigned int> outTris;
+  outTris.reserve( liveTriangles * 3 );
+  for( int t=0; t<triangleCount; ++t )
+    {
+    if( alive[t] )
+      {
+      outTris << tris[t*3] << tris[t*3+1] << tris[t*3+2];
+      }
+    }
+
+  // any points and lines follow their vertex through the collapses.
+  XVector<int> collapsedTo( count, -1 );
+  for( int t=0; t<triangleCount; ++t )
+    {
+    for( int i=0; i<3; ++i )
+      {
+      unsigned int original = geo.triangles()[t*3+i];
+      if( original != tris[t*3+i] )
+        {
+        collapsedTo[original] = tris[t*3+i];
+        }
+      }
+    }
+
+  XVector<unsigned int> lines = geo.lines();
+  XVector<unsigned int> points = geo.points();
+  for( int i=0; i<lines.size(); ++i )
+    {
+    while( collapsed[lines[i]] && collapsedTo[lines[i]] != -1 )
+      {
+      lines[i] = collapsedTo[lines[i]];
+      }
+    }
+  for( int i=0; i<points.size(); ++i )
+    {
+    while( collapsed[points[i]] && collapsedTo[points[i]] != -1 )
+      {
+      points[i] = collapsedTo[points[i]];
+      }
+    }
+
+  ret.setTriangles( outTris );
+  ret.setLines( lines );
+  ret.setPoints( points );
+  reorderVertices( &ret, true );
+
+  if( errorOut )
+    {
+    *errorOut = sqrt( maxError );
+    }
+  return ret;
+  }
+
+XVector<LOD> generateLODs( const XGeometry &geo, xuint32 levels, xReal reduction, xReal errorPerUnitDistance, const QString &semantic )
+  {
+  xAssert( reduction > 0.0f && reduction < 1.0f );
+  xAssert( errorPerUnitDistance > 0.0f );
+
+  XVector<LOD> lods;
+  if( levels == 0 )
+    {
+    return lods;
+    }
+
+  XGeometry base( geo );
+  weldVertices( &base, 1e-5f, semantic );
+  optimiseVertexCache( &base );
+  optimiseVertexFetch( &base );
+
+  LOD first;
+  first.geometry = base;
+  first.error = 0.0f;
+  first.minimumDistance = 0.0f;
+  first.maximumDistance = FLT_MAX;
+  lods << first;
+
+  int previousTriangles = base.triangles().size() / 3;
+  xReal target = previousTriangles;
+  for( xuint32 i=1; i<levels; ++i )
+    {
+    target *= reduction;
+
+    LOD lod;
+    lod.geometry = simplify( base, (xuint32)target, &lod.error, semantic );
+
+    int triangles = lod.geometry.triangles().size() / 3;
+    if( triangles == 0 || triangles >= previousTriangles )
+      {
+      // cant simplify any further without removing the mesh.
+      break;
+      }
+    previousTriangles = triangles;
+
+    optimiseVertexCache( &lod.geometry );
+    optimiseVertexFetch( &lod.geometry );
+
+    // switch to this level once its error is below the tolerance at that distance.
+    LOD &previous = lods.back();
+    lod.minimumDistance = xMax( lod.error / errorPerUnitDistance, previous.minimumDistance );
+    lod.maximumDistance = FLT_MAX;
+    previous.maximumDistance = lod.minimumDistance;
+
+    lods << lod;
+    }
+
+  return lods;
+  }
+}
@@ -0,0 +1,1683 @@
+#include "XSoftwareRenderer.h"
+#include "XFramebuffer.h"
+#include "XGeometry.h"
+#include "XShader.h"
+#include "XTexture.h"
+#include "QRunnable"
+#include "math.h"
+#include "string.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define X_SOFTWARE_RENDERER_SSE
+# include <emmintrin.h>
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+// TEXTURE
+//----------------------------------------------------------------------------------------------------------------------
+
+class XSoftwareTexture : public XAbstractTexture
+    {
+public:
+    XSoftwareTexture( XSoftwareRenderer * );
+    XSoftwareTexture( XSoftwareRenderer *, bool depth, int width, int height );
+    virtual void load( const QImage & );
+    virtual QImage save( );
+
+private:
+    XSoftwareRenderer *_renderer;
+    // colour is stored as 8 bit ARGB whatever the format asked for, depth as one float per pixel.
+    QImage _image;
+    XVector<float> _depth;
+    int _width;
+    friend class XSoftwareFramebuffer;
+    friend class XSoftwareRenderer;
+    };
+
+//----------------------------------------------------------------------------------------------------------------------
+// FRAMEBUFFER
+//----------------------------------------------------------------------------------------------------------------------
+
+class XSoftwareFramebuffer : public XAbstractFramebuffer
+    {
+public:
+    XSoftwareFramebuffer( XSoftwareRenderer *, int options, int width, int height );
+    ~XSoftwareFramebuffer( );
+
+    virtual bool isValid() const;
+
+    virtual const XAbstractTexture *colour() const;
+    virtual const XAbstractTexture *depth() const;
+
+private:
+    int _width;
+    int _height;
+    XSoftwareTexture *_colour;
+    XSoftwareTexture *_depth;
+    friend class XSoftwareRenderer;
+    };
+
+//----------------------------------------------------------------------------------------------------------------------
+// SHADER
+//----------------------------------------------------------------------------------------------------------------------
+
+class XSoftwareShaderVariable;
+
+class XSoftwareShader : public XAbstractShader
+    {
+public:
+    XSoftwareShader( XSoftwareRenderer * );
+
+    void setType( int );
+private:
+    virtual XAbstractShaderVariable *createVariable( QString, XAbstractShader * );
+    virtual void destroyVariable( XAbstractShaderVariable * );
+
+    virtual QByteArray save();
+    virtual void load( QByteArray );
+
+    int _type;
+    XHash<QString, XSoftwareShaderVariable *> _variables;
+    friend class XSoftwareRenderer;
+    };
+
+//----------------------------------------------------------------------------------------------------------------------
+// SHADER VARIABLE
+//----------------------------------------------------------------------------------------------------------------------
+
+class XSoftwareShaderVariable : public XAbstractShaderVariable
+    {
+public:
+    XSoftwareShaderVariable( XAbstractShader *, QString );
+    ~XSoftwareShaderVariable( );
+
+    void setValue( int value );
+    void setValue( xReal value );
+    void setValue( unsigned int value );
+    void setValue( const XColour &value );
+    void setValue( const XVector2D &value );
+    void setValue( const XVector3D &value );
+    void setValue( const XVector4D &value );
+    void setValue( const QMatrix2x2 &value );
+    void setValue( const QMatrix2x3 &value );
+    void setValue( const QMatrix2x4 &value );
+    void setValue( const QMatrix3x2 &value );
+    void setValue( const QMatrix3x3 &value );
+    void setValue( const QMatrix3x4 &value );
+    void setValue( const QMatrix4x2 &value );
+    void setValue( const QMatrix4x3 &value );
+    void setValue( const QMatrix4x4 &value );
+    void setValue( const XTexture &value );
+    void setValueArray( const XVector<int> &values );
+    void setValueArray( const XVector<xReal> &values );
+    void setValueArray( const XVector<unsigned int> &values );
+    void setValueArray( const XVector<XColour> &values );
+    void setValueArray( const XVector<XVector2D> &values );
+    void setValueArray( const XVector<XVector3D> &values );
+    void setValueArray( const XVector<XVector4D> &values );
+    void setValueArray( const XVector<QMatrix2x2> &values );
+    void setValueArray( const XVector<QMatrix2x3> &values );
+    void setValueArray( const XVector<QMatrix2x4> &values );
+    void setValueArray( const XVector<QMatrix3x2> &values );
+    void setValueArray( const XVector<QMatrix3x3> &values );
+    void setValueArray( const XVector<QMatrix3x4> &values );
+    void setValueArray( const XVector<QMatrix4x2> &values );
+    void setValueArray( const XVector<QMatrix4x3> &values );
+    void setValueArray( const XVector<QMatrix4x4> &values );
+
+    virtual void rebind();
+
+private:
+    template <typename T> void set( const T &value );
+    template <typename T> void setArray( const XVector<T> &values );
+    void clear();
+    QString _name;
+    XTexture *_texture;
+    // every value is flattened to floats, matrices column major.
+    XVector<float> _values;
+    friend class XSoftwareShader;
+    friend class XSoftwareRenderer;
+    };
+
+//----------------------------------------------------------------------------------------------------------------------
+// GEOMETRY CACHE
+//----------------------------------------------------------------------------------------------------------------------
+
+class XSoftwareGeometryCache : public XAbstractGeometry
+    {
+public:
+    XSoftwareGeometryCache( );
+
+    virtual void setPoints( const XVector<unsigned int> & );
+    virtual void setLines( const XVector<unsigned int> & );
+    virtual void setTriangles( const XVector<unsigned int> & );
+
+    virtual void setPoints( const unsigned int *, int count );
+    virtual void setLines( const unsigned int *, int count );
+    virtual void setTriangles( const unsigned int *, int count );
+
+    virtual void setAttributesSize( int, int, int, int, int );
+
+    virtual void setAttribute( QString, const XVector<xReal> & );
+    virtual void setAttribute( QString, const XVector<XVector2D> & );
+    virtual void setAttribute( QString, const XVector<XVector3D> & );
+    virtual void setAttribute( QString, const XVector<XVector4D> & );
+    virtual void setAttribute( QString, const xReal *, int components, int count );
+
+    virtual void setAttributeRange( QString, const XVector<xReal> &, int first, int count );
+    virtual void setAttributeRange( QString, const XVector<XVector2D> &, int first, int count );
+    virtual void setAttributeRange( QString, const XVector<XVector3D> &, int first, int count );
+    virtual void setAttributeRange( QString, const XVector<XVector4D> &, int first, int count );
+
+private:
+    struct Attribute
+        {
+        Attribute() : components( 0 ) { }
+        int components;
+        XVector<float> data;
+        };
+
+    void writeAttribute( const QString &name, const float *data, int components, int first, int count );
+
+    XVector<unsigned int> _points;
+    XVector<unsigned int> _lines;
+    XVector<unsigned int> _triangles;
+    XHash<QString, Attribute> _attributes;
+    int _vertexCount;
+    friend class XSoftwareRenderer;
+    };
+
+//----------------------------------------------------------------------------------------------------------------------
+// PROGRAMS
+//----------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+XVector3D toVector3D( const float *data )
+    {
+    return XVector3D( data[0], data[1], data[2] );
+    }
+
+// default.vert and default.frag, a checker of grey and the absolute normal.
+void defaultVertex( const XSoftwareRenderer::ShaderState &state, const XVector4D *attributes, XVector4D &position, float *varyings )
+    {
+    XVector4D vertex( attributes[0].x(), attributes[0].y(), attributes[0].z(), 1.0f );
+    position = state.projection.matrix() * ( state.modelView.matrix() * vertex );
+
+    varyings[0] = attributes[1].x();
+    varyings[1] = attributes[1].y();
+    varyings[2] = attributes[1].z();
+    }
+
+bool defaultFragment( const XSoftwareRenderer::ShaderState &, const float *varyings, xReal x, xReal y, XVector4D &colour )
+    {
+    if( fmodf( x + y, 20.0f ) < 10.0f )
+        {
+        colour = XVector4D( 0.2f, 0.2f, 0.2f, 1.0f );
+        }
+    else
+        {
+        XVector3D normal = toVector3D( varyings );
+        xReal length = normal.norm();
+        if( length > 0.0f )
+            {
+            normal /= length;
+            }
+        colour = XVector4D( fabsf( normal.x() ), fabsf( normal.y() ), fabsf( normal.z() ), 1.0f );
+        }
+    return true;
+    }
+
+// blinn.vert and blinn.frag, a textured surface lit by one directional light.
+const XVector3D blinnLightDirection = XVector3D( 0.25f, 1.0f, 0.5f ).normalized();
+const XVector3D blinnHalfVector = ( XVector3D( 0.0f, 0.0f, 1.0f ) + blinnLightDirection ).normalized();
+
+void blinnVertex( const XSoftwareRenderer::ShaderState &state, const XVector4D *attributes, XVector4D &position, float *varyings )
+    {
+    XVector4D vertex( attributes[0].x(), attributes[0].y(), attributes[0].z(), 1.0f );
+    XVector4D cameraSpace = state.modelView.matrix() * vertex;
+    position = state.projection.matrix() * cameraSpace;
+
+    XVector3D normal = state.modelView.linear() * XVector3D( attributes[1].x(), attributes[1].y(), attributes[1].z() );
+    xReal length = normal.norm();
+    if( length > 0.0f )
+        {
+        normal /= length;
+        }
+
+    varyings[0] = attributes[2].x();
+    varyings[1] = attributes[2].y();
+    varyings[2] = normal.x();
+    varyings[3] = normal.y();
+    varyings[4] = normal.z();
+    }
+
+bool blinnFragment( const XSoftwareRenderer::ShaderState &state, const float *varyings, xReal, xReal, XVector4D &colour )
+    {
+    XVector4D tex = XSoftwareRenderer::sample( state.textures[0], varyings[0], varyings[1] );
+    XVector3D normal = toVector3D( varyings + 2 );
+
+    const xReal specularity = 30.0f;
+    const xReal lightSpecularity = 100.0f;
+
+    xReal diffuse = xMin( xMax( blinnLightDirection.dot( normal ), 0.0f ), 1.0f );
+    xReal specular = powf( xMin( xMax( normal.dot( blinnHalfVector ), 0.0f ), 1.0f ), lightSpecularity ) * specularity;
+
+    colour = XVector4D(
+      tex.x() * ( diffuse * 1.0f + specular * 1.0f + 0.2f ),
+      tex.y() * ( diffuse * 0.8f + specular * 0.8f + 0.2f ),
+      tex.z() * ( diffuse * 0.78f + specular * 1.0f + 0.2f ),
+      tex.w() );
+    return true;
+    }
+
+XVector4D unpack( QRgb rgb )
+    {
+    const xReal scale = 1.0f / 255.0f;
+    return XVector4D( qRed( rgb ) * scale, qGreen( rgb ) * scale, qBlue( rgb ) * scale, qAlpha( rgb ) * scale );
+    }
+
+int toByte( xReal value )
+    {
+    return (int)( xMin( xMax( value, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+    }
+
+QRgb pack( const XVector4D &colour )
+    {
+    return qRgba( toByte( colour.x() ), toByte( colour.y() ), toByte( colour.z() ), toByte( colour.w() ) );
+    }
+
+int wrap( int value, int size )
+    {
+    value %= size;
+    return value < 0 ? value + size : value;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// TILE JOB
+//----------------------------------------------------------------------------------------------------------------------
+
+// takes the next tile with work until there are none left.
+class XSoftwareRenderer::TileJob : public QRunnable
+    {
+public:
+    TileJob( const XSoftwareRenderer *r, QAtomicInt *next ) : _renderer( r ), _next( next )
+        {
+        }
+
+    void run()
+        {
+        for(;;)
+            {
+            int i = _next->fetchAndAddOrdered( 1 );
+            if( i >= _renderer->_activeTiles.size() )
+                {
+                return;
+                }
+            _renderer->rasterise( _renderer->_activeTiles[i] );
+            }
+        }
+
+private:
+    const XSoftwareRenderer *_renderer;
+    QAtomicInt *_next;
+    };
+
+//----------------------------------------------------------------------------------------------------------------------
+// RENDERER
+//----------------------------------------------------------------------------------------------------------------------
+
+XSoftwareRenderer::Program::Program() : varyingCount( 0 ), vertex( 0 ), fragment( 0 )
+    {
+    }
+
+XSoftwareRenderer::XSoftwareRenderer( int maxThreads ) : _currentShader( 0 ), _screen( 0 ), _currentFramebuffer( 0 ),
+    _viewportWidth( 0 ), _viewportHeight( 0 ), _width( 0 ), _height( 0 ), _tilesX( 0 ), _tilesY( 0 ),
+    _colourBits( 0 ), _colourStride( 0 ), _depthBits( 0 ), _depthStride( 0 )
+    {
+    _transforms << XTransform::Identity();
+    _projection = XComplexTransform::Identity();
+
+    if( maxThreads > 0 )
+        {
+        _pool.setMaxThreadCount( maxThreads );
+        }
+
+    Program def;
+    def.attributes << "vertex" << "normals";
+    def.varyingCount = 3;
+    def.vertex = defaultVertex;
+    def.fragment = defaultFragment;
+    setProgram( XShader::Default, def );
+
+    Program blinn;
+    blinn.attributes << "vertex" << "normal" << "texture";
+    blinn.textures << "ambientTexture";
+    blinn.varyingCount = 5;
+    blinn.vertex = blinnVertex;
+    blinn.fragment = blinnFragment;
+    setProgram( XShader::AmbientShader, blinn );
+    }
+
+XSoftwareRenderer::~XSoftwareRenderer()
+    {
+    delete _screen;
+    }
+
+void XSoftwareRenderer::setProgram( int type, const Program &program )
+    {
+    xAssert( program.attributes.size() <= MaximumAttributes );
+    xAssert( program.varyingCount <= MaximumVaryings );
+    _programs.insert( type, program );
+    }
+
+const XSoftwareRenderer::Program &XSoftwareRenderer::program( int type ) const
+    {
+    static Program none;
+    XHash<int, Program>::const_iterator it = _programs.find( type );
+    return it == _programs.end() ? none : it.value();
+    }
+
+XSoftwareFramebuffer *XSoftwareRenderer::target() const
+    {
+    return _currentFramebuffer ? _currentFramebuffer : _screen;
+    }
+
+QImage XSoftwareRenderer::colour()
+    {
+    flush();
+    XSoftwareFramebuffer *fb = target();
+    return fb && fb->_colour ? fb->_colour->_image : QImage();
+    }
+
+XVector4D XSoftwareRenderer::sample( const QImage &image, xReal u, xReal v )
+    {
+    // GL reads an unbound sampler as opaque black.
+    if( image.isNull() )
+        {
+        return XVector4D( 0.0f, 0.0f, 0.0f, 1.0f );
+        }
+
+    // QImage rows run top down, GL binds them so t = 0 is the bottom row.
+    int width = image.width();
+    int height = image.height();
+    xReal fx = u * width - 0.5f;
+    xReal fy = ( 1.0f - v ) * height - 0.5f;
+    xReal floorX = floorf( fx );
+    xReal floorY = floorf( fy );
+    xReal tx = fx - floorX;
+    xReal ty = fy - floorY;
+
+    int x0 = wrap( (int)floorX, width );
+    int x1 = wrap( x0 + 1, width );
+    int y0 = wrap( (int)floorY, height );
+    int y1 = wrap( y0 + 1, height );
+
+    const QRgb *row0 = reinterpret_cast<const QRgb *>( image.constScanLine( y0 ) );
+    const QRgb *row1 = reinterpret_cast<const QRgb *>( image.constScanLine( y1 ) );
+
+    XVector4D top = unpack( row0[x0] ) * ( 1.0f - tx ) + unpack( row0[x1] ) * tx;
+    XVector4D bottom = unpack( row1[x0] ) * ( 1.0f - tx ) + unpack( row1[x1] ) * tx;
+    return top * ( 1.0f - ty ) + bottom * ty;
+    }
+
+void XSoftwareRenderer::pushTransform( const XTransform &trans )
+    {
+    XTransform current = _transforms.last() * trans;
+    _transforms << current;
+    }
+
+void XSoftwareRenderer::popTransform( )
+    {
+    xAssert( _transforms.size() > 1 );
+    _transforms.pop_back();
+    }
+
+void XSoftwareRenderer::clear( )
+    {
+    flush();
+
+    XSoftwareFramebuffer *fb = target();
+    if( !fb )
+        {
+        return;
+        }
+
+    if( fb->_colour )
+        {
+        fb->_colour->_image.fill( 0 );
+        }
+    if( fb->_depth )
+        {
+        fb->_depth->_depth.fill( 1.0f );
+        }
+    }
+
+void XSoftwareRenderer::enableRenderFlag( RenderFlags )
+    {
+    // flags are read from renderFlags() as each draw is recorded.
+    }
+
+void XSoftwareRenderer::disableRenderFlag( RenderFlags )
+    {
+    }
+
+void XSoftwareRenderer::setViewportSize( QSize size )
+    {
+    flush();
+    _size = size;
+
+    if( _screen && _screen->_width == size.width() && _screen->_height == size.height() )
+        {
+        return;
+        }
+
+    delete _screen;
+    _screen = 0;
+    if( size.width() > 0 && size.height() > 0 )
+        {
+        _screen = new XSoftwareFramebuffer( this, XFramebuffer::Colour|XFramebuffer::Depth, size.width(), size.height() );
+        }
+    }
+
+QSize XSoftwareRenderer::viewportSize() const
+    {
+    return _size;
+    }
+
+void XSoftwareRenderer::setProjectionTransform( const XComplexTransform &trans )
+    {
+    _projection = trans;
+    }
+
+void XSoftwareRenderer::setShader( const XShader *shader )
+    {
+    if( shader )
+        {
+        shader->prepareInternal( this );
+        _currentShader = static_cast<XSoftwareShader*>(shader->internal());
+        }
+    else
+        {
+        _currentShader = 0;
+        }
+    }
+
+void XSoftwareRenderer::setFramebuffer( const XFramebuffer *fb )
+    {
+    flush();
+
+    if( fb )
+        {
+        fb->prepareInternal( this );
+        _currentFramebuffer = static_cast<XSoftwareFramebuffer*>(fb->internal());
+        }
+    else
+        {
+        _currentFramebuffer = 0;
+        }
+    }
+
+void XSoftwareRenderer::begin( XSoftwareFramebuffer *fb )
+    {
+    _viewportWidth = _size.width() > 0 ? _size.width() : fb->_width;
+    _viewportHeight = _size.height() > 0 ? _size.height() : fb->_height;
+
+    // the viewport is anchored at the top left of the target, and cut to its size.
+    _width = xMin( _viewportWidth, fb->_width );
+    _height = xMin( _viewportHeight, fb->_height );
+    _tilesX = ( _width + TileSize - 1 ) / TileSize;
+    _tilesY = ( _height + TileSize - 1 ) / TileSize;
+    _bins.resize( _tilesX * _tilesY );
+    }
+
+void XSoftwareRenderer::drawGeometry( const XGeometry &geometry )
+    {
+    XSoftwareFramebuffer *fb = target();
+    if( !_currentShader || !fb )
+        {
+        return;
+        }
+
+    const Program &prog = program( _currentShader->_type );
+    if( !prog.vertex || !prog.fragment )
+        {
+        return;
+        }
+
+    geometry.prepareInternal( this );
+    const XSoftwareGeometryCache *cache = static_cast<const XSoftwareGeometryCache*>(geometry.internal());
+
+    if( _draws.isEmpty() )
+        {
+        begin( fb );
+        }
+
+    Draw draw;
+    draw.program = prog;
+    draw.flags = renderFlags();
+    draw.state.modelView = _transforms.last();
+    draw.state.projection = _projection;
+
+    foreach( const QString &name, prog.uniforms )
+        {
+        XSoftwareShaderVariable *var = _currentShader->_variables.value( name, 0 );
+        draw.state.uniforms << ( var ? var->_values : XVector<float>() );
+        }
+
+    foreach( const QString &name, prog.textures )
+        {
+        XSoftwareShaderVariable *var = _currentShader->_variables.value( name, 0 );
+        QImage image;
+        if( var && var->_texture )
+            {
+            var->_texture->prepareInternal( this );
+            image = static_cast<XSoftwareTexture*>(var->_texture->internal())->_image;
+            }
+        draw.state.textures << image;
+        }
+    _draws << draw;
+
+    // vertex stage, each vertex is shaded once however many primitives use it.
+    const XSoftwareGeometryCache::Attribute *sources[MaximumAttributes];
+    int attributeCount = prog.attributes.size();
+    for( int i=0; i<attributeCount; ++i )
+        {
+        XHash<QString, XSoftwareGeometryCache::Attribute>::const_iterator it = cache->_attributes.find( prog.attributes[i] );
+        sources[i] = it == cache->_attributes.end() ? 0 : &it.value();
+        }
+
+    const ShaderState &state = _draws.last().state;
+    int vertexCount = cache->_vertexCount;
+    _clipVertices.resize( vertexCount );
+    ClipVertex *clip = _clipVertices.data();
+
+    XVector4D attributes[MaximumAttributes];
+    XVector4D position;
+    for( int v=0; v<vertexCount; ++v )
+        {
+        for( int i=0; i<attributeCount; ++i )
+            {
+            attributes[i] = XVector4D( 0.0f, 0.0f, 0.0f, 1.0f );
+
+            const XSoftwareGeometryCache::Attribute *source = sources[i];
+            if( source && ( v + 1 ) * source->components <= source->data.size() )
+                {
+                const float *data = source->data.constData() + v * source->components;
+                for( int c=0; c<source->components; ++c )
+                    {
+                    attributes[i](c) = data[c];
+                    }
+                }
+            }
+
+        prog.vertex( state, attributes, position, clip[v].varyings );
+        for( int c=0; c<4; ++c )
+            {
+            clip[v].position[c] = position(c);
+            }
+        }
+
+    _screenIndices.fill( X_UINT32_SENTINEL, vertexCount );
+
+    // primitive assembly
+    const ClipVertex *vertices[3];
+    for( int i=0; i<cache->_points.size(); ++i )
+        {
+        unsigned int p = cache->_points[i];
+        if( p < (unsigned int)vertexCount )
+            {
+            vertices[0] = clip + p;
+            drawPrimitive( 1, vertices );
+            }
+        }
+
+    for( int i=0; i+1<cache->_lines.size(); i+=2 )
+        {
+        unsigned int a = cache->_lines[i];
+        unsigned int b = cache->_lines[i+1];
+        if( a < (unsigned int)vertexCount && b < (unsigned int)vertexCount )
+            {
+            vertices[0] = clip + a;
+            vertices[1] = clip + b;
+            drawPrimitive( 2, vertices );
+            }
+        }
+
+    for( int i=0; i+2<cache->_triangles.size(); i+=3 )
+        {
+        unsigned int a = cache->_triangles[i];
+        unsigned int b = cache->_triangles[i+1];
+        unsigned int c = cache->_triangles[i+2];
+        if( a < (unsigned int)vertexCount && b < (unsigned int)vertexCount && c < (unsigned int)vertexCount )
+            {
+            vertices[0] = clip + a;
+            vertices[1] = clip + b;
+            vertices[2] = clip + c;
+            drawPrimitive( 3, vertices );
+            }
+        }
+    }
+
+void XSoftwareRenderer::drawPrimitive( xuint32 count, const ClipVertex **vertices )
+    {
+    // reject primitives entirely outside one of the frustum planes, and find those crossing the near plane.
+    int outside = 0x3F;
+    bool crossesNear = false;
+    for( xuint32 i=0; i<count; ++i )
+        {
+        const float *p = vertices[i]->position;
+        int code = 0;
+        code |= p[0] < -p[3] ? 1 : 0;
+        code |= p[0] > p[3] ? 2 : 0;
+        code |= p[1] < -p[3] ? 4 : 0;
+        code |= p[1] > p[3] ? 8 : 0;
+        code |= p[2] < -p[3] ? 16 : 0;
+        code |= p[2] > p[3] ? 32 : 0;
+        outside &= code;
+        crossesNear |= ( code & 16 ) != 0;
+        }
+
+    if( outside )
+        {
+        return;
+        }
+
+    xuint32 indices[3];
+    if( !crossesNear )
+        {
+        for( xuint32 i=0; i<count; ++i )
+            {
+            indices[i] = screenVertex( vertices[i] );
+            }
+        addPrimitive( count, indices );
+        }
+    else if( count == 3 )
+        {
+        clipTriangle( vertices );
+        }
+    else if( count == 2 )
+        {
+        // keep the part of the line in front of the near plane.
+        const float *a = vertices[0]->position;
+        const float *b = vertices[1]->position;
+        float da = a[2] + a[3];
+        float db = b[2] + b[3];
+        float t = da / ( da - db );
+        int varyingCount = _draws.last().program.varyingCount;
+
+        ClipVertex cut;
+        for( int c=0; c<4; ++c )
+            {
+            cut.position[c] = a[c] + ( b[c] - a[c] ) * t;
+            }
+        for( int c=0; c<varyingCount; ++c )
+            {
+            cut.varyings[c] = vertices[0]->varyings[c] + ( vertices[1]->varyings[c] - vertices[0]->varyings[c] ) * t;
+            }
+
+        indices[0] = da >= 0.0f ? screenVertex( vertices[0] ) : screenVertex( vertices[1] );
+        indices[1] = addVertex( cut );
+        addPrimitive( 2, indices );
+        }
+    }
+
+void XSoftwareRenderer::clipTriangle( const ClipVertex **vertices )
+    {
+    int varyingCount = _draws.last().program.varyingCount;
+
+    // Sutherland-Hodgman against z = -w, one triangle in gives at most a quad out.
+    ClipVertex out[4];
+    int outCount = 0;
+    for( int i=0; i<3; ++i )
+        {
+        const ClipVertex &a = *vertices[i];
+        const ClipVertex &b = *vertices[(i+1)%3];
+        float da = a.position[2] + a.position[3];
+        float db = b.position[2] + b.position[3];
+
+        if( da >= 0.0f )
+            {
+            out[outCount++] = a;
+            }
+
+        if( ( da >= 0.0f ) != ( db >= 0.0f ) )
+            {
+            float t = da / ( da - db );
+            ClipVertex &cut = out[outCount++];
+            for( int c=0; c<4; ++c )
+                {
+                cut.position[c] = a.position[c] + ( b.position[c] - a.position[c] ) * t;
+                }
+            for( int c=0; c<varyingCount; ++c )
+                {
+                cut.varyings[c] = a.varyings[c] + ( b.varyings[c] - a.varyings[c] ) * t;
+                }
+            }
+        }
+
+    if( outCount < 3 )
+        {
+        return;
+        }
+
+    xuint32 indices[3];
+    indices[0] = addVertex( out[0] );
+    for( int i=1; i+1<outCount; ++i )
+        {
+        indices[1] = addVertex( out[i] );
+        indices[2] = addVertex( out[i+1] );
+        addPrimitive( 3, indices );
+        }
+    }
+
+xuint32 XSoftwareRenderer::screenVertex( const ClipVertex *vertex )
+    {
+    xuint32 &index = _screenIndices[vertex - _clipVertices.constData()];
+    if( index == X_UINT32_SENTINEL )
+        {
+        index = addVertex( *vertex );
+        }
+    return index;
+    }
+
+xuint32 XSoftwareRenderer::addVertex( const ClipVertex &vertex )
+    {
+    const float *p = vertex.position;
+    float invW = 1.0f / p[3];
+
+    ScreenVertex screen;
+    screen.x = ( p[0] * invW * 0.5f + 0.5f ) * _viewportWidth;
+    screen.y = ( 0.5f - p[1] * invW * 0.5f ) * _viewportHeight;
+    screen.z = p[2] * invW * 0.5f + 0.5f;
+    screen.invW = invW;
+    memcpy( screen.varyings, vertex.varyings, sizeof(float) * _draws.last().program.varyingCount );
+
+    xuint32 index = _vertices.size();
+    _vertices << screen;
+    return index;
+    }
+
+void XSoftwareRenderer::addPrimitive( xuint32 count, xuint32 *indices )
+    {
+    Primitive prim;
+    prim.draw = _draws.size() - 1;
+    prim.count = count;
+
+    const ScreenVertex *v[3];
+    for( xuint32 i=0; i<3; ++i )
+        {
+        // points are drawn as a line with no length.
+        prim.vertices[i] = indices[xMin( i, count - 1 )];
+        v[i] = _vertices.constData() + prim.vertices[i];
+        }
+
+    if( count == 3 )
+        {
+        // with y down a triangle GL calls front facing, anticlockwise in window space, has negative area.
+        float area = ( v[1]->x - v[0]->x ) * ( v[2]->y - v[0]->y ) - ( v[1]->y - v[0]->y ) * ( v[2]->x - v[0]->x );
+        if( area == 0.0f || ( area > 0.0f && ( _draws.last().flags & BackfaceCulling ) != false ) )
+            {
+            return;
+            }
+
+        // wind every triangle the same way, so the edge functions are positive inside.
+        if( area < 0.0f )
+            {
+            qSwap( prim.vertices[1], prim.vertices[2] );
+            }
+        }
+
+    float minX = xMin( v[0]->x, xMin( v[1]->x, v[2]->x ) );
+    float minY = xMin( v[0]->y, xMin( v[1]->y, v[2]->y ) );
+    float maxX = xMax( v[0]->x, xMax( v[1]->x, v[2]->x ) );
+    float maxY = xMax( v[0]->y, xMax( v[1]->y, v[2]->y ) );
+
+    xuint32 index = _primitives.size();
+    _primitives << prim;
+    bin( index, minX, minY, maxX, maxY );
+    }
+
+void XSoftwareRenderer::bin( xuint32 primitive, float minX, float minY, float maxX, float maxY )
+    {
+    if( maxX < 0.0f || maxY < 0.0f || minX >= _width || minY >= _height )
+        {
+        return;
+        }
+
+    int tileX0 = xMax( (int)minX, 0 ) / TileSize;
+    int tileY0 = xMax( (int)minY, 0 ) / TileSize;
+    int tileX1 = xMin( (int)maxX, _width - 1 ) / TileSize;
+    int tileY1 = xMin( (int)maxY, _height - 1 ) / TileSize;
+
+    for( int y=tileY0; y<=tileY1; ++y )
+        {
+        for( int x=tileX0; x<=tileX1; ++x )
+            {
+            _bins[y * _tilesX + x] << primitive;
+            }
+        }
+    }
+
+void XSoftwareRenderer::flush()
+    {
+    XSoftwareFramebuffer *fb = target();
+    if( fb && !_primitives.isEmpty() )
+        {
+        _colourBits = fb->_colour ? fb->_colour->_image.bits() : 0;
+        _colourStride = fb->_colour ? fb->_colour->_image.bytesPerLine() : 0;
+        _depthBits = fb->_depth ? fb->_depth->_depth.data() : 0;
+        _depthStride = fb->_width;
+
+        _activeTiles.clear();
+        for( int i=0; i<_bins.size(); ++i )
+            {
+            if( !_bins[i].isEmpty() )
+                {
+                _activeTiles << i;
+                }
+            }
+
+        int jobs = xMin( _pool.maxThreadCount(), _activeTiles.size() );
+        if( jobs <= 1 )
+            {
+            foreach( int tile, _activeTiles )
+                {
+                rasterise( tile );
+                }
+            }
+        else
+            {
+            QAtomicInt next( 0 );
+            for( int i=0; i<jobs; ++i )
+                {
+                _pool.start( new TileJob( this, &next ) );
+                }
+            _pool.waitForDone();
+            }
+
+        _colourBits = 0;
+        _depthBits = 0;
+        }
+
+    _draws.clear();
+    _vertices.clear();
+    _primitives.clear();
+    _bins.clear();
+    _activeTiles.clear();
+    }
+
+void XSoftwareRenderer::rasterise( int tile ) const
+    {
+    int x0 = ( tile % _tilesX ) * TileSize;
+    int y0 = ( tile / _tilesX ) * TileSize;
+    int x1 = xMin( x0 + (int)TileSize, _width );
+    int y1 = xMin( y0 + (int)TileSize, _height );
+
+    const XVector<xuint32> &bin = _bins[tile];
+    for( int i=0; i<bin.size(); ++i )
+        {
+        const Primitive &prim = _primitives[bin[i]];
+        if( prim.count == 3 )
+            {
+            rasteriseTriangle( prim, x0, y0, x1, y1 );
+            }
+        else
+            {
+            rasteriseLine( prim, x0, y0, x1, y1 );
+            }
+        }
+    }
+
+void XSoftwareRenderer::rasteriseTriangle( const Primitive &prim, int x0, int y0, int x1, int y1 ) const
+    {
+    const ScreenVertex *v[3];
+    for( int i=0; i<3; ++i )
+        {
+        v[i] = _vertices.constData() + prim.vertices[i];
+        }
+
+    // edge i is opposite vertex i, E(x, y) = a x + b y + c is positive inside. Triangles sharing an edge
+    // compute exactly negated values for it, and the top left rule gives pixels on the edge to only one of them.
+    float a[3];
+    float b[3];
+    float c[3];
+    bool owns[3];
+    for( int i=0; i<3; ++i )
+        {
+        const ScreenVertex *p = v[(i+1)%3];
+        const ScreenVertex *q = v[(i+2)%3];
+        a[i] = p->y - q->y;
+        b[i] = q->x - p->x;
+        c[i] = p->x * q->y - q->x * p->y;
+        owns[i] = a[i] > 0.0f || ( a[i] == 0.0f && b[i] < 0.0f );
+        }
+
+    float area = a[0] * v[0]->x + b[0] * v[0]->y + c[0];
+    if( area <= 0.0f )
+        {
+        return;
+        }
+    float invArea = 1.0f / area;
+
+    int minX = xMax( x0, (int)floorf( xMin( v[0]->x, xMin( v[1]->x, v[2]->x ) ) ) );
+    int minY = xMax( y0, (int)floorf( xMin( v[0]->y, xMin( v[1]->y, v[2]->y ) ) ) );
+    int maxX = xMin( x1 - 1, (int)ceilf( xMax( v[0]->x, xMax( v[1]->x, v[2]->x ) ) ) );
+    int maxY = xMin( y1 - 1, (int)ceilf( xMax( v[0]->y, xMax( v[1]->y, v[2]->y ) ) ) );
+
+    const Draw &draw = _draws[prim.draw];
+    int startX = x0 + ( ( minX - x0 ) & ~3 );
+
+#ifdef X_SOFTWARE_RENDERER_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 offsets = _mm_set_ps( 3.5f, 2.5f, 1.5f, 0.5f );
+    __m128 edgeA[3];
+    for( int i=0; i<3; ++i )
+        {
+        edgeA[i] = _mm_set1_ps( a[i] );
+        }
+#endif
+
+    float e[3][4];
+    for( int y=minY; y<=maxY; ++y )
+        {
+        float py = y + 0.5f;
+        float row[3];
+        for( int i=0; i<3; ++i )
+            {
+            row[i] = b[i] * py + c[i];
+            }
+
+        // four pixels at a time
+        for( int x=startX; x<=maxX; x+=4 )
+            {
+            int mask;
+#ifdef X_SOFTWARE_RENDERER_SSE
+            __m128 px = _mm_add_ps( _mm_set1_ps( (float)x ), offsets );
+            __m128 inside = _mm_cmpeq_ps( zero, zero );
+            for( int i=0; i<3; ++i )
+                {
+                __m128 edge = _mm_add_ps( _mm_mul_ps( edgeA[i], px ), _mm_set1_ps( row[i] ) );
+                inside = _mm_and_ps( inside, owns[i] ? _mm_cmpge_ps( edge, zero ) : _mm_cmpgt_ps( edge, zero ) );
+                _mm_storeu_ps( e[i], edge );
+                }
+            mask = _mm_movemask_ps( inside );
+#else
+            mask = 0;
+            for( int k=0; k<4; ++k )
+                {
+                float px = x + k + 0.5f;
+                bool inside = true;
+                for( int i=0; i<3; ++i )
+                    {
+                    e[i][k] = a[i] * px + row[i];
+                    inside = inside && ( owns[i] ? e[i][k] >= 0.0f : e[i][k] > 0.0f );
+                    }
+                mask |= inside ? ( 1 << k ) : 0;
+                }
+#endif
+
+            // lanes past the right of the triangle or tile
+            if( maxX - x < 3 )
+                {
+                mask &= ( 1 << ( maxX - x + 1 ) ) - 1;
+                }
+
+            for( int k=0; mask; ++k, mask >>= 1 )
+                {
+                if( mask & 1 )
+                    {
+                    float weights[3] = { e[0][k] * invArea, e[1][k] * invArea, e[2][k] * invArea };
+                    float z = weights[0] * v[0]->z + weights[1] * v[1]->z + weights[2] * v[2]->z;
+                    shade( draw, v, weights, 3, x + k, y, z );
+                    }
+                }
+            }
+        }
+    }
+
+void XSoftwareRenderer::rasteriseLine( const Primitive &prim, int x0, int y0, int x1, int y1 ) const
+    {
+    const ScreenVertex *v[2] = { _vertices.constData() + prim.vertices[0], _vertices.constData() + prim.vertices[1] };
+    const Draw &draw = _draws[prim.draw];
+
+    float dx = v[1]->x - v[0]->x;
+    float dy = v[1]->y - v[0]->y;
+    int steps = (int)ceilf( xMax( fabsf( dx ), fabsf( dy ) ) );
+
+    for( int i=0; i<=steps; ++i )
+        {
+        float t = steps ? (float)i / steps : 0.0f;
+        int x = (int)floorf( v[0]->x + dx * t );
+        int y = (int)floorf( v[0]->y + dy * t );
+        if( x < x0 || x >= x1 || y < y0 || y >= y1 )
+            {
+            continue;
+            }
+
+        float weights[2] = { 1.0f - t, t };
+        float z = weights[0] * v[0]->z + weights[1] * v[1]->z;
+        shade( draw, v, weights, 2, x, y, z );
+        }
+    }
+
+void XSoftwareRenderer::shade( const Draw &draw, const ScreenVertex **v, const float *weights, int count, int x, int y, float z ) const
+    {
+    // beyond the far plane
+    if( z > 1.0f )
+        {
+        return;
+        }
+
+    float *depth = 0;
+    if( _depthBits && ( draw.flags & DepthTest ) != false )
+        {
+        depth = _depthBits + y * _depthStride + x;
+        if( z >= *depth )
+            {
+            return;
+            }
+        }
+
+    // perspective correct interpolation, weight each vertex by 1/w and renormalise.
+    float perspective[3];
+    float sum = 0.0f;
+    for( int i=0; i<count; ++i )
+        {
+        perspective[i] = weights[i] * v[i]->invW;
+        sum += perspective[i];
+        }
+    float invSum = sum != 0.0f ? 1.0f / sum : 0.0f;
+
+    float varyings[MaximumVaryings];
+    for( int j=0; j<draw.program.varyingCount; ++j )
+        {
+        float value = 0.0f;
+        for( int i=0; i<count; ++i )
+            {
+            value += perspective[i] * v[i]->varyings[j];
+            }
+        varyings[j] = value * invSum;
+        }
+
+    XVector4D colour;
+    if( !draw.program.fragment( draw.state, varyings, x + 0.5f, _viewportHeight - ( y + 0.5f ), colour ) )
+        {
+        return;
+        }
+
+    if( depth )
+        {
+        *depth = z;
+        }
+
+    if( _colourBits )
+        {
+        QRgb *pixel = reinterpret_cast<QRgb *>( _colourBits + y * _colourStride ) + x;
+        if( ( draw.flags & AlphaBlending ) != false )
+            {
+            // glBlendFunc( GL_SRC_ALPHA, GL_ONE )
+            colour = colour * colour.w() + unpack( *pixel );
+            }
+        *pixel = pack( colour );
+        }
+    }
+
+XAbstractShader *XSoftwareRenderer::getShader( )
+    {
+    return new XSoftwareShader( this );
+    }
+
+XAbstractGeometry *XSoftwareRenderer::getGeometry( XGeometry::BufferType, XGeometry::VertexLayout )
+    {
+    return new XSoftwareGeometryCache( );
+    }
+
+XAbstractTexture *XSoftwareRenderer::getTexture()
+    {
+    return new XSoftwareTexture( this );
+    }
+
+XAbstractFramebuffer *XSoftwareRenderer::getFramebuffer( int options, int, int, int width, int height )
+    {
+    if( width <= 0 || height <= 0 )
+        {
+        width = _size.width();
+        height = _size.height();
+        }
+    return new XSoftwareFramebuffer( this, options, width, height );
+    }
+
+void XSoftwareRenderer::destroyShader( XAbstractShader *shader )
+    {
+    if( shader == _currentShader )
+        {
+        _currentShader = 0;
+        }
+    delete shader;
+    }
+
+void XSoftwareRenderer::destroyGeometry( XAbstractGeometry *geometry )
+    {
+    // pending draws keep their own transformed copy of the vertices.
+    delete geometry;
+    }
+
+void XSoftwareRenderer::destroyTexture( XAbstractTexture *texture )
+    {
+    delete texture;
+    }
+
+void XSoftwareRenderer::destroyFramebuffer( XAbstractFramebuffer *fb )
+    {
+    if( fb == _currentFramebuffer )
+        {
+        flush();
+        _currentFramebuffer = 0;
+        }
+    delete fb;
+    }
+
+//----------------------------------------------------------------------------------------------------------------------
+// TEXTURE
+//----------------------------------------------------------------------------------------------------------------------
+
+XSoftwareTexture::XSoftwareTexture( XSoftwareRenderer *r ) : _renderer( r ), _width( 0 )
+    {
+    }
+
+XSoftwareTexture::XSoftwareTexture( XSoftwareRenderer *r, bool depth, int width, int height ) : _renderer( r ), _width( width )
+    {
+    if( depth )
+        {
+        _depth.fill( 1.0f, width * height );
+        }
+    else
+        {
+        _image = QImage( width, height, QImage::Format_ARGB32 );
+        _image.fill( 0 );
+        }
+    }
+
+void XSoftwareTexture::load( const QImage &im )
+    {
+    _image = im.convertToFormat( QImage::Format_ARGB32 );
+    _depth.clear();
+    _width = _image.width();
+    }
+
+QImage XSoftwareTexture::save( )
+    {
+    // the texture may be drawn to, so finish first.
+    _renderer->flush();
+
+    if( _depth.isEmpty() )
+        {
+        return _image;
+        }
+
+    int height = _depth.size() / _width;
+    QImage ret( _width, height, QImage::Format_RGB32 );
+    for( int y=0; y<height; ++y )
+        {
+        QRgb *row = reinterpret_cast<QRgb *>( ret.scanLine( y ) );
+        const float *depth = _depth.constData() + y * _width;
+        for( int x=0; x<_width; ++x )
+            {
+            int grey = toByte( depth[x] );
+            row[x] = qRgb( grey, grey, grey );
+            }
+        }
+    return ret;
+    }
+
+//----------------------------------------------------------------------------------------------------------------------
+// FRAMEBUFFER
+//----------------------------------------------------------------------------------------------------------------------
+
+XSoftwareFramebuffer::XSoftwareFramebuffer( XSoftwareRenderer *r, int options, int width, int height )
+    : _width( xMax( width, 0 ) ), _height( xMax( height, 0 ) ), _colour( 0 ), _depth( 0 )
+  {
+  if( (options&XFramebuffer::Colour) != false )
+    {
+    _colour = new XSoftwareTexture( r, false, _width, _height );
+    }
+
+  if( (options&XFramebuffer::Depth) != false )
+    {
+    _depth = new XSoftwareTexture( r, true, _width, _height );
+    }
+  }
+
+XSoftwareFramebuffer::~XSoftwareFramebuffer( )
+  {
+  delete _colour;
+  delete _depth;
+  }
+
+bool XSoftwareFramebuffer::isValid() const
+  {
+  return _width > 0 && _height > 0 && ( _colour || _depth );
+  }
+
+const XAbstractTexture *XSoftwareFramebuffer::colour() const
+  {
+  return _colour;
+  }
+
+const XAbstractTexture *XSoftwareFramebuffer::depth() const
+  {
+  return _depth;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+// SHADER
+//----------------------------------------------------------------------------------------------------------------------
+
+XSoftwareShader::XSoftwareShader( XSoftwareRenderer *renderer ) : XAbstractShader( renderer ), _type( XShader::Default )
+    {
+    }
+
+void XSoftwareShader::setType( int type )
+    {
+    _type = type;
+    }
+
+XAbstractShaderVariable *XSoftwareShader::createVariable( QString in, XAbstractShader *s )
+    {
+    XSoftwareShaderVariable *var = new XSoftwareShaderVariable( s, in );
+    static_cast<XSoftwareShader*>(s)->_variables.insert( in, var );
+    return var;
+    }
+
+void XSoftwareShader::destroyVariable( XAbstractShaderVariable *var )
+    {
+    XSoftwareShaderVariable *softwareVar = static_cast<XSoftwareShaderVariable*>(var);
+    _variables.remove( softwareVar->_name );
+    delete var;
+    }
+
+QByteArray XSoftwareShader::save()
+    {
+    return QByteArray();
+    }
+
+void XSoftwareShader::load( QByteArray )
+    {
+    }
+
+//----------------------------------------------------------------------------------------------------------------------
+// SHADER VARIABLE
+//----------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+void append( XVector<float> &out, int value )
+  {
+  out << (float)value;
+  }
+
+void append( XVector<float> &out, xReal value )
+  {
+  out << value;
+  }
+
+void append( XVector<float> &out, unsigned int value )
+  {
+  out << (float)value;
+  }
+
+template <typename Derived> void append( XVector<float> &out, const Eigen::MatrixBase<Derived> &value )
+  {
+  for( int i=0; i<value.size(); ++i )
+    {
+    out << value(i);
+    }
+  }
+
+template <int N, int M> void append( XVector<float> &out, const QGenericMatrix<N, M, qreal> &value )
+  {
+  const qreal *data = value.constData();
+  for( int i=0; i<N*M; ++i )
+    {
+    out << (float)data[i];
+    }
+  }
+
+void append( XVector<float> &out, const QMatrix4x4 &value )
+  {
+  const qreal *data = value.constData();
+  for( int i=0; i<16; ++i )
+    {
+    out << (float)data[i];
+    }
+  }
+}
+
+XSoftwareShaderVariable::XSoftwareShaderVariable( XAbstractShader *s, QString name )
+    : XAbstractShaderVariable( s ), _name( name ), _texture( 0 )
+  {
+  }
+
+XSoftwareShaderVariable::~XSoftwareShaderVariable( )
+  {
+  delete _texture;
+  }
+
+template <typename T> void XSoftwareShaderVariable::set( const T &value )
+  {
+  clear();
+  append( _values, value );
+  }
+
+template <typename T> void XSoftwareShaderVariable::setArray( const XVector<T> &values )
+  {
+  clear();
+  foreach( const T &value, values )
+    {
+    append( _values, value );
+    }
+  }
+
+void XSoftwareShaderVariable::setValue( int value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( xReal value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( unsigned int value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const XColour &value )
+  {
+  set( static_cast<const XVector4D &>(value) );
+  }
+
+void XSoftwareShaderVariable::setValue( const XVector2D &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const XVector3D &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const XVector4D &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix2x2 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix2x3 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix2x4 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix3x2 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix3x3 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix3x4 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix4x2 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix4x3 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const QMatrix4x4 &value )
+  {
+  set( value );
+  }
+
+void XSoftwareShaderVariable::setValue( const XTexture &value )
+  {
+  clear();
+  _texture = new XTexture( value );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<int> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<xReal> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<unsigned int> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<XColour> &values )
+  {
+  clear();
+  foreach( const XColour &value, values )
+    {
+    append( _values, static_cast<const XVector4D &>(value) );
+    }
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<XVector2D> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<XVector3D> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<XVector4D> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix2x2> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix2x3> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix2x4> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix3x2> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix3x3> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix3x4> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix4x2> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix4x3> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::setValueArray( const XVector<QMatrix4x4> &values )
+  {
+  setArray( values );
+  }
+
+void XSoftwareShaderVariable::rebind()
+  {
+  // values are looked up by name as each draw is recorded.
+  }
+
+void XSoftwareShaderVariable::clear()
+  {
+  delete _texture;
+  _texture = 0;
+  _values.clear();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+// GEOMETRY CACHE
+//----------------------------------------------------------------------------------------------------------------------
+
+XSoftwareGeometryCache::XSoftwareGeometryCache( ) : _vertexCount( 0 )
+    {
+    }
+
+void XSoftwareGeometryCache::setPoints( const XVector<unsigned int> &poi )
+    {
+    _points = poi;
+    }
+
+void XSoftwareGeometryCache::setLines( const XVector<unsigned int> &lin )
+    {
+    _lines = lin;
+    }
+
+void XSoftwareGeometryCache::setTriangles( const XVector<unsigned int> &tri )
+    {
+    _triangles = tri;
+    }
+
+void XSoftwareGeometryCache::setPoints( const unsigned int *poi, int count )
+    {
+    _points.resize( count );
+    memcpy( _points.data(), poi, sizeof(unsigned int) * count );
+    }
+
+void XSoftwareGeometryCache::setLines( const unsigned int *lin, int count )
+    {
+    _lines.resize( count );
+    memcpy( _lines.data(), lin, sizeof(unsigned int) * count );
+    }
+
+void XSoftwareGeometryCache::setTriangles( const unsigned int *tri, int count )
+    {
+    _triangles.resize( count );
+    memcpy( _triangles.data(), tri, sizeof(unsigned int) * count );
+    }
+
+void XSoftwareGeometryCache::setAttributesSize( int s, int, int, int, int )
+    {
+    _attributes.clear();
+    _vertexCount = s;
+    }
+
+void XSoftwareGeometryCache::setAttribute( QString name, const XVector<xReal> &attr )
+    {
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 1, 0, attr.size() );
+    }
+
+void XSoftwareGeometryCache::setAttribute( QString name, const XVector<XVector2D> &attr )
+    {
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 2, 0, attr.size() );
+    }
+
+void XSoftwareGeometryCache::setAttribute( QString name, const XVector<XVector3D> &attr )
+    {
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 3, 0, attr.size() );
+    }
+
+void XSoftwareGeometryCache::setAttribute( QString name, const XVector<XVector4D> &attr )
+    {
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 4, 0, attr.size() );
+    }
+
+void XSoftwareGeometryCache::setAttribute( QString name, const xReal *attr, int components, int count )
+    {
+    writeAttribute( name, attr, components, 0, count );
+    }
+
+void XSoftwareGeometryCache::setAttributeRange( QString name, const XVector<xReal> &attr, int first, int count )
+    {
+    xAssert( first >= 0 && first + count <= attr.size() );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 1, first, count );
+    }
+
+void XSoftwareGeometryCache::setAttributeRange( QString name, const XVector<XVector2D> &attr, int first, int count )
+    {
+    xAssert( first >= 0 && first + count <= attr.size() );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 2, first, count );
+    }
+
+void XSoftwareGeometryCache::setAttributeRange( QString name, const XVector<XVector3D> &attr, int first, int count )
+    {
+    xAssert( first >= 0 && first + count <= attr.size() );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 3, first, count );
+    }
+
+void XSoftwareGeometryCache::setAttributeRange( QString name, const XVector<XVector4D> &attr, int first, int count )
+    {
+    xAssert( first >= 0 && first + count <= attr.size() );
+    writeAttribute( name, reinterpret_cast<const float *>(attr.constData()), 4, first, count );
+    }
+
+void XSoftwareGeometryCache::writeAttribute( const QString &name, const float *data, int components, int first, int count )
+    {
+    if( count <= 0 )
+        {
+        return;
+        }
+
+    Attribute &attr = _attributes[name];
+    if( attr.components != components )
+        {
+        attr.components = components;
+        attr.data.clear();
+        }
+
+    int size = ( first + count ) * components;
+    if( attr.data.size() < size )
+        {
+        attr.data.resize( size );
+        }
+    memcpy( attr.data.data() + first * components, data + first * components, sizeof(float) * count * components );
+
+    _vertexCount = xMax( _vertexCount, first + count );
+    }
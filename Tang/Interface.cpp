@@ -2,11 +2,15 @@
 #include "QApplication"
 #include "QTcpSocket"
 #include "QHostAddress"
+#include "XEnvironmentCodec.h"
 
 #define X_NULL_ITEM_ID (ItemID)-1
 
 Interface::Interface() : _readingLength(X_UINT64_SENTINEL)
   {
+  // bytes of item data kept to apply deltas to.
+  _bases.setMaxCost(64 * 1024 * 1024);
+
   _socket = new QTcpSocket(this);
 
   _socket->connectToHost(QHostAddress::LocalHost, 16161, QIODevice::ReadWrite);
@@ -38,8 +42,7 @@ void Interface::requestReady()
 
       qDebug() << "Parse complete transmission for item" << request.type() << request.ID() << request.subType();
 
-      controller()->setData(request, request.extraData());
-      controller()->requestComplete(request.requestID());
+      receive(request);
 
       complete = true;
       _readingLength = X_UINT64_SENTINEL;
@@ -47,6 +50,93 @@ void Interface::requestReady()
     } while(complete && _socket->bytesAvailable() != 0);
   }
 
+Interface::BaseKey Interface::baseKey( const ItemRequest &request )
+  {
+  return BaseKey(((xuint32)request.type() << 16) | request.subType(), request.ID());
+  }
+
+bool Interface::findBase( const ItemRequest &request, xuint32 version, QByteArray &data )
+  {
+  Base *base = _bases.object(baseKey(request));
+  if(base && base->version == version)
+    {
+    data = base->data;
+    return true;
+    }
+
+  // we may have it from an earlier run.
+  return controller()->cachedData(request, version, data);
+  }
+
+Interface::ItemRequest Interface::versioned( const ItemRequest &request )
+  {
+  // tell the server what we hold, it can send a delta or nothing at all.
+  ItemRequest r(request);
+  Base *base = _bases.object(baseKey(request));
+  if(base && base->version > r.version())
+    {
+    r.setVersion(base->version);
+    }
+  return r;
+  }
+
+void Interface::receive( ItemRequest &request )
+  {
+  if(request.type() == XEnvironment::SpecialType && request.subType() == XEnvironment::Batch)
+    {
+    QDataStream str(request.extraData());
+    while(!str.atEnd())
+      {
+      xuint64 size;
+      ItemRequest inner;
+      str >> size >> inner;
+      if(str.status() != QDataStream::Ok)
+        {
+        qWarning() << "Malformed batch from server";
+        return;
+        }
+      receive(inner);
+      }
+    return;
+    }
+
+  if(request.type() != XEnvironment::SpecialType)
+    {
+    XEnvironmentCodec::Encoding encoding = (XEnvironmentCodec::Encoding)request.encoding();
+    bool relative = encoding == XEnvironmentCodec::Delta || encoding == XEnvironmentCodec::Unchanged;
+
+    QByteArray base;
+    if(relative && !findBase(request, request.baseVersion(), base))
+      {
+      // made against a version we no longer hold, ask for all of it.
+      _requests << ItemRequest(request.type(), request.ID(), request.subType(), request.requestID());
+      pollPendingRequests();
+      return;
+      }
+
+    QByteArray data;
+    if(!XEnvironmentCodec::decode(request.extraData(), encoding, base, data))
+      {
+      qWarning() << "Undecodable data for item" << request.type() << request.ID() << request.subType();
+      return;
+      }
+
+    if(data.size())
+      {
+      Base *received = new Base;
+      received->version = request.version();
+      received->data = data;
+      _bases.insert(baseKey(request), received, data.size());
+      }
+
+    request.setExtraData(data);
+    request.setEncoding(XEnvironmentCodec::Raw);
+    }
+
+  // decoded off this thread, the controller installs it on its next update.
+  controller()->receive(request);
+  }
+
 void Interface::onConnected()
   {
   pollPendingRequests();
@@ -54,11 +144,10 @@ void Interface::onConnected()
 
 void Interface::pollPendingRequests()
   {
-  QDataStream str(_socket);
-
+  QList<ItemRequest> outgoing;
   while(_requests.size())
     {
-    str << _requests.back().saveSize() << _requests.back();
+    outgoing << _requests.back();
     _requests.removeLast();
     }
 
@@ -71,11 +160,33 @@ void Interface::pollPendingRequests()
 
     if(correct)
       {
-      r.setExtraData(data);
-      str << r.saveSize() << r;
+      XEnvironmentCodec::Encoding encoding;
+      r.setExtraData(XEnvironmentCodec::encode(data, QByteArray(), &encoding));
+      r.setEncoding(encoding);
+      outgoing << r;
       }
     _syncRequests.removeLast();
     }
+
+  QDataStream str(_socket);
+  if(outgoing.size() == 1)
+    {
+    str << outgoing.front().saveSize() << outgoing.front();
+    }
+  else if(outgoing.size() > 1)
+    {
+    // many requests go as one message.
+    QByteArray frames;
+    QDataStream batchStr(&frames, QIODevice::WriteOnly);
+    foreach(const ItemRequest &r, outgoing)
+      {
+      batchStr << r.saveSize() << r;
+      }
+
+    ItemRequest batch(XEnvironment::SpecialType, 0, XEnvironment::Batch);
+    batch.setExtraData(frames);
+    str << batch.saveSize() << batch;
+    }
   }
 
 void Interface::poll()
@@ -85,7 +196,17 @@ void Interface::poll()
 
 void Interface::requestItem( const ItemRequest &request )
   {
-  _requests << request;
+  _requests << versioned(request);
+  pollPendingRequests();
+  }
+
+void Interface::requestItems( const XList<ItemRequest> &requests )
+  {
+  // queued together, so they go in one batch.
+  foreach(const ItemRequest &request, requests)
+    {
+    _requests << versioned(request);
+    }
   pollPendingRequests();
   }
 
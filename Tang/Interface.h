@@ -5,6 +5,8 @@ class QTcpSocket;
 
 #include "QList"
 #include "QDataStream"
+#include "QCache"
+#include "QPair"
 
 #include "XModeller.h"
 #include "XShader.h"
@@ -24,6 +26,7 @@ public:
   virtual void poll();
 
   virtual void requestItem( const ItemRequest & );
+  virtual void requestItems( const XList<ItemRequest> & );
   virtual void syncItem( const ItemRequest & );
 
 private slots:
@@ -31,11 +34,25 @@ private slots:
   void onConnected();
 
 private:
+  // the last data received for an item, deltas from the server are made against it.
+  struct Base
+    {
+    xuint32 version;
+    QByteArray data;
+    };
+  typedef QPair<xuint32, ItemID> BaseKey;
+  static BaseKey baseKey( const ItemRequest & );
+  bool findBase( const ItemRequest &, xuint32 version, QByteArray &data );
+  ItemRequest versioned( const ItemRequest & );
+
+  void receive( ItemRequest & );
+  void pollPendingRequests();
+
   QTcpSocket *_socket;
   QList<ItemRequest> _requests;
   QList<ItemRequest> _syncRequests;
   xuint64 _readingLength;
-  void pollPendingRequests();
+  QCache<BaseKey, Base> _bases;
   };
 
 
@@ -1,7 +1,12 @@
 #include "application.h"
+#include "QDesktopServices"
+#include "QDir"
 
 Application::Application() : _environment(&_dataInterface, this)
   {
+  // items from earlier runs are used again once the server confirms they're current.
+  _environment.setDiskCache(QDesktopServices::storageLocation(QDesktopServices::CacheLocation) + QDir::separator() + "EnvironmentCache");
+  _environment.validateDiskCache();
   }
 
 void Application::onRequestComplete(const XEnvironment::Request &request)
@@ -9,6 +14,17 @@ void Application::onRequestComplete(const XEnvironment::Request &request)
   emit requestComplete(request);
   }
 
+void Application::onRequestsDecoded()
+  {
+  // called on a decode thread, install the data on ours.
+  QMetaObject::invokeMethod(this, "updateEnvironment", Qt::QueuedConnection);
+  }
+
+void Application::updateEnvironment()
+  {
+  _environment.update();
+  }
+
 void Application::createContainer(XEnvironment::ItemID parentID)
   {
   XEnvironment::ItemID id = _environment.createItem(XEnvironment::ContainerType);
@@ -23,8 +23,12 @@ signals:
   void dataChanged(const XEnvironment::Request &request);
   void requestComplete(const XEnvironment::Request &request);
 
+private slots:
+  void updateEnvironment();
+
 private:
   virtual void onRequestComplete(const XEnvironmentRequest &request);
+  virtual void onRequestsDecoded();
   };
 
 #endif // APPLICATION_H
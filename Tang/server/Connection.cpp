@@ -0,0 +1,91 @@
+#include "Connection.h"
+#include "QTcpSocket"
+#include "QDataStream"
+#include "QDebug"
+
+Connection::Connection(QTcpSocket *socket, QObject *parent) : QObject(parent), _socket(socket),
+    _readingLength(X_UINT64_SENTINEL), _paused(false), _queuedBytes(0)
+  {
+  _socket->setParent(this);
+  // bound what the socket buffers for us between requests, so a client that floods us is throttled by TCP.
+  _socket->setReadBufferSize(HighWater);
+
+  connect(_socket, SIGNAL(readyRead()), this, SLOT(readRequests()));
+  connect(_socket, SIGNAL(bytesWritten(qint64)), this, SLOT(flush()));
+  connect(_socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+  }
+
+void Connection::send(const QByteArray &buffer)
+  {
+  _queue << buffer;
+  _queuedBytes += buffer.size();
+  flush();
+  }
+
+void Connection::readRequests()
+  {
+  QDataStream str(_socket);
+  while(!_paused)
+    {
+    if(_readingLength == X_UINT64_SENTINEL)
+      {
+      if(_socket->bytesAvailable() < (qint64)sizeof(xuint64))
+        {
+        break;
+        }
+      str >> _readingLength;
+
+      if(_readingLength > MaximumRequest)
+        {
+        qWarning() << "Request of" << _readingLength << "bytes is too large, dropping client";
+        _socket->abort();
+        return;
+        }
+
+      // the buffer has to hold the whole of a large request, or we would wait for it forever.
+      if(_readingLength > HighWater)
+        {
+        _socket->setReadBufferSize(_readingLength);
+        }
+      }
+
+    if((xuint64)_socket->bytesAvailable() < _readingLength)
+      {
+      break;
+      }
+
+    XEnvironmentRequest request;
+    str >> request;
+    if(_readingLength > HighWater)
+      {
+      _socket->setReadBufferSize(HighWater);
+      }
+    _readingLength = X_UINT64_SENTINEL;
+
+    emit requestReceived(this, request);
+
+    // the replies to this client are backing up, leave the rest of its requests until they drain.
+    _paused = _queuedBytes > HighWater;
+    }
+  }
+
+void Connection::flush()
+  {
+  while(!_queue.isEmpty() && _socket->bytesToWrite() < SocketWindow)
+    {
+    QByteArray buffer = _queue.takeFirst();
+    _queuedBytes -= buffer.size();
+    _socket->write(buffer);
+    }
+
+  if(_paused && _queuedBytes < LowWater)
+    {
+    _paused = false;
+    readRequests();
+    }
+  }
+
+void Connection::onDisconnected()
+  {
+  emit disconnected(this);
+  }
@@ -0,0 +1,54 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include "QObject"
+#include "QList"
+#include "QByteArray"
+#include "XEnvironmentRequest.h"
+
+class QTcpSocket;
+
+// A client socket with its own request framing and outgoing queue. Outgoing buffers are shared,
+// so one serialised item can be queued on every subscribed connection without copying.
+class Connection : public QObject
+  {
+  Q_OBJECT
+
+public:
+  enum
+    {
+    // stop reading requests while more than this is waiting to be sent, resume below LowWater.
+    HighWater = 4 * 1024 * 1024,
+    LowWater = 1024 * 1024,
+    // most bytes handed to the socket at once, the rest wait in our queue.
+    SocketWindow = 256 * 1024,
+    // largest request a client may announce, anything bigger is a broken or hostile client.
+    MaximumRequest = 64 * 1024 * 1024
+    };
+
+  Connection(QTcpSocket *socket, QObject *parent);
+
+  QTcpSocket *socket() const { return _socket; }
+  xuint64 queuedBytes() const { return _queuedBytes; }
+
+  void send(const QByteArray &buffer);
+
+signals:
+  void requestReceived(Connection *connection, const XEnvironmentRequest &request);
+  void disconnected(Connection *connection);
+
+private slots:
+  void readRequests();
+  void flush();
+  void onDisconnected();
+
+private:
+  QTcpSocket *_socket;
+  xuint64 _readingLength;
+  bool _paused;
+
+  QList<QByteArray> _queue;
+  xuint64 _queuedBytes;
+  };
+
+#endif // CONNECTION_H
@@ -0,0 +1,155 @@
+#include "ItemCache.h"
+
+ItemCache::ItemCache(xuint64 budget) : _budget(budget), _bytes(0), _hits(0), _misses(0), _evictions(0), _hand(0)
+  {
+  }
+
+void ItemCache::setBudget(xuint64 budget)
+  {
+  _budget = budget;
+  evict();
+  }
+
+bool ItemCache::find(const ItemKey &key, QByteArray &data, xuint32 *version)
+  {
+  QHash<ItemKey, int>::const_iterator it = _index.find(key);
+  if(it == _index.end())
+    {
+    ++_misses;
+    return false;
+    }
+
+  Entry &entry = _entries[it.value()];
+  entry.referenced = true;
+  data = entry.data;
+  if(version)
+    {
+    *version = entry.version;
+    }
+  ++_hits;
+  return true;
+  }
+
+void ItemCache::insert(const ItemKey &key, const QByteArray &data, xuint32 version)
+  {
+  QHash<ItemKey, int>::const_iterator it = _index.find(key);
+  int slot;
+  if(it != _index.end())
+    {
+    slot = it.value();
+    // a read started before a newer version was set, keep the newer one.
+    if(version < _entries[slot].version)
+      {
+      return;
+      }
+    _bytes -= _entries[slot].data.size();
+    }
+  else
+    {
+    if(_freeSlots.size())
+      {
+      slot = _freeSlots.back();
+      _freeSlots.pop_back();
+      }
+    else
+      {
+      slot = _entries.size();
+      _entries.resize(slot + 1);
+      }
+    _index.insert(key, slot);
+    }
+
+  Entry &entry = _entries[slot];
+  entry.key = key;
+  entry.data = data;
+  entry.version = version;
+  entry.used = true;
+  entry.referenced = true;
+  entry.pinned = _pinned.contains(key);
+  _bytes += data.size();
+
+  evict();
+  }
+
+void ItemCache::remove(const ItemKey &key)
+  {
+  QHash<ItemKey, int>::const_iterator it = _index.find(key);
+  if(it != _index.end())
+    {
+    release(it.value());
+    }
+  }
+
+void ItemCache::pin(const ItemKey &key)
+  {
+  _pinned << key;
+  QHash<ItemKey, int>::const_iterator it = _index.find(key);
+  if(it != _index.end())
+    {
+    _entries[it.value()].pinned = true;
+    }
+  }
+
+void ItemCache::unpin(const ItemKey &key)
+  {
+  _pinned.remove(key);
+  QHash<ItemKey, int>::const_iterator it = _index.find(key);
+  if(it != _index.end())
+    {
+    _entries[it.value()].pinned = false;
+    evict();
+    }
+  }
+
+ItemCache::Stats ItemCache::stats() const
+  {
+  Stats s;
+  s.hits = _hits;
+  s.misses = _misses;
+  s.evictions = _evictions;
+  s.bytesResident = _bytes;
+  s.items = _index.size();
+  return s;
+  }
+
+void ItemCache::evict()
+  {
+  // two full sweeps clear every referenced bit, if we're still over budget everything left is pinned.
+  int remaining = _entries.size() * 2;
+  while(_bytes > _budget && remaining-- > 0)
+    {
+    if(_hand >= _entries.size())
+      {
+      _hand = 0;
+      }
+
+    int slot = _hand++;
+    Entry &entry = _entries[slot];
+    if(!entry.used || entry.pinned)
+      {
+      continue;
+      }
+
+    if(entry.referenced)
+      {
+      entry.referenced = false;
+      continue;
+      }
+
+    release(slot);
+    ++_evictions;
+    }
+  }
+
+void ItemCache::release(int slot)
+  {
+  Entry &entry = _entries[slot];
+  _index.remove(entry.key);
+  _bytes -= entry.data.size();
+
+  entry.data = QByteArray();
+  entry.used = false;
+  entry.referenced = false;
+  entry.pinned = false;
+  _freeSlots << slot;
+  }
@@ -0,0 +1,84 @@
+#ifndef ITEMCACHE_H
+#define ITEMCACHE_H
+
+#include "QHash"
+#include "QSet"
+#include "QVector"
+#include "QByteArray"
+#include "XEnvironmentRequest.h"
+
+// identifies one stored item, as (type, ID, subType).
+struct ItemKey
+  {
+  xuint16 type;
+  XEnvironmentID ID;
+  xuint16 subType;
+
+  ItemKey(xuint16 t, XEnvironmentID id, xuint16 s) : type(t), ID(id), subType(s) { }
+  ItemKey(const XEnvironmentRequest &r) : type(r.type()), ID(r.ID()), subType(r.subType()) { }
+  bool operator==(const ItemKey &k) const { return type == k.type && ID == k.ID && subType == k.subType; }
+  friend uint qHash(const ItemKey &k) { return qHash(k.ID) ^ (k.type << 16) ^ k.subType; }
+  };
+
+// Item data held in memory up to a byte budget. When over budget, unpinned items are evicted by
+// CLOCK: the hand sweeps the entries, clearing the referenced bit of recently used ones and
+// evicting the first it finds unreferenced.
+class ItemCache
+  {
+public:
+  struct Stats
+    {
+    xuint64 hits;
+    xuint64 misses;
+    xuint64 evictions;
+    xuint64 bytesResident;
+    xuint32 items;
+    };
+
+  ItemCache(xuint64 budget);
+
+  xuint64 budget() const { return _budget; }
+  void setBudget(xuint64 budget);
+
+  // returns true and fills [data], and [version] if given, if [key] is cached.
+  bool find(const ItemKey &key, QByteArray &data, xuint32 *version = 0);
+  // replaces any cached data for [key], unless what is cached is a newer version.
+  void insert(const ItemKey &key, const QByteArray &data, xuint32 version = 0);
+  void remove(const ItemKey &key);
+
+  // pinned items are never evicted, the key can be pinned before it is cached.
+  void pin(const ItemKey &key);
+  void unpin(const ItemKey &key);
+
+  Stats stats() const;
+
+private:
+  struct Entry
+    {
+    ItemKey key;
+    QByteArray data;
+    xuint32 version;
+    bool used;
+    bool referenced;
+    bool pinned;
+
+    Entry() : key(0, 0, 0), version(0), used(false), referenced(false), pinned(false) { }
+    };
+
+  void evict();
+  void release(int slot);
+
+  xuint64 _budget;
+  xuint64 _bytes;
+  xuint64 _hits;
+  xuint64 _misses;
+  xuint64 _evictions;
+
+  QVector<Entry> _entries;
+  QVector<int> _freeSlots;
+  QHash<ItemKey, int> _index;
+  QSet<ItemKey> _pinned;
+  int _hand;
+  };
+
+#endif // ITEMCACHE_H
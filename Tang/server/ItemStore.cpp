@@ -0,0 +1,494 @@
+#include "ItemStore.h"
+#include "QFile"
+#include "QDir"
+#include "QDataStream"
+#include "QStringList"
+#include "QDebug"
+#include "string.h"
+
+namespace
+{
+const xuint32 RecordMagic = 0x32455249; // "IRE2"
+const xuint32 SnapshotMagic = 0x50534E53; // "SNSP"
+const xuint32 SnapshotVersion = 2;
+}
+
+ItemStore::ItemStore(const QString &directory, xuint64 segmentSize) : _directory(directory), _segmentSize(segmentSize),
+    _activeID(0), _activeWrite(0)
+  {
+  }
+
+ItemStore::~ItemStore()
+  {
+  close();
+  }
+
+QString ItemStore::segmentPath(xuint32 id) const
+  {
+  return _directory + QDir::separator() + QString("segment%1.dat").arg(id, 8, 10, QChar('0'));
+  }
+
+QString ItemStore::snapshotPath() const
+  {
+  return _directory + QDir::separator() + "index.dat";
+  }
+
+bool ItemStore::open()
+  {
+  if(!QDir::root().mkpath(_directory))
+    {
+    return false;
+    }
+
+  QStringList files = QDir(_directory).entryList(QStringList() << "segment*.dat", QDir::Files, QDir::Name);
+  foreach(const QString &file, files)
+    {
+    bool ok = false;
+    xuint32 id = file.mid(7, file.length() - 11).toUInt(&ok);
+    if(ok)
+      {
+      openSegment(id);
+      }
+    }
+
+  // load what we can from the snapshot, then read the records written after it.
+  QHash<xuint32, xuint64> covered;
+  if(!loadSnapshot(covered))
+    {
+    _index.clear();
+    _nextID.clear();
+    covered.clear();
+    foreach(Segment *segment, _segments)
+      {
+      segment->liveBytes = 0;
+      }
+    }
+
+  for(QMap<xuint32, Segment *>::const_iterator it = _segments.begin(); it != _segments.end(); ++it)
+    {
+    scanSegment(it.key(), covered.value(it.key(), 0));
+    }
+
+  // continue appending to the last segment if it has space.
+  if(_segments.isEmpty() || _segments.last()->size >= _segmentSize)
+    {
+    _activeID = _segments.isEmpty() ? 0 : _segments.lastKey() + 1;
+    openSegment(_activeID);
+    }
+  else
+    {
+    _activeID = _segments.lastKey();
+    }
+
+  Segment *active = _segments[_activeID];
+  if(active->map)
+    {
+    active->file->unmap(const_cast<uchar *>(active->map));
+    active->map = 0;
+    }
+
+  _activeWrite = new QFile(segmentPath(_activeID));
+  return _activeWrite->open(QIODevice::WriteOnly | QIODevice::Append);
+  }
+
+void ItemStore::close()
+  {
+  if(!_activeWrite)
+    {
+    return;
+    }
+
+  saveSnapshot();
+
+  delete _activeWrite;
+  _activeWrite = 0;
+
+  foreach(Segment *segment, _segments)
+    {
+    delete segment->file;
+    delete segment;
+    }
+  _segments.clear();
+  _index.clear();
+  }
+
+ItemStore::Segment *ItemStore::openSegment(xuint32 id)
+  {
+  Segment *segment = new Segment;
+  segment->file = new QFile(segmentPath(id));
+
+  // create it if needed, reads are unbuffered so they see appends as soon as they are flushed.
+  if(!segment->file->exists())
+    {
+    segment->file->open(QIODevice::WriteOnly);
+    segment->file->close();
+    }
+  segment->file->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+  segment->size = segment->file->size();
+  if(segment->size)
+    {
+    segment->map = segment->file->map(0, segment->size);
+    }
+
+  _segments.insert(id, segment);
+  return segment;
+  }
+
+void ItemStore::sealActive()
+  {
+  _activeWrite->close();
+  delete _activeWrite;
+
+  Segment *sealed = _segments[_activeID];
+  xuint32 next = _activeID + 1;
+
+  QWriteLocker l(&_lock);
+  if(sealed->size)
+    {
+    sealed->map = sealed->file->map(0, sealed->size);
+    }
+
+  openSegment(next);
+  _activeID = next;
+  _activeWrite = new QFile(segmentPath(_activeID));
+  _activeWrite->open(QIODevice::WriteOnly | QIODevice::Append);
+  }
+
+void ItemStore::scanSegment(xuint32 id, xuint64 from)
+  {
+  Segment *segment = _segments[id];
+  QFile file(segmentPath(id));
+  if(!file.open(QIODevice::ReadOnly))
+    {
+    return;
+    }
+
+  xuint64 fileSize = file.size();
+  xuint64 offset = from;
+  file.seek(offset);
+  while(offset + sizeof(RecordHeader) <= fileSize)
+    {
+    RecordHeader header;
+    if(file.read(reinterpret_cast<char *>(&header), sizeof(RecordHeader)) != sizeof(RecordHeader) ||
+       header.magic != RecordMagic ||
+       offset + sizeof(RecordHeader) + header.length > fileSize)
+      {
+      break;
+      }
+
+    QByteArray data = file.read(header.length);
+    if(qChecksum(data.constData(), data.size()) != header.checksum)
+      {
+      break;
+      }
+
+    Location location = { id, (xuint32)offset, header.length, header.version };
+    setLocation(ItemKey(header.type, header.ID, header.subType), location);
+
+    ItemID &next = _nextID[header.type];
+    next = xMax(next, header.ID + 1);
+
+    offset += sizeof(RecordHeader) + header.length;
+    }
+
+  if(offset < fileSize)
+    {
+    // a torn write from a crash, drop it so appends continue from a valid record.
+    qWarning() << "Truncating damaged item segment" << segmentPath(id) << "at" << offset;
+    file.close();
+    if(segment->map)
+      {
+      segment->file->unmap(const_cast<uchar *>(segment->map));
+      segment->map = 0;
+      }
+    QFile::resize(segmentPath(id), offset);
+    }
+
+  segment->size = offset;
+  }
+
+bool ItemStore::loadSnapshot(QHash<xuint32, xuint64> &covered)
+  {
+  QFile file(snapshotPath());
+  if(!file.open(QIODevice::ReadOnly))
+    {
+    return false;
+    }
+
+  QDataStream str(&file);
+  xuint32 magic = 0;
+  xuint32 version = 0;
+  str >> magic >> version;
+  if(magic != SnapshotMagic || version != SnapshotVersion)
+    {
+    return false;
+    }
+
+  xuint32 segmentCount = 0;
+  str >> segmentCount;
+  for(xuint32 i=0; i<segmentCount; ++i)
+    {
+    xuint32 id;
+    xuint64 size;
+    xuint64 liveBytes;
+    str >> id >> size >> liveBytes;
+
+    // the snapshot must describe the segments as they are, or its locations can't be trusted.
+    QMap<xuint32, Segment *>::const_iterator segment = _segments.find(id);
+    if(segment == _segments.end() || segment.value()->size < size)
+      {
+      return false;
+      }
+    segment.value()->liveBytes = liveBytes;
+    covered.insert(id, size);
+    }
+
+  str >> _nextID;
+
+  xuint32 itemCount = 0;
+  str >> itemCount;
+  _index.reserve(itemCount);
+  for(xuint32 i=0; i<itemCount && str.status() == QDataStream::Ok; ++i)
+    {
+    xuint16 type;
+    ItemID ID;
+    xuint16 subType;
+    Location location;
+    str >> type >> ID >> subType >> location.segment >> location.offset >> location.length >> location.version;
+    _index.insert(ItemKey(type, ID, subType), location);
+    }
+
+  return str.status() == QDataStream::Ok;
+  }
+
+void ItemStore::saveSnapshot()
+  {
+  QString tempPath = snapshotPath() + ".tmp";
+  QFile file(tempPath);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+    return;
+    }
+
+  QDataStream str(&file);
+  str << SnapshotMagic << SnapshotVersion;
+
+  str << (xuint32)_segments.size();
+  for(QMap<xuint32, Segment *>::const_iterator it = _segments.begin(); it != _segments.end(); ++it)
+    {
+    str << it.key() << it.value()->size << it.value()->liveBytes;
+    }
+
+  str << _nextID;
+
+  str << (xuint32)_index.size();
+  for(QHash<ItemKey, Location>::const_iterator it = _index.begin(); it != _index.end(); ++it)
+    {
+    const ItemKey &key = it.key();
+    const Location &location = it.value();
+    str << key.type << key.ID << key.subType << location.segment << location.offset << location.length << location.version;
+    }
+
+  file.close();
+
+  // replace the old snapshot only once the new one is complete.
+  QFile::remove(snapshotPath());
+  QFile::rename(tempPath, snapshotPath());
+  }
+
+bool ItemStore::read(const ItemKey &key, QByteArray &data, xuint32 *version) const
+  {
+  QReadLocker l(&_lock);
+  QHash<ItemKey, Location>::const_iterator it = _index.find(key);
+  if(it == _index.end())
+    {
+    return false;
+    }
+
+  const Location &location = it.value();
+  if(version)
+    {
+    *version = location.version;
+    }
+
+  const Segment *segment = _segments.value(location.segment);
+  xAssert(segment);
+
+  xuint64 offset = location.offset + sizeof(RecordHeader);
+  if(segment->map)
+    {
+    data = QByteArray(reinterpret_cast<const char *>(segment->map) + offset, location.length);
+    }
+  else
+    {
+    QMutexLocker active(&_activeLock);
+    segment->file->seek(offset);
+    data = segment->file->read(location.length);
+    }
+  return true;
+  }
+
+bool ItemStore::contains(const ItemKey &key) const
+  {
+  QReadLocker l(&_lock);
+  return _index.contains(key);
+  }
+
+xuint32 ItemStore::version(const ItemKey &key) const
+  {
+  QReadLocker l(&_lock);
+  QHash<ItemKey, Location>::const_iterator it = _index.find(key);
+  return it != _index.end() ? it->version : 0;
+  }
+
+void ItemStore::write(const ItemKey &key, const QByteArray &data, xuint32 version)
+  {
+  append(key, data, version);
+  }
+
+ItemStore::ItemID ItemStore::createItem(xuint16 type)
+  {
+  ItemID &next = _nextID[type];
+  ItemID id = next++;
+
+  append(ItemKey(type, id, 0), QByteArray(), 1);
+  return id;
+  }
+
+void ItemStore::append(const ItemKey &key, const QByteArray &data, xuint32 version)
+  {
+  xAssert(_activeWrite);
+  xuint64 recordSize = sizeof(RecordHeader) + data.size();
+  if(_segments[_activeID]->size && _segments[_activeID]->size + recordSize > _segmentSize)
+    {
+    sealActive();
+    }
+
+  RecordHeader header;
+  memset(&header, 0, sizeof(RecordHeader));
+  header.magic = RecordMagic;
+  header.type = key.type;
+  header.subType = key.subType;
+  header.ID = key.ID;
+  header.length = data.size();
+  header.checksum = qChecksum(data.constData(), data.size());
+  header.version = version;
+
+  Segment *segment = _segments[_activeID];
+  Location location = { _activeID, (xuint32)segment->size, header.length, version };
+
+  _activeWrite->write(reinterpret_cast<const char *>(&header), sizeof(RecordHeader));
+  _activeWrite->write(data);
+  _activeWrite->flush();
+
+  // publish it once the bytes are in the file.
+  QWriteLocker l(&_lock);
+  segment->size += recordSize;
+  setLocation(key, location);
+  }
+
+void ItemStore::setLocation(const ItemKey &key, const Location &location)
+  {
+  QHash<ItemKey, Location>::iterator it = _index.find(key);
+  if(it != _index.end())
+    {
+    Segment *old = _segments.value(it->segment);
+    if(old)
+      {
+      old->liveBytes -= sizeof(RecordHeader) + it->length;
+      }
+    it.value() = location;
+    }
+  else
+    {
+    _index.insert(key, location);
+    }
+
+  _segments[location.segment]->liveBytes += sizeof(RecordHeader) + location.length;
+  }
+
+void ItemStore::compact(float liveRatio)
+  {
+  QList<xuint32> candidates;
+  for(QMap<xuint32, Segment *>::const_iterator it = _segments.begin(); it != _segments.end(); ++it)
+    {
+    const Segment *segment = it.value();
+    if(it.key() != _activeID && segment->liveBytes < segment->size * liveRatio)
+      {
+      candidates << it.key();
+      }
+    }
+
+  if(candidates.isEmpty())
+    {
+    return;
+    }
+
+  foreach(xuint32 id, candidates)
+    {
+    Segment *segment = _segments[id];
+
+    QByteArray contents;
+    const char *data = reinterpret_cast<const char *>(segment->map);
+    if(!data && segment->size)
+      {
+      QMutexLocker active(&_activeLock);
+      segment->file->seek(0);
+      contents = segment->file->readAll();
+      data = contents.constData();
+      }
+
+    // copy out the records the index still points at.
+    xuint64 offset = 0;
+    xuint32 copied = 0;
+    while(offset + sizeof(RecordHeader) <= segment->size)
+      {
+      RecordHeader header;
+      memcpy(&header, data + offset, sizeof(RecordHeader));
+
+      ItemKey key(header.type, header.ID, header.subType);
+      QHash<ItemKey, Location>::const_iterator it = _index.find(key);
+      if(it != _index.end() && it->segment == id && it->offset == offset)
+        {
+        append(key, QByteArray(data + offset + sizeof(RecordHeader), header.length), header.version);
+        ++copied;
+        }
+
+      offset += sizeof(RecordHeader) + header.length;
+      }
+
+      {
+      QWriteLocker l(&_lock);
+      _segments.remove(id);
+      }
+
+    if(segment->map)
+      {
+      segment->file->unmap(const_cast<uchar *>(segment->map));
+      }
+    delete segment->file;
+    delete segment;
+    QFile::remove(segmentPath(id));
+
+    qDebug() << "Compacted item segment" << id << "moved" << copied << "records";
+    }
+
+  // the snapshot mustn't refer to the removed segments.
+  saveSnapshot();
+  }
+
+ItemStore::Stats ItemStore::stats() const
+  {
+  QReadLocker l(&_lock);
+  Stats s;
+  s.segments = _segments.size();
+  s.items = _index.size();
+  s.totalBytes = 0;
+  s.liveBytes = 0;
+  foreach(const Segment *segment, _segments)
+    {
+    s.totalBytes += segment->size;
+    s.liveBytes += segment->liveBytes;
+    }
+  return s;
+  }
@@ -0,0 +1,111 @@
+#ifndef ITEMSTORE_H
+#define ITEMSTORE_H
+
+#include "QString"
+#include "QHash"
+#include "QMap"
+#include "QReadWriteLock"
+#include "QMutex"
+#include "ItemCache.h"
+
+class QFile;
+
+// Item data packed into append-only segment files, with an in memory index from ItemKey to
+// (segment, offset, length, version). Writing an item appends a new record and supersedes the old one,
+// compaction copies the live records out of mostly dead segments and deletes them.
+// The index and the next free ID of each type are saved to a snapshot, so opening only has to
+// scan records appended since the last snapshot.
+//
+// read() is safe from any thread, everything else must be called from a single writer thread.
+class ItemStore
+  {
+public:
+  typedef XEnvironmentID ItemID;
+
+  struct Stats
+    {
+    xuint32 segments;
+    xuint32 items;
+    xuint64 totalBytes;
+    xuint64 liveBytes;
+    };
+
+  ItemStore(const QString &directory, xuint64 segmentSize = 64 * 1024 * 1024);
+  ~ItemStore();
+
+  bool open();
+  // save the index snapshot and close the segments.
+  void close();
+
+  bool read(const ItemKey &key, QByteArray &data, xuint32 *version = 0) const;
+  bool contains(const ItemKey &key) const;
+  // the version of the stored data for [key], 0 if there is none. Safe from any thread.
+  xuint32 version(const ItemKey &key) const;
+  void write(const ItemKey &key, const QByteArray &data, xuint32 version);
+
+  // allocate an ID of [type] and store an empty record for its first level, at version 1.
+  ItemID createItem(xuint16 type);
+
+  // rewrite sealed segments where less than [liveRatio] of the bytes are still used.
+  void compact(float liveRatio = 0.5f);
+  // save the index snapshot, so the next open doesn't scan.
+  void saveSnapshot();
+
+  Stats stats() const;
+
+private:
+  struct Location
+    {
+    xuint32 segment;
+    xuint32 offset;
+    xuint32 length;
+    xuint32 version;
+    };
+
+  struct RecordHeader
+    {
+    xuint32 magic;
+    xuint16 type;
+    xuint16 subType;
+    ItemID ID;
+    xuint32 length;
+    xuint32 checksum;
+    xuint32 version;
+    xuint32 reserved;
+    };
+
+  struct Segment
+    {
+    Segment() : file(0), map(0), size(0), liveBytes(0) { }
+    QFile *file;
+    // sealed segments are mapped, the active segment is read through the file under _activeLock.
+    const uchar *map;
+    xuint64 size;
+    xuint64 liveBytes;
+    };
+
+  QString segmentPath(xuint32 id) const;
+  QString snapshotPath() const;
+
+  Segment *openSegment(xuint32 id);
+  void sealActive();
+  void scanSegment(xuint32 id, xuint64 from);
+  bool loadSnapshot(QHash<xuint32, xuint64> &covered);
+  void append(const ItemKey &key, const QByteArray &data, xuint32 version);
+  void setLocation(const ItemKey &key, const Location &location);
+
+  QString _directory;
+  xuint64 _segmentSize;
+
+  // guards the index and segment list, the writer holds it only to publish changes.
+  mutable QReadWriteLock _lock;
+  QHash<ItemKey, Location> _index;
+  QMap<xuint32, Segment *> _segments;
+  QHash<xuint16, ItemID> _nextID;
+
+  xuint32 _activeID;
+  QFile *_activeWrite;
+  mutable QMutex _activeLock;
+  };
+
+#endif // ITEMSTORE_H
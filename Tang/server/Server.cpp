@@ -1,10 +1,81 @@
 #include "Server.h"
+#include "Connection.h"
 #include "QFile"
 #include "QDir"
-#include "QApplication"
+#include "QCoreApplication"
+#include "QRunnable"
+#include "QTimer"
 
-Server::Server() : _readingLength( -1 )
+class Server::IOJob : public QRunnable
   {
+public:
+  enum Type
+    {
+    Read,
+    Write,
+    Special,
+    Compact
+    };
+
+  IOJob(Server *server, Type type, const Request &request, Connection *connection=0)
+      : _server(server)
+    {
+    _result.type = type;
+    _result.request = request;
+    _result.version = 0;
+    _result.connection = connection;
+    }
+
+  void run()
+    {
+    if(_result.type == Read)
+      {
+      _result.payload = _server->readItem(_result.request, &_result.version);
+      }
+    else if(_result.type == Write)
+      {
+      _server->writeItem(_result.request);
+      }
+    else if(_result.type == Special)
+      {
+      _result.payload = encodePayload(_server->getSpecialData(_result.request));
+      }
+    else if(_result.type == Compact)
+      {
+      _server->_store.compact();
+      return;
+      }
+
+    _server->ioComplete(_result);
+    }
+
+private:
+  Server *_server;
+  CompletedIO _result;
+  };
+
+Server::Server(xuint64 cacheBudget) : _cache(cacheBudget), _store(getDataDirectory()), _historyBytes(0), _batchDepth(0)
+  {
+  _writePool.setMaxThreadCount(1);
+
+  if(!_store.open())
+    {
+    qWarning() << "Failed to open item store in" << getDataDirectory();
+    }
+  ItemStore::Stats stored = _store.stats();
+  qDebug() << "Item store has" << stored.items << "items in" << stored.segments << "segments";
+
+  // every client starts from the root container, so never drop it.
+  _cache.pin(ItemKey(XEnvironment::ContainerType, 0, 0));
+
+  QTimer *statsTimer = new QTimer(this);
+  connect(statsTimer, SIGNAL(timeout()), this, SLOT(logCacheStats()));
+  statsTimer->start(60 * 1000);
+
+  QTimer *compactTimer = new QTimer(this);
+  connect(compactTimer, SIGNAL(timeout()), this, SLOT(compactStore()));
+  compactTimer->start(10 * 60 * 1000);
+
   _server = new QTcpServer(this);
   _server->listen(QHostAddress::LocalHost, 16161);
 
@@ -12,214 +83,503 @@ Server::Server() : _readingLength( -1 )
   connect(_server, SIGNAL(newConnection()), this, SLOT(onConnection()));
   }
 
+Server::~Server()
+  {
+  _readPool.waitForDone();
+  _writePool.waitForDone();
+  _store.close();
+  }
+
 void Server::onConnection()
   {
   while(QTcpSocket *socket = _server->nextPendingConnection())
     {
-    connect(socket, SIGNAL(readyRead()), this, SLOT(requestAvailable()));
-    connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnection()));
+    Connection *connection = new Connection(socket, this);
+    connect(connection, SIGNAL(requestReceived(Connection*,XEnvironmentRequest)), this, SLOT(onRequest(Connection*,XEnvironmentRequest)));
+    connect(connection, SIGNAL(disconnected(Connection*)), this, SLOT(onDisconnection(Connection*)));
 
-    _clientData.insert(socket, ClientDataHash());
+    _connections << connection;
 
     qDebug() << "Connection from" << socket->peerAddress().toString() << ":" << socket->peerPort();
     }
   }
 
-void Server::onDisconnection()
-  {
-  QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-  _clientData.remove(socket);
-  qDebug() << "Disconnection from" << socket->peerAddress().toString() << ":" << socket->peerPort();
-  }
-
-void Server::requestAvailable()
+void Server::onDisconnection(Connection *connection)
   {
-  QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-  QDataStream str(socket);
+  qDebug() << "Disconnection from" << connection->socket()->peerAddress().toString() << ":" << connection->socket()->peerPort();
 
-  bool repeat = true;
-  do
+  _connections.remove(connection);
+  QMutableHashIterator<SubscriptionKey, QSet<Connection *> > it(_subscribers);
+  while(it.hasNext())
     {
-    repeat = false;
-    if( _readingLength == -1 )
+    it.next();
+    it.value().remove(connection);
+    if(it.value().isEmpty())
       {
-      str >> _readingLength;
+      it.remove();
       }
+    }
 
-    qDebug() << "Request recieved [" << socket->bytesAvailable() << "/" << _readingLength << "]";
-    if( socket->bytesAvailable() >= _readingLength )
-      {
-      QByteArray out;
-      str >> out;
-
-      // read out request
-      XEnvironmentRequest request;
-      QDataStream subStream( &out, QIODevice::ReadWrite );
-      subStream >> request;
+  // waiters hold guarded pointers, so outstanding reads just skip it.
+  connection->deleteLater();
+  }
 
-      if(!request.hasExtraData())
-        {
-        putItem(str, request);
-        }
-      else
+void Server::onRequest(Connection *connection, const XEnvironmentRequest &request)
+  {
+  if(request.type() == XEnvironment::SpecialType && request.subType() == XEnvironment::Batch)
+    {
+    // answer everything in the batch before sending, so the replies are batched too.
+    beginBatch();
+    QDataStream str(request.extraData());
+    while(!str.atEnd())
+      {
+      xuint64 size;
+      XEnvironmentRequest inner;
+      str >> size >> inner;
+      if(str.status() != QDataStream::Ok)
         {
-        setItem(request);
-        syncClients(request, socket);
+        qWarning() << "Malformed request batch";
+        break;
         }
-
-      _readingLength = -1;
-      repeat = true;
+      onRequest(connection, inner);
       }
+    endBatch();
+    return;
+    }
+
+  if(!request.hasExtraData())
+    {
+    getItem(connection, request);
+    }
+  else
+    {
+    setItem(connection, request);
     }
-  while( repeat && socket->bytesAvailable() > 0 );
   }
 
-void Server::putItem( QDataStream &stream, const XEnvironmentRequest &request )
+void Server::getItem( Connection *connection, const Request &request )
   {
-  XEnvironmentRequest sendRequest(request);
-  sendRequest.setExtraData(getItem(request));
+  if(request.type() == XEnvironment::SpecialType)
+    {
+    // specials create items on disk, so are ordered with the writes.
+    _writePool.start(new IOJob(this, IOJob::Special, request, connection));
+    return;
+    }
 
-  stream << sendRequest.saveSize() << sendRequest;
-  }
+  _subscribers[SubscriptionKey(request.type(), request.ID())] << connection;
 
-void Server::setItem( const XEnvironmentRequest &r )
-  {
-  qDebug() << "Set item " << r.type() << r.ID() << "level" << r.subType();
+  ItemKey key(request);
+  xuint32 clientVersion = request.version();
+
+  // the client is up to date, it doesn't need the data.
+  if(clientVersion && clientVersion == currentVersion(key))
+    {
+    reply(connection, request, request.requestID(), QByteArray(), clientVersion, clientVersion);
+    return;
+    }
 
-  cacheData(r, r.extraData());
+  QByteArray data;
+  xuint32 version = 0;
+  if(currentData(key, data, version))
+    {
+    reply(connection, request, request.requestID(), data, version, clientVersion);
+    return;
+    }
 
-  QString dir = getItemDirectory(r.type(), r.ID());
-  QString filename = getItemFilename(r.subType());
+  // a read already in progress for this item answers this request too.
+  QHash<ItemKey, QList<Waiter> >::iterator pending = _pendingReads.find(key);
+  bool start = pending == _pendingReads.end();
+  if(start)
+    {
+    pending = _pendingReads.insert(key, QList<Waiter>());
+    }
 
-  xAssert(!prepareItemDirectory(dir));
+  Waiter waiter;
+  waiter.connection = connection;
+  waiter.requestID = request.requestID();
+  waiter.version = clientVersion;
+  pending.value() << waiter;
 
-  QFile file(dir + filename);
-  if(file.open(QIODevice::WriteOnly))
+  if(start)
     {
-    QDataStream str(&file);
-    str << r.extraData();
-    file.close();
+    _readPool.start(new IOJob(this, IOJob::Read, request));
     }
   }
 
-void Server::syncClients( const XEnvironmentRequest &request, QTcpSocket *sender )
+void Server::setItem( Connection *connection, const Request &r )
   {
-  foreach(QTcpSocket *socket, _clientData.keys())
+  QByteArray data;
+  if(!XEnvironmentCodec::decode(r.extraData(), (XEnvironmentCodec::Encoding)r.encoding(), QByteArray(), data))
+    {
+    qWarning() << "Undecodable data set for item" << r.type() << r.ID() << "level" << r.subType();
+    return;
+    }
+
+  ItemKey key(r);
+  QByteArray previous;
+  xuint32 previousVersion = 0;
+  if(currentData(key, previous, previousVersion))
+    {
+    // subscribers hold this version, keep it to send them a delta.
+    recordPastVersion(key, previousVersion, previous);
+    }
+  else
     {
-    if(socket != sender)
+    previousVersion = currentVersion(key);
+    }
+  xuint32 version = previousVersion + 1;
+
+  qDebug() << "Set item " << r.type() << r.ID() << "level" << r.subType() << "version" << version;
+
+  // write through, the cache and the disk are updated together.
+  cacheData(r, data, version);
+
+  PendingWrite pending = { data, version };
+  _pendingWrites.insert(key, pending);
+
+  Request write(r.type(), r.ID(), r.subType());
+  write.setExtraData(data);
+  write.setVersion(version);
+  _writePool.start(new IOJob(this, IOJob::Write, write));
+
+  syncClients(r, data, version, connection);
+  }
+
+void Server::syncClients( const Request &request, const QByteArray &data, xuint32 version, Connection *sender )
+  {
+  QHash<SubscriptionKey, QSet<Connection *> >::const_iterator it = _subscribers.find(SubscriptionKey(request.type(), request.ID()));
+  if(it == _subscribers.end())
+    {
+    return;
+    }
+
+  // subscribers should hold the previous version, any that don't ask again for the whole item.
+  xuint32 baseVersion = version - 1;
+  XEnvironmentCodec::Encoding encoding;
+  QByteArray encoded = XEnvironmentCodec::encode(data, pastVersion(ItemKey(request), baseVersion), &encoding);
+  if(encoding != XEnvironmentCodec::Delta && encoding != XEnvironmentCodec::Unchanged)
+    {
+    baseVersion = 0;
+    }
+
+  // one header and payload, shared by every subscriber's queue.
+  QByteArray payload = encodePayload(encoded);
+  QByteArray header = encodeHeader(request, PushRequestID, version, baseVersion, encoding, payload);
+  foreach(Connection *connection, it.value())
+    {
+    if(connection != sender)
       {
-      const ClientDataHash &data(_clientData[socket]);
-      if(data.contains(request.type()) && data[request.type()].contains(request.ID()))
-        {
-        QDataStream str(socket);
-        putItem(str, request);
-        }
+      send(connection, header, payload);
       }
     }
   }
 
-QByteArray Server::getSpecialData(const XEnvironmentRequest &request) const
+void Server::reply( Connection *connection, const Request &request, xuint32 requestID,
+                    const QByteArray &data, xuint32 version, xuint32 clientVersion )
   {
-  QByteArray arr;
-  QDataStream str(&arr, QIODevice::WriteOnly);
-  if(request.subType() == XEnvironment::CreateItem)
+  XEnvironmentCodec::Encoding encoding = XEnvironmentCodec::Unchanged;
+  QByteArray encoded;
+  if(!clientVersion || clientVersion != version)
     {
-    ItemID firstFreeId = X_UINT64_SENTINEL;
-    QString dir;
+    encoded = XEnvironmentCodec::encode(data, pastVersion(ItemKey(request), clientVersion), &encoding);
+    }
 
-    do
-      {
-      firstFreeId++;
-      dir = getItemDirectory(request.ID(), firstFreeId);
-      } while(QDir::root().exists(dir));
+  xuint32 baseVersion = 0;
+  if(encoding == XEnvironmentCodec::Delta || encoding == XEnvironmentCodec::Unchanged)
+    {
+    baseVersion = clientVersion;
+    }
 
-    xAssert(prepareItemDirectory(dir));
-    str << firstFreeId;
+  QByteArray payload = encodePayload(encoded);
+  send(connection, encodeHeader(request, requestID, version, baseVersion, encoding, payload), payload);
+  }
 
-    QString filename = getItemFilename(0);
+void Server::send( Connection *connection, const QByteArray &header, const QByteArray &payload )
+  {
+  if(!_batchDepth)
+    {
+    connection->send(header);
+    connection->send(payload);
+    return;
+    }
 
-    QFile file(dir + filename);
-    if(file.open(QIODevice::WriteOnly))
-      {
-      file.close();
-      }
+  if(payload.size() > BatchLimit)
+    {
+    // keep the order, anything already batched goes first.
+    flushBatch(connection);
+    connection->send(header);
+    connection->send(payload);
+    return;
     }
-  return arr;
+
+  QList<QByteArray> &batch = _batched[connection];
+  batch << header << payload;
+  }
+
+void Server::beginBatch()
+  {
+  ++_batchDepth;
   }
 
-bool Server::prepareItemDirectory(const QString &dir) const
+void Server::endBatch()
   {
-  if(!QDir::root().exists(dir))
+  xAssert(_batchDepth > 0);
+  if(--_batchDepth)
     {
-    return QDir::root().mkpath(dir);
+    return;
+    }
+
+  foreach(Connection *connection, _batched.keys())
+    {
+    flushBatch(connection);
     }
-  return false;
   }
 
-QString Server::getDataDirectory() const
+void Server::flushBatch( Connection *connection )
   {
-  return QApplication::applicationDirPath() + QDir::separator() + "EnvironmentData" + QDir::separator();
+  QList<QByteArray> batch = _batched.take(connection);
+  if(batch.size() == 2)
+    {
+    connection->send(batch[0]);
+    connection->send(batch[1]);
+    }
+  else if(batch.size())
+    {
+    QByteArray frames;
+    foreach(const QByteArray &buffer, batch)
+      {
+      frames.append(buffer);
+      }
+
+    Request request(XEnvironment::SpecialType, 0, XEnvironment::Batch);
+    QByteArray payload = encodePayload(frames);
+    connection->send(encodeHeader(request, PushRequestID, 0, 0, XEnvironmentCodec::Raw, payload));
+    connection->send(payload);
+    }
   }
 
-QString Server::getItemFilename(xuint16 subtype) const
+xuint32 Server::currentVersion( const ItemKey &key ) const
   {
-  return QString::number(subtype);
+  QHash<ItemKey, PendingWrite>::const_iterator written = _pendingWrites.find(key);
+  if(written != _pendingWrites.end())
+    {
+    return written->version;
+    }
+  return _store.version(key);
   }
 
-QString Server::getItemDirectory(xuint16 type, ItemID id) const
+bool Server::currentData( const ItemKey &key, QByteArray &data, xuint32 &version )
   {
-  return getDataDirectory() + QDir::separator() + QString::number(type) +
-    QDir::separator() + QString::number(id) + QDir::separator();
+  QHash<ItemKey, PendingWrite>::const_iterator written = _pendingWrites.find(key);
+  if(written != _pendingWrites.end())
+    {
+    data = written->data;
+    version = written->version;
+    return true;
+    }
+
+  return _cache.find(key, data, &version);
   }
 
-void Server::cacheData(const XEnvironmentRequest &request, const QByteArray &a) const
+void Server::recordPastVersion( const ItemKey &key, xuint32 version, const QByteArray &data )
   {
-  if(a.length())
+  QList<PastVersion> &versions = _history[key];
+  PastVersion past = { version, data };
+  versions << past;
+  _historyBytes += data.size();
+
+  while(versions.size() > HistoryDepth)
     {
-    _data[request.type()][request.ID()][request.subType()] = a;
+    _historyBytes -= versions.takeFirst().data.size();
+    }
+
+  // over budget, drop whole items until we fit, they'll be sent in full instead.
+  QMutableHashIterator<ItemKey, QList<PastVersion> > it(_history);
+  while(_historyBytes > HistoryBudget && it.hasNext())
+    {
+    it.next();
+    if(it.key() == key)
+      {
+      continue;
+      }
+    foreach(const PastVersion &dropped, it.value())
+      {
+      _historyBytes -= dropped.data.size();
+      }
+    it.remove();
     }
   }
 
-const QByteArray Server::cachedData(const XEnvironmentRequest &request, bool *correct) const
+QByteArray Server::pastVersion( const ItemKey &key, xuint32 version ) const
   {
-  if(_data.contains(request.type()))
+  QHash<ItemKey, QList<PastVersion> >::const_iterator it = _history.find(key);
+  if(version && it != _history.end())
     {
-    const IDHash &idHash(_data[request.type()]);
-    if(idHash.contains(request.ID()))
+    foreach(const PastVersion &past, it.value())
       {
-      const SubTypeHash &subTypeHash(idHash[request.ID()]);
-      if(subTypeHash.contains(request.subType()))
+      if(past.version == version)
         {
-        return subTypeHash[request.subType()];
+        return past.data;
         }
       }
     }
+  return QByteArray();
   }
 
-QByteArray Server::getItem(const XEnvironmentRequest &req) const
+void Server::ioComplete( const CompletedIO &io )
   {
-  if(req.type() == XEnvironment::SpecialType)
+  bool first = false;
     {
-    return getSpecialData(req);
+    QMutexLocker l(&_completedLock);
+    first = _completed.isEmpty();
+    _completed << io;
     }
 
-  bool correct = false;
-  const QByteArray &cached = cachedData(req, &correct);
-  if(correct)
+  // one queued call handles everything completed before it runs.
+  if(first)
     {
-    return cached;
+    QMetaObject::invokeMethod(this, "processCompletedIO", Qt::QueuedConnection);
+    }
+  }
+
+void Server::processCompletedIO()
+  {
+  QList<CompletedIO> completed;
+    {
+    QMutexLocker l(&_completedLock);
+    completed = _completed;
+    _completed.clear();
+    }
+
+  beginBatch();
+  foreach(const CompletedIO &io, completed)
+    {
+    const Request &request = io.request;
+    if(io.type == IOJob::Read)
+      {
+      ItemKey key(request);
+      QByteArray data = io.payload;
+      xuint32 version = io.version;
+
+      // the item was set while it was being read, answer with the newer data instead.
+      if(version < currentVersion(key))
+        {
+        if(!currentData(key, data, version))
+          {
+          // and it has been evicted since, read it again for the same waiters.
+          _readPool.start(new IOJob(this, IOJob::Read, request));
+          continue;
+          }
+        }
+      else
+        {
+        cacheData(request, data, version);
+        }
+
+      QList<Waiter> waiters = _pendingReads.take(key);
+      foreach(const Waiter &waiter, waiters)
+        {
+        if(waiter.connection)
+          {
+          reply(waiter.connection, request, waiter.requestID, data, version, waiter.version);
+          }
+        }
+      }
+    else if(io.type == IOJob::Write)
+      {
+      // a later write of the same item may still be queued.
+      QHash<ItemKey, PendingWrite>::iterator it = _pendingWrites.find(ItemKey(request));
+      if(it != _pendingWrites.end() && it->version == request.version())
+        {
+        _pendingWrites.erase(it);
+        }
+      }
+    else if(io.type == IOJob::Special)
+      {
+      if(io.connection)
+        {
+        send(io.connection, encodeHeader(request, request.requestID(), 0, 0, XEnvironmentCodec::Raw, io.payload), io.payload);
+        }
+      }
     }
+  endBatch();
+  }
+
+QByteArray Server::encodePayload( const QByteArray &data )
+  {
+  QByteArray payload;
+  QDataStream str(&payload, QIODevice::WriteOnly);
+  str << data;
+  return payload;
+  }
+
+QByteArray Server::encodeHeader( const Request &request, xuint32 requestID, xuint32 version, xuint32 baseVersion,
+                                 XEnvironmentCodec::Encoding encoding, const QByteArray &payload )
+  {
+  // matches XEnvironmentRequest's stream format, with the extra data following in the payload.
+  xuint64 saveSize = Request::StaticSaveSize + payload.size() - sizeof(quint32);
+
+  QByteArray header;
+  QDataStream str(&header, QIODevice::WriteOnly);
+  str << saveSize << request.type() << request.ID() << request.subType() << requestID
+      << version << baseVersion << (xuint8)encoding;
+  return header;
+  }
 
+QByteArray Server::readItem( const Request &req, xuint32 *version ) const
+  {
   QByteArray arr;
-  QFile file(getItemDirectory(req.type(), req.ID()) + getItemFilename(req.subType()));
-  if(file.open(QIODevice::ReadOnly))
+  _store.read(ItemKey(req), arr, version);
+  return arr;
+  }
+
+void Server::writeItem( const Request &r )
+  {
+  _store.write(ItemKey(r), r.extraData(), r.version());
+  }
+
+QByteArray Server::getSpecialData(const XEnvironmentRequest &request)
+  {
+  QByteArray arr;
+  QDataStream str(&arr, QIODevice::WriteOnly);
+  if(request.subType() == XEnvironment::CreateItem)
     {
-    QDataStream str(&file);
-    str >> arr;
+    // the request's ID holds the type to create.
+    ItemID id = _store.createItem(request.ID());
+    str << id;
+    }
+  return arr;
+  }
 
-    cacheData(req, arr);
-    return arr;
+QString Server::getDataDirectory() const
+  {
+  return QCoreApplication::applicationDirPath() + QDir::separator() + "EnvironmentData";
+  }
+
+void Server::cacheData(const XEnvironmentRequest &request, const QByteArray &a, xuint32 version)
+  {
+  if(a.length())
+    {
+    _cache.insert(ItemKey(request), a, version);
     }
+  }
 
-  return QByteArray();
+void Server::logCacheStats()
+  {
+  ItemCache::Stats stats = _cache.stats();
+  xuint64 lookups = stats.hits + stats.misses;
+  qDebug() << "Cache" << stats.items << "items" << stats.bytesResident / 1024 << "/" << _cache.budget() / 1024 << "KB,"
+           << "hits" << stats.hits << "misses" << stats.misses
+           << "hit rate" << (lookups ? (100.0 * stats.hits) / lookups : 0.0) << "%"
+           << "evictions" << stats.evictions;
+  }
+
+void Server::compactStore()
+  {
+  ItemStore::Stats stats = _store.stats();
+  qDebug() << "Item store" << stats.items << "items" << stats.liveBytes / 1024 << "/" << stats.totalBytes / 1024 << "KB live in"
+           << stats.segments << "segments";
+
+  // ordered with the writes, readers only block while a compacted segment is dropped.
+  _writePool.start(new IOJob(this, IOJob::Compact, Request()));
   }
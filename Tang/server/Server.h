@@ -4,10 +4,19 @@
 #include "QObject"
 #include "QTcpServer"
 #include "QTcpSocket"
+#include "QThreadPool"
+#include "QMutex"
+#include "QPointer"
+#include "QSet"
 #include "XEnvironment.h"
 #include "XEnvironmentRequest.h"
 #include "XEnvironmentArea.h"
 #include "XColladaFile.h"
+#include "ItemCache.h"
+#include "ItemStore.h"
+#include "XEnvironmentCodec.h"
+
+class Connection;
 
 class Server : public QObject
   {
@@ -19,45 +28,124 @@ public:
   typedef XEnvironmentArea::SubType SubType;
   typedef QList <ItemID> ItemList;
 
-  Server();
+  // [cacheBudget] is the most item data, in bytes, held in memory.
+  Server(xuint64 cacheBudget = 256 * 1024 * 1024);
+  ~Server();
 
 private slots:
   void onConnection();
-  void onDisconnection();
-  void requestAvailable();
+  void onDisconnection(Connection *connection);
+  void onRequest(Connection *connection, const XEnvironmentRequest &request);
+  void processCompletedIO();
+  void logCacheStats();
+  void compactStore();
 
 private:
-  QByteArray getTexture(ItemID id) const;
-  QByteArray getShader(ItemID id) const;
-  QByteArray getWorld(ItemID id, xuint16 subtype) const;
+  class IOJob;
+  struct CompletedIO
+    {
+    int type;
+    Request request;
+    // the item data for reads, the encoded reply for specials.
+    QByteArray payload;
+    xuint32 version;
+    QPointer<Connection> connection;
+    };
+
+  struct Waiter
+    {
+    QPointer<Connection> connection;
+    xuint32 requestID;
+    // the version the client already holds.
+    xuint32 version;
+    };
+
+  struct PendingWrite
+    {
+    QByteArray data;
+    xuint32 version;
+    };
+
+  struct PastVersion
+    {
+    xuint32 version;
+    QByteArray data;
+    };
+
+  enum
+    {
+    // replies larger than this aren't worth copying into a batch.
+    BatchLimit = 16 * 1024,
+    // past versions kept per item, and in total, to make deltas against.
+    HistoryDepth = 4,
+    HistoryBudget = 32 * 1024 * 1024
+    };
+
+  // requests pushed to clients rather than asked for use this ID.
+  static const xuint32 PushRequestID = X_UINT32_SENTINEL;
+
+  void getItem( Connection *connection, const Request &request );
+  void setItem( Connection *connection, const Request &request );
+  void syncClients( const Request &, const QByteArray &data, xuint32 version, Connection *sender );
+  // reply with [data] at [version], encoded against [clientVersion] where we still have it.
+  void reply( Connection *connection, const Request &request, xuint32 requestID,
+              const QByteArray &data, xuint32 version, xuint32 clientVersion );
+  void send( Connection *connection, const QByteArray &header, const QByteArray &payload );
+  void ioComplete( const CompletedIO & );
+
+  // while batching, small replies to each connection are collected and sent as one message.
+  void beginBatch();
+  void endBatch();
+  void flushBatch( Connection *connection );
+
+  xuint32 currentVersion( const ItemKey &key ) const;
+  bool currentData( const ItemKey &key, QByteArray &data, xuint32 &version );
+  void recordPastVersion( const ItemKey &key, xuint32 version, const QByteArray &data );
+  QByteArray pastVersion( const ItemKey &key, xuint32 version ) const;
+
+  // the item data as it is sent, serialised once and shared by every reply.
+  static QByteArray encodePayload( const QByteArray &data );
+  static QByteArray encodeHeader( const Request &request, xuint32 requestID, xuint32 version, xuint32 baseVersion,
+                                  XEnvironmentCodec::Encoding encoding, const QByteArray &payload );
+
+  // disk access, these run on the I/O threads.
+  QByteArray readItem( const Request &req, xuint32 *version ) const;
+  void writeItem( const Request &req );
+  QByteArray getSpecialData( const Request &level );
+
+  void cacheData(const Request &request, const QByteArray &a, xuint32 version);
 
-  void putItem( QDataStream &stream, const Request &request );
-  void setItem( const Request & );
-  void syncClients( const Request &, QTcpSocket *sender );
-  QByteArray getSpecialData(const Request &level) const;
+  QString getDataDirectory() const;
 
-  bool prepareItemDirectory(const QString &dir) const;
+  // data of recently used items, set items are written through to disk.
+  ItemCache _cache;
+  // every item's data, packed into segment files. Only written from the write pool.
+  ItemStore _store;
 
-  const QByteArray cachedData(const Request &request, bool *correct) const;
-  void cacheData(const Request &request, const QByteArray &a) const;
+  QTcpServer *_server;
+  QSet<Connection *> _connections;
 
-  QString getItemFilename(SubType subtype) const;
-  QString getDataDirectory() const;
-  QString getItemDirectory(xuint16, ItemID) const;
+  // clients which have asked for an item are sent its changes.
+  typedef QPair<xuint16, ItemID> SubscriptionKey;
+  QHash<SubscriptionKey, QSet<Connection *> > _subscribers;
 
-  QByteArray getItem(const Request &req) const;
+  // reads are spread over a pool, writes, item creation and compaction run in order on a single thread.
+  QThreadPool _readPool;
+  QThreadPool _writePool;
 
-  typedef QHash <SubType, QByteArray> SubTypeHash;
-  typedef QHash <ItemID, SubTypeHash> IDHash;
-  typedef QHash <xuint16, IDHash> TypeHash;
+  // reads in progress, and the clients waiting for them.
+  QHash<ItemKey, QList<Waiter> > _pendingReads;
+  // data set by clients which isn't on disk yet.
+  QHash<ItemKey, PendingWrite> _pendingWrites;
 
-  mutable TypeHash _data;
+  QHash<ItemKey, QList<PastVersion> > _history;
+  xuint64 _historyBytes;
 
-  QTcpServer *_server;
-  int _readingLength;
+  int _batchDepth;
+  QHash<Connection *, QList<QByteArray> > _batched;
 
-  typedef QHash<xuint16, ItemList> ClientDataHash;
-  QHash <QTcpSocket*, ClientDataHash> _clientData;
+  QMutex _completedLock;
+  QList<CompletedIO> _completed;
   };
 
 #endif // SERVER_H
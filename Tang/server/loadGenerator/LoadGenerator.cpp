@@ -0,0 +1,138 @@
+#include "LoadGenerator.h"
+#include "QTcpSocket"
+#include "QHostAddress"
+#include "QDataStream"
+#include "QCoreApplication"
+#include "QTimer"
+#include "QDebug"
+#include "XEnvironment.h"
+#include "algorithm"
+
+Viewer::Viewer(LoadGenerator *generator, int index) : QObject(generator), _generator(generator),
+    _readingLength(X_UINT64_SENTINEL), _nextRequestID(0), _running(true)
+  {
+  // each viewer walks the items from a different place, so requests overlap but aren't identical.
+  _nextItem = (index * 7) % generator->items();
+
+  _socket = new QTcpSocket(this);
+  connect(_socket, SIGNAL(connected()), this, SLOT(onConnected()));
+  connect(_socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+  _socket->connectToHost(QHostAddress::LocalHost, 16161, QIODevice::ReadWrite);
+  }
+
+void Viewer::onConnected()
+  {
+  for(int i=0; i<_generator->outstanding(); ++i)
+    {
+    sendRequest();
+    }
+  }
+
+void Viewer::sendRequest()
+  {
+  XEnvironmentRequest request(XEnvironment::ContainerType, _nextItem, 0, _nextRequestID++);
+  _nextItem = (_nextItem + 1) % _generator->items();
+
+  _sent.insert(request.requestID(), XTime::now());
+
+  QDataStream str(_socket);
+  str << request.saveSize() << request;
+  }
+
+void Viewer::onReadyRead()
+  {
+  QDataStream str(_socket);
+  for(;;)
+    {
+    if(_readingLength == X_UINT64_SENTINEL)
+      {
+      if(_socket->bytesAvailable() < (qint64)sizeof(xuint64))
+        {
+        break;
+        }
+      str >> _readingLength;
+      }
+
+    if((xuint64)_socket->bytesAvailable() < _readingLength)
+      {
+      break;
+      }
+
+    XEnvironmentRequest reply;
+    str >> reply;
+    _readingLength = X_UINT64_SENTINEL;
+
+    onReply(reply);
+    }
+  }
+
+void Viewer::onReply(const XEnvironmentRequest &reply)
+  {
+  if(reply.type() == XEnvironment::SpecialType && reply.subType() == XEnvironment::Batch)
+    {
+    QDataStream str(reply.extraData());
+    while(!str.atEnd() && str.status() == QDataStream::Ok)
+      {
+      xuint64 size;
+      XEnvironmentRequest inner;
+      str >> size >> inner;
+      onReply(inner);
+      }
+    return;
+    }
+
+  QHash<xuint32, XTime>::iterator it = _sent.find(reply.requestID());
+  if(it == _sent.end())
+    {
+    // pushed change from another client
+    return;
+    }
+
+  _generator->recordLatency((XTime::now() - it.value()).milliseconds());
+  _sent.erase(it);
+
+  if(_running)
+    {
+    sendRequest();
+    }
+  }
+
+LoadGenerator::LoadGenerator(int viewers, int seconds, int outstanding, int items)
+    : _seconds(seconds), _outstanding(outstanding), _items(xMax(items, 1))
+  {
+  for(int i=0; i<viewers; ++i)
+    {
+    _viewers << new Viewer(this, i);
+    }
+
+  QTimer::singleShot(0, this, SLOT(start()));
+  }
+
+void LoadGenerator::start()
+  {
+  _start = XTime::now();
+  QTimer::singleShot(_seconds * 1000, this, SLOT(finish()));
+  }
+
+void LoadGenerator::finish()
+  {
+  foreach(Viewer *viewer, _viewers)
+    {
+    viewer->stop();
+    }
+
+  float seconds = (XTime::now() - _start).milliseconds() / 1000.0f;
+  std::sort(_latencies.begin(), _latencies.end());
+
+  int count = _latencies.size();
+  qDebug() << "Viewers:" << _viewers.size() << "outstanding per viewer:" << _outstanding;
+  qDebug() << "Requests:" << count << "in" << seconds << "s," << (seconds > 0.0f ? count / seconds : 0.0f) << "requests/s";
+  if(count)
+    {
+    qDebug() << "Latency ms p50:" << _latencies[count / 2]
+             << "p99:" << _latencies[xMin(count - 1, (count * 99) / 100)]
+             << "max:" << _latencies.back();
+    }
+
+  QCoreApplication::quit();
+  }
@@ -0,0 +1,64 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include "QObject"
+#include "QHash"
+#include "QVector"
+#include "XTime"
+#include "XEnvironmentRequest.h"
+
+class QTcpSocket;
+class LoadGenerator;
+
+// One simulated client, keeping a fixed number of item requests outstanding.
+class Viewer : public QObject
+  {
+  Q_OBJECT
+
+public:
+  Viewer(LoadGenerator *generator, int index);
+
+  void stop() { _running = false; }
+
+private slots:
+  void onConnected();
+  void onReadyRead();
+
+private:
+  void sendRequest();
+  void onReply(const XEnvironmentRequest &reply);
+
+  LoadGenerator *_generator;
+  QTcpSocket *_socket;
+  xuint64 _readingLength;
+  xuint32 _nextRequestID;
+  xuint32 _nextItem;
+  bool _running;
+  QHash<xuint32, XTime> _sent;
+  };
+
+class LoadGenerator : public QObject
+  {
+  Q_OBJECT
+
+public:
+  LoadGenerator(int viewers, int seconds, int outstanding, int items);
+
+  int outstanding() const { return _outstanding; }
+  int items() const { return _items; }
+  void recordLatency(float ms) { _latencies << ms; }
+
+private slots:
+  void start();
+  void finish();
+
+private:
+  int _seconds;
+  int _outstanding;
+  int _items;
+  QList<Viewer *> _viewers;
+  QVector<float> _latencies;
+  XTime _start;
+  };
+
+#endif // LOADGENERATOR_H
@@ -0,0 +1,19 @@
+# -------------------------------------------------
+# Simulates many viewers requesting items from a running server,
+# run as "loadGenerator [viewers] [seconds] [outstanding] [items]"
+# -------------------------------------------------
+QT += network
+QT -= gui
+TARGET = loadGenerator
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+SOURCES += main.cpp \
+    LoadGenerator.cpp
+HEADERS += LoadGenerator.h
+LIBS += -L../../../bin \
+    -lEksCore \
+    -lEks3D
+INCLUDEPATH += ../../../EksCore \
+    ../../../Eks3D/include
+DESTDIR = ../../../bin
@@ -0,0 +1,17 @@
+#include "QCoreApplication"
+#include "QStringList"
+#include "LoadGenerator.h"
+
+int main(int argc, char *argv[])
+  {
+  QCoreApplication a(argc, argv);
+
+  QStringList args = a.arguments();
+  int viewers = args.size() > 1 ? args[1].toInt() : 100;
+  int seconds = args.size() > 2 ? args[2].toInt() : 10;
+  int outstanding = args.size() > 3 ? args[3].toInt() : 4;
+  int items = args.size() > 4 ? args[4].toInt() : 64;
+
+  LoadGenerator generator(viewers, seconds, outstanding, items);
+  return a.exec();
+  }
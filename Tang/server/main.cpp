@@ -1,10 +1,16 @@
 #include <QtCore/QCoreApplication>
 #include "QDebug"
+#include "QStringList"
 #include "Server.h"
 
 int main(int argc, char *argv[])
   {
   QCoreApplication a(argc, argv);
-  Server s;
+
+  // optional cache budget in megabytes
+  QStringList args = a.arguments();
+  xuint64 cacheMegabytes = args.size() > 1 ? args[1].toULongLong() : 256;
+
+  Server s(cacheMegabytes * 1024 * 1024);
   return a.exec();
   }
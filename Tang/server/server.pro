@@ -8,8 +8,14 @@ CONFIG += console
 CONFIG -= app_bundle
 TEMPLATE = app
 SOURCES += main.cpp \
-    Server.cpp
-HEADERS += Server.h
+    Server.cpp \
+    Connection.cpp \
+    ItemCache.cpp \
+    ItemStore.cpp
+HEADERS += Server.h \
+    Connection.h \
+    ItemCache.h \
+    ItemStore.h
 LIBS += -L../../bin \
     -lEksCore \
     -lEks3D
@@ -0,0 +1,151 @@
+#include "QApplication"
+#include "QStringList"
+#include "QDir"
+#include "QFile"
+#include "QSet"
+#include "QPair"
+#include "QDebug"
+#include "XTime"
+#include "XEnvironment.h"
+#include "Interface.h"
+
+namespace
+{
+void removeDirectory(const QString &path)
+  {
+  QDir dir(path);
+  foreach(const QFileInfo &info, dir.entryInfoList(QDir::NoDotAndDotDot | QDir::Files))
+    {
+    QFile::remove(info.filePath());
+    }
+  dir.rmdir(path);
+  }
+
+// one client start, loading what the first frame needs: the root container and everything under it.
+class StartupRun : private XEnvironment::Listener
+  {
+public:
+  StartupRun(const QString &cacheDirectory) : _environment(&_interface, this), _outstanding(0), _completed(0)
+    {
+    _environment.setDiskCache(cacheDirectory);
+    }
+
+  // milliseconds until everything has loaded, or a negative value on timeout.
+  double run(int timeoutSeconds)
+    {
+    XTime start = XTime::now();
+    _environment.validateDiskCache();
+    request(XEnvironment::ContainerType, 0, 0);
+
+    while(_outstanding)
+      {
+      QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 100);
+      _environment.update();
+
+      if((XTime::now() - start).seconds() > timeoutSeconds)
+        {
+        return -1.0;
+        }
+      }
+
+    return (XTime::now() - start).milliseconds();
+    }
+
+  int completed() const { return _completed; }
+
+private:
+  void request(xuint16 type, XEnvironment::ItemID id, xuint16 subType)
+    {
+    QPair<xuint32, XEnvironment::ItemID> key(((xuint32)type << 16) | subType, id);
+    if(_requested.contains(key))
+      {
+      return;
+      }
+    _requested << key;
+
+    ++_outstanding;
+    XEnvironment::Request r(type, id, subType);
+    _environment.requestItem(r);
+    }
+
+  void onRequestComplete(const XEnvironmentRequest &r)
+    {
+    --_outstanding;
+    ++_completed;
+
+    if(r.type() != XEnvironment::ContainerType)
+      {
+      return;
+      }
+
+    const XEnvironment::Container *container = _environment.container(r.ID());
+    if(!container)
+      {
+      return;
+      }
+
+    foreach(const XEnvironment::Container::Item &item, container->items())
+      {
+      if(item.type() == XEnvironment::ContainerType || item.type() == XEnvironment::MeshType)
+        {
+        request(item.type(), item.ID(), 0);
+        }
+      else if(item.type() == XEnvironment::TextureType)
+        {
+        request(item.type(), item.ID(), XEnvironment::InfoSubType);
+        }
+      }
+    }
+
+  void onRequestsDecoded()
+    {
+    // wakes run()'s event loop to install them.
+    QCoreApplication::postEvent(QCoreApplication::instance(), new QEvent(QEvent::User));
+    }
+
+  Interface _interface;
+  XEnvironment _environment;
+  QSet<QPair<xuint32, XEnvironment::ItemID> > _requested;
+  int _outstanding;
+  int _completed;
+  };
+
+bool report(const char *name, StartupRun &run, int timeout)
+  {
+  double ms = run.run(timeout);
+  if(ms < 0.0)
+    {
+    qWarning() << name << "start timed out, is the server running?";
+    return false;
+    }
+
+  qDebug() << name << "start:" << ms << "ms to first frame," << run.completed() << "items";
+  return true;
+  }
+}
+
+int main(int argc, char *argv[])
+  {
+  QApplication app(argc, argv, false);
+
+  QStringList args = app.arguments();
+  int timeout = args.size() > 1 ? args[1].toInt() : 60;
+
+  QString cache = QDir::tempPath() + QDir::separator() + "startupBenchmarkCache";
+  removeDirectory(cache);
+
+  bool ok = true;
+    {
+    StartupRun cold(cache);
+    ok = report("Cold", cold, timeout);
+    }
+
+  if(ok)
+    {
+    StartupRun warm(cache);
+    ok = report("Warm", warm, timeout);
+    }
+
+  removeDirectory(cache);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
@@ -0,0 +1,22 @@
+# -------------------------------------------------
+# Times a client loading everything under the root container from a
+# running server, with an empty and then a warm disk cache,
+# run as "startupBenchmark [timeoutSeconds]"
+# -------------------------------------------------
+QT += network \
+    opengl \
+    xml
+TARGET = startupBenchmark
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+SOURCES += main.cpp \
+    ../../Interface.cpp
+HEADERS += ../../Interface.h
+LIBS += -L../../../bin \
+    -lEksCore \
+    -lEks3D
+INCLUDEPATH += ../.. \
+    ../../../EksCore \
+    ../../../Eks3D/include
+DESTDIR = ../../../bin
@@ -0,0 +1,140 @@
+#include "QCoreApplication"
+#include "QStringList"
+#include "XTime"
+#include "QDir"
+#include "QFile"
+#include "QDebug"
+#include "ItemStore.h"
+
+namespace
+{
+const xuint16 BenchmarkType = 1;
+
+void removeDirectory(const QString &path)
+  {
+  QDir dir(path);
+  foreach(const QFileInfo &info, dir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllEntries))
+    {
+    if(info.isDir())
+      {
+      removeDirectory(info.filePath());
+      }
+    else
+      {
+      QFile::remove(info.filePath());
+      }
+    }
+  dir.rmdir(path);
+  }
+
+void report(const char *name, xuint64 items, const XTime &start)
+  {
+  double ms = (XTime::now() - start).milliseconds();
+  qDebug() << name << ms << "ms" << (ms > 0.0 ? (items * 1000.0) / ms : 0.0) << "items/s";
+  }
+
+void benchmarkStore(const QString &path, xuint32 items, const QByteArray &data)
+  {
+  XTime start;
+
+    {
+    ItemStore store(path);
+    store.open();
+
+    start = XTime::now();
+    for(xuint32 i=0; i<items; ++i)
+      {
+      ItemStore::ItemID id = store.createItem(BenchmarkType);
+      store.write(ItemKey(BenchmarkType, id, 0), data, 2);
+      }
+    report("Store create + write", items, start);
+
+    start = XTime::now();
+    QByteArray read;
+    for(xuint32 i=0; i<items; ++i)
+      {
+      store.read(ItemKey(BenchmarkType, qrand() % items, 0), read);
+      }
+    report("Store random read", items, start);
+
+    // rewrite half the items, leaving most segments half dead.
+    for(xuint32 i=0; i<items; i+=2)
+      {
+      store.write(ItemKey(BenchmarkType, i, 0), data, 3);
+      }
+
+    ItemStore::Stats stats = store.stats();
+    qDebug() << "Before compaction" << stats.segments << "segments" << stats.liveBytes / 1024 << "/" << stats.totalBytes / 1024 << "KB live";
+
+    start = XTime::now();
+    store.compact(0.75f);
+    stats = store.stats();
+    qDebug() << "Compaction" << (XTime::now() - start).milliseconds() << "ms," << stats.segments << "segments" << stats.liveBytes / 1024 << "/" << stats.totalBytes / 1024 << "KB live";
+    }
+
+  start = XTime::now();
+    {
+    ItemStore store(path);
+    store.open();
+    qDebug() << "Reopen from snapshot" << (XTime::now() - start).milliseconds() << "ms," << store.stats().items << "items";
+    }
+
+  QFile::remove(path + QDir::separator() + "index.dat");
+  start = XTime::now();
+    {
+    ItemStore store(path);
+    store.open();
+    qDebug() << "Reopen by scanning" << (XTime::now() - start).milliseconds() << "ms," << store.stats().items << "items";
+    }
+  }
+
+void benchmarkFiles(const QString &path, xuint32 items, const QByteArray &data)
+  {
+  // the layout the server used before the store, a directory per item and a file per level.
+  XTime start = XTime::now();
+  for(xuint32 i=0; i<items; ++i)
+    {
+    QString dir = path + QDir::separator() + QString::number(BenchmarkType) + QDir::separator() + QString::number(i);
+    QDir::root().mkpath(dir);
+    QFile file(dir + QDir::separator() + "0");
+    if(file.open(QIODevice::WriteOnly))
+      {
+      file.write(data);
+      }
+    }
+  report("Files create + write", items, start);
+
+  start = XTime::now();
+  for(xuint32 i=0; i<items; ++i)
+    {
+    QFile file(path + QDir::separator() + QString::number(BenchmarkType) + QDir::separator() + QString::number(qrand() % items) + QDir::separator() + "0");
+    if(file.open(QIODevice::ReadOnly))
+      {
+      file.readAll();
+      }
+    }
+  report("Files random read", items, start);
+  }
+}
+
+int main(int argc, char *argv[])
+  {
+  QCoreApplication a(argc, argv);
+
+  QStringList args = a.arguments();
+  xuint32 items = args.size() > 1 ? args[1].toUInt() : 1000000;
+  int itemBytes = args.size() > 2 ? args[2].toInt() : 256;
+
+  QByteArray data(itemBytes, 'x');
+  QString root = QDir::tempPath() + QDir::separator() + "storeBenchmark";
+
+  qDebug() << items << "items of" << itemBytes << "bytes";
+
+  removeDirectory(root);
+  benchmarkStore(root + QDir::separator() + "store", items, data);
+  removeDirectory(root);
+  benchmarkFiles(root + QDir::separator() + "files", items, data);
+  removeDirectory(root);
+
+  return 0;
+  }
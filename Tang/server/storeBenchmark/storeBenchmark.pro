@@ -0,0 +1,20 @@
+# -------------------------------------------------
+# Times the server's item store against one file per item,
+# run as "storeBenchmark [items] [itemBytes]"
+# -------------------------------------------------
+QT -= gui
+TARGET = storeBenchmark
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+SOURCES += main.cpp \
+    ../ItemStore.cpp
+HEADERS += ../ItemStore.h \
+    ../ItemCache.h
+LIBS += -L../../../bin \
+    -lEksCore \
+    -lEks3D
+INCLUDEPATH += .. \
+    ../../../EksCore \
+    ../../../Eks3D/include
+DESTDIR = ../../../bin
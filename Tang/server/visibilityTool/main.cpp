@@ -0,0 +1,94 @@
+#include "QCoreApplication"
+#include "QStringList"
+#include "QDataStream"
+#include "QDebug"
+#include "XTime"
+#include "XEnvironment.h"
+#include "XEnvironmentArea.h"
+#include "XEnvironmentVisibility.h"
+#include "ItemStore.h"
+
+namespace
+{
+bool readArea(const ItemStore &store, XEnvironmentArea::ItemID id, XEnvironmentArea &area)
+  {
+  QByteArray data;
+  if(!store.read(ItemKey(XEnvironment::WorldType, id, XEnvironmentArea::Item), data))
+    {
+    return false;
+    }
+
+  QDataStream str(&data, QIODevice::ReadOnly);
+  area.restore(str);
+  return str.status() == QDataStream::Ok;
+  }
+}
+
+// The children of the area are the items of its visibility, and their bounds are treated as solid. That
+// suits an area split into blocks of buildings, open children will hide more than they should.
+int main(int argc, char *argv[])
+  {
+  QCoreApplication a(argc, argv);
+
+  QStringList args = a.arguments();
+  if(args.size() < 3)
+    {
+    qDebug() << "usage: visibilityTool dataDirectory areaID [samplesPerCell] [raysPerSample] [maxItemsPerCell]";
+    return 1;
+    }
+
+  XEnvironmentArea::ItemID areaID = args[2].toULongLong();
+  xuint32 samples = args.size() > 3 ? args[3].toUInt() : 16;
+  xuint32 rays = args.size() > 4 ? args[4].toUInt() : 256;
+  xuint32 maxItemsPerCell = args.size() > 5 ? args[5].toUInt() : 16;
+
+  ItemStore store(args[1]);
+  if(!store.open())
+    {
+    qDebug() << "Couldn't open the store in" << args[1];
+    return 1;
+    }
+
+  XEnvironmentArea area;
+  if(!readArea(store, areaID, area))
+    {
+    qDebug() << "No area" << areaID;
+    return 1;
+    }
+
+  XEnvironmentVisibility::ItemList items;
+  foreach(XEnvironmentArea::ItemID child, area.childAreas())
+    {
+    XEnvironmentArea childArea;
+    if(readArea(store, child, childArea))
+      {
+      items << XEnvironmentVisibility::Item(child, childArea.bounds());
+      }
+    else
+      {
+      qDebug() << "Skipping missing child area" << child;
+      }
+    }
+
+  XTime start = XTime::now();
+  XEnvironmentVisibility &visibility = area.visibility();
+  visibility.build(area.bounds(), items, maxItemsPerCell);
+  qDebug() << "Built" << visibility.nodeCount() << "nodes," << visibility.leafCount() << "leaves over" << items.size() << "items in" << (XTime::now() - start).milliseconds() << "ms";
+
+  start = XTime::now();
+  visibility.computeVisibility(samples, rays);
+  qDebug() << "Sampled" << samples << "x" << rays << "rays per leaf in" << (XTime::now() - start).milliseconds() << "ms," << visibility.visibleSetCount() << "distinct sets," << visibility.memoryUsage() / 1024 << "KB";
+
+  QByteArray data;
+    {
+    QDataStream str(&data, QIODevice::WriteOnly);
+    area.saveVisibility(str);
+    }
+
+  ItemKey key(XEnvironment::WorldType, areaID, XEnvironmentArea::Visibility);
+  store.write(key, data, store.version(key) + 1);
+  store.close();
+
+  qDebug() << "Stored" << data.size() << "bytes for area" << areaID;
+  return 0;
+  }
@@ -0,0 +1,21 @@
+# -------------------------------------------------
+# Computes the visibility of an area's children, offline, and stores it
+# with the area. Stop the server first, the store has a single writer.
+# run as "visibilityTool dataDirectory areaID [samplesPerCell] [raysPerSample] [maxItemsPerCell]"
+# -------------------------------------------------
+QT -= gui
+TARGET = visibilityTool
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+SOURCES += main.cpp \
+    ../ItemStore.cpp
+HEADERS += ../ItemStore.h \
+    ../ItemCache.h
+LIBS += -L../../../bin \
+    -lEksCore \
+    -lEks3D
+INCLUDEPATH += .. \
+    ../../../EksCore \
+    ../../../Eks3D/include
+DESTDIR = ../../../bin
@@ -12,6 +12,7 @@ UIGraphDebugSurface::UIGraphDebugSurface(SEntity *ent) : UISurface("Graph Debug"
   _canvas->setModel(this);
   _canvas->setAntiAliasingEnabled(true);
   _canvas->setController(&_controller);
+  setIndex(&_delegate.index());
 
   connect(&_controller, SIGNAL(onContextMenu(QPoint)), this, SLOT(onContextMenu(QPoint)));
   }
@@ -44,7 +45,7 @@ void UIGraphDebugSurface::onContextMenu(QPoint point)
     _iterator = createIterator();
     }
 
-  resetIterator(_iterator);
+  resetIterator(_iterator, QRect(graphSpacePoint, QSize(1, 1)));
   while(_iterator->next())
     {
     Iterator *i = static_cast<Iterator*>(_iterator);
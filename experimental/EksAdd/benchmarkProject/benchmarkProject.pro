@@ -0,0 +1,17 @@
+# -------------------------------------------------
+# EksAdd benchmarks, run as "benchmarkProject [benchmark] [args]"
+# -------------------------------------------------
+TARGET = EksAddBenchmarks
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+QT += core
+DESTDIR = ../../../bin
+LIBS += -L../../../bin/ \
+    -lEksCore \
+    -lEksAdd
+INCLUDEPATH += ../include \
+    ../../../EksCore/
+SOURCES += main.cpp \
+    networkBenchmark.cpp
+HEADERS += benchmarks.h
@@ -0,0 +1,11 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "QStringList"
+
+// each benchmark takes the remaining command line arguments and returns an exit code.
+int networkChainBenchmark(const QStringList &args);
+int networkFanOutBenchmark(const QStringList &args);
+int networkParallelBenchmark(const QStringList &args);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,234 @@
+#include "benchmarks.h"
+#include "XNetwork.h"
+#include "XTime"
+#include "QDebug"
+#include "QThread"
+#include "math.h"
+
+namespace
+{
+enum
+  {
+  AddOneType = 1,
+  HeavyType = 2,
+  ChainLength = 100000,
+  // evaluated recursively, a longer uncompiled chain would run out of stack.
+  UncompiledChainLength = 10000,
+  FanOutWidth = 1000,
+  // independent chains of heavy calculations, like one effect chain per fixture.
+  ParallelChains = 64,
+  ParallelChainLength = 8,
+  HeavyIterations = 20000,
+  Evaluations = 100
+  };
+
+void addOne(const XNodeInputs &inputs, const XNodeOutputs &outputs)
+  {
+  outputs.at<xint32>(0) = inputs.at<xint32>(0) + 1;
+  }
+
+XNodeDefinition addOneDefinition()
+  {
+  XNodeDefinition def(AddOneType);
+  def.addInput<xint32>(0);
+  def.addOutput<xint32>(0);
+  def.addCalculation(addOne, XNodeDefinition::Inputs() << 0, XNodeDefinition::Outputs() << 0);
+  return def;
+  }
+
+// enough arithmetic per calculation to be worth running on another thread.
+void heavy(const XNodeInputs &inputs, const XNodeOutputs &outputs)
+  {
+  float value = inputs.at<float>(0);
+  float result = 0.0f;
+  for(int i=0; i<HeavyIterations; ++i)
+    {
+    result += sinf(value + i * 0.001f);
+    }
+  outputs.at<float>(0) = value + result * 0.0001f;
+  }
+
+XNodeDefinition heavyDefinition()
+  {
+  XNodeDefinition def(HeavyType);
+  def.addInput<float>(0.0f);
+  def.addOutput<float>(0.0f);
+  def.addCalculation(heavy, XNodeDefinition::Inputs() << 0, XNodeDefinition::Outputs() << 0);
+  return def;
+  }
+
+int argument(const QStringList &args, int index, int fallback)
+  {
+  bool ok = false;
+  int value = index < args.size() ? args[index].toInt(&ok) : 0;
+  return ok ? value : fallback;
+  }
+
+// a chain of [length] nodes each adding one, so the last outputs the first input plus [length].
+int runChain(int length, bool compiled)
+  {
+  XNetwork network;
+  network.addDefinition(addOneDefinition());
+  network.setCompiled(compiled);
+
+  XTime start = XTime::now();
+  XVector<XNetwork::InstanceID> nodes;
+  nodes.reserve(length);
+  for(int i=0; i<length; ++i)
+    {
+    nodes << network.createNode(AddOneType);
+    if(i)
+      {
+      network.connect(nodes[i-1], 0, nodes[i], 0);
+      }
+    }
+  double building = (XTime::now() - start).milliseconds();
+
+  start = XTime::now();
+  int first = network.output<xint32>(nodes.last(), 0);
+  double firstEvaluation = (XTime::now() - start).milliseconds();
+
+  // read again as a script would, through XVariant.
+  bool correct = first == length && network.outputVariant(nodes.last(), 0).toInt() == length;
+
+  // change the head of the chain, so every evaluation dirties and computes the whole chain.
+  start = XTime::now();
+  for(int i=0; i<Evaluations; ++i)
+    {
+    network.setInput<xint32>(nodes.first(), 0, i);
+    correct = correct && network.output<xint32>(nodes.last(), 0) == i + length;
+    }
+  double evaluating = (XTime::now() - start).milliseconds() / Evaluations;
+
+  qDebug() << (compiled ? "compiled" : "uncompiled") << "chain of" << length << "built in" << building << "ms,"
+           << "first evaluated in" << firstEvaluation << "ms, then" << evaluating << "ms an evaluation";
+
+  if(!correct)
+    {
+    qWarning() << "chain of" << length << "computed the wrong value";
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
+
+// one node feeding [width] nodes, each read after every change to the source.
+int runFanOut(int width, bool compiled)
+  {
+  XNetwork network;
+  network.addDefinition(addOneDefinition());
+  network.setCompiled(compiled);
+
+  XNetwork::InstanceID source = network.createNode(AddOneType);
+  XVector<XNetwork::InstanceID> nodes;
+  nodes.reserve(width);
+  for(int i=0; i<width; ++i)
+    {
+    nodes << network.createNode(AddOneType);
+    network.connect(source, 0, nodes.last(), 0);
+    }
+
+  bool correct = true;
+  XTime start = XTime::now();
+  for(int i=0; i<Evaluations; ++i)
+    {
+    network.setInput<xint32>(source, 0, i);
+    foreach(XNetwork::InstanceID node, nodes)
+      {
+      correct = correct && network.output<xint32>(node, 0) == i + 2;
+      }
+    }
+  double evaluating = (XTime::now() - start).milliseconds() / Evaluations;
+
+  qDebug() << (compiled ? "compiled" : "uncompiled") << "fan out of" << width << "evaluated in" << evaluating << "ms";
+
+  if(!correct)
+    {
+    qWarning() << "fan out of" << width << "computed the wrong value";
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
+}
+
+// [chains] chains of heavy calculations, fed from one input, evaluated by reading each chain's end in turn, or
+// by preparing every end at once.
+void runParallel(int chains, bool parallel, XVector<float> &results)
+  {
+  XNetwork network;
+  network.addDefinition(heavyDefinition());
+  network.setCompiled(true);
+
+  XNetwork::InstanceID source = network.createNode(HeavyType);
+  XVector<XNetwork::OutputReference> ends;
+  for(int c=0; c<chains; ++c)
+    {
+    XNetwork::InstanceID last = source;
+    for(int i=0; i<ParallelChainLength; ++i)
+      {
+      XNetwork::InstanceID node = network.createNode(HeavyType);
+      network.connect(last, 0, node, 0);
+      last = node;
+      }
+    ends << XNetwork::OutputReference(last, 0);
+    }
+
+  XTime start = XTime::now();
+  network.setInput<float>(source, 0, 1.0f);
+  if(parallel)
+    {
+    network.prepareOutputs(ends);
+    }
+
+  results.clear();
+  foreach(const XNetwork::OutputReference &end, ends)
+    {
+    results << network.output<float>(end.first, end.second);
+    }
+  double evaluating = (XTime::now() - start).milliseconds();
+
+  qDebug() << (parallel ? "parallel" : "serial") << chains << "chains of" << ParallelChainLength << "evaluated in"
+           << evaluating << "ms";
+  }
+
+int networkChainBenchmark(const QStringList &args)
+  {
+  int length = argument(args, 0, ChainLength);
+  int uncompiledLength = qMin(length, argument(args, 1, UncompiledChainLength));
+
+  int result = runChain(length, true);
+  if(runChain(uncompiledLength, false) != EXIT_SUCCESS)
+    {
+    result = EXIT_FAILURE;
+    }
+  return result;
+  }
+
+int networkFanOutBenchmark(const QStringList &args)
+  {
+  int width = argument(args, 0, FanOutWidth);
+
+  int result = runFanOut(width, true);
+  if(runFanOut(width, false) != EXIT_SUCCESS)
+    {
+    result = EXIT_FAILURE;
+    }
+  return result;
+  }
+
+int networkParallelBenchmark(const QStringList &args)
+  {
+  int chains = argument(args, 0, ParallelChains);
+  qDebug() << "on" << QThread::idealThreadCount() << "threads";
+
+  XVector<float> serial, parallel;
+  runParallel(chains, false, serial);
+  runParallel(chains, true, parallel);
+
+  // each calculation is the same arithmetic on the same values, wherever it runs.
+  if(serial != parallel)
+    {
+    qWarning() << "parallel evaluation computed different values";
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
@@ -5,7 +5,9 @@
 #include "XMap"
 #include "XList"
 #include "XNodeDefinition.h"
+#include "QPair"
 
+class QThreadPool;
 class XNodeInputObserver;
 class XNodeOutputObserver;
 class XNodeDirtyObserver;
@@ -15,6 +17,7 @@ class EKSADD_EXPORT XNetwork
 public:
   typedef xuint32 InstanceID;
   XNetwork();
+  ~XNetwork();
 
   void addDefinition(const XNodeDefinition &);
   InstanceID createNode(XNodeDefinition::TypeID);
@@ -23,8 +26,27 @@ public:
   void connect(InstanceID outputNode, XNodeDefinition::OutputID, InstanceID inputNode, XNodeDefinition::InputID);
   void disconnect(InstanceID outputNode, XNodeDefinition::OutputID, InstanceID inputNode, XNodeDefinition::InputID);
 
-  void setInput(InstanceID, XNodeDefinition::InputID, const XVariant &);
-  XVariant &output(InstanceID, XNodeDefinition::OutputID);
+  // set or read a port as the type it was declared with.
+  template <typename T> void setInput(InstanceID id, XNodeDefinition::InputID input, const T &value)
+    {
+    NodeInstance *inst = instance(id);
+    *static_cast<T *>(inputValue(inst, input, XMetaType::typeOf<T>())) = value;
+    inputChanged(inst, input);
+    }
+  template <typename T> const T &output(InstanceID id, XNodeDefinition::OutputID output)
+    {
+    return *static_cast<const T *>(outputValue(instance(id), output, XMetaType::typeOf<T>()));
+    }
+
+  // set or read a port from a script or UI, converting to and from its type.
+  void setInputVariant(InstanceID, XNodeDefinition::InputID, const XVariant &);
+  XVariant outputVariant(InstanceID, XNodeDefinition::OutputID);
+
+  typedef QPair<InstanceID, XNodeDefinition::OutputID> OutputReference;
+  // bring every output in [outputs] up to date, to be read with output() after. When compiled, calculations
+  // which don't depend on each other run at the same time on a thread pool, so calculation functions must only
+  // touch their own inputs and outputs. Observers are still called on this thread, in schedule order.
+  void prepareOutputs(const XVector<OutputReference> &outputs);
 
   void addOutputObserver(InstanceID, XNodeOutputObserver *);
   void addDirtyObserver(InstanceID, XNodeDirtyObserver *);
@@ -32,13 +54,41 @@ public:
   void removeOutputObserver(XNodeOutputObserver *);
   void removeDirtyObserver(XNodeDirtyObserver *);
 
+  // when compiled the calculations are sorted into a flat schedule, each after those it reads from, and outputs
+  // are evaluated and inputs dirtied by looping over it, rather than recursing node to node. The schedule is
+  // built again the next time it is used after nodes are created, destroyed, connected or disconnected.
+  void setCompiled(bool compiled);
+  bool isCompiled() const { return _plan != 0; }
+
 private:
   class NodeInstance;
-  void disconnect(NodeInstance *, XNodeDefinition::OutputID, NodeInstance *, XNodeDefinition::InputID);
+  class Plan;
+  class Column;
+  NodeInstance *instance(InstanceID) const;
+  void *inputValue(NodeInstance *, XNodeDefinition::InputID, XMetaType::Type);
+  const void *outputValue(NodeInstance *, XNodeDefinition::OutputID, XMetaType::Type);
+  void inputChanged(NodeInstance *, XNodeDefinition::InputID);
+  // the storage for values of [type], created on first use.
+  Column *column(XMetaType::Type type);
+
+  // [copyValue] keeps the input holding the value it was connected to, unneeded if the input node is going.
+  void disconnect(NodeInstance *, XNodeDefinition::OutputID, NodeInstance *, XNodeDefinition::InputID, bool copyValue=true);
   void prepareOutput(NodeInstance*, XNodeDefinition::OutputID);
   void dirtyInput(NodeInstance*, XNodeDefinition::InputID);
+
+  // the schedule, built if the network has changed since it was last used.
+  Plan *plan();
+  // hand dirty state back to the instances, before the network changes shape.
+  void invalidatePlan();
+  void prepareCompiledOutput(NodeInstance*, XNodeDefinition::OutputID);
+  void dirtyCompiledInput(NodeInstance*, XNodeDefinition::InputID);
+
   XMap <XNodeDefinition::TypeID, XNodeDefinition*> _nodes;
   XMap <InstanceID, NodeInstance*> _instances;
+  XMap <XMetaType::Type, Column*> _columns;
+  Plan *_plan;
+  bool _planValid;
+  QThreadPool *_pool;
   };
 
 #endif // XNETWORK_H
@@ -7,9 +7,32 @@
 #include "XVector"
 #include "XProperty"
 #include "XVariant"
+#include "XMetaType"
 
 class XNetwork;
 
+// the values a calculation reads, in the order its inputs were listed, each the type its port declares.
+class XNodeInputs
+  {
+public:
+  XNodeInputs(const void * const *values) : _values(values) { }
+  template <typename T> const T &at(xsize i) const { return *static_cast<const T *>(_values[i]); }
+
+private:
+  const void * const *_values;
+  };
+
+// the values a calculation writes, in the order its outputs were listed.
+class XNodeOutputs
+  {
+public:
+  XNodeOutputs(void * const *values) : _values(values) { }
+  template <typename T> T &at(xsize i) const { return *static_cast<T *>(_values[i]); }
+
+private:
+  void * const *_values;
+  };
+
 #define X_NODE(node, parent)
 
 class EKSADD_EXPORT XNodeDefinition
@@ -21,7 +44,46 @@ public:
   typedef XList<InputID> Inputs;
   typedef XList<OutputID> Outputs;
 
-  typedef void (*CalculationFunction)(const XVariant **, XVariant **);
+  typedef void (*CalculationFunction)(const XNodeInputs &, const XNodeOutputs &);
+
+  // an input or output, holding a value of one type. XVariant is only used to set or read a port from
+  // outside the network, calculations see the value itself.
+  struct Port
+    {
+    XMetaType::Type type;
+    XVariant defaultValue;
+    void (*construct)(void *value, const XVariant &from);
+    void (*assign)(void *value, const XVariant &from);
+    XVariant (*toVariant)(const void *value);
+
+    template <typename T> static Port of(const T &defaultValue)
+      {
+      Port port;
+      port.type = XMetaType::typeOf<T>();
+      port.defaultValue = defaultValue;
+      port.construct = constructHelper<T>;
+      port.assign = assignHelper<T>;
+      port.toVariant = toVariantHelper<T>;
+      return port;
+      }
+
+  private:
+    template <typename T> static void constructHelper(void *value, const XVariant &from)
+      {
+      new(value) T(from.valueAs<T>());
+      }
+
+    template <typename T> static void assignHelper(void *value, const XVariant &from)
+      {
+      *static_cast<T *>(value) = from.valueAs<T>();
+      }
+
+    template <typename T> static XVariant toVariantHelper(const void *value)
+      {
+      return XVariant(*static_cast<const T *>(value));
+      }
+    };
+
   struct Calculation
     {
     CalculationFunction func;
@@ -32,8 +94,8 @@ public:
 properties:
   XRORefProperty(TypeID, type);
   XRORefProperty(XVector <Calculation>, calculations);
-  XRORefProperty(XVariantVector, defaultInputs);
-  XRORefProperty(XVariantVector, defaultOutputs);
+  XRORefProperty(XVector <Port>, inputs);
+  XRORefProperty(XVector <Port>, outputs);
 
   typedef XMap<OutputID, XVector<InputID> > OutputMapLookup;
   XRORefProperty(OutputMapLookup, outputMap);
@@ -44,8 +106,17 @@ properties:
 public:
   XNodeDefinition(TypeID type);
 
-  xuint32 addInput( const XVariant & );
-  xuint32 addOutput( const XVariant & );
+  template <typename T> InputID addInput( const T &defaultValue = T() )
+    {
+    _inputs << Port::of(defaultValue);
+    return _inputs.size() - 1;
+    }
+
+  template <typename T> OutputID addOutput( const T &defaultValue = T() )
+    {
+    _outputs << Port::of(defaultValue);
+    return _outputs.size() - 1;
+    }
 
   void addCalculation( CalculationFunction, const Inputs &, const Outputs & );
   };
@@ -1,6 +1,71 @@
 #include "XNetwork.h"
 #include "XNodeObserver.h"
 #include "XProperty"
+#include "QtAlgorithms"
+#include "QPair"
+#include "QThreadPool"
+#include "QRunnable"
+
+// values of one type, for every node in the network, packed together in blocks which never move, so calculations
+// can hold pointers to them. Slots freed by destroyed nodes are reused before the column grows.
+class XNetwork::Column
+  {
+public:
+  enum
+    {
+    BlockSize = 1024,
+    Alignment = 16
+    };
+
+  Column(XMetaType::Type type) : _type(type), _stride(XMetaType::sizeOf(type)), _used(0)
+    {
+    xAssert(_stride);
+    }
+
+  ~Column()
+    {
+    foreach(char *block, _blocks)
+      {
+      qFreeAligned(block);
+      }
+    }
+
+  XMetaType::Type type() const { return _type; }
+
+  // an unconstructed slot for a value.
+  void *allocate()
+    {
+    if(_free.size())
+      {
+      void *value = _free.last();
+      _free.pop_back();
+      return value;
+      }
+
+    if(_used == (xsize)_blocks.size() * BlockSize)
+      {
+      _blocks << (char *)qMallocAligned(_stride * BlockSize, Alignment);
+      }
+    void *value = _blocks.last() + (_used % BlockSize) * _stride;
+    ++_used;
+    return value;
+    }
+
+  // return a slot, its value already destroyed.
+  void release(void *value)
+    {
+    _free << value;
+    }
+
+private:
+  X_DISABLE_COPY(Column);
+
+  XMetaType::Type _type;
+  xsize _stride;
+  xsize _used;
+  XVector<char *> _blocks;
+  XVector<void *> _free;
+  };
 
 class XNetwork::NodeInstance
   {
@@ -8,9 +73,11 @@ public:
   struct CalculationInstance
     {
     XNodeDefinition::CalculationFunction func;
-    XVector <XVariant*> inputs;
-    XVector <XVariant*> outputs;
+    XVector <const void*> inputs;
+    XVector <void*> outputs;
     bool dirty;
+    // where this calculation is in the compiled schedule.
+    xuint32 step;
     };
 
   struct Connection
@@ -20,12 +87,14 @@ public:
     xuint32 id;
     };
 
+  // the id the network knows this node by
+  InstanceID id;
   // The definition this node is instanced from
   const XNodeDefinition *node;
-  // the inputs for this node, inputs in CalculationInstances point at these
-  XVector <XVariant> inputs;
-  // the inputs for this node, outputs in CalculationInstances point at these
-  XVector <XVariant> outputs;
+  // the inputs for this node, held in the network's columns, inputs in CalculationInstances point at these
+  XVector <void*> inputs;
+  // the outputs for this node, outputs in CalculationInstances point at these
+  XVector <void*> outputs;
   // calculation instances
   XVector <CalculationInstance> calculations;
   // Map from outputs to calculations
@@ -41,65 +110,305 @@ public:
   // dirty observers
   XVector <XNodeDirtyObserver*> dirtyObservers;
 
-  NodeInstance(const XNodeDefinition *n)
+  NodeInstance(InstanceID i, const XNodeDefinition *n, XNetwork *net) : id(i)
     {
     // assign the definition pointer
     node = n;
 
-    // copy the default values
-    inputs = node->defaultInputs();
-    outputs = node->defaultOutputs();
+    // copy the default values into the network's storage
+    foreach(const XNodeDefinition::Port &port, node->inputs())
+      {
+      void *value = net->column(port.type)->allocate();
+      port.construct(value, port.defaultValue);
+      inputs << value;
+      }
+    foreach(const XNodeDefinition::Port &port, node->outputs())
+      {
+      void *value = net->column(port.type)->allocate();
+      port.construct(value, port.defaultValue);
+      outputs << value;
+      }
 
     // create the connection maps
     connectionsIn.fill(Connection(), inputs.size());
-    connectionsOut.fill(XVector<Connection>(), inputs.size());
+    connectionsOut.fill(XVector<Connection>(), outputs.size());
 
     // for each calculation in the definition
     calculations.reserve(node->calculations().size());
-    const XNodeDefinition::Calculation *first = &node->calculations().first(),
-                                       *calc = first,
-                                       *calcEnd = first + node->calculations().size();
-    for(; calc != calcEnd; ++calc)
+    foreach(const XNodeDefinition::Calculation &calc, node->calculations())
       {
       // create instance from its definition
       CalculationInstance calcInst;
-      calcInst.func = calc->func;
+      calcInst.func = calc.func;
       calcInst.dirty = true;
+      calcInst.step = 0;
 
       // set up the input pointer to point at the instanced nodes values
-      const xuint32 *index = &calc->inputIDs.first(), *end = index + calc->inputIDs.size();
-      for(; index != end; ++index)
+      foreach(xuint32 index, calc.inputIDs)
         {
-        calcInst.inputs << &inputs[*index];
+        calcInst.inputs << inputs[index];
         }
 
       // set up the output pointer to point at the instanced nodes values
-      index = &calc->outputIDs.first(); end = index + calc->outputIDs.size();
-      for(; index != end; ++index)
+      foreach(xuint32 index, calc.outputIDs)
         {
-        calcInst.outputs << &outputs[*index];
+        calcInst.outputs << outputs[index];
         }
 
       calculations << calcInst;
       }
 
     calculationMap.fill(0, outputs.size());
-    calc = first;
-    for(; calc != calcEnd; ++calc)
+    for(int calc=0; calc<calculations.size(); ++calc)
       {
-      // set up the output pointer to point at the instanced nodes values
-      const xuint32 *index = &calc->outputIDs.first(),
-                    *end = index + calc->outputIDs.size();
-      for(; index != end; ++index)
+      // map each output to the calculation which computes it
+      foreach(xuint32 index, node->calculations()[calc].outputIDs)
         {
-        calculationMap[*index] = &calculations[calc-first];
+        calculationMap[index] = &calculations[calc];
         }
       }
     }
+
+  // destroy the values, and hand their slots back to the network.
+  void release(XNetwork *net)
+    {
+    for(int i=0; i<inputs.size(); ++i)
+      {
+      XMetaType::Type type = node->inputs()[i].type;
+      XMetaType::destroy(type, inputs[i], false);
+      net->column(type)->release(inputs[i]);
+      }
+    for(int i=0; i<outputs.size(); ++i)
+      {
+      XMetaType::Type type = node->outputs()[i].type;
+      XMetaType::destroy(type, outputs[i], false);
+      net->column(type)->release(outputs[i]);
+      }
+    inputs.clear();
+    outputs.clear();
+    }
   };
 
-XNetwork::XNetwork()
+class XNetwork::Plan
+  {
+public:
+  struct Step
+    {
+    NodeInstance *node;
+    NodeInstance::CalculationInstance *calculation;
+    const XNodeDefinition::Calculation *definition;
+    XNodeDefinition::CalculationFunction func;
+    // where the step's values start in inputs and outputs.
+    xuint32 firstInput;
+    xuint32 firstOutput;
+    };
+
+  enum
+    {
+    Clean,
+    Dirty,
+    // dirty, and already waiting to be evaluated.
+    Queued
+    };
+
+  // the calculations, each after every calculation it reads from.
+  XVector<Step> steps;
+  XVector<const void *> inputs;
+  XVector<void *> outputs;
+  XVector<xuint8> dirty;
+
+  // for step s, the steps it reads from are dependencies[dependencyStart[s]] to dependencies[dependencyStart[s+1]],
+  // and likewise for the steps which read from it.
+  XVector<xuint32> dependencyStart;
+  XVector<xuint32> dependencies;
+  XVector<xuint32> dependentStart;
+  XVector<xuint32> dependents;
+
+  // working space, sized to the schedule so evaluating doesn't allocate.
+  XVector<xuint32> stack;
+  XVector<xuint32> pending;
+  XVector<xuint32> level;
+  XVector<xuint32> levelStart;
+  XVector<xuint32> ordered;
+
+  // add [target] and the dirty calculations it depends on to pending, each once, returning the new pending size.
+  xuint32 queue(xuint32 target, xuint32 pendingSize);
+  // sort the pending steps into ordered, grouped by how many pending steps are upstream of them, so the
+  // steps of a level only read from earlier levels. Returns the number of levels.
+  xuint32 sortIntoLevels(xuint32 pendingSize);
+
+  void notifyCalculation(XNetwork *net, xuint32 s) const;
+  void run(xuint32 s) const
+    {
+    const Step &step = steps[s];
+    step.func(XNodeInputs(inputs.constData() + step.firstInput), XNodeOutputs(outputs.constData() + step.firstOutput));
+    }
+
+  // runs some steps of one level on the network's thread pool.
+  class Job : public QRunnable
+    {
+  public:
+    Job(const Plan *plan, const xuint32 *begin, const xuint32 *end) : _plan(plan), _begin(begin), _end(end)
+      {
+      }
+
+    void run()
+      {
+      for(const xuint32 *s = _begin; s != _end; ++s)
+        {
+        _plan->run(*s);
+        }
+      }
+
+  private:
+    const Plan *_plan;
+    const xuint32 *_begin;
+    const xuint32 *_end;
+    };
+  };
+
+xuint32 XNetwork::Plan::queue(xuint32 target, xuint32 pendingSize)
+  {
+  if(dirty[target] != Dirty)
+    {
+    return pendingSize;
+    }
+
+  // a clean calculation's dependencies are all clean, so the search stops there.
+  xuint32 stackSize = 0;
+  dirty[target] = Queued;
+  stack[stackSize++] = target;
+  while(stackSize)
+    {
+    xuint32 s = stack[--stackSize];
+    pending[pendingSize++] = s;
+
+    const xuint32 *dep = dependencies.constData() + dependencyStart[s];
+    const xuint32 *depEnd = dependencies.constData() + dependencyStart[s+1];
+    for(; dep != depEnd; ++dep)
+      {
+      if(dirty[*dep] == Dirty)
+        {
+        dirty[*dep] = Queued;
+        stack[stackSize++] = *dep;
+        }
+      }
+    }
+  return pendingSize;
+  }
+
+xuint32 XNetwork::Plan::sortIntoLevels(xuint32 pendingSize)
   {
+  // in schedule order every step comes after those it reads from, so their levels are already known.
+  qSort(pending.begin(), pending.begin() + pendingSize);
+
+  xuint32 levels = 0;
+  for(xuint32 i=0; i<pendingSize; ++i)
+    {
+    xuint32 s = pending[i];
+    xuint32 stepLevel = 0;
+    for(xuint32 d=dependencyStart[s]; d<dependencyStart[s+1]; ++d)
+      {
+      if(dirty[dependencies[d]] == Queued)
+        {
+        stepLevel = qMax(stepLevel, level[dependencies[d]] + 1);
+        }
+      }
+    level[s] = stepLevel;
+    levels = qMax(levels, stepLevel + 1);
+    }
+
+  levelStart.fill(0, levels + 1);
+  for(xuint32 i=0; i<pendingSize; ++i)
+    {
+    ++levelStart[level[pending[i]] + 1];
+    }
+  for(xuint32 l=0; l<levels; ++l)
+    {
+    levelStart[l+1] += levelStart[l];
+    }
+
+  // placed in schedule order within each level, using the stack as each level's cursor.
+  for(xuint32 l=0; l<levels; ++l)
+    {
+    stack[l] = levelStart[l];
+    }
+  for(xuint32 i=0; i<pendingSize; ++i)
+    {
+    ordered[stack[level[pending[i]]]++] = pending[i];
+    }
+  return levels;
+  }
+
+void XNetwork::Plan::notifyCalculation(XNetwork *net, xuint32 s) const
+  {
+  const Step &step = steps[s];
+  if(step.node->outputObservers.size())
+    {
+    foreach(XNodeDefinition::OutputID calcOutput, step.definition->outputIDs)
+      {
+      XNodeOutputObserver * const *obs = step.node->outputObservers.constData(),
+                          * const *obsEnd = obs + step.node->outputObservers.size();
+      for(; obs != obsEnd; ++obs)
+        {
+        (*obs)->onCalculation(net, step.node->id, calcOutput);
+        }
+      }
+    }
+  }
+
+namespace
+{
+typedef QPair<xuint32, xuint32> Edge;
+
+// lay the edges out grouped by their first step, the run for step s starts at start[s] and ends at start[s+1].
+void buildAdjacency(xuint32 count, const XVector<Edge> &edges, XVector<xuint32> &start, XVector<xuint32> &values)
+  {
+  start.fill(0, count + 1);
+  foreach(const Edge &edge, edges)
+    {
+    ++start[edge.first + 1];
+    }
+  for(xuint32 i=0; i<count; ++i)
+    {
+    start[i+1] += start[i];
+    }
+
+  XVector<xuint32> next(start);
+  values.resize(edges.size());
+  foreach(const Edge &edge, edges)
+    {
+    values[next[edge.first]++] = edge.second;
+    }
+  }
+}
+
+XNetwork::XNetwork() : _plan(0), _planValid(false), _pool(0)
+  {
+  }
+
+XNetwork::~XNetwork()
+  {
+  // waits for any running calculations.
+  delete _pool;
+  delete _plan;
+  foreach(NodeInstance *inst, _instances)
+    {
+    inst->release(this);
+    delete inst;
+    }
+  qDeleteAll(_columns);
+  qDeleteAll(_nodes);
+  }
+
+XNetwork::Column *XNetwork::column(XMetaType::Type type)
+  {
+  Column *&col = _columns[type];
+  if(!col)
+    {
+    col = new Column(type);
+    }
+  return col;
   }
 
 void XNetwork::addDefinition(const XNodeDefinition &node)
@@ -109,13 +418,17 @@ void XNetwork::addDefinition(const XNodeDefinition &node)
 
 XNetwork::InstanceID XNetwork::createNode(XNodeDefinition::TypeID type)
   {
+  invalidatePlan();
+
   static xuint32 id = 0;
-  _instances.insert(id, new NodeInstance(_nodes[type]));
+  _instances.insert(id, new NodeInstance(id, _nodes[type], this));
   return id++;
   }
 
 void XNetwork::destroyNode(InstanceID id)
   {
+  invalidatePlan();
+
   NodeInstance *node = _instances[id];
 
   //for all the nodes in the network
@@ -127,43 +440,33 @@ void XNetwork::destroyNode(InstanceID id)
       }
 
     // for each connection on the node
-    NodeInstance::Connection *firstConn = &poss->connectionsIn.first(),
-                             *conn = firstConn,
-                             *lastConn = firstConn + poss->connectionsIn.size();
-    for(; conn != lastConn; ++conn)
+    for(int conn=0; conn<poss->connectionsIn.size(); ++conn)
       {
       // if its connected to the deleting node
-      if(conn->node == node)
+      const NodeInstance::Connection &in = poss->connectionsIn[conn];
+      if(in.node == node)
         {
-        disconnect(node, conn->id, poss, conn-firstConn);
+        disconnect(node, in.id, poss, conn);
         }
       }
 
-    // for each connection on the node
-    XVector<NodeInstance::Connection> *firstConnVector = &poss->connectionsOut.first(),
-                                      *connVector = firstConnVector,
-                                      *lastConnVector = firstConnVector + poss->connectionsOut.size();
-    for(; connVector != lastConnVector; ++connVector)
+    // for each output on the node
+    for(int out=0; out<poss->connectionsOut.size(); ++out)
       {
-      if(connVector->size())
+      // for each connection on the output, backwards as disconnecting removes it
+      XVector<NodeInstance::Connection> &connections = poss->connectionsOut[out];
+      for(int conn=connections.size()-1; conn>=0; --conn)
         {
-        // for each connection on the output node
-        NodeInstance::Connection *firstConn = &connVector->first(),
-                                 *conn = firstConn,
-                                 *lastConn = firstConn + connVector->size();
-        for(; conn != lastConn; ++conn)
+        // if its connected to the deleting node, which won't need the value copied
+        if(connections[conn].node == node)
           {
-          // if its the disconnecting connection
-          if(conn->node == node)
-            {
-            disconnect(poss, conn-firstConn, node, conn->id);
-            break;
-            }
+          disconnect(poss, out, node, connections[conn].id, false);
           }
         }
       }
     }
 
+  node->release(this);
   delete node;
   _instances.remove(id);
   }
@@ -175,17 +478,19 @@ void XNetwork::connect(InstanceID output, XNodeDefinition::OutputID outID,
   NodeInstance *iNode = _instances[input];
   xAssert(oNode);
   xAssert(iNode);
-  xAssert(outID < (xuint32)oNode->inputs.size());
+  xAssert(outID < (xuint32)oNode->outputs.size());
   xAssert(inID < (xuint32)iNode->inputs.size());
+  xAssert(oNode->node->outputs()[outID].type == iNode->node->inputs()[inID].type);
 
   // if its not already connected
   if(iNode->connectionsIn[inID].node == 0)
     {
+    invalidatePlan();
+
     // dirty the inputs
-    const xuint32 *index = &iNode->node->inputMap()[inID].first(), *end = index + iNode->node->inputMap()[inID].size();
-    for(; index != end; ++index)
+    foreach(xuint32 index, iNode->node->inputMap().value(inID))
       {
-      iNode->calculationMap[*index]->dirty = true;
+      iNode->calculationMap[index]->dirty = true;
       }
 
     // set up the connection maps
@@ -200,11 +505,13 @@ void XNetwork::connect(InstanceID output, XNodeDefinition::OutputID outID,
     oNode->connectionsOut[outID] << outCon;
 
     // set up the value pointers to point at the correct outputs
-    const XNodeDefinition::Calculation *first = &iNode->node->calculations().first();
-    const XNodeDefinition::Calculation *calc = first, *calcEnd = first + iNode->node->calculations().size();
-    for(; calc != calcEnd; ++calc)
+    for(int calc=0; calc<iNode->calculations.size(); ++calc)
       {
-      iNode->calculations[calc-first].inputs[inID] = &oNode->outputs[outID];
+      int index = iNode->node->calculations()[calc].inputIDs.indexOf(inID);
+      if(index != -1)
+        {
+        iNode->calculations[calc].inputs[index] = oNode->outputs[outID];
+        }
       }
     }
   else
@@ -222,13 +529,15 @@ void XNetwork::disconnect(InstanceID output, XNodeDefinition::OutputID outID,
   }
 
 void XNetwork::disconnect(NodeInstance *oNode, XNodeDefinition::OutputID outID,
-                       NodeInstance *iNode, XNodeDefinition::InputID inID)
+                       NodeInstance *iNode, XNodeDefinition::InputID inID, bool copyValue)
   {
   xAssert(oNode);
   xAssert(iNode);
-  xAssert(outID < (xuint32)oNode->inputs.size());
+  xAssert(outID < (xuint32)oNode->outputs.size());
   xAssert(inID < (xuint32)iNode->inputs.size());
 
+  invalidatePlan();
+
   // Copy on disconnect causes this to not be necessary, but it might be?
   // for each output connected to the input, dirty it.
   //const xuint32 *index = &iNode->node->inputMap()[inID].first(), *end = index + iNode->node->inputMap()[inID].size();
@@ -242,49 +551,106 @@ void XNetwork::disconnect(NodeInstance *oNode, XNodeDefinition::OutputID outID,
   iNode->connectionsIn[inID] = con;
 
   // for each connection on the output node
-  NodeInstance::Connection *firstConn = &oNode->connectionsOut[outID].first(),
-                           *conn = firstConn,
-                           *lastConn = firstConn + oNode->connectionsOut[outID].size();
-  for(; conn != lastConn; ++conn)
+  XVector<NodeInstance::Connection> &outputConnections = oNode->connectionsOut[outID];
+  for(int conn=0; conn<outputConnections.size(); ++conn)
     {
     // if its the disconnecting connection
-    if(conn->node == iNode)
+    if(outputConnections[conn].node == iNode && outputConnections[conn].id == inID)
       {
       // remove from the output list
-      oNode->connectionsOut[outID].remove(conn-firstConn);
+      outputConnections.remove(conn);
+      break;
       }
     }
 
+  if(!copyValue)
+    {
+    return;
+    }
+
+  // copy old value to default location
+  XMetaType::assign(iNode->node->inputs()[inID].type, iNode->inputs[inID], oNode->outputs[outID]);
+
   // for each calculation set on the input (destination) node
-  const XNodeDefinition::Calculation *firstCalc = &iNode->node->calculations().first(),
-                                     *calc = firstCalc,
-                                     *calcEnd = firstCalc + iNode->node->calculations().size();
-  for(; calc != calcEnd; ++calc)
-    {
-    // copy old value to default location
-    XVariant &var = iNode->inputs[inID];
-    XVariant *var2 = iNode->calculations[calc-firstCalc].inputs[inID];
-    var = *var2;
-    // reset to default location
-    iNode->calculations[calc-firstCalc].inputs[inID] = &iNode->inputs[inID];
+  for(int calc=0; calc<iNode->calculations.size(); ++calc)
+    {
+    int index = iNode->node->calculations()[calc].inputIDs.indexOf(inID);
+    if(index != -1)
+      {
+      // reset to default location
+      iNode->calculations[calc].inputs[index] = iNode->inputs[inID];
+      }
     }
   }
 
-void XNetwork::setInput(XNetwork::InstanceID id, XNodeDefinition::InputID input, const XVariant &var)
+XNetwork::NodeInstance *XNetwork::instance(InstanceID id) const
   {
-  NodeInstance *inst = _instances[id];
+  NodeInstance *inst = _instances.value(id);
   xAssert(inst);
+  return inst;
+  }
+
+void *XNetwork::inputValue(NodeInstance *inst, XNodeDefinition::InputID input, XMetaType::Type type)
+  {
+  xAssert(input < (xuint32)inst->inputs.size());
+  xAssert(inst->node->inputs()[input].type == type);
+  X_UNUSED(type);
+  return inst->inputs[input];
+  }
+
+const void *XNetwork::outputValue(NodeInstance *inst, XNodeDefinition::OutputID output, XMetaType::Type type)
+  {
+  xAssert(output < (xuint32)inst->outputs.size());
+  xAssert(inst->node->outputs()[output].type == type);
+  X_UNUSED(type);
+
+  // prepare the output, then return it
+  if(_plan)
+    {
+    prepareCompiledOutput(inst, output);
+    }
+  else
+    {
+    prepareOutput(inst, output);
+    }
+  return inst->outputs[output];
+  }
+
+void XNetwork::setInputVariant(XNetwork::InstanceID id, XNodeDefinition::InputID input, const XVariant &var)
+  {
+  NodeInstance *inst = instance(id);
   xAssert(input < (xuint32)inst->inputs.size());
 
   // set the value, then dirty the connected nodes
-  inst->inputs[input] = var;
-  dirtyInput(inst, input);
+  inst->node->inputs()[input].assign(inst->inputs[input], var);
+  inputChanged(inst, input);
+  }
+
+XVariant XNetwork::outputVariant(InstanceID id, XNodeDefinition::OutputID output)
+  {
+  NodeInstance *inst = instance(id);
+  xAssert(output < (xuint32)inst->outputs.size());
+  const XNodeDefinition::Port &port = inst->node->outputs()[output];
+  return port.toVariant(outputValue(inst, output, port.type));
+  }
+
+void XNetwork::inputChanged(NodeInstance *inst, XNodeDefinition::InputID input)
+  {
+  if(_plan)
+    {
+    dirtyCompiledInput(inst, input);
+    }
+  else
+    {
+    dirtyInput(inst, input);
+    }
   }
 
 void XNetwork::dirtyInput(NodeInstance *inst, XNodeDefinition::InputID input)
   {
   // for each ioutput connected to this input, dirty it
-  const xuint32 *index = &inst->node->inputMap()[input].first(), *end = index + inst->node->inputMap()[input].size();
+  const XVector<XNodeDefinition::OutputID> affected(inst->node->inputMap().value(input));
+  const xuint32 *index = affected.constData(), *end = index + affected.size();
   for(; index != end; ++index)
     {
     if(!inst->calculationMap[*index]->dirty)
@@ -295,7 +661,7 @@ void XNetwork::dirtyInput(NodeInstance *inst, XNodeDefinition::InputID input)
         XNodeDirtyObserver **obs = &inst->dirtyObservers.first(), **obsEnd = obs + inst->dirtyObservers.size();
         for(; obs != obsEnd; ++obs)
           {
-          (*obs)->onDirty(this, _instances.key(inst), *index);
+          (*obs)->onDirty(this, inst->id, *index);
           }
         }
 
@@ -316,24 +682,14 @@ void XNetwork::dirtyInput(NodeInstance *inst, XNodeDefinition::InputID input)
     }
   }
 
-XVariant &XNetwork::output(InstanceID id, XNodeDefinition::OutputID output)
-  {
-  NodeInstance *inst = _instances[id];
-  xAssert(inst);
-  xAssert(output < (xuint32)inst->outputs.size());
-
-  // prepare the output, then return it
-  prepareOutput(inst, output);
-  return inst->outputs[output];
-  }
-
 void XNetwork::prepareOutput(NodeInstance *inst, XNodeDefinition::OutputID output)
   {
   NodeInstance::CalculationInstance *calc = inst->calculationMap[output];
   if(calc->dirty)
     {
     // for each input connected to the output, compute the node
-    const xuint32 *index = &inst->node->outputMap()[output].first(), *end = index + inst->node->outputMap()[output].size();
+    const XVector<XNodeDefinition::InputID> used(inst->node->outputMap().value(output));
+    const xuint32 *index = used.constData(), *end = index + used.size();
     for(; index != end; ++index)
       {
       const NodeInstance::Connection &connection = inst->connectionsIn[*index];
@@ -349,12 +705,12 @@ void XNetwork::prepareOutput(NodeInstance *inst, XNodeDefinition::OutputID outpu
       XNodeOutputObserver **obs = &inst->outputObservers.first(), **obsEnd = obs + inst->outputObservers.size();
       for(; obs != obsEnd; ++obs)
         {
-        (*obs)->onCalculation(this, _instances.key(inst), output);
+        (*obs)->onCalculation(this, inst->id, output);
         }
       }
 
     // call the compute function
-    calc->func((const XVariant **)&calc->inputs[0], &calc->outputs[0]);
+    calc->func(XNodeInputs(calc->inputs.constData()), XNodeOutputs(calc->outputs.constData()));
 
     // node is not dirty any more
     calc->dirty = false;
@@ -404,3 +760,301 @@ void XNetwork::removeDirtyObserver(XNodeDirtyObserver *obs)
       }
     }
   }
+
+void XNetwork::setCompiled(bool compiled)
+  {
+  if(compiled == isCompiled())
+    {
+    return;
+    }
+
+  if(compiled)
+    {
+    _plan = new Plan;
+    _planValid = false;
+    }
+  else
+    {
+    invalidatePlan();
+    delete _plan;
+    _plan = 0;
+    }
+  }
+
+void XNetwork::invalidatePlan()
+  {
+  if(_plan && _planValid)
+    {
+    for(int s=0; s<_plan->steps.size(); ++s)
+      {
+      _plan->steps[s].calculation->dirty = _plan->dirty[s] != Plan::Clean;
+      }
+    }
+  _planValid = false;
+  }
+
+XNetwork::Plan *XNetwork::plan()
+  {
+  xAssert(_plan);
+  if(_planValid)
+    {
+    return _plan;
+    }
+
+  // give every calculation a dense id, in instance order.
+  XVector<Plan::Step> unsorted;
+  foreach(NodeInstance *inst, _instances)
+    {
+    for(int calc=0; calc<inst->calculations.size(); ++calc)
+      {
+      Plan::Step step;
+      step.node = inst;
+      step.calculation = &inst->calculations[calc];
+      step.definition = &inst->node->calculations()[calc];
+      step.func = step.calculation->func;
+      step.firstInput = 0;
+      step.firstOutput = 0;
+
+      step.calculation->step = unsorted.size();
+      unsorted << step;
+      }
+    }
+  xuint32 count = unsorted.size();
+
+  // an edge from each calculation to every calculation reading one of its outputs.
+  XVector<Edge> edges;
+  XVector<xuint32> waitingOn(count, 0);
+  for(xuint32 s=0; s<count; ++s)
+    {
+    const Plan::Step &step = unsorted[s];
+    int firstEdge = edges.size();
+    foreach(XNodeDefinition::InputID input, step.definition->inputIDs)
+      {
+      const NodeInstance::Connection &connection = step.node->connectionsIn[input];
+      if(connection.node)
+        {
+        Edge edge(connection.node->calculationMap[connection.id]->step, s);
+        // two inputs fed by the same calculation are still one dependency.
+        if(edges.indexOf(edge, firstEdge) == -1)
+          {
+          edges << edge;
+          ++waitingOn[s];
+          }
+        }
+      }
+    }
+
+  XVector<xuint32> start, dependents;
+  buildAdjacency(count, edges, start, dependents);
+
+  // sort, each calculation once everything it reads from has been placed.
+  XVector<xuint32> order;
+  order.reserve(count);
+  for(xuint32 s=0; s<count; ++s)
+    {
+    if(!waitingOn[s])
+      {
+      order << s;
+      }
+    }
+  for(int next=0; next<order.size(); ++next)
+    {
+    xuint32 s = order[next];
+    for(xuint32 i=start[s]; i<start[s+1]; ++i)
+      {
+      if(!--waitingOn[dependents[i]])
+        {
+        order << dependents[i];
+        }
+      }
+    }
+
+  if((xuint32)order.size() != count)
+    {
+    xAssertFailMessage("Network contains a cycle");
+    // schedule what remains anyway, its values won't be meaningful.
+    for(xuint32 s=0; s<count; ++s)
+      {
+      if(waitingOn[s])
+        {
+        order << s;
+        }
+      }
+    }
+
+  Plan &p = *_plan;
+  p.steps.resize(count);
+  p.inputs.clear();
+  p.outputs.clear();
+  for(xuint32 s=0; s<count; ++s)
+    {
+    Plan::Step &step = p.steps[s];
+    step = unsorted[order[s]];
+    step.calculation->step = s;
+
+    // the value pointers of each step, back to back.
+    step.firstInput = p.inputs.size();
+    p.inputs << step.calculation->inputs;
+    step.firstOutput = p.outputs.size();
+    p.outputs << step.calculation->outputs;
+    }
+
+  // the edges again, between positions in the schedule, looked up both ways.
+  XVector<Edge> reversed;
+  reversed.reserve(edges.size());
+  for(int e=0; e<edges.size(); ++e)
+    {
+    edges[e].first = unsorted[edges[e].first].calculation->step;
+    edges[e].second = unsorted[edges[e].second].calculation->step;
+    reversed << Edge(edges[e].second, edges[e].first);
+    }
+  buildAdjacency(count, edges, p.dependentStart, p.dependents);
+  buildAdjacency(count, reversed, p.dependencyStart, p.dependencies);
+
+  p.dirty.resize(count);
+  for(xuint32 s=0; s<count; ++s)
+    {
+    p.dirty[s] = p.steps[s].calculation->dirty ? Plan::Dirty : Plan::Clean;
+    }
+
+  p.stack.resize(count);
+  p.pending.resize(count);
+  p.level.resize(count);
+  p.ordered.resize(count);
+
+  _planValid = true;
+  return _plan;
+  }
+
+void XNetwork::prepareCompiledOutput(NodeInstance *inst, XNodeDefinition::OutputID output)
+  {
+  Plan *p = plan();
+
+  xuint32 pendingSize = p->queue(inst->calculationMap[output]->step, 0);
+  if(!pendingSize)
+    {
+    return;
+    }
+
+  // in schedule order every calculation runs after those it reads from.
+  xuint32 *pending = p->pending.data();
+  qSort(pending, pending + pendingSize);
+
+  for(xuint32 i=0; i<pendingSize; ++i)
+    {
+    p->notifyCalculation(this, pending[i]);
+    p->run(pending[i]);
+    p->dirty[pending[i]] = Plan::Clean;
+    }
+  }
+
+void XNetwork::prepareOutputs(const XVector<OutputReference> &outputs)
+  {
+  if(!_plan)
+    {
+    foreach(const OutputReference &ref, outputs)
+      {
+      NodeInstance *inst = instance(ref.first);
+      xAssert(ref.second < (xuint32)inst->outputs.size());
+      prepareOutput(inst, ref.second);
+      }
+    return;
+    }
+
+  Plan *p = plan();
+
+  xuint32 pendingSize = 0;
+  foreach(const OutputReference &ref, outputs)
+    {
+    NodeInstance *inst = instance(ref.first);
+    xAssert(ref.second < (xuint32)inst->outputs.size());
+    pendingSize = p->queue(inst->calculationMap[ref.second]->step, pendingSize);
+    }
+  if(!pendingSize)
+    {
+    return;
+    }
+
+  if(!_pool)
+    {
+    _pool = new QThreadPool;
+    }
+
+  xuint32 levels = p->sortIntoLevels(pendingSize);
+  for(xuint32 l=0; l<levels; ++l)
+    {
+    const xuint32 *begin = p->ordered.constData() + p->levelStart[l];
+    const xuint32 *end = p->ordered.constData() + p->levelStart[l+1];
+    xuint32 count = end - begin;
+
+    // observers hear the whole level, in schedule order, before any of it runs.
+    for(const xuint32 *s = begin; s != end; ++s)
+      {
+      p->notifyCalculation(this, *s);
+      }
+
+    // split between the pool and this thread, which runs the first part itself.
+    xuint32 parts = qMin(count, (xuint32)_pool->maxThreadCount() + 1);
+    xuint32 partSize = (count + parts - 1) / parts;
+    for(const xuint32 *part = begin + partSize; part < end; part += partSize)
+      {
+      _pool->start(new Plan::Job(p, part, qMin(part + partSize, end)));
+      }
+    Plan::Job(p, begin, qMin(begin + partSize, end)).run();
+    _pool->waitForDone();
+
+    for(const xuint32 *s = begin; s != end; ++s)
+      {
+      p->dirty[*s] = Plan::Clean;
+      }
+    }
+  }
+
+void XNetwork::dirtyCompiledInput(NodeInstance *inst, XNodeDefinition::InputID input)
+  {
+  Plan *p = plan();
+
+  xuint32 *stack = p->stack.data();
+  xuint32 stackSize = 0;
+
+  // the calculations reading the input, then everything downstream of them.
+  const XVector<XNodeDefinition::OutputID> affected(inst->node->inputMap().value(input));
+  foreach(XNodeDefinition::OutputID output, affected)
+    {
+    xuint32 s = inst->calculationMap[output]->step;
+    if(p->dirty[s] == Plan::Clean)
+      {
+      p->dirty[s] = Plan::Dirty;
+      stack[stackSize++] = s;
+      }
+    }
+
+  while(stackSize)
+    {
+    xuint32 s = stack[--stackSize];
+
+    const Plan::Step &step = p->steps[s];
+    if(step.node->dirtyObservers.size())
+      {
+      foreach(XNodeDefinition::OutputID calcOutput, step.definition->outputIDs)
+        {
+        XNodeDirtyObserver **obs = &step.node->dirtyObservers.first(), **obsEnd = obs + step.node->dirtyObservers.size();
+        for(; obs != obsEnd; ++obs)
+          {
+          (*obs)->onDirty(this, step.node->id, calcOutput);
+          }
+        }
+      }
+
+    const xuint32 *dep = p->dependents.constData() + p->dependentStart[s];
+    const xuint32 *depEnd = p->dependents.constData() + p->dependentStart[s+1];
+    for(; dep != depEnd; ++dep)
+      {
+      if(p->dirty[*dep] == Plan::Clean)
+        {
+        p->dirty[*dep] = Plan::Dirty;
+        stack[stackSize++] = *dep;
+        }
+      }
+    }
+  }
@@ -6,18 +6,6 @@ XNodeDefinition::XNodeDefinition(TypeID type) : _type(type)
   _calculations.reserve(5);
   }
 
-xuint32 XNodeDefinition::addInput( const XVariant &in )
-  {
-  _defaultInputs << in;
-  return _defaultInputs.size() - 1;
-  }
-
-xuint32 XNodeDefinition::addOutput( const XVariant &out )
-  {
-  _defaultOutputs << out;
-  return _defaultOutputs.size() - 1;
-  }
-
 void XNodeDefinition::addCalculation( CalculationFunction func,
                             const Inputs &in,
                             const Outputs &out )
@@ -3,6 +3,7 @@
 #include "X2DCanvas.h"
 #include "QPen"
 #include "QPainter"
+#include "QRunnable"
 #include "sentity.h"
 
 #define MAX_WIDTH 128
@@ -11,16 +12,76 @@
 #define PROP_PADDING 2
 #define SHADOW_OFFSET 3
 #define CONNECTION_EXTENSION 50
+#define CONNECTION_WIDTH 3
 
-GCSimpleNodeDelegate::GCSimpleNodeDelegate() : _titleFntMetrics(_titleFnt), _propFntMetrics(_propFnt)
+// below this zoom nodes are drawn simplified, and below the overview scale from cached tiles.
+#define DETAIL_SCALE 0.4f
+#define OVERVIEW_SCALE 0.25f
+
+// entities laid out in one background job.
+#define LAYOUT_JOB_SIZE 256
+
+class GCSimpleNodeDelegate::LayoutJob : public QRunnable
   {
-  _titleFnt.setBold(true);
-  _titleFntMetrics = QFontMetrics(_titleFnt);
+public:
+  class Item
+    {
+  public:
+    const void *entity;
+    xuint32 serial;
+    LayoutSource source;
+    RenderData data;
+    };
+
+  LayoutJob(const GCSimpleNodeDelegate *delegate, QWidget *canvas) : _delegate(delegate), _canvas(canvas)
+    {
+    // kept until its layouts are installed, on the thread which owns the delegate.
+    setAutoDelete(false);
+    }
+
+  void run()
+    {
+    for(int i=0; i<items.size(); ++i)
+      {
+      _delegate->layout(items[i].source, items[i].data);
+      }
+
+    // once handed back the job may be deleted.
+    QWidget *canvas = _canvas;
+    _delegate->onLaidOut(this);
+    QMetaObject::invokeMethod(canvas, "update", Qt::QueuedConnection);
+    }
 
-  _propFnt.setPixelSize(_propFnt.pixelSize() * 0.7f);
-  _propFntMetrics = QFontMetrics(_titleFnt);
+  XVector<Item> items;
+
+private:
+  const GCSimpleNodeDelegate *_delegate;
+  QWidget *_canvas;
+  };
+
+GCSimpleNodeDelegate::GCSimpleNodeDelegate() : _detail(FullDetail), _overview(this, OVERVIEW_SCALE),
+    _queuedLayout(0), _layoutSerial(0)
+  {
+  QFont titleFnt;
+  titleFnt.setBold(true);
+  titleFnt.setPixelSize(11);
+  _titleText = GCTextCache::forFont(titleFnt);
+
+  QFont propFnt;
+  propFnt.setPixelSize(9);
+  _propText = GCTextCache::forFont(propFnt);
   }
 
+GCSimpleNodeDelegate::~GCSimpleNodeDelegate()
+  {
+  delete _queuedLayout;
+
+  _layoutPool.waitForDone();
+  foreach(LayoutJob *job, _laidOut)
+    {
+    delete job;
+    }
+  }
 
 void GCSimpleNodeDelegate::ensureRenderData(const SEntity *ent) const
   {
@@ -30,165 +91,544 @@ void GCSimpleNodeDelegate::ensureRenderData(const SEntity *ent) const
     }
   }
 
-void GCSimpleNodeDelegate::preSetupProperty(const QFont& font, RenderData::PropertyData& data, const SProperty *prop, int yOffset) const
+void GCSimpleNodeDelegate::gatherProperty(LayoutSource::Property &data, const SProperty *prop) const
   {
-  QFontMetrics propFntMetrics(font);
-
-  QString name = prop->name();
-  if(name.isEmpty())
+  data.name = prop->name();
+  if(data.name.isEmpty())
     {
-    name = "[" + QString::number(prop->index()) + "]";
+    data.name = "[" + QString::number(prop->index()) + "]";
     }
 
-  QString elided = propFntMetrics.elidedText(name, Qt::ElideRight, MAX_WIDTH - 2*OUTER_PADDING);
-  data.text.setText(elided);
-  data.text.prepare(QTransform(), font);
-
   data.onRight = (prop->hasOutputs() && !prop->hasInput()) || prop->isComputed();
 
-  data.position.setY(yOffset);
-
-  int fillHeight = propFntMetrics.height();
-  int fillWidth = propFntMetrics.width(elided);
-
-  yOffset += fillHeight;
-
   const SPropertyContainer* cont = prop->castTo<SPropertyContainer>();
   if(cont)
     {
-    data.childProperties.resize(cont->size());
+    data.children.resize(cont->size());
 
     int i = 0;
     for(SProperty *child=cont->firstChild(); child; child=child->nextSibling(), ++i)
       {
-      RenderData::PropertyData& childData = data.childProperties[i];
+      gatherProperty(data.children[i], child);
+      }
+    }
+  }
 
-      preSetupProperty(font, childData, child, yOffset);
+void GCSimpleNodeDelegate::gather(const SEntity *ent, LayoutSource &source) const
+  {
+  source.title = ent->name();
+  source.properties.resize(ent->size());
 
-      fillWidth = qMax(fillWidth, childData.renderSize.width());
+  int i = 0;
+  for(SProperty *prop=ent->firstChild(); prop; prop=prop->nextSibling(), ++i)
+    {
+    gatherProperty(source.properties[i], prop);
+    }
+  }
 
-      yOffset += childData.renderSize.height();
-      fillHeight += childData.renderSize.height();
-      }
+void GCSimpleNodeDelegate::preSetupProperty(RenderData::PropertyData& data, const LayoutSource::Property &prop, int yOffset) const
+  {
+  GCTextCache::Text text = _propText->text(prop.name, MAX_WIDTH - 2*OUTER_PADDING);
+  data.text = text.text;
+
+  data.onRight = prop.onRight;
+
+  data.position.setY(yOffset);
+
+  int fillHeight = _propText->height();
+  int fillWidth = text.width;
+
+  yOffset += fillHeight;
+
+  data.childProperties.resize(prop.children.size());
+  for(int i=0; i<prop.children.size(); ++i)
+    {
+    RenderData::PropertyData& childData = data.childProperties[i];
+
+    preSetupProperty(childData, prop.children[i], yOffset);
+
+    fillWidth = qMax(fillWidth, childData.renderSize.width());
+
+    yOffset += childData.renderSize.height();
+    fillHeight += childData.renderSize.height();
     }
 
   data.renderSize.setHeight(fillHeight);
   data.renderSize.setWidth(fillWidth);
   }
 
-void GCSimpleNodeDelegate::postSetupProperty(const QFont& font, RenderData::PropertyData& data, const SProperty *prop, int minX, int maxWidth) const
+void GCSimpleNodeDelegate::postSetupProperty(RenderData::PropertyData& data, int minX, int maxWidth) const
   {
-  const SPropertyContainer* cont = prop->castTo<SPropertyContainer>();
-  if(cont)
+  int newMinX = minX + OUTER_PADDING;
+  int newMaxWidth = maxWidth - 2 * OUTER_PADDING;
+
+  for(int i=0; i<data.childProperties.size(); ++i)
     {
-    int newMinX = minX + OUTER_PADDING;
-    int newMaxWidth = maxWidth - 2 * OUTER_PADDING;
+    RenderData::PropertyData& childData = data.childProperties[i];
 
-    int i = 0;
-    for(SProperty *child=cont->firstChild(); child; child=child->nextSibling(), ++i)
+    postSetupProperty(childData, newMinX, newMaxWidth);
+
+    if(childData.onRight)
+      {
+      childData.position.setX(newMaxWidth - childData.renderSize.width());
+      }
+    else
+      {
+      childData.position.setX(newMinX);
+      }
+    }
+  }
+
+void GCSimpleNodeDelegate::layout(const LayoutSource &source, RenderData &rd) const
+  {
+  GCTextCache::Text title = _titleText->text(source.title);
+  int titleHeight = _titleText->height();
+
+  int fillWidth = title.width;
+
+  int propYStart = titleHeight + OUTER_PADDING + (2 * TITLE_PADDING) + PROP_PADDING;
+
+  rd.properties.resize(source.properties.size());
+  for(int i=0; i<source.properties.size(); ++i)
+    {
+    RenderData::PropertyData& data = rd.properties[i];
+
+    preSetupProperty(data, source.properties[i], propYStart);
+
+    propYStart += data.renderSize.height();
+
+    fillWidth = qMax(fillWidth, data.renderSize.width());
+    }
+
+  fillWidth = qMax(fillWidth, MAX_WIDTH);
+
+  rd.size.setWidth(fillWidth + (2*TITLE_PADDING) + (3*OUTER_PADDING) + titleHeight);
+  rd.size.setHeight(propYStart + OUTER_PADDING);
+
+  rd.titleBounds.setTopLeft(QPoint(OUTER_PADDING, OUTER_PADDING));
+  rd.titleBounds.setBottomRight(QPoint(rd.size.width() - (2*OUTER_PADDING) - 1 - titleHeight,
+              titleHeight + TITLE_PADDING + OUTER_PADDING));
+
+  for(int i=0; i<rd.properties.size(); ++i)
+    {
+    RenderData::PropertyData& data = rd.properties[i];
+
+    postSetupProperty(data, OUTER_PADDING, rd.size.width() - (2*OUTER_PADDING));
+
+    if(data.onRight)
       {
-      RenderData::PropertyData& childData = data.childProperties[i];
+      data.position.setX(rd.size.width() - data.renderSize.width() - (2*OUTER_PADDING));
+      }
+    else
+      {
+      data.position.setX(OUTER_PADDING);
+      }
+    }
+
+  rd.entOutputRadius = rd.titleBounds.height() / 2;
+  rd.entOutputPos = QPoint(rd.titleBounds.right() + OUTER_PADDING, OUTER_PADDING);
+
+  // the title is never wider than fillWidth, so isn't elided.
+  rd.title = title.text;
+  }
+
+void GCSimpleNodeDelegate::install(const SEntity *ent, const RenderData &laidOut) const
+  {
+  QPoint position(100, 100);
+  QHash<const void *, RenderData>::const_iterator existing = _renderData.find(ent);
+  if(existing != _renderData.end())
+    {
+    position = existing->position;
+    }
+
+  RenderData &rd(_renderData[ent]);
+  rd = laidOut;
+  rd.position = position;
+
+  indexEntity(ent);
+  indexOutputs(ent);
+  }
+
+void GCSimpleNodeDelegate::updateRenderData(const SEntity *ent) const
+  {
+  xAssert(ent);
+
+  // a layout still running in the background would be older than this one.
+  _pendingLayouts.remove(ent);
+
+  LayoutSource source;
+  gather(ent, source);
+
+  RenderData rd;
+  layout(source, rd);
+  install(ent, rd);
+  }
+
+void GCSimpleNodeDelegate::queueLayout(const SEntity *ent, QWidget *canvas) const
+  {
+  PendingLayout &pending = _pendingLayouts[ent];
+  pending.entity = const_cast<SEntity *>(ent);
+  pending.serial = ++_layoutSerial;
+
+  if(!_queuedLayout)
+    {
+    _queuedLayout = new LayoutJob(this, canvas);
+    }
 
-      postSetupProperty(font, childData, child, newMinX, newMaxWidth);
+  _queuedLayout->items.resize(_queuedLayout->items.size() + 1);
+  LayoutJob::Item &item = _queuedLayout->items.last();
+  item.entity = ent;
+  item.serial = pending.serial;
+  gather(ent, item.source);
 
-      if(childData.onRight)
+  if(_queuedLayout->items.size() >= LAYOUT_JOB_SIZE)
+    {
+    startQueuedLayout();
+    }
+  }
+
+void GCSimpleNodeDelegate::startQueuedLayout() const
+  {
+  if(_queuedLayout)
+    {
+    _layoutPool.start(_queuedLayout);
+    _queuedLayout = 0;
+    }
+  }
+
+void GCSimpleNodeDelegate::onLaidOut(LayoutJob *job) const
+  {
+  QMutexLocker l(&_laidOutLock);
+  _laidOut << job;
+  _hasLaidOut.fetchAndStoreOrdered(1);
+  }
+
+void GCSimpleNodeDelegate::installLaidOut() const
+  {
+  XVector<LayoutJob *> jobs;
+    {
+    QMutexLocker l(&_laidOutLock);
+    jobs = _laidOut;
+    _laidOut.clear();
+    _hasLaidOut.fetchAndStoreOrdered(0);
+    }
+
+  foreach(LayoutJob *job, jobs)
+    {
+    foreach(const LayoutJob::Item &item, job->items)
+      {
+      // entities laid out again since, or removed from the graph, are skipped.
+      QHash<const void *, PendingLayout>::iterator it = _pendingLayouts.find(item.entity);
+      if(it == _pendingLayouts.end() || it->serial != item.serial)
         {
-        childData.position.setX(newMaxWidth - childData.renderSize.width());
+        continue;
         }
-      else
+
+      bool valid = it->entity.isValid();
+      SEntity *ent = it->entity;
+      _pendingLayouts.erase(it);
+
+      if(valid)
         {
-        childData.position.setX(newMinX);
+        install(ent, item.data);
         }
       }
+    delete job;
     }
   }
 
-void GCSimpleNodeDelegate::updateRenderData(const SEntity *ent) const
+SEntity *GCSimpleNodeDelegate::inputEntity(const SEntity *ent, SProperty *input) const
   {
-  xAssert(ent);
+  for(SProperty *inputProp=input; inputProp; inputProp=inputProp->parent())
+    {
+    if(inputProp->parent() == ent->parent())
+      {
+      return inputProp->castTo<SEntity>();
+      }
+    }
+  return 0;
+  }
 
-  if(!_renderData.contains(ent))
+bool GCSimpleNodeDelegate::connectionPoints(const SEntity *ent, const SProperty *prop, xsize index, QPoint &from, QPoint &to) const
+  {
+  SProperty *input = prop->input();
+  if(!input)
     {
-    RenderData rd;
-    rd.position.setX(100);
-    rd.position.setY(100);
-    _renderData[ent] = rd;
+    return false;
     }
 
-  RenderData &rd(_renderData[ent]);
+  SEntity *connectedEnt = inputEntity(ent, input);
 
-  QFont titleFnt;
-  titleFnt.setBold(true);
-  titleFnt.setPixelSize(11);
-  QFontMetrics titleFntMetrics(titleFnt);
+  // entities are laid out in turn, the connection is indexed with the entity it comes from when that is laid out.
+  if(!connectedEnt || !_renderData.contains(connectedEnt))
+    {
+    return false;
+    }
 
-  QFont propFnt;
-  propFnt.setPixelSize(9);
+  const RenderData &rd(_renderData[ent]);
+  const RenderData &inputRD(_renderData[connectedEnt]);
 
-  xsize numProperties = ent->size();
+  to = rd.position + rd.properties[index].position + QPoint(-OUTER_PADDING, _propText->height() / 2);
 
-  int fillWidth = titleFntMetrics.width(ent->name());
+  if(input == connectedEnt)
+    {
+    from = inputRD.position + QPoint(inputRD.size.width(), inputRD.entOutputPos.y() + inputRD.entOutputRadius);
+    }
+  else
+    {
+    from = inputRD.position + inputRD.properties[input->index()].position + QPoint(-OUTER_PADDING, _propText->height() / 2);
+    }
 
-  int propYStart = _titleFntMetrics.height() + OUTER_PADDING + (2 * TITLE_PADDING) + PROP_PADDING;
+  to.setX(rd.position.x());
+  from.setX(inputRD.position.x() + inputRD.size.width());
+  return true;
+  }
 
-  int i = 0;
-  rd.properties.resize(numProperties);
-  for(SProperty *prop=ent->firstChild(); prop; prop=prop->nextSibling(), ++i)
+QRect GCSimpleNodeDelegate::connectionBounds(const QPoint &from, const QPoint &to) const
+  {
+  // the curve stays within its control points.
+  QPoint topLeft(qMin(from.x(), to.x() - CONNECTION_EXTENSION), qMin(from.y(), to.y()));
+  QPoint bottomRight(qMax(from.x() + CONNECTION_EXTENSION, to.x()), qMax(from.y(), to.y()));
+
+  return QRect(topLeft, bottomRight).adjusted(-CONNECTION_WIDTH, -CONNECTION_WIDTH, CONNECTION_WIDTH, CONNECTION_WIDTH);
+  }
+
+QRect GCSimpleNodeDelegate::paintBounds(const SEntity *ent) const
+  {
+  const RenderData &rd(_renderData[ent]);
+  QRect bounds = QRect(rd.position, rd.size + QSize(SHADOW_OFFSET, SHADOW_OFFSET)).adjusted(-1, -1, 1, 1);
+
+
+  xsize index = 0;
+  for(SProperty *prop=ent->firstChild(); prop; prop=prop->nextSibling(), ++index)
     {
-    RenderData::PropertyData& data = rd.properties[i];
+    QPoint from;
+    QPoint to;
+    if(connectionPoints(ent, prop, index, from, to))
+      {
+      bounds |= connectionBounds(from, to);
+      }
+    }
 
-    preSetupProperty(propFnt, data, prop, propYStart);
+  return bounds;
+  }
 
-    data.position.setY(propYStart);
-    propYStart += data.renderSize.height();
+void GCSimpleNodeDelegate::indexEntity(const SEntity *ent) const
+  {
+  _index.insert(ent, paintBounds(ent));
+  }
 
-    fillWidth = qMax(fillWidth, data.renderSize.width());
+void GCSimpleNodeDelegate::indexOutputs(const SProperty *prop) const
+  {
+  for(SProperty *output=prop->output(); output; output=output->nextOutput())
+    {
+    const SEntity *connected = output->entity();
+    if(connected && _index.contains(connected))
+      {
+      indexEntity(connected);
+      }
     }
 
+  const SPropertyContainer* cont = prop->castTo<SPropertyContainer>();
+  if(cont)
+    {
+    for(SProperty *child=cont->firstChild(); child; child=child->nextSibling())
+      {
+      // child entities are nodes of another graph.
+      if(!child->castTo<SEntity>())
+        {
+        indexOutputs(child);
+        }
+      }
+    }
+  }
 
-  fillWidth = qMax(fillWidth, MAX_WIDTH);
+void GCSimpleNodeDelegate::simplifiedConnections(const SEntity *ent, const QRect &region, XVector<QLine> &lines) const
+  {
+  const RenderData &rd(*_renderData.constFind(ent));
+  QPoint to(rd.position.x(), rd.position.y() + rd.size.height() / 2);
 
-  rd.size.setWidth(fillWidth + (2*TITLE_PADDING) + (3*OUTER_PADDING) + titleFntMetrics.height());
-  rd.size.setHeight(propYStart + OUTER_PADDING);
+  xsize first = lines.size();
+  for(SProperty *prop=ent->firstChild(); prop; prop=prop->nextSibling())
+    {
+    SProperty *input = prop->input();
+    SEntity *connectedEnt = input ? inputEntity(ent, input) : 0;
 
-  rd.titleBounds.setTopLeft(QPoint(OUTER_PADDING, OUTER_PADDING));
-  rd.titleBounds.setBottomRight(QPoint(rd.size.width() - (2*OUTER_PADDING) - 1 - titleFntMetrics.height(),
-              _titleFntMetrics.height() + TITLE_PADDING + OUTER_PADDING));
+    QHash<const void *, RenderData>::const_iterator inputRD = _renderData.constFind(connectedEnt);
+    if(!connectedEnt || inputRD == _renderData.constEnd())
+      {
+      continue;
+      }
 
-  i = 0;
-  for(SProperty *prop=ent->firstChild(); prop; prop=prop->nextSibling(), ++i)
+    QPoint from(inputRD->position.x() + inputRD->size.width(), inputRD->position.y() + inputRD->size.height() / 2);
+    if(!region.intersects(QRect(from, to).normalized()))
+      {
+      continue;
+      }
+
+    // every connection between two entities is bundled into one line.
+    bool bundled = false;
+    for(xsize i=first; i<(xsize)lines.size() && !bundled; ++i)
+      {
+      bundled = lines[i].p1() == from;
+      }
+
+    if(!bundled)
+      {
+      lines << QLine(from, to);
+      }
+    }
+  }
+
+void GCSimpleNodeDelegate::paintConnectionBatch(QPainter *ptr, const XVector<QLine> &lines) const
+  {
+  ptr->save();
+  ptr->setRenderHint(QPainter::Antialiasing, false);
+
+  QPen pen(QColor(255, 255, 255, 160));
+  pen.setCosmetic(true);
+  ptr->setPen(pen);
+  ptr->drawLines(lines.constData(), lines.size());
+
+  ptr->restore();
+  }
+
+void GCSimpleNodeDelegate::paintNodeBatch(QPainter *ptr, const XVector<QRect> &nodes) const
+  {
+  ptr->save();
+  ptr->setRenderHint(QPainter::Antialiasing, false);
+
+  ptr->setPen(Qt::NoPen);
+  ptr->setBrush(QColor(64, 64, 64));
+  ptr->drawRects(nodes.constData(), nodes.size());
+
+  ptr->restore();
+  }
+
+GCSimpleNodeDelegate::Detail GCSimpleNodeDelegate::detailFor(const X2DCanvas *canvas, const GCShiftRenderModel *model) const
+  {
+  float scale = canvas->transform().m11();
+  if(scale >= DETAIL_SCALE)
     {
-    RenderData::PropertyData& data = rd.properties[i];
+    return FullDetail;
+    }
 
-    postSetupProperty(propFnt, data, prop, OUTER_PADDING, rd.size.width() - (2*OUTER_PADDING));
+  // tiles are painted from the index, which the model must keep up to date, and which only holds every entity
+  // once they are all laid out.
+  if(scale < OVERVIEW_SCALE && model->index() == &_index && _index.size() >= model->entityCount())
+    {
+    return OverviewDetail;
+    }
 
-    if(data.onRight)
+  return SimplifiedDetail;
+  }
+
+void GCSimpleNodeDelegate::paintOverview(QPainter *ptr, const QRect &region) const
+  {
+  XVector<const void *> nodes;
+  _index.find(region, nodes);
+
+  XVector<QLine> connections;
+  XVector<QRect> bounds;
+  bounds.reserve(nodes.size());
+  foreach(const void *node, nodes)
+    {
+    const SEntity *ent = static_cast<const SEntity *>(node);
+    simplifiedConnections(ent, region, connections);
+
+    const RenderData &rd(*_renderData.constFind(ent));
+    bounds << QRect(rd.position, rd.size);
+    }
+
+  paintConnectionBatch(ptr, connections);
+  paintNodeBatch(ptr, bounds);
+  }
+
+bool GCSimpleNodeDelegate::beginPass(xuint32 pass, XAbstractCanvas *c, const XAbstractRenderModel *m) const
+  {
+  X2DCanvas *canvas = static_cast<X2DCanvas *>(c);
+
+  if(pass == ShadowPass)
+    {
+    if(_hasLaidOut)
       {
-      data.position.setX(rd.size.width() - data.renderSize.width() - (2*OUTER_PADDING));
+      installLaidOut();
+      }
+
+    XVector<QRect> changed;
+    if(_index.takeChanged(changed))
+      {
+      foreach(const QRect &region, changed)
+        {
+        _overview.invalidate(region);
+        }
       }
     else
       {
-      data.position.setX(OUTER_PADDING);
+      _overview.invalidateAll();
+      }
+
+    _detail = detailFor(canvas, static_cast<const GCShiftRenderModel *>(m));
+    if(_detail == OverviewDetail &&
+       !_overview.paint(canvas->currentPainter(), canvas->region(), canvas->transform().m11()))
+      {
+      // a few tiles are rendered each paint, until the view is complete.
+      QMetaObject::invokeMethod(canvas, "update", Qt::QueuedConnection);
       }
     }
+  else
+    {
+    // entities queued as the first pass walked the graph are laid out together.
+    startQueuedLayout();
+    }
 
+  return _detail == OverviewDetail;
+  }
 
-  rd.entOutputRadius = rd.titleBounds.height() / 2;
-  rd.entOutputPos = QPoint(rd.titleBounds.right() + OUTER_PADDING, OUTER_PADDING);
+void GCSimpleNodeDelegate::endPass(xuint32 pass, XAbstractCanvas *c, const XAbstractRenderModel *) const
+  {
+  if(_detail != SimplifiedDetail)
+    {
+    return;
+    }
 
-  rd.title.setText(titleFntMetrics.elidedText(ent->name(), Qt::ElideRight, fillWidth));
-  rd.title.prepare(QTransform(), titleFnt);
+  QPainter *ptr = static_cast<X2DCanvas *>(c)->currentPainter();
+  if(pass == ConnectionPass)
+    {
+    paintConnectionBatch(ptr, _connectionBatch);
+    _connectionBatch.clear();
+    }
+  else if(pass == NodePass)
+    {
+    paintNodeBatch(ptr, _nodeBatch);
+    _nodeBatch.clear();
+    }
   }
 
-void GCSimpleNodeDelegate::update(const XAbstractCanvas *,
+void GCSimpleNodeDelegate::update(const XAbstractCanvas *c,
                     const XAbstractRenderModel::Iterator *aIt,
-                    const XAbstractRenderModel *) const
+                    const XAbstractRenderModel *m) const
   {
   const GCShiftRenderModel::Iterator *it = static_cast<const GCShiftRenderModel::Iterator *>(aIt);
   const SEntity *ent = it->entity();
   xAssert(ent);
 
-  updateRenderData(ent);
+  // large changes, ie. imports, are laid out in the background, entities keep their old layout until then.
+  const GCShiftRenderModel *model = static_cast<const GCShiftRenderModel *>(m);
+  if(model->updateCount() >= BackgroundLayoutThreshold)
+    {
+    queueLayout(ent, const_cast<X2DCanvas *>(static_cast<const X2DCanvas *>(c)));
+
+    // the remainder is started now, it may be off screen and never painted.
+    if(it->isLast())
+      {
+      startQueuedLayout();
+      }
+    }
+  else
+    {
+    updateRenderData(ent);
+    }
   }
 
 void GCSimpleNodeDelegate::paintProperties(QPainter *ptr, QPoint nodePos, const QVector<RenderData::PropertyData> &props) const
@@ -204,69 +644,71 @@ void GCSimpleNodeDelegate::paintProperties(QPainter *ptr, QPoint nodePos, const
 void GCSimpleNodeDelegate::paint(xuint32 pass,
                                 XAbstractCanvas *c,
                                 const XAbstractRenderModel::Iterator *aIt,
-                                const XAbstractRenderModel *) const
+                                const XAbstractRenderModel *m) const
   {
   const GCShiftRenderModel::Iterator *it = static_cast<const GCShiftRenderModel::Iterator *>(aIt);
   const SEntity *ent = it->entity();
   xAssert(ent);
 
-  ensureRenderData(ent);
-  const RenderData &rd(_renderData.value(ent));
-
   X2DCanvas* canvas = static_cast<X2DCanvas*>(c);
+
+  // painted from tiles as the pass began.
+  if(_detail == OverviewDetail)
+    {
+    return;
+    }
+
+  if(!_renderData.contains(ent))
+    {
+    const GCShiftRenderModel *model = static_cast<const GCShiftRenderModel *>(m);
+    if(_pendingLayouts.contains(ent))
+      {
+      return;
+      }
+    if(model->entityCount() >= BackgroundLayoutThreshold)
+      {
+      queueLayout(ent, canvas);
+      return;
+      }
+    updateRenderData(ent);
+    }
+  const RenderData &rd(_renderData[ent]);
+
+  if(_detail == SimplifiedDetail)
+    {
+    if(pass == ConnectionPass)
+      {
+      simplifiedConnections(ent, canvas->region(), _connectionBatch);
+      }
+    else if(pass == NodePass)
+      {
+      QRect bounds(rd.position, rd.size);
+      if(canvas->region().intersects(bounds))
+        {
+        _nodeBatch << bounds;
+        }
+      }
+    return;
+    }
+
   QPainter *ptr = canvas->currentPainter();
   xAssert(ptr);
   if(pass == ConnectionPass)
     {
+    QPen pen;
+    pen.setColor(Qt::white);
+    pen.setWidth(CONNECTION_WIDTH);
+    ptr->setPen(pen);
+    ptr->setBrush(Qt::transparent);
+
     xsize index = 0;
     for(SProperty *prop=ent->firstChild(); prop; prop=prop->nextSibling(), ++index)
       {
-      if(prop->hasInput())
+      QPoint outputPosition;
+      QPoint inputPosition;
+      if(connectionPoints(ent, prop, index, outputPosition, inputPosition) &&
+         canvas->region().intersects(connectionBounds(outputPosition, inputPosition)))
         {
-        SProperty *input = prop->input();
-
-        SProperty *inputProp = input;
-        SEntity *connectedEnt = 0;
-        while(inputProp && !connectedEnt)
-          {
-          if(inputProp->parent() == ent->parent())
-            {
-            connectedEnt = inputProp->castTo<SEntity>();
-            break;
-            }
-          inputProp = inputProp->parent();
-          }
-
-        if(!ent)
-          {
-          xAssertFail();
-          return;
-          }
-
-        ensureRenderData(connectedEnt);
-        const RenderData &inputRD(_renderData.value(connectedEnt));
-
-        QPoint inputPosition = rd.position + rd.properties[index].position + QPoint(-OUTER_PADDING, _propFntMetrics.height() / 2);
-        QPoint outputPosition;
-
-        if(input == connectedEnt)
-          {
-          outputPosition = inputRD.position + QPoint(inputRD.size.width(), inputRD.entOutputPos.y() + inputRD.entOutputRadius);
-          }
-        else
-          {
-          outputPosition = inputRD.position + inputRD.properties[input->index()].position + QPoint(-OUTER_PADDING, _propFntMetrics.height() / 2);
-          }
-
-        inputPosition.setX(rd.position.x());
-        outputPosition.setX(inputRD.position.x() + inputRD.size.width());
-
-        QPen pen;
-        pen.setColor(Qt::white);
-        pen.setWidth(3);
-        ptr->setPen(pen);
-        ptr->setBrush(Qt::transparent);
-
         QPainterPath path;
         path.moveTo(outputPosition);
         path.cubicTo(outputPosition + QPoint(CONNECTION_EXTENSION, 0),
@@ -309,11 +751,11 @@ void GCSimpleNodeDelegate::paint(xuint32 pass,
       ptr->drawEllipse(renderPoint + rd.entOutputPos, rd.entOutputRadius, rd.entOutputRadius);
 
       ptr->setPen(Qt::black);
-      ptr->setFont(_titleFnt);
+      ptr->setFont(_titleText->font());
       ptr->drawStaticText(renderPoint, rd.title);
 
       ptr->setPen(QColor(196, 196, 196));
-      ptr->setFont(_propFnt);
+      ptr->setFont(_propText->font());
 
       paintProperties(ptr, rd.position, rd.properties);
       }
@@ -323,7 +765,11 @@ void GCSimpleNodeDelegate::paint(xuint32 pass,
 GCAbstractNodeDelegate::HitArea GCSimpleNodeDelegate::hitTest(const QPoint &point, const void *ent, xsize &index) const
   {
   HitArea area = None;
-  xAssert(_renderData.contains(ent));
+  // entities still being laid out can't be hit.
+  if(!_renderData.contains(ent))
+    {
+    return area;
+    }
   const RenderData &rd(_renderData[ent]);
 
   if(QRect(rd.position, rd.size).contains(point))
@@ -343,7 +789,7 @@ GCAbstractNodeDelegate::HitArea GCSimpleNodeDelegate::hitTest(const QPoint &poin
       xsize i = 0;
       foreach(const RenderData::PropertyData &prop, rd.properties)
         {
-        QRect left(rd.position + prop.position, QSize(rd.size.width() / 2, _propFntMetrics.height()));
+        QRect left(rd.position + prop.position, QSize(rd.size.width() / 2, _propText->height()));
         left.moveLeft(rd.position.x());
         QRect right(left);
         right.moveLeft(right.left() + (rd.size.width() / 2));
@@ -368,8 +814,13 @@ GCAbstractNodeDelegate::HitArea GCSimpleNodeDelegate::hitTest(const QPoint &poin
 
 void GCSimpleNodeDelegate::move(const QPoint &pos, const void *ent) const
   {
+  xAssert(_renderData.contains(ent));
   RenderData &rd(_renderData[ent]);
   rd.position += pos;
+
+  const SEntity *entity = static_cast<const SEntity *>(ent);
+  indexEntity(entity);
+  indexOutputs(entity);
   }
 
 void GCSimpleNodeDelegate::drawConnection(XAbstractCanvas *c, const void *ent, xsize prop, bool fromOutput, const QPoint &to) const
@@ -387,7 +838,7 @@ void GCSimpleNodeDelegate::drawConnection(XAbstractCanvas *c, const void *ent, x
     }
   else
     {
-    connectingPosition = rd.position + rd.properties[prop].position + QPoint(-OUTER_PADDING, _propFntMetrics.height() / 2);
+    connectingPosition = rd.position + rd.properties[prop].position + QPoint(-OUTER_PADDING, _propText->height() / 2);
     }
 
   QPainterPath path;
@@ -412,7 +863,7 @@ void GCSimpleNodeDelegate::drawConnection(XAbstractCanvas *c, const void *ent, x
 
   QPen pen;
   pen.setColor(Qt::white);
-  pen.setWidth(3);
+  pen.setWidth(CONNECTION_WIDTH);
   ptr->setPen(pen);
   ptr->setBrush(Qt::transparent);
 
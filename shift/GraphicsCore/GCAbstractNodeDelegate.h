@@ -6,11 +6,22 @@
 #include "QSize"
 #include "QRect"
 #include "QStaticText"
-#include "QFontMetrics"
+#include "QLine"
 #include "QHash"
+#include "QThreadPool"
+#include "QMutex"
+#include "QAtomicInt"
+#include "XVector"
+#include "GCNodeIndex.h"
+#include "GCTextCache.h"
+#include "GCOverviewCache.h"
+#include "sentityweakpointer.h"
 
 class QPoint;
+class QWidget;
 class SEntity;
+class X2DCanvas;
+class GCShiftRenderModel;
 
 class GRAPHICSCORE_EXPORT GCAbstractNodeDelegate : public XAbstractDelegate
   {
@@ -32,7 +43,7 @@ public:
   virtual void drawConnection(XAbstractCanvas *c, const void *ent, xsize prop, bool fromOutput, const QPoint &to) const = 0;
   };
 
-class GRAPHICSCORE_EXPORT GCSimpleNodeDelegate : public GCAbstractNodeDelegate
+class GRAPHICSCORE_EXPORT GCSimpleNodeDelegate : public GCAbstractNodeDelegate, public GCOverviewCache::Source
   {
 public:
   enum
@@ -43,11 +54,31 @@ public:
     MaxPasses
     };
 
+  enum
+    {
+    // updates to, or first paints of, graphs of at least this many entities are laid out in the background.
+    BackgroundLayoutThreshold = 512
+    };
+
+  // how much is drawn, chosen by how far the canvas is zoomed out.
+  enum Detail
+    {
+    // titles, properties, shadows and curved connections.
+    FullDetail,
+    // flat nodes and straight connections, one line between each pair of entities, drawn in batches.
+    SimplifiedDetail,
+    // tiles of the simplified graph, cached and refreshed as entities change.
+    OverviewDetail
+    };
+
   GCSimpleNodeDelegate();
+  ~GCSimpleNodeDelegate();
 
   virtual void update(const XAbstractCanvas *, const XAbstractRenderModel::Iterator *, const XAbstractRenderModel *) const;
   virtual void paint(xuint32 pass, XAbstractCanvas *, const XAbstractRenderModel::Iterator *, const XAbstractRenderModel *) const;
   virtual xuint32 maxNumberOfPasses(XAbstractCanvas *, const XAbstractRenderModel::Iterator *, const XAbstractRenderModel *) const { return MaxPasses; }
+  virtual bool beginPass(xuint32 pass, XAbstractCanvas *, const XAbstractRenderModel *) const;
+  virtual void endPass(xuint32 pass, XAbstractCanvas *, const XAbstractRenderModel *) const;
   virtual HitArea hitTest(const QPoint &point, const void *ent, xsize &index) const;
   virtual void move(const QPoint &delta, const void *ent) const;
   virtual void drawConnection(XAbstractCanvas *c, const void *ent, xsize prop, bool fromOutput, const QPoint &to) const;
@@ -78,17 +109,87 @@ public:
   void updateRenderData(const SEntity *ent) const;
   void ensureRenderData(const SEntity *ent) const;
 
+  // the bounds each laid out entity paints in, including the connections into it, kept as nodes move and are
+  // laid out again.
+  GCNodeIndex &index() const { return _index; }
+
+  virtual void paintOverview(QPainter *ptr, const QRect &region) const;
+
 private:
-  void preSetupProperty(const QFont& font, RenderData::PropertyData& data, const SProperty *prop, int yOffset) const;
-  void postSetupProperty(const QFont& font, RenderData::PropertyData& data, const SProperty *prop, int minX, int maxWidth) const;
+  Detail detailFor(const X2DCanvas *canvas, const GCShiftRenderModel *model) const;
+  // the entity beside [ent] which [input], or a parent of it, belongs to.
+  SEntity *inputEntity(const SEntity *ent, SProperty *input) const;
+  // append a line for each entity connected into [ent] within [region].
+  void simplifiedConnections(const SEntity *ent, const QRect &region, XVector<QLine> &lines) const;
+  void paintConnectionBatch(QPainter *ptr, const XVector<QLine> &lines) const;
+  void paintNodeBatch(QPainter *ptr, const XVector<QRect> &nodes) const;
+
+  // find where the connection into [prop], the [index]th child of [ent], starts and ends. false if [prop] has no
+  // input, or it isn't from an entity beside [ent].
+  bool connectionPoints(const SEntity *ent, const SProperty *prop, xsize index, QPoint &from, QPoint &to) const;
+  QRect connectionBounds(const QPoint &from, const QPoint &to) const;
+  QRect paintBounds(const SEntity *ent) const;
+  void indexEntity(const SEntity *ent) const;
+  // re-index the entities [prop] or its properties connect into, their connections have moved with it.
+  void indexOutputs(const SProperty *prop) const;
+
+  // what layout needs of an entity, read from the tree on the owning thread so layout can run on any thread.
+  struct LayoutSource
+    {
+    struct Property
+      {
+      QString name;
+      bool onRight;
+      QVector<Property> children;
+      };
 
-  void paintProperties(QPainter *ptr, QPoint nodePos, const QVector<RenderData::PropertyData> &) const;
+    QString title;
+    QVector<Property> properties;
+    };
+
+  class LayoutJob;
+  struct PendingLayout
+    {
+    SEntityWeakPointer entity;
+    xuint32 serial;
+    };
+
+  void gather(const SEntity *ent, LayoutSource &source) const;
+  void gatherProperty(LayoutSource::Property &data, const SProperty *prop) const;
+  void layout(const LayoutSource &source, RenderData &rd) const;
+  void preSetupProperty(RenderData::PropertyData& data, const LayoutSource::Property &prop, int yOffset) const;
+  void postSetupProperty(RenderData::PropertyData& data, int minX, int maxWidth) const;
+  // use [laidOut] for [ent], keeping where it has been moved to.
+  void install(const SEntity *ent, const RenderData &laidOut) const;
 
-  QFont _titleFnt;
-  QFontMetrics _titleFntMetrics;
+  void queueLayout(const SEntity *ent, QWidget *canvas) const;
+  void startQueuedLayout() const;
+  // called from layout threads as a job finishes.
+  void onLaidOut(LayoutJob *job) const;
+  void installLaidOut() const;
+
+  void paintProperties(QPainter *ptr, QPoint nodePos, const QVector<RenderData::PropertyData> &) const;
 
-  QFont _propFnt;
-  QFontMetrics _propFntMetrics;
+  GCTextCache *_titleText;
+  GCTextCache *_propText;
+
+  mutable GCNodeIndex _index;
+
+  // chosen as each paint begins, simplified entities are collected and drawn as their pass ends.
+  mutable Detail _detail;
+  mutable XVector<QLine> _connectionBatch;
+  mutable XVector<QRect> _nodeBatch;
+  mutable GCOverviewCache _overview;
+
+  // layouts are queued and run in jobs, the latest serial for an entity is the one installed. Finished jobs are
+  // handed back under _laidOutLock.
+  mutable QHash<const void *, PendingLayout> _pendingLayouts;
+  mutable LayoutJob *_queuedLayout;
+  mutable xuint32 _layoutSerial;
+  mutable QThreadPool _layoutPool;
+  mutable QMutex _laidOutLock;
+  mutable XVector<LayoutJob *> _laidOut;
+  mutable QAtomicInt _hasLaidOut;
   };
 
 #endif // GCABSTRACTNODEDELEGATE_H
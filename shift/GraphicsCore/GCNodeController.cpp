@@ -41,6 +41,10 @@ GCNodeController::UsedFlags GCNodeController::mouseEvent(MouseEventType type,
 
   QPoint mouseDelta(graphSpacePoint - lKP);
 
+  // only entities under the mouse need hit testing.
+  const GCShiftRenderModel *model = static_cast<const GCShiftRenderModel *>(canvas()->model());
+  QRect mouseRegion(graphSpacePoint, QSize(1, 1));
+
   if(!_iterator)
     {
     _iterator = canvas()->model()->createIterator();
@@ -64,7 +68,7 @@ GCNodeController::UsedFlags GCNodeController::mouseEvent(MouseEventType type,
       {
       xAssert(_interactionEntity == 0);
       xAssert(_controlMode == None);
-      canvas()->model()->resetIterator(_iterator);
+      model->resetIterator(_iterator, mouseRegion);
       while(_iterator->next())
         {
         const GCAbstractNodeDelegate *delegate = static_cast<const GCAbstractNodeDelegate*>(canvas()->model()->delegateFor(_iterator, canvas()));
@@ -112,7 +116,7 @@ GCNodeController::UsedFlags GCNodeController::mouseEvent(MouseEventType type,
       {
       if(_controlMode == ConnectingEntity)
         {
-        canvas()->model()->resetIterator(_iterator);
+        model->resetIterator(_iterator, mouseRegion);
         while(_iterator->next())
           {
           const GCAbstractNodeDelegate *delegate = static_cast<const GCAbstractNodeDelegate*>(canvas()->model()->delegateFor(_iterator, canvas()));
@@ -136,7 +140,7 @@ GCNodeController::UsedFlags GCNodeController::mouseEvent(MouseEventType type,
         }
       if(_controlMode == ConnectingProperty)
         {
-        canvas()->model()->resetIterator(_iterator);
+        model->resetIterator(_iterator, mouseRegion);
         while(_iterator->next())
           {
           const GCAbstractNodeDelegate *delegate = static_cast<const GCAbstractNodeDelegate*>(canvas()->model()->delegateFor(_iterator, canvas()));
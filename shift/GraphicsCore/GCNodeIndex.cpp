@@ -0,0 +1,212 @@
+#include "GCNodeIndex.h"
+#include "QtAlgorithms"
+
+namespace
+{
+int cellFloor(int value, int cellSize)
+  {
+  return value >= 0 ? value / cellSize : -((-value + cellSize - 1) / cellSize);
+  }
+
+struct Found
+  {
+  xuint32 order;
+  const void *node;
+
+  bool operator<(const Found &other) const { return order < other.order; }
+  };
+}
+
+GCNodeIndex::GCNodeIndex(int cellSize) : _cellSize(cellSize), _nextOrder(0), _query(0),
+    _allChanged(false)
+  {
+  xAssert(cellSize > 0);
+  }
+
+void GCNodeIndex::clear()
+  {
+  _nodes.clear();
+  _cells.clear();
+  _nextOrder = 0;
+
+  _changed.clear();
+  _allChanged = true;
+  }
+
+QRect GCNodeIndex::cellsFor(const QRect &bounds) const
+  {
+  QRect normalised = bounds.normalized();
+  return QRect(QPoint(cellFloor(normalised.left(), _cellSize), cellFloor(normalised.top(), _cellSize)),
+               QPoint(cellFloor(normalised.right(), _cellSize), cellFloor(normalised.bottom(), _cellSize)));
+  }
+
+void GCNodeIndex::addToCells(const void *node, const QRect &cells)
+  {
+  for(int y=cells.top(); y<=cells.bottom(); ++y)
+    {
+    for(int x=cells.left(); x<=cells.right(); ++x)
+      {
+      _cells[cellKey(x, y)] << node;
+      }
+    }
+  }
+
+void GCNodeIndex::removeFromCells(const void *node, const QRect &cells)
+  {
+  for(int y=cells.top(); y<=cells.bottom(); ++y)
+    {
+    for(int x=cells.left(); x<=cells.right(); ++x)
+      {
+      XHash<quint64, XVector<const void *> >::iterator it = _cells.find(cellKey(x, y));
+      xAssert(it != _cells.end());
+
+      XVector<const void *> &cell = it.value();
+      int index = cell.indexOf(node);
+      xAssert(index != -1);
+
+      // order within a cell doesn't matter, results are sorted.
+      cell[index] = cell.last();
+      cell.pop_back();
+      if(cell.isEmpty())
+        {
+        _cells.erase(it);
+        }
+      }
+    }
+  }
+
+void GCNodeIndex::insert(const void *node, const QRect &bounds)
+  {
+  QRect cells = cellsFor(bounds);
+
+  XHash<const void *, Node>::iterator it = _nodes.find(node);
+  if(it == _nodes.end())
+    {
+    Node n;
+    n.bounds = bounds;
+    n.cells = cells;
+    n.order = _nextOrder++;
+    n.query = _query;
+    _nodes.insert(node, n);
+
+    addToCells(node, cells);
+    markChanged(bounds);
+    return;
+    }
+
+  // inserted again in the same place, it has still been laid out again.
+  Node &n = it.value();
+  markChanged(n.bounds);
+  if(n.bounds != bounds)
+    {
+    markChanged(bounds);
+    }
+  n.bounds = bounds;
+  // most moves stay within the cells the node already covers.
+  if(n.cells != cells)
+    {
+    removeFromCells(node, n.cells);
+    addToCells(node, cells);
+    n.cells = cells;
+    }
+  }
+
+void GCNodeIndex::remove(const void *node)
+  {
+  XHash<const void *, Node>::iterator it = _nodes.find(node);
+  if(it != _nodes.end())
+    {
+    removeFromCells(node, it.value().cells);
+    markChanged(it.value().bounds);
+    _nodes.erase(it);
+    }
+  }
+
+void GCNodeIndex::find(const QRect &region, XVector<const void *> &nodes) const
+  {
+  if(_nodes.isEmpty() || !region.isValid())
+    {
+    return;
+    }
+
+  XVector<Found> found;
+
+  QRect cells = cellsFor(region);
+  if((xsize)cells.width() * cells.height() > (xsize)_nodes.size())
+    {
+    // zoomed far out, there are more cells to look in than nodes.
+    for(XHash<const void *, Node>::const_iterator it = _nodes.begin(), end = _nodes.end(); it != end; ++it)
+      {
+      if(it.value().bounds.intersects(region))
+        {
+        Found f = { it.value().order, it.key() };
+        found << f;
+        }
+      }
+    }
+  else
+    {
+    // nodes covering several cells are seen once each query.
+    ++_query;
+    for(int y=cells.top(); y<=cells.bottom(); ++y)
+      {
+      for(int x=cells.left(); x<=cells.right(); ++x)
+        {
+        XHash<quint64, XVector<const void *> >::const_iterator cell = _cells.find(cellKey(x, y));
+        if(cell == _cells.end())
+          {
+          continue;
+          }
+
+        foreach(const void *node, cell.value())
+          {
+          const Node &n = *_nodes.find(node);
+          if(n.query != _query && n.bounds.intersects(region))
+            {
+            n.query = _query;
+            Found f = { n.order, node };
+            found << f;
+            }
+          }
+        }
+      }
+    }
+
+  qSort(found.begin(), found.end());
+
+  nodes.reserve(nodes.size() + found.size());
+  foreach(const Found &f, found)
+    {
+    nodes << f.node;
+    }
+  }
+
+void GCNodeIndex::markChanged(const QRect &bounds)
+  {
+  if(_allChanged)
+    {
+    return;
+    }
+
+  if(_changed.size() >= MaximumChanges)
+    {
+    _changed.clear();
+    _allChanged = true;
+    return;
+    }
+
+  _changed << bounds;
+  }
+
+bool GCNodeIndex::takeChanged(XVector<QRect> &changed)
+  {
+  bool listed = !_allChanged;
+  if(listed)
+    {
+    changed << _changed;
+    }
+
+  _changed.clear();
+  _allChanged = false;
+  return listed;
+  }
@@ -0,0 +1,66 @@
+#ifndef GCNODEINDEX_H
+#define GCNODEINDEX_H
+
+#include "GCGlobal.h"
+#include "XHash"
+#include "XVector"
+#include "QRect"
+
+// A uniform grid over the bounds of the nodes in a graph, so the nodes under the mouse, or in the visible
+// region, can be found without visiting every node. Nodes are updated one at a time as they move or are laid
+// out again, only touching the cells they leave and enter.
+class GRAPHICSCORE_EXPORT GCNodeIndex
+  {
+public:
+  enum
+    {
+    // past this many changed bounds between calls to takeChanged, everything is treated as changed.
+    MaximumChanges = 4096
+    };
+
+  GCNodeIndex(int cellSize = 256);
+
+  void clear();
+
+  // add [node], or move it if it is already indexed.
+  void insert(const void *node, const QRect &bounds);
+  void remove(const void *node);
+
+  bool contains(const void *node) const { return _nodes.contains(node); }
+  QRect bounds(const void *node) const { return _nodes.value(node).bounds; }
+  xsize size() const { return _nodes.size(); }
+
+  // append the nodes whose bounds intersect [region] to [nodes], in the order they were first inserted, which
+  // is the order they were laid out and painted in.
+  void find(const QRect &region, XVector<const void *> &nodes) const;
+
+  // append the bounds nodes have been inserted at, moved from and to, or removed from since the last call, so
+  // caches of what is drawn there can be refreshed. false if too much changed to list, and everything should be.
+  bool takeChanged(XVector<QRect> &changed);
+
+private:
+  struct Node
+    {
+    QRect bounds;
+    QRect cells;
+    xuint32 order;
+    mutable xuint32 query;
+    };
+
+  QRect cellsFor(const QRect &bounds) const;
+  static quint64 cellKey(int x, int y) { return ((quint64)(quint32)x << 32) | (quint32)y; }
+  void addToCells(const void *node, const QRect &cells);
+  void removeFromCells(const void *node, const QRect &cells);
+  void markChanged(const QRect &bounds);
+
+  int _cellSize;
+  XHash<const void *, Node> _nodes;
+  XHash<quint64, XVector<const void *> > _cells;
+  xuint32 _nextOrder;
+  mutable xuint32 _query;
+
+  XVector<QRect> _changed;
+  bool _allChanged;
+  };
+
+#endif // GCNODEINDEX_H
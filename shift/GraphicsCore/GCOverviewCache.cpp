@@ -0,0 +1,181 @@
+#include "GCOverviewCache.h"
+#include "XVector"
+#include "QPainter"
+#include "QPair"
+#include "QtAlgorithms"
+
+namespace
+{
+int cellFloor(int value, int cellSize)
+  {
+  return value >= 0 ? value / cellSize : -((-value + cellSize - 1) / cellSize);
+  }
+}
+
+GCOverviewCache::GCOverviewCache(const Source *source, float baseScale) : _source(source), _baseScale(baseScale), _frame(0)
+  {
+  xAssert(source);
+  xAssert(baseScale > 0.0f);
+  }
+
+quint64 GCOverviewCache::tileKey(int level, int x, int y)
+  {
+  return ((quint64)level << 56) | ((quint64)(x & 0xFFFFFFF) << 28) | (quint64)(y & 0xFFFFFFF);
+  }
+
+int GCOverviewCache::levelFor(float scale) const
+  {
+  // the coarsest level still at least as detailed as the view, so tiles are only ever scaled down.
+  int level = 0;
+  while(level < MaximumLevels - 1 && levelScale(level + 1) >= scale)
+    {
+    ++level;
+    }
+  return level;
+  }
+
+void GCOverviewCache::invalidate(const QRect &region)
+  {
+  for(XHash<quint64, Tile>::iterator it = _tiles.begin(), end = _tiles.end(); it != end; ++it)
+    {
+    if(it->region.intersects(region))
+      {
+      it->dirty = true;
+      }
+    }
+  }
+
+void GCOverviewCache::invalidateAll()
+  {
+  for(XHash<quint64, Tile>::iterator it = _tiles.begin(), end = _tiles.end(); it != end; ++it)
+    {
+    it->dirty = true;
+    }
+  }
+
+void GCOverviewCache::clear()
+  {
+  _tiles.clear();
+  }
+
+bool GCOverviewCache::paint(QPainter *ptr, const QRect &region, float scale)
+  {
+  ++_frame;
+
+  int level = levelFor(scale);
+  int size = tileRegionSize(level);
+
+  QRect tiles(QPoint(cellFloor(region.left(), size), cellFloor(region.top(), size)),
+              QPoint(cellFloor(region.right(), size), cellFloor(region.bottom(), size)));
+
+  bool complete = true;
+  int renders = 0;
+  for(int y=tiles.top(); y<=tiles.bottom(); ++y)
+    {
+    for(int x=tiles.left(); x<=tiles.right(); ++x)
+      {
+      QRect tileRegion(x * size, y * size, size, size);
+
+      quint64 key = tileKey(level, x, y);
+      XHash<quint64, Tile>::iterator it = _tiles.find(key);
+      if(it == _tiles.end() || it->dirty)
+        {
+        if(renders < MaximumRendersPerPaint)
+          {
+          if(it == _tiles.end())
+            {
+            Tile tile;
+            tile.region = tileRegion;
+            tile.dirty = true;
+            it = _tiles.insert(key, tile);
+            }
+
+          render(*it, level);
+          ++renders;
+          }
+        else
+          {
+          // out of date tiles are shown until they are rendered again.
+          complete = false;
+          }
+        }
+
+      if(it != _tiles.end())
+        {
+        it->used = _frame;
+        ptr->drawImage(tileRegion, it->image);
+        }
+      else
+        {
+        paintCoarser(ptr, level, tileRegion);
+        }
+      }
+    }
+
+  evict();
+  return complete;
+  }
+
+void GCOverviewCache::render(Tile &tile, int level)
+  {
+  if(tile.image.isNull())
+    {
+    tile.image = QImage(TileSize, TileSize, QImage::Format_ARGB32_Premultiplied);
+    }
+  tile.image.fill(0);
+
+  QPainter ptr(&tile.image);
+  ptr.setRenderHint(QPainter::Antialiasing);
+
+  float scale = levelScale(level);
+  ptr.scale(scale, scale);
+  ptr.translate(-tile.region.topLeft());
+
+  _source->paintOverview(&ptr, tile.region);
+
+  tile.dirty = false;
+  }
+
+void GCOverviewCache::paintCoarser(QPainter *ptr, int level, const QRect &region)
+  {
+  for(int coarser=level+1; coarser<MaximumLevels; ++coarser)
+    {
+    int size = tileRegionSize(coarser);
+
+    XHash<quint64, Tile>::iterator it = _tiles.find(tileKey(coarser, cellFloor(region.left(), size), cellFloor(region.top(), size)));
+    if(it != _tiles.end())
+      {
+      float scale = levelScale(coarser);
+      QRectF source(QPointF(region.topLeft() - it->region.topLeft()) * scale, QSizeF(region.size()) * scale);
+
+      it->used = _frame;
+      ptr->drawImage(QRectF(region), it->image, source);
+      return;
+      }
+    }
+  }
+
+void GCOverviewCache::evict()
+  {
+  if(_tiles.size() <= MaximumTiles)
+    {
+    return;
+    }
+  xsize excess = (xsize)_tiles.size() - MaximumTiles;
+
+  // the tiles painted longest ago go first, never those in view.
+  XVector<QPair<xuint32, quint64> > unused;
+  for(XHash<quint64, Tile>::const_iterator it = _tiles.begin(), end = _tiles.end(); it != end; ++it)
+    {
+    if(it->used != _frame)
+      {
+      unused << qMakePair(it->used, it.key());
+      }
+    }
+  qSort(unused.begin(), unused.end());
+
+  for(xsize i=0; i<excess && i<(xsize)unused.size(); ++i)
+    {
+    _tiles.remove(unused[i].second);
+    }
+  }
@@ -0,0 +1,71 @@
+#ifndef GCOVERVIEWCACHE_H
+#define GCOVERVIEWCACHE_H
+
+#include "GCGlobal.h"
+#include "XHash"
+#include "QImage"
+#include "QRect"
+
+class QPainter;
+
+// Rasterised tiles of a 2D scene, at power of two steps down from a base scale, used to paint views zoomed too
+// far out to draw every item each frame. Tiles are marked out of date as the items under them change, and shown
+// until they are rendered again, a few at a time, so panning over a huge graph stays smooth.
+class GRAPHICSCORE_EXPORT GCOverviewCache
+  {
+public:
+  enum
+    {
+    TileSize = 256,
+    MaximumLevels = 8,
+    // tiles not painted recently are dropped past this many, 256 tiles are 64MB.
+    MaximumTiles = 256,
+    MaximumRendersPerPaint = 8
+    };
+
+  class Source
+    {
+  public:
+    virtual ~Source() { }
+
+    // paint the items within [region], in scene coordinates, [ptr] is already transformed to the tile.
+    virtual void paintOverview(QPainter *ptr, const QRect &region) const = 0;
+    };
+
+  GCOverviewCache(const Source *source, float baseScale);
+
+  // mark the tiles over [region], in scene coordinates, out of date.
+  void invalidate(const QRect &region);
+  void invalidateAll();
+  void clear();
+
+  // paint [region] of the scene, viewed at [scale], with [ptr] already transformed to the scene. Returns false
+  // if tiles are still missing or out of date, and another paint is needed to complete the view.
+  bool paint(QPainter *ptr, const QRect &region, float scale);
+
+private:
+  struct Tile
+    {
+    QImage image;
+    QRect region;
+    bool dirty;
+    xuint32 used;
+    };
+
+  int levelFor(float scale) const;
+  float levelScale(int level) const { return _baseScale / (1 << level); }
+  int tileRegionSize(int level) const { return qRound(TileSize / levelScale(level)); }
+  static quint64 tileKey(int level, int x, int y);
+
+  void render(Tile &tile, int level);
+  // paint the part of a coarser tile covering [region], in place of a tile at [level] not rendered yet.
+  void paintCoarser(QPainter *ptr, int level, const QRect &region);
+  void evict();
+
+  const Source *_source;
+  float _baseScale;
+  XHash<quint64, Tile> _tiles;
+  xuint32 _frame;
+  };
+
+#endif // GCOVERVIEWCACHE_H
@@ -1,7 +1,9 @@
 #include "GCShiftRenderModel.h"
+#include "GCNodeIndex.h"
+#include "X2DCanvas.h"
 #include "sentity.h"
 
-GCShiftRenderModel::Iterator::Iterator(const GCShiftRenderModel *m) : _model(m), _cache(0)
+GCShiftRenderModel::Iterator::Iterator(const GCShiftRenderModel *m) : _model(m), _cache(0), _fromList(false), _listIndex(0)
   {
   }
 
@@ -9,6 +11,17 @@ bool GCShiftRenderModel::Iterator::next()
   {
   xAssert(_model);
 
+  if(_fromList)
+    {
+    if(_listIndex < (xsize)_list.size())
+      {
+      setProperty((SEntity *)_list[_listIndex++]);
+      return true;
+      }
+    setProperty(0);
+    return false;
+    }
+
   SIterator::FilterFunction filter(_model->filter());
   xAssert(filter);
 
@@ -19,10 +32,12 @@ bool GCShiftRenderModel::Iterator::next()
 void GCShiftRenderModel::Iterator::reset()
   {
   _property = 0;
+  _fromList = false;
   _cache.reset(_model->entity());
   }
 
-GCShiftRenderModel::GCShiftRenderModel(SEntity *ent, SIterator::FilterFunction func) : _entity(0), _filter(func)
+GCShiftRenderModel::GCShiftRenderModel(SEntity *ent, SIterator::FilterFunction func) : _entity(0), _filter(func),
+    _index(0), _entityCount(0), _invalidateAll(true)
   {
   xAssert(func);
   setEntity(ent);
@@ -30,6 +45,8 @@ GCShiftRenderModel::GCShiftRenderModel(SEntity *ent, SIterator::FilterFunction f
 
 GCShiftRenderModel::~GCShiftRenderModel()
   {
+  // the index belongs to a delegate, which may already be gone.
+  _index = 0;
   setEntity(0);
   }
 
@@ -56,6 +73,27 @@ void GCShiftRenderModel::setEntity(SEntity *entity)
       child->addConnectionObserver(this);
       }
     }
+
+  if(_index)
+    {
+    _index->clear();
+    }
+  countEntities();
+  _invalidated.clear();
+  _invalidateAll = true;
+  }
+
+void GCShiftRenderModel::countEntities()
+  {
+  _entityCount = 0;
+  if(_entity)
+    {
+    SIterator::DataCache cache(_entity);
+    while(_filter(cache))
+      {
+      ++_entityCount;
+      }
+    }
   }
 
 XAbstractRenderModel::Iterator *GCShiftRenderModel::createIterator() const
@@ -69,16 +107,158 @@ void GCShiftRenderModel::resetIterator(XAbstractRenderModel::Iterator *it) const
   slIt->reset();
   }
 
-void GCShiftRenderModel::onConnectionChange(const SChange *)
+void GCShiftRenderModel::resetIterator(XAbstractRenderModel::Iterator *it, const QRect &region) const
   {
-  update(TreeChange);
+  GCShiftRenderModel::Iterator *slIt = static_cast<GCShiftRenderModel::Iterator*>(it);
+  slIt->reset();
+
+  // entities are indexed as the delegate lays them out, until they all have been the whole tree is walked.
+  if(_index && _index->size() >= _entityCount)
+    {
+    slIt->_fromList = true;
+    slIt->_list.clear();
+    slIt->_listIndex = 0;
+    _index->find(region, slIt->_list);
+    }
   }
 
-void GCShiftRenderModel::onTreeChange(const SChange *c)
+void GCShiftRenderModel::resetPaintIterator(XAbstractRenderModel::Iterator *it, const XAbstractCanvas *c) const
   {
-  update(TreeChange);
+  resetIterator(it, static_cast<const X2DCanvas*>(c)->region());
+  }
+
+SEntity *GCShiftRenderModel::nodeFor(SProperty *prop) const
+  {
+  for(; prop; prop=prop->parent())
+    {
+    if(prop->parent() == &_entity->children)
+      {
+      return prop->castTo<SEntity>();
+      }
+    }
+  return 0;
+  }
+
+void GCShiftRenderModel::invalidate(SProperty *prop)
+  {
+  SEntity *node = nodeFor(prop);
+  if(node && !_invalidated.contains(node))
+    {
+    _invalidated << node;
+    }
+  }
 
+void GCShiftRenderModel::updateInvalidated()
+  {
+  if(_invalidateAll || !_invalidated.isEmpty())
+    {
+    update(TreeChange);
+    }
+  _invalidated.clear();
+  _invalidateAll = false;
+  }
+
+xsize GCShiftRenderModel::updateCount() const
+  {
+  return _invalidateAll ? _entityCount : _invalidated.size();
+  }
+
+void GCShiftRenderModel::resetUpdateIterator(XAbstractRenderModel::Iterator *it, const XAbstractCanvas *) const
+  {
+  GCShiftRenderModel::Iterator *slIt = static_cast<GCShiftRenderModel::Iterator*>(it);
+  slIt->reset();
+  slIt->_list.clear();
+  slIt->_listIndex = 0;
+
+  if(_invalidateAll)
+    {
+    // listed up front, so delegates can tell when they are given the last entity.
+    while(slIt->next())
+      {
+      slIt->_list << slIt->entity();
+      }
+    slIt->_property = 0;
+    }
+  else
+    {
+    foreach(SEntity *ent, _invalidated)
+      {
+      slIt->_list << ent;
+      }
+    }
+
+  slIt->_fromList = true;
+  }
+
+void GCShiftRenderModel::onConnectionChange(const SChange *c)
+  {
+  const SProperty::ConnectionChange *conn = c->castTo<SProperty::ConnectionChange>();
+  if(conn)
+    {
+    invalidate(const_cast<SProperty *>(conn->driver()));
+    invalidate(const_cast<SProperty *>(conn->driven()));
+    }
+  else
+    {
+    _invalidateAll = true;
+    }
+
+  updateInvalidated();
+  }
+
+void GCShiftRenderModel::onTreeChange(const SChange *c)
+  {
+  // only the entities a change is within are laid out again. Undoing a change informs with the same before and
+  // after, so where the property is now decides if it was added or removed.
   const SPropertyContainer::TreeChange *t = c->castTo<SPropertyContainer::TreeChange>();
+  const SProperty::NameChange *n = c->castTo<SProperty::NameChange>();
+  if(t)
+    {
+    SProperty *prop = t->property();
+    SPropertyContainer *nodes = &_entity->children;
+    bool isNode = prop->parent() == nodes;
+    bool wasNode = !isNode && (t->before() == nodes || t->after() == nodes);
+    bool moved = t->before() == nodes && t->after() == nodes;
+
+    if(isNode)
+      {
+      if(!moved)
+        {
+        ++_entityCount;
+        }
+      invalidate(prop);
+      }
+    else if(wasNode)
+      {
+      --_entityCount;
+      const SEntity *ent = prop->castTo<SEntity>();
+      if(_index && ent)
+        {
+        _index->remove(ent);
+        }
+      }
+
+    // a property added to, or removed from, a node.
+    if(t->before() && t->before() != nodes)
+      {
+      invalidate(const_cast<SPropertyContainer *>(t->before()));
+      }
+    if(t->after() && t->after() != nodes)
+      {
+      invalidate(const_cast<SPropertyContainer *>(t->after()));
+      }
+    }
+  else if(n)
+    {
+    invalidate(const_cast<SProperty *>(n->property()));
+    }
+  else
+    {
+    _invalidateAll = true;
+    }
+
+  updateInvalidated();
+
   if(t)
     {
     if(t->before() && t->before()->isDescendedFrom(_entity))
@@ -6,14 +6,20 @@
 #include "sobserver.h"
 #include "sentityweakpointer.h"
 #include "siterator.h"
+#include "XVector"
+#include "QRect"
 
 class SEntity;
+class GCNodeIndex;
 
 class GRAPHICSCORE_EXPORT GCShiftRenderModel : public XAbstractRenderModel, SConnectionObserver, STreeObserver
   {
 XProperties:
   XROProperty(SEntityWeakPointer, entity);
   XROProperty(SIterator::FilterFunction, filter);
+  // where the delegate lays out the entities, when set the entities in a region can be iterated without visiting
+  // the rest.
+  XProperty(GCNodeIndex *, index, setIndex);
 
 public:
   class GRAPHICSCORE_EXPORT Iterator : public XAbstractRenderModel::Iterator
@@ -38,10 +44,18 @@ public:
       return 0;
       }
 
+    // true when the entity visited is the last, only known when iterating a list, ie. for updates.
+    bool isLast() const { return _fromList && _listIndex == (xsize)_list.size(); }
+
   protected:
     void reset();
     void setProperty(SProperty *p) { _property = p; }
 
+    // entities to visit instead of filtering the tree, when _fromList is set.
+    bool _fromList;
+    XVector<const void *> _list;
+    xsize _listIndex;
+
     friend class GCShiftRenderModel;
     };
 
@@ -53,9 +67,31 @@ public:
   virtual XAbstractRenderModel::Iterator *createIterator() const;
 
   virtual void resetIterator(XAbstractRenderModel::Iterator *) const;
+  // reset to visit only the entities whose indexed bounds intersect [region], or every entity if some haven't
+  // been laid out into the index yet.
+  void resetIterator(XAbstractRenderModel::Iterator *, const QRect &region) const;
+  virtual void resetPaintIterator(XAbstractRenderModel::Iterator *, const XAbstractCanvas *) const;
+  // reset to visit the entities changes have invalidated since the last update.
+  virtual void resetUpdateIterator(XAbstractRenderModel::Iterator *, const XAbstractCanvas *) const;
+
+  xsize entityCount() const { return _entityCount; }
+  // the number of entities the update being made visits.
+  xsize updateCount() const;
 
   void onConnectionChange(const SChange *);
   void onTreeChange(const SChange *);
+
+private:
+  // the direct child entity of entity() [prop] is within, or 0.
+  SEntity *nodeFor(SProperty *prop) const;
+  void invalidate(SProperty *prop);
+  void updateInvalidated();
+
+  void countEntities();
+  xsize _entityCount;
+
+  XVector<SEntity *> _invalidated;
+  bool _invalidateAll;
   };
 
 #endif // GCSHIFTRENDERMODEL_H
@@ -0,0 +1,60 @@
+#include "GCTextCache.h"
+
+namespace
+{
+QMutex g_cachesLock;
+XHash<QString, GCTextCache *> g_caches;
+}
+
+GCTextCache *GCTextCache::forFont(const QFont &font)
+  {
+  QMutexLocker l(&g_cachesLock);
+
+  GCTextCache *&cache = g_caches[font.key()];
+  if(!cache)
+    {
+    cache = new GCTextCache(font);
+    }
+  return cache;
+  }
+
+GCTextCache::GCTextCache(const QFont &font) : _font(font), _height(QFontMetrics(font).height())
+  {
+  }
+
+GCTextCache::Text GCTextCache::text(const QString &str, int maxWidth)
+  {
+  QPair<QString, int> key(str, maxWidth);
+    {
+    QMutexLocker l(&_lock);
+    XHash<QPair<QString, int>, Text>::const_iterator it = _texts.find(key);
+    if(it != _texts.end())
+      {
+      return it.value();
+      }
+    }
+
+  // measured without the lock, so layout threads only wait on each other for lookups. Copied metrics would
+  // share their data with the other threads', so each measurement builds fresh metrics from the font.
+  QFontMetrics metrics(_font);
+
+  Text t;
+  QString shown = maxWidth < 0 ? str : metrics.elidedText(str, Qt::ElideRight, maxWidth);
+  t.width = metrics.width(shown);
+  t.text.setText(shown);
+  t.text.prepare(QTransform(), _font);
+
+  QMutexLocker l(&_lock);
+  if(_texts.size() >= MaximumEntries)
+    {
+    _texts.clear();
+    }
+  _texts.insert(key, t);
+  return t;
+  }
+
+void GCTextCache::clear()
+  {
+  QMutexLocker l(&_lock);
+  _texts.clear();
+  }
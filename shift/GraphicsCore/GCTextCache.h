@@ -0,0 +1,52 @@
+#ifndef GCTEXTCACHE_H
+#define GCTEXTCACHE_H
+
+#include "GCGlobal.h"
+#include "XHash"
+#include "QFont"
+#include "QFontMetrics"
+#include "QStaticText"
+#include "QMutex"
+#include "QPair"
+
+// Measured and prepared text in one font, shared by everything laying out text in that font, so a name laid out
+// again, or shown in many places, is only measured once. Safe to use from layout threads.
+class GRAPHICSCORE_EXPORT GCTextCache
+  {
+public:
+  enum
+    {
+    // past this many strings the cache is emptied, rather than growing with every name ever shown.
+    MaximumEntries = 1 << 16
+    };
+
+  class Text
+    {
+  public:
+    QStaticText text;
+    int width;
+    };
+
+  // the cache for [font], created on first use and kept until exit.
+  static GCTextCache *forFont(const QFont &font);
+
+  const QFont &font() const { return _font; }
+  int height() const { return _height; }
+
+  // [str] elided to fit [maxWidth], or whole when [maxWidth] is negative, and prepared to draw in font().
+  Text text(const QString &str, int maxWidth = -1);
+
+  void clear();
+
+private:
+  GCTextCache(const QFont &font);
+  X_DISABLE_COPY(GCTextCache);
+
+  QFont _font;
+  int _height;
+
+  QMutex _lock;
+  XHash<QPair<QString, int>, Text> _texts;
+  };
+
+#endif // GCTEXTCACHE_H
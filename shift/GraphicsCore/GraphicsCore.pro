@@ -17,6 +17,9 @@ HEADERS += GCGlobal.h \
     GCShiftRenderModel.h \
     GCAbstractNodeDelegate.h \
     GCNodeController.h \
+    GCNodeIndex.h \
+    GCTextCache.h \
+    GCOverviewCache.h \
     GCQImage.h \
     GCGeometry.h \
     3D/GCTransform.h \
@@ -45,6 +48,9 @@ SOURCES += \
     GCShiftRenderModel.cpp \
     GCAbstractNodeDelegate.cpp \
     GCNodeController.cpp \
+    GCNodeIndex.cpp \
+    GCTextCache.cpp \
+    GCOverviewCache.cpp \
     GCQImage.cpp \
     3D/GCTransform.cpp \
     3D/GCRenderToTexture.cpp \
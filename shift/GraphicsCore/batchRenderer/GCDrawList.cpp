@@ -0,0 +1,199 @@
+#include "GCDrawList.h"
+#include "XShader.h"
+#include "XSet"
+
+namespace
+{
+// bring [copy]'s uniform values up to date with [source]'s, they may change between frames.
+void syncShader(XShader *copy, const XShader &source)
+  {
+  XMap<QString, XShaderVariable*> variables = source.variables();
+  for(XMap<QString, XShaderVariable*>::const_iterator it = variables.begin(); it != variables.end(); ++it)
+    {
+    XShaderVariable *var = copy->getVariable(it.key());
+    if(var->value() != it.value()->value())
+      {
+      var->setVariantValue(it.value()->value());
+      }
+    }
+  }
+}
+
+GCDrawList::Resources::~Resources()
+  {
+  // the copies are destroyed before their renderer, so they can release what they hold in it.
+  foreach(XShader *s, _shaders)
+    {
+    delete s;
+    }
+  foreach(XGeometry *g, _geometry)
+    {
+    delete g;
+    }
+  }
+
+GCDrawList::GCDrawList()
+  {
+  reset();
+  }
+
+void GCDrawList::reset()
+  {
+  _draws.clear();
+  _transforms.clear();
+  _transforms << XTransform::Identity();
+  _projection = XComplexTransform::Identity();
+  _shader = 0;
+  }
+
+void GCDrawList::prepare(Resources &res) const
+  {
+  XSet<const XShader *> refreshedShaders;
+  XSet<const XGeometry *> refreshed;
+  foreach(const Draw &d, _draws)
+    {
+    if(d.shader && !refreshedShaders.contains(d.shader))
+      {
+      refreshedShaders << d.shader;
+
+      XShader *&copy = res._shaders[d.shader];
+      if(copy)
+        {
+        syncShader(copy, *d.shader);
+        }
+      else
+        {
+        copy = new XShader(*d.shader);
+        }
+      }
+
+    if(refreshed.contains(d.geometry))
+      {
+      continue;
+      }
+    refreshed << d.geometry;
+
+    // geometry may change between frames, assigning keeps the copy's buffers when only values differ.
+    XGeometry *&copy = res._geometry[d.geometry];
+    if(copy)
+      {
+      *copy = *d.geometry;
+      }
+    else
+      {
+      copy = new XGeometry(*d.geometry);
+      }
+    }
+  }
+
+void GCDrawList::replay(XRenderer *r, const XComplexTransform &adjust, const Resources &res) const
+  {
+  foreach(const Draw &d, _draws)
+    {
+    const XGeometry *geo = res._geometry.value(d.geometry);
+    xAssert(geo);
+
+    r->setRenderFlags(d.flags);
+    r->setProjectionTransform(adjust * d.projection);
+    r->setShader(d.shader ? res._shaders.value(d.shader) : 0);
+    r->pushTransform(d.modelView);
+    r->drawGeometry(*geo);
+    r->popTransform();
+    }
+  }
+
+XAbstractShader *GCDrawList::getShader()
+  {
+  xAssertFail();
+  return 0;
+  }
+
+XAbstractGeometry *GCDrawList::getGeometry(XGeometry::BufferType, XGeometry::VertexLayout)
+  {
+  xAssertFail();
+  return 0;
+  }
+
+XAbstractTexture *GCDrawList::getTexture()
+  {
+  xAssertFail();
+  return 0;
+  }
+
+XAbstractFramebuffer *GCDrawList::getFramebuffer(int, int, int, int, int)
+  {
+  xAssertFail();
+  return 0;
+  }
+
+void GCDrawList::destroyShader(XAbstractShader *)
+  {
+  }
+
+void GCDrawList::destroyGeometry(XAbstractGeometry *)
+  {
+  }
+
+void GCDrawList::destroyTexture(XAbstractTexture *)
+  {
+  }
+
+void GCDrawList::destroyFramebuffer(XAbstractFramebuffer *)
+  {
+  }
+
+void GCDrawList::pushTransform(const XTransform &trans)
+  {
+  XTransform current = _transforms.last() * trans;
+  _transforms << current;
+  }
+
+void GCDrawList::popTransform()
+  {
+  xAssert(_transforms.size() > 1);
+  _transforms.pop_back();
+  }
+
+void GCDrawList::clear()
+  {
+  // the target is cleared by whoever replays the list.
+  }
+
+void GCDrawList::setViewportSize(QSize)
+  {
+  }
+
+void GCDrawList::setProjectionTransform(const XComplexTransform &trans)
+  {
+  _projection = trans;
+  }
+
+void GCDrawList::setShader(const XShader *shader)
+  {
+  _shader = shader;
+  }
+
+void GCDrawList::drawGeometry(const XGeometry &geo)
+  {
+  Draw d;
+  d.projection = _projection;
+  d.modelView = _transforms.last();
+  d.shader = _shader;
+  d.geometry = &geo;
+  d.flags = renderFlags();
+  _draws << d;
+  }
+
+void GCDrawList::setFramebuffer(const XFramebuffer *)
+  {
+  // scenes draw to the batch output, render to texture isn't recorded.
+  xAssertFail();
+  }
+
+void GCDrawList::enableRenderFlag(RenderFlags)
+  {
+  }
+
+void GCDrawList::disableRenderFlag(RenderFlags)
+  {
+  }
@@ -0,0 +1,81 @@
+#ifndef GCDRAWLIST_H
+#define GCDRAWLIST_H
+
+#include "XRenderer.h"
+#include "XVector"
+#include "XHash"
+
+// A renderer which records the draws it is given, so they can be replayed onto other renderers. Shift
+// evaluates on one thread and XShader/XGeometry bind to a single renderer, so scenes are recorded on the main
+// thread and each worker replays them onto its own renderer, with its own copies of the shaders and geometry.
+class GCDrawList : public XRenderer
+  {
+public:
+  // one worker's copies of the recorded shaders and geometry, made by prepare().
+  class Resources
+    {
+  public:
+    ~Resources();
+
+  private:
+    XHash<const XShader *, XShader *> _shaders;
+    XHash<const XGeometry *, XGeometry *> _geometry;
+    friend class GCDrawList;
+    };
+
+  GCDrawList();
+
+  void reset();
+  xsize drawCount() const { return _draws.size(); }
+
+  // refresh [res] from the recorded draws, call on the thread which recorded them. Shader copies take the
+  // source's current uniform values, but keep the type they were copied with.
+  void prepare(Resources &res) const;
+  // issue the draws to [r], the projection of each is pre-multiplied by [adjust].
+  void replay(XRenderer *r, const XComplexTransform &adjust, const Resources &res) const;
+
+  virtual XAbstractShader *getShader();
+  virtual XAbstractGeometry *getGeometry(XGeometry::BufferType, XGeometry::VertexLayout);
+  virtual XAbstractTexture *getTexture();
+  virtual XAbstractFramebuffer *getFramebuffer(int options, int colourFormat, int depthFormat, int width, int height);
+
+  virtual void destroyShader(XAbstractShader *);
+  virtual void destroyGeometry(XAbstractGeometry *);
+  virtual void destroyTexture(XAbstractTexture *);
+  virtual void destroyFramebuffer(XAbstractFramebuffer *);
+
+  virtual void pushTransform(const XTransform &);
+  virtual void popTransform();
+
+  virtual void clear();
+
+  virtual void setViewportSize(QSize);
+  virtual void setProjectionTransform(const XComplexTransform &);
+
+  virtual void setShader(const XShader *);
+
+  virtual void drawGeometry(const XGeometry &);
+
+  virtual void setFramebuffer(const XFramebuffer *);
+
+protected:
+  virtual void enableRenderFlag(RenderFlags);
+  virtual void disableRenderFlag(RenderFlags);
+
+private:
+  struct Draw
+    {
+    XComplexTransform projection;
+    XTransform modelView;
+    const XShader *shader;
+    const XGeometry *geometry;
+    int flags;
+    };
+
+  XVector<Draw> _draws;
+  XVector<XTransform> _transforms;
+  XComplexTransform _projection;
+  const XShader *_shader;
+  };
+
+#endif // GCDRAWLIST_H
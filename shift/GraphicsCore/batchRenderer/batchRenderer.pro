@@ -0,0 +1,23 @@
+# -------------------------------------------------
+# Renders the GCScenes in a shift database to images, without a GL context.
+# run as "batchRenderer database outputDirectory [width] [height] [frames] [tileSize] [threads]"
+# -------------------------------------------------
+TARGET = batchRenderer
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+QT += opengl
+
+include("../../../EksCore/GeneralOptions.pri")
+
+SOURCES += main.cpp \
+    GCDrawList.cpp
+
+HEADERS += GCDrawList.h
+
+INCLUDEPATH += $$ROOT/shift/GraphicsCore $$ROOT/EksCore $$ROOT/Eks3D/include $$ROOT/Shift
+
+LIBS += -lShiftGraphicsCore -lshift -lEksCore -lEks3D
+
+win32:LIBS += -lpsapi
@@ -0,0 +1,313 @@
+#include "QCoreApplication"
+#include "QStringList"
+#include "QThread"
+#include "QThreadPool"
+#include "QRunnable"
+#include "QMutex"
+#include "QFile"
+#include "QDir"
+#include "QDebug"
+#include "XTime"
+#include "XSoftwareRenderer.h"
+#include "sdatabase.h"
+#include "sxmlio.h"
+#include "styperegistry.h"
+#include "GraphicsCore.h"
+#include "3D/GCScene.h"
+#include "GCDrawList.h"
+
+#ifdef Q_OS_WIN
+# include "windows.h"
+# include "psapi.h"
+#endif
+
+namespace
+{
+// the most memory the process has had resident, in KB, or 0 where that isn't known.
+xsize peakMemory()
+  {
+#if defined(Q_OS_WIN)
+  PROCESS_MEMORY_COUNTERS counters;
+  if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+    return counters.PeakWorkingSetSize / 1024;
+    }
+#elif defined(Q_OS_LINUX)
+  QFile status("/proc/self/status");
+  if(status.open(QIODevice::ReadOnly))
+    {
+    QList<QByteArray> lines = status.readAll().split('\n');
+    foreach(const QByteArray &line, lines)
+      {
+      if(line.startsWith("VmHWM:"))
+        {
+        return line.mid(6).trimmed().split(' ').first().toULongLong();
+        }
+      }
+    }
+#endif
+  return 0;
+  }
+
+void findScenes(SPropertyContainer *parent, XVector<GCScene *> &scenes)
+  {
+  for(SProperty *child = parent->firstChild(); child; child = child->nextSibling())
+    {
+    if(GCScene *scene = child->castTo<GCScene>())
+      {
+      scenes << scene;
+      }
+    else if(SPropertyContainer *container = child->castTo<SPropertyContainer>())
+      {
+      findScenes(container, scenes);
+      }
+    }
+  }
+
+// a binary PPM, sized up front so tiles can be written as they finish, in any order.
+class TileWriter
+  {
+public:
+  TileWriter(const QString &path, int width, int height) : _file(path), _width(width)
+    {
+    QByteArray header = QString("P6\n%1 %2\n255\n").arg(width).arg(height).toAscii();
+    _headerSize = header.size();
+
+    if(_file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+      {
+      _file.write(header);
+      _file.resize(_headerSize + (qint64)width * height * 3);
+      }
+    }
+
+  bool isOpen() const { return _file.isOpen(); }
+
+  void write(const QImage &tile, int x, int y)
+    {
+    QByteArray row(tile.width() * 3, 0);
+
+    QMutexLocker l(&_lock);
+    for(int r=0; r<tile.height(); ++r)
+      {
+      const QRgb *pixels = (const QRgb *)tile.constScanLine(r);
+      char *out = row.data();
+      for(int i=0; i<tile.width(); ++i)
+        {
+        *out++ = qRed(pixels[i]);
+        *out++ = qGreen(pixels[i]);
+        *out++ = qBlue(pixels[i]);
+        }
+
+      _file.seek(_headerSize + ((qint64)(y + r) * _width + x) * 3);
+      _file.write(row);
+      }
+    }
+
+private:
+  QFile _file;
+  QMutex _lock;
+  qint64 _headerSize;
+  int _width;
+  };
+
+// the frame being rendered, shared by the workers.
+class Frame
+  {
+public:
+  const GCDrawList *draws;
+  TileWriter *output;
+  int width;
+  int height;
+  int tileSize;
+  int tilesX;
+  int tileCount;
+  QAtomicInt nextTile;
+  };
+
+// owns a renderer, and copies of the scene's resources for it, and renders tiles of a Frame until there are none left.
+class Worker : public QRunnable
+  {
+public:
+  Worker() : _renderer(1), _frame(0)
+    {
+    setAutoDelete(false);
+    }
+
+  void prepare(Frame *frame)
+    {
+    _frame = frame;
+    frame->draws->prepare(_resources);
+    }
+
+  void run()
+    {
+    int tile;
+    while((tile = _frame->nextTile.fetchAndAddOrdered(1)) < _frame->tileCount)
+      {
+      int x = (tile % _frame->tilesX) * _frame->tileSize;
+      int y = (tile / _frame->tilesX) * _frame->tileSize;
+      int w = xMin(_frame->tileSize, _frame->width - x);
+      int h = xMin(_frame->tileSize, _frame->height - y);
+
+      // scale and offset clip space so the tile's part of the frame fills the viewport. Row 0 is the top,
+      // where y is +1 in clip space.
+      xReal scaleX = (xReal)_frame->width / w;
+      xReal scaleY = (xReal)_frame->height / h;
+      xReal centreX = -1.0f + (2.0f * x + w) / _frame->width;
+      xReal centreY = 1.0f - (2.0f * y + h) / _frame->height;
+
+      XComplexTransform adjust = XComplexTransform::Identity();
+      adjust.matrix()(0, 0) = scaleX;
+      adjust.matrix()(1, 1) = scaleY;
+      adjust.matrix()(0, 3) = -scaleX * centreX;
+      adjust.matrix()(1, 3) = -scaleY * centreY;
+
+      _renderer.setViewportSize(QSize(w, h));
+      _renderer.clear();
+      _frame->draws->replay(&_renderer, adjust, _resources);
+      _frame->output->write(_renderer.colour(), x, y);
+      }
+    }
+
+private:
+  // declared first, the resources are released into it as the worker is destroyed.
+  XSoftwareRenderer _renderer;
+  GCDrawList::Resources _resources;
+  Frame *_frame;
+  };
+}
+
+// Renders every GCScene in a database without a GL context, for thumbnails and turntables on servers. Scenes
+// are evaluated and recorded on the main thread, then the frame is split into tiles which the workers render
+// in parallel and write to the output as they finish, so only a tile per worker is ever held in memory.
+// With more than one frame, the scene turns about the world's y axis once over the sequence.
+int main(int argc, char *argv[])
+  {
+  QCoreApplication a(argc, argv);
+
+  QStringList args = a.arguments();
+  if(args.size() < 3)
+    {
+    qDebug() << "usage: batchRenderer database outputDirectory [width] [height] [frames] [tileSize] [threads]";
+    return 1;
+    }
+
+  int width = args.size() > 3 ? args[3].toInt() : 1920;
+  int height = args.size() > 4 ? args[4].toInt() : 1080;
+  int frames = args.size() > 5 ? args[5].toInt() : 1;
+  int tileSize = args.size() > 6 ? args[6].toInt() : 256;
+  int threads = args.size() > 7 ? args[7].toInt() : QThread::idealThreadCount();
+  if(width <= 0 || height <= 0 || frames <= 0 || tileSize <= 0)
+    {
+    qDebug() << "The size, frame count and tile size must be positive";
+    return 1;
+    }
+  threads = xMax(threads, 1);
+
+  STypeRegistry::initiate();
+
+  SDatabase db;
+  initiateGraphicsCore(&db);
+  // nothing is undone, so changes aren't kept.
+  db.setStateStorageEnabled(false);
+
+  QFile file(args[1]);
+  if(!file.open(QIODevice::ReadOnly))
+    {
+    qDebug() << "Couldn't open" << args[1];
+    return 1;
+    }
+
+  XTime start = XTime::now();
+  SXMLLoader loader;
+  loader.readFromDevice(&file, &db);
+  qDebug() << "Loaded" << args[1] << "in" << (XTime::now() - start).milliseconds() << "ms";
+
+  XVector<GCScene *> scenes;
+  findScenes(&db, scenes);
+  if(scenes.isEmpty())
+    {
+    qDebug() << "No scenes in" << args[1];
+    return 1;
+    }
+
+  QDir outputDir(args[2]);
+  if(!outputDir.mkpath("."))
+    {
+    qDebug() << "Couldn't create" << args[2];
+    return 1;
+    }
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(threads);
+
+  XVector<Worker *> workers;
+  for(int i=0; i<threads; ++i)
+    {
+    workers << new Worker;
+    }
+
+  GCDrawList draws;
+  Frame frame;
+  frame.draws = &draws;
+  frame.width = width;
+  frame.height = height;
+  frame.tileSize = tileSize;
+  frame.tilesX = (width + tileSize - 1) / tileSize;
+  frame.tileCount = frame.tilesX * ((height + tileSize - 1) / tileSize);
+
+  double recordTime = 0.0;
+  xuint64 drawCount = 0;
+  start = XTime::now();
+  foreach(GCScene *scene, scenes)
+    {
+    XTransform camera = scene->cameraTransform();
+
+    for(int f=0; f<frames; ++f)
+      {
+      XTime recordStart = XTime::now();
+      if(frames > 1)
+        {
+        xReal angle = X_DEGTORAD(360.0f * f / frames);
+        scene->cameraTransform = camera * Eigen::AngleAxisf(angle, XVector3D::UnitY());
+        }
+
+      draws.reset();
+      scene->render(&draws);
+      drawCount += draws.drawCount();
+
+      foreach(Worker *w, workers)
+        {
+        w->prepare(&frame);
+        }
+      recordTime += (XTime::now() - recordStart).milliseconds();
+
+      QString name = QString("%1_%2.ppm").arg(scene->name()).arg(f, 4, 10, QChar('0'));
+      TileWriter output(outputDir.filePath(name), width, height);
+      if(!output.isOpen())
+        {
+        qDebug() << "Couldn't write" << outputDir.filePath(name);
+        return 1;
+        }
+
+      frame.output = &output;
+      frame.nextTile = 0;
+      foreach(Worker *w, workers)
+        {
+        pool.start(w);
+        }
+      pool.waitForDone();
+      }
+
+    scene->cameraTransform = camera;
+    }
+  double elapsed = (XTime::now() - start).milliseconds();
+
+  qDeleteAll(workers);
+
+  int totalFrames = scenes.size() * frames;
+  qDebug() << totalFrames << "frames of" << width << "x" << height << "in" << frame.tileCount << "tiles on" << threads << "threads,"
+           << totalFrames * 1000.0 / elapsed << "fps," << recordTime / totalFrames << "ms a frame recording,"
+           << (double)drawCount / totalFrames << "draws a frame, peak memory" << peakMemory() / 1024 << "MB";
+  return 0;
+  }
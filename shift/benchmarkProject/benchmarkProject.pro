@@ -0,0 +1,21 @@
+# -------------------------------------------------
+# shift benchmarks, run as "benchmarkProject [benchmark] [args]"
+# -------------------------------------------------
+TARGET = ShiftBenchmarks
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+include("../../EksCore/GeneralOptions.pri")
+
+INCLUDEPATH += .. \
+    $$ROOT/EksCore
+
+LIBS += -lshift \
+    -lEksCore
+
+SOURCES += main.cpp \
+    iteratorBenchmark.cpp \
+    containerBenchmark.cpp
+
+HEADERS += benchmarks.h
@@ -0,0 +1,10 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "QStringList"
+
+// each benchmark takes the remaining command line arguments and returns an exit code.
+int iteratorBenchmark(const QStringList &args);
+int containerBenchmark(const QStringList &args);
+
+#endif // BENCHMARKS_H
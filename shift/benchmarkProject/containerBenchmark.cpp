@@ -0,0 +1,117 @@
+#include "benchmarks.h"
+#include "sdatabase.h"
+#include "sbaseproperties.h"
+#include "styperegistry.h"
+#include "XTime"
+#include "QDebug"
+
+namespace
+{
+enum
+  {
+  Properties = 100000,
+  Inserts = 1000
+  };
+
+int argument(const QStringList &args, int index, int fallback)
+  {
+  bool ok = false;
+  int value = index < args.size() ? args[index].toInt(&ok) : 0;
+  return ok ? value : fallback;
+  }
+
+// every child knows where it is, and the container agrees.
+bool checkIndices(SPropertyArray &array)
+  {
+  xsize index = 0;
+  for(SProperty *child = array.firstChild(); child; child = child->nextSibling(), ++index)
+    {
+    if(child->index() != index || array.at(index) != child || !array.contains(child))
+      {
+      qWarning() << "child" << index << "reports index" << child->index();
+      return false;
+      }
+    }
+  return index == array.size();
+  }
+
+// inserting at the front moves every dynamic child up, then removing and restoring one of them, as undo does.
+bool checkInsertAndUndo(SDatabase &db)
+  {
+  SPropertyArray &array = db.addChild<SEntity>("indices")->children;
+  array.add(FloatProperty::staticTypeInformation(), 8);
+
+  SProperty *shifted = array.at(0);
+  array.add(FloatProperty::staticTypeInformation(), 1, 0);
+  if(!checkIndices(array) || shifted->index() != 1)
+    {
+    return false;
+    }
+
+  SPropertyContainer::TreeChange change(&array, 0, shifted, shifted->index());
+  ((SChange &)change).apply(SChange::Forward);
+  if(!checkIndices(array) || array.contains(shifted) || array.size() != 8)
+    {
+    return false;
+    }
+
+  ((SChange &)change).apply(SChange::Backward);
+  if(!checkIndices(array) || array.at(1) != shifted)
+    {
+    return false;
+    }
+
+  array.remove(shifted);
+  return checkIndices(array) && array.size() == 8;
+  }
+}
+
+int containerBenchmark(const QStringList &args)
+  {
+  int properties = argument(args, 0, Properties);
+
+  STypeRegistry::initiate();
+
+  SDatabase db;
+  // nothing is undone, so changes aren't kept.
+  db.setStateStorageEnabled(false);
+
+  if(!checkInsertAndUndo(db))
+    {
+    qWarning() << "container indices are wrong after inserting and undoing";
+    return EXIT_FAILURE;
+    }
+
+  SPropertyArray &array = db.addChild<SEntity>("array")->children;
+
+  XTime start = XTime::now();
+  array.add(FloatProperty::staticTypeInformation(), properties);
+  double adding = (XTime::now() - start).milliseconds();
+
+  start = XTime::now();
+  xsize sum = 0;
+  for(xsize i=0, s=array.size(); i<s; ++i)
+    {
+    sum += array.at(i)->index();
+    }
+  double indexing = (XTime::now() - start).milliseconds();
+
+  start = XTime::now();
+  for(int i=0; i<Inserts; ++i)
+    {
+    array.add(FloatProperty::staticTypeInformation(), 1, array.size() / 2);
+    array.at(array.size() / 2 + 1)->index();
+    }
+  double inserting = (XTime::now() - start).milliseconds();
+
+  qDebug() << "added" << properties << "properties in" << adding << "ms, indexed all in" << indexing << "ms,"
+           << Inserts << "middle inserts in" << inserting << "ms";
+
+  xsize expected = (xsize)properties * (properties - 1) / 2;
+  if(sum != expected || !checkIndices(array))
+    {
+    qWarning() << "container indices are wrong";
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
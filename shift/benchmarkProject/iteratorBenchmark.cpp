@@ -0,0 +1,120 @@
+#include "benchmarks.h"
+#include "siterator.h"
+#include "sdatabase.h"
+#include "sbaseproperties.h"
+#include "styperegistry.h"
+#include "XTime"
+#include "QDebug"
+
+namespace
+{
+enum
+  {
+  // groups of entities, each holding properties, about a million properties in all.
+  Groups = 100,
+  EntitiesPerGroup = 100,
+  PropertiesPerEntity = 96,
+  Passes = 5
+  };
+
+int argument(const QStringList &args, int index, int fallback)
+  {
+  bool ok = false;
+  int value = index < args.size() ? args[index].toInt(&ok) : 0;
+  return ok ? value : fallback;
+  }
+
+// the walk as it was done before, through the public tree API, calling preGet() each step.
+xsize countRecursive(SProperty *prop)
+  {
+  xsize count = 1;
+  SPropertyContainer *cont = prop->castTo<SPropertyContainer>();
+  if(cont)
+    {
+    for(SProperty *child = cont->firstChild(); child; child = child->nextSibling())
+      {
+      count += countRecursive(child);
+      }
+    }
+  return count;
+  }
+
+xsize countFiltered(SProperty *root, SIterator::FilterFunction filter)
+  {
+  xsize count = 0;
+  SIterator::DataCache cache(root);
+  while(filter(cache))
+    {
+    ++count;
+    }
+  return count;
+  }
+}
+
+int iteratorBenchmark(const QStringList &args)
+  {
+  int groups = argument(args, 0, Groups);
+
+  STypeRegistry::initiate();
+
+  SDatabase db;
+  // nothing is undone, so changes aren't kept.
+  db.setStateStorageEnabled(false);
+
+  XTime start = XTime::now();
+  xsize entities = 0;
+  for(int g=0; g<groups; ++g)
+    {
+    SEntity *group = db.addChild<SEntity>("group");
+    for(int e=0; e<EntitiesPerGroup; ++e)
+      {
+      SEntity *ent = group->addChild<SEntity>("entity");
+      ++entities;
+      for(int p=0; p<PropertiesPerEntity; ++p)
+        {
+        ent->children.add<FloatProperty>();
+        }
+      }
+    }
+  qDebug() << "built" << groups * EntitiesPerGroup << "entities in" << (XTime::now() - start).milliseconds() << "ms";
+
+  xsize expected = countRecursive(&db);
+
+  start = XTime::now();
+  for(int i=0; i<Passes; ++i)
+    {
+    countRecursive(&db);
+    }
+  double recursive = (XTime::now() - start).milliseconds() / Passes;
+
+  SIterator::FilterFunction tree = SIterator::createFilter<ChildTree>();
+  xsize walked = 0;
+  start = XTime::now();
+  for(int i=0; i<Passes; ++i)
+    {
+    walked = countFiltered(&db, tree);
+    }
+  double iterated = (XTime::now() - start).milliseconds() / Passes;
+
+  SIterator::FilterFunction entityTree = SIterator::createFilter<ChildTree, Typed<SEntity>::Is>();
+  xsize foundEntities = 0;
+  start = XTime::now();
+  for(int i=0; i<Passes; ++i)
+    {
+    foundEntities = countFiltered(&db, entityTree);
+    }
+  double filtered = (XTime::now() - start).milliseconds() / Passes;
+
+  qDebug() << expected << "properties, walked recursively in" << recursive << "ms, by SIterator in" << iterated
+           << "ms, and only entities in" << filtered << "ms";
+
+  // the database itself and the groups are entities too.
+  xsize expectedEntities = 1 + groups + entities;
+  if(walked != expected || foundEntities != expectedEntities)
+    {
+    qWarning() << "SIterator visited" << walked << "properties and" << foundEntities << "entities, expected"
+               << expected << "and" << expectedEntities;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+  }
@@ -5,9 +5,30 @@
 #include "QRegExp"
 #include "QDebug"
 #include "styperegistry.h"
+#include "QRunnable"
 
 S_IMPLEMENT_PROPERTY(SDatabase)
 
+namespace
+{
+class ObserverJob : public QRunnable
+  {
+public:
+  ObserverJob(SObserver *obs, const SChangeBatch &batch) : _observer(obs), _batch(batch)
+    {
+    }
+
+  void run()
+    {
+    _observer->actOnBatch(_batch);
+    }
+
+private:
+  SObserver *_observer;
+  SChangeBatch _batch;
+  };
+}
+
 SPropertyInformation *SDatabase::createTypeInformation()
   {
   SPropertyInformation* info = SPropertyInformation::create<SDatabase>("SDatabase");
@@ -22,10 +43,15 @@ SDatabase::SDatabase() : _blockLevel(0)
   _database = this;
   _info = staticTypeInformation();
   _instanceInfo = &_instanceInfoData;
+
+  // one thread, so each observer's batches arrive in the order their blocks ended.
+  _observerThread.setMaxThreadCount(1);
   }
 
 SDatabase::~SDatabase()
   {
+  waitForObservers();
+
   // clear out our child elements before the allocator is destroyed.
   SProperty *prop = _child;
   while(prop)
@@ -38,6 +64,7 @@ SDatabase::~SDatabase()
     prop = next;
     }
   _child = 0;
+  _children.clear();
 
   foreach(SChange *ch, _done)
     {
@@ -214,12 +241,45 @@ void SDatabase::destoryChangeMemory(SChange *ptr)
   _memory.free(ptr);
   }
 
+void SDatabase::queueObserver(SObserver *obs, const SChangeBatch::Entry &entry)
+  {
+  if(!obs->_queued)
+    {
+    obs->_queued = true;
+    _blockObservers << obs;
+    }
+
+  if(obs->_delivery != SObserver::Notify)
+    {
+    obs->_batch.append(entry);
+    }
+  }
+
+void SDatabase::waitForObservers()
+  {
+  _observerThread.waitForDone();
+  }
+
 void SDatabase::inform()
   {
   SProfileFunction
-  foreach(SObserver *obs, _blockObservers)
+  // observers may make changes as they act, which queue observers for a block of their own.
+  SObservers observers(_blockObservers);
+  _blockObservers.clear();
+
+  foreach(SObserver *obs, observers)
     {
-    obs->actOnChanges();
+    SChangeBatch batch(obs->_batch);
+    obs->_batch.clear();
+    obs->_queued = false;
+
+    if(obs->_delivery == SObserver::CollectOnThread)
+      {
+      _observerThread.start(new ObserverJob(obs, batch));
+      }
+    else
+      {
+      obs->actOnBatch(batch);
+      }
     }
-  _blockObservers.clear();
   }
@@ -7,8 +7,10 @@
 #include "sbaseproperties.h"
 #include "XRandomAccessAllocator"
 #include "sloader.h"
+#include "QThreadPool"
 
 class SChange;
+class SObserver;
 
 class SHIFT_EXPORT SDatabase : public SEntity
   {
@@ -39,6 +41,9 @@ public:
     bool oldStateStorageEnabled = _stateStorageEnabled;
     setStateStorageEnabled(false);
 
+    // a change made outside a block is a block of its own, so its observers act on it straight away.
+    beginBlock();
+
     int mode = SChange::Forward|SChange::Inform;
     if(!oldStateStorageEnabled)
       {
@@ -73,9 +78,14 @@ public:
         }
       }
     setStateStorageEnabled(oldStateStorageEnabled);
+
+    endBlock();
     }
 
-  SObservers &currentBlockObserverList() { return _blockObservers; }
+  // called as [obs] is informed of a change, it acts on the changes once the current block ends.
+  void queueObserver(SObserver *obs, const SChangeBatch::Entry &entry);
+  // wait for batches delivered on the observer thread to be acted on.
+  void waitForObservers();
 
   bool stateStorageEnabled() const { return _stateStorageEnabled; }
   void setStateStorageEnabled(bool enable) { _stateStorageEnabled = enable; }
@@ -97,6 +107,8 @@ private:
 
   void inform();
   SObservers _blockObservers;
+  // batches for SObserver::CollectOnThread observers are delivered here, one at a time, in order.
+  QThreadPool _observerThread;
   QMutex _doChange;
   bool _stateStorageEnabled;
 
@@ -77,84 +77,192 @@ SDatabaseModel::~SDatabaseModel()
     {
     _root->removeTreeObserver(this);
     }
+  clearRows();
   }
 
-int SDatabaseModel::rowCount( const QModelIndex &parent ) const
+SProperty *SDatabaseModel::itemFor(const QModelIndex &index) const
   {
-  SDataModelProfileFunction
-  const SProperty *prop = _root;
-  int size = 0;
-  if(parent.isValid())
+  if(index.isValid())
     {
-    prop = (SProperty *)parent.internalPointer();
+    return (SProperty *)index.internalPointer();
     }
+  return const_cast<SEntity *>((const SEntity *)_root);
+  }
 
-  if(!prop)
+const SPropertyContainer *SDatabaseModel::rowsContainer(const SProperty *item) const
+  {
+  if(!item)
     {
     return 0;
     }
 
   if(_options.hasFlag(EntitiesOnly))
     {
-    const SEntity *ent = prop->castTo<SEntity>();
+    const SEntity *ent = item->castTo<SEntity>();
     xAssert(ent);
 
-    prop = &ent->children;
+    return ent ? &ent->children : 0;
     }
 
-  const SPropertyContainer *container = prop->castTo<SPropertyContainer>();
-  if(container)
+  return item->castTo<SPropertyContainer>();
+  }
+
+SDatabaseModel::Rows *SDatabaseModel::rowsFor(const SProperty *item) const
+  {
+  const SPropertyContainer *container = rowsContainer(item);
+  if(!container)
     {
-    SProperty *child = container->firstChild();
-    while(child)
-      {
-      size++;
-      child = child->nextSibling();
-      }
+    return 0;
     }
 
-  return size;
+  Rows *&rows = _rows[container];
+  if(!rows)
+    {
+    rows = new Rows;
+    rows->item = const_cast<SProperty *>(item);
+    rows->container = container;
+    rows->validRows = 0;
+    rows->columns = -1;
+    rows->complete = false;
+
+    // views are yet to ask about these rows, so the first batch is there from the start.
+    fetch(rows, FetchBatchSize);
+    }
+  return rows;
   }
 
-QModelIndex SDatabaseModel::index( int row, int column, const QModelIndex &parent ) const
+void SDatabaseModel::fetch(Rows *rows, int count) const
   {
-  SDataModelProfileFunction
-  const SProperty *prop = _root;
-  int size = 0;
-  if(parent.isValid())
+  int oldSize = rows->children.size();
+
+  SProperty *child = rows->children.isEmpty() ? rows->container->firstChild() : rows->children.last()->nextSibling();
+  for(int i=0; i<count && child; ++i, child=child->nextSibling())
+    {
+    rows->rowOf.insert(child, rows->children.size());
+    rows->children << child;
+    }
+
+  if(rows->validRows == oldSize)
     {
-    prop = (SProperty *)parent.internalPointer();
+    rows->validRows = rows->children.size();
     }
+  rows->complete = child == 0;
+  }
+
+int SDatabaseModel::rowIn(Rows *rows, const SProperty *child, xsize hint) const
+  {
+  if(hint < (xsize)rows->children.size() && rows->children[hint] == child)
+    {
+    return (int)hint;
+    }
+
+  XHash<const SProperty *, int>::const_iterator it = rows->rowOf.find(child);
+  if(it == rows->rowOf.end())
+    {
+    return -1;
+    }
+
+  if(it.value() < rows->validRows)
+    {
+    return it.value();
+    }
+
+  for(int i=rows->validRows; i<rows->children.size(); ++i)
+    {
+    rows->rowOf[rows->children[i]] = i;
+    }
+  rows->validRows = rows->children.size();
+
+  return rows->rowOf.value(child);
+  }
 
-  if(!prop)
+QModelIndex SDatabaseModel::indexFor(const SProperty *item) const
+  {
+  if(!item || item == (const SEntity *)_root)
     {
     return QModelIndex();
     }
 
-  if(_options.hasFlag(EntitiesOnly))
+  // an item's row is in the rows of the container holding it, if it has been fetched there must be those rows.
+  int row = -1;
+  Rows *rows = _rows.value(item->parent());
+  if(rows)
     {
-    const SEntity *ent = prop->castTo<SEntity>();
-    xAssert(ent);
+    row = rowIn(rows, item, X_SIZE_SENTINEL);
+    }
+
+  if(row == -1)
+    {
+    row = item->index();
+    }
+
+  return createIndex(row, 0, (void *)item);
+  }
+
+int SDatabaseModel::rowCount( const QModelIndex &parent ) const
+  {
+  SDataModelProfileFunction
+  const Rows *rows = rowsFor(itemFor(parent));
+  return rows ? rows->children.size() : 0;
+  }
+
+bool SDatabaseModel::hasChildren( const QModelIndex &parent ) const
+  {
+  SDataModelProfileFunction
+  // rows may not be fetched yet, but the item should still be expandable.
+  const SPropertyContainer *container = rowsContainer(itemFor(parent));
+  return container && container->firstChild();
+  }
 
-    prop = &ent->children;
+bool SDatabaseModel::canFetchMore( const QModelIndex &parent ) const
+  {
+  SDataModelProfileFunction
+  const Rows *rows = rowsFor(itemFor(parent));
+  return rows && !rows->complete;
+  }
+
+void SDatabaseModel::fetchMore( const QModelIndex &parent )
+  {
+  SDataModelProfileFunction
+  Rows *rows = rowsFor(itemFor(parent));
+  if(!rows || rows->complete)
+    {
+    return;
     }
 
-  const SPropertyContainer *container = prop->castTo<SPropertyContainer>();
-  if(container)
+  int available = 0;
+  SProperty *child = rows->children.isEmpty() ? rows->container->firstChild() : rows->children.last()->nextSibling();
+  for(; available<FetchBatchSize && child; ++available, child=child->nextSibling())
     {
-    SProperty *child = container->firstChild();
-    while(child)
-      {
-      if(size == row)
-        {
-        return createIndex(row, column, child);
-        }
-      size++;
-      child = child->nextSibling();
-      }
     }
 
-  return QModelIndex();
+  if(!available)
+    {
+    // the rest was removed before it was fetched.
+    rows->complete = true;
+    return;
+    }
+
+  beginInsertRows(parent, rows->children.size(), rows->children.size() + available - 1);
+  fetch(rows, available);
+  endInsertRows();
+  }
+
+QModelIndex SDatabaseModel::index( int row, int column, const QModelIndex &parent ) const
+  {
+  SDataModelProfileFunction
+  if(row < 0 || column < 0)
+    {
+    return QModelIndex();
+    }
+
+  const Rows *rows = rowsFor(itemFor(parent));
+  if(!rows || row >= rows->children.size())
+    {
+    return QModelIndex();
+    }
+
+  return createIndex(row, column, rows->children[row]);
   }
 
 QModelIndex SDatabaseModel::parent( const QModelIndex &child ) const
@@ -163,19 +271,16 @@ QModelIndex SDatabaseModel::parent( const QModelIndex &child ) const
   if(child.isValid())
     {
     SProperty *prop = (SProperty *)child.internalPointer();
-    if(prop->parent() && prop->parent() != _root)
+    if(_options.hasFlag(EntitiesOnly))
       {
-      if(_options.hasFlag(EntitiesOnly))
-        {
-        SEntity *ent = prop->castTo<SEntity>();
-        xAssert(ent);
+      SEntity *ent = prop->castTo<SEntity>();
+      xAssert(ent);
 
-        return createIndex(ent->parentEntity()->index(), 0, ent->parentEntity());
-        }
-      else
-        {
-        return createIndex(prop->parent()->index(), 0, prop->parent());
-        }
+      return indexFor(ent->parentEntity());
+      }
+    else
+      {
+      return indexFor(prop->parent());
       }
     }
   return QModelIndex();
@@ -184,14 +289,16 @@ QModelIndex SDatabaseModel::parent( const QModelIndex &child ) const
 int SDatabaseModel::columnCount( const QModelIndex &parent ) const
   {
   SDataModelProfileFunction
-  const SProperty *prop = _root;
-  if(parent.isValid())
-    {
-    prop = (SProperty *)parent.internalPointer();
-    }
+  const SProperty *prop = itemFor(parent);
 
   if(_options.hasFlag(ShowValues) && prop)
     {
+    Rows *rows = rowsFor(prop);
+    if(rows && rows->columns != -1)
+      {
+      return rows->columns;
+      }
+
     xsize columns = 1;
 
     const SPropertyContainer *cont = prop->castTo<SPropertyContainer>();
@@ -210,6 +317,12 @@ int SDatabaseModel::columnCount( const QModelIndex &parent ) const
         child = child->nextSibling();
         }
       }
+
+    // kept until the rows under prop change.
+    if(rows)
+      {
+      rows->columns = columns;
+      }
     return columns;
     }
   return 1;
@@ -268,6 +381,82 @@ Qt::ItemFlags SDatabaseModel::flags(const QModelIndex &index) const
   return QAbstractItemModel::flags(index);
   }
 
+void SDatabaseModel::updateRows(const SPropertyContainer *container, SProperty *prop, xsize hint)
+  {
+  // views haven't been given rows under containers never fetched.
+  Rows *rows = _rows.value(container);
+  if(!rows)
+    {
+    return;
+    }
+
+  // a change can be heard more than once, from each entity it touches, so compare with the tree.
+  int row = rowIn(rows, prop, hint);
+  if(prop->parent() == container)
+    {
+    if(row != -1)
+      {
+      return;
+      }
+
+    // the row goes before the first sibling after it which has been fetched.
+    SProperty *next = prop->nextSibling();
+    while(next && !rows->rowOf.contains(next))
+      {
+      next = next->nextSibling();
+      }
+
+    int insertAt = rows->children.size();
+    if(next)
+      {
+      insertAt = rowIn(rows, next, hint == X_SIZE_SENTINEL ? hint : hint + 1);
+      }
+    else if(!rows->complete)
+      {
+      // it will be fetched with the rest.
+      return;
+      }
+
+    beginInsertRows(indexFor(rows->item), insertAt, insertAt);
+    rows->children.insert(insertAt, prop);
+    rows->rowOf.insert(prop, insertAt);
+    rows->validRows = qMin(rows->validRows, insertAt);
+    rows->columns = -1;
+    endInsertRows();
+    }
+  else if(row != -1)
+    {
+    beginRemoveRows(indexFor(rows->item), row, row);
+    rows->children.remove(row);
+    rows->rowOf.remove(prop);
+    rows->validRows = qMin(rows->validRows, row);
+    rows->columns = -1;
+    endRemoveRows();
+
+    dropRows(prop);
+    }
+  }
+
+void SDatabaseModel::dropRows(const SProperty *item)
+  {
+  // rows can only have been fetched under rows which were, so only those need searching.
+  Rows *rows = _rows.take(rowsContainer(item));
+  if(rows)
+    {
+    foreach(SProperty *child, rows->children)
+      {
+      dropRows(child);
+      }
+    delete rows;
+    }
+  }
+
+void SDatabaseModel::clearRows()
+  {
+  qDeleteAll(_rows);
+  _rows.clear();
+  }
+
 void SDatabaseModel::onTreeChange(const SChange *c)
   {
   const SEntity::TreeChange *tC = c->castTo<SEntity::TreeChange>();
@@ -275,22 +464,34 @@ void SDatabaseModel::onTreeChange(const SChange *c)
     {
     if(tC->property() == _root && tC->after() == 0)
       {
+      beginResetModel();
+      clearRows();
       _root = 0;
+      endResetModel();
+      return;
       }
-    emit layoutAboutToBeChanged();
 
-    if(tC->after() == 0)
+    if(tC->before())
       {
-      changePersistentIndex(createIndex(tC->index(), 0, (void*)tC->property()), QModelIndex());
+      updateRows(tC->before(), tC->property(), tC->index());
+      }
+    if(tC->after() && tC->after() != tC->before())
+      {
+      updateRows(tC->after(), tC->property(), tC->index());
       }
-
-    emit layoutChanged();
     }
 
   const SProperty::NameChange *nameChange = c->castTo<SProperty::NameChange>();
   if(nameChange)
     {
-    emit dataChanged(index(0,0), index(_root->children.size(),0));
+    const SProperty *prop = nameChange->property();
+    Rows *rows = _rows.value(prop->parent());
+    int row = rows ? rowIn(rows, prop, X_SIZE_SENTINEL) : -1;
+    if(row != -1)
+      {
+      QModelIndex changed = createIndex(row, 0, (void *)prop);
+      emit dataChanged(changed, changed);
+      }
     }
   }
 
@@ -300,9 +501,11 @@ void SDatabaseModel::actOnChanges()
 
 void SDatabaseModel::setOptions(Options options)
   {
-  emit layoutAboutToBeChanged();
+  // which rows there are depends on the options.
+  beginResetModel();
+  clearRows();
   _options = options;
-  emit layoutChanged();
+  endResetModel();
   }
 
 SDatabaseModel::Options SDatabaseModel::options() const
@@ -317,6 +520,7 @@ void SDatabaseModel::setRoot(SEntity *ent)
     {
     _root->removeTreeObserver(this);
     }
+  clearRows();
   _root = ent;
 
   if(_root)
@@ -324,8 +528,6 @@ void SDatabaseModel::setRoot(SEntity *ent)
     _root->addTreeObserver(this);
     }
   endResetModel();
-
-  emit dataChanged(index(0, 0), index(_root->children.size(), 0));
   }
 
 void SDatabaseModel::setDatabase(SDatabase *db, SEntity *root)
@@ -7,8 +7,11 @@
 #include "sentityui.h"
 #include "sentityweakpointer.h"
 #include "XFlags"
+#include "XHash"
+#include "XVector"
 
 class SDatabase;
+class SPropertyContainer;
 
 class SHIFT_EXPORT SDatabaseDelegate : public QItemDelegate
   {
@@ -42,10 +45,19 @@ public:
     };
   typedef XFlags<OptionsFlags> Options;
 
+  enum
+    {
+    // rows are fetched as views scroll to them, this many at a time.
+    FetchBatchSize = 256
+    };
+
   SDatabaseModel(SDatabase *db, SEntity *ent, Options options);
   ~SDatabaseModel();
 
   virtual int rowCount( const QModelIndex &parent = QModelIndex() ) const;
+  virtual bool hasChildren( const QModelIndex &parent = QModelIndex() ) const;
+  virtual bool canFetchMore( const QModelIndex &parent ) const;
+  virtual void fetchMore( const QModelIndex &parent );
   virtual QModelIndex index( int row, int column, const QModelIndex &parent = QModelIndex() ) const;
   virtual QModelIndex parent( const QModelIndex &child ) const;
   virtual int columnCount( const QModelIndex &parent = QModelIndex() ) const;
@@ -65,9 +77,38 @@ public:
   void setDatabase(SDatabase *db, SEntity *ent);
 
 private:
+  // the rows fetched so far under an item, in the order of the container holding them. Kept up to date from
+  // tree changes, so views are told exactly which rows are inserted and removed.
+  struct Rows
+    {
+    SProperty *item;
+    const SPropertyContainer *container;
+    XVector<SProperty *> children;
+    // rows from validRows on may have moved since they were numbered, and are numbered again when looked up.
+    XHash<const SProperty *, int> rowOf;
+    int validRows;
+    int columns;
+    bool complete;
+    };
+
+  SProperty *itemFor(const QModelIndex &index) const;
+  const SPropertyContainer *rowsContainer(const SProperty *item) const;
+  // the rows under [item], fetching the first batch if views haven't seen them before.
+  Rows *rowsFor(const SProperty *item) const;
+  void fetch(Rows *rows, int count) const;
+  // the row of [child], checking [hint] first, or -1 if it hasn't been fetched.
+  int rowIn(Rows *rows, const SProperty *child, xsize hint) const;
+  QModelIndex indexFor(const SProperty *item) const;
+
+  // insert or remove [prop]'s row under [container], to match the tree.
+  void updateRows(const SPropertyContainer *container, SProperty *prop, xsize hint);
+  void dropRows(const SProperty *item);
+  void clearRows();
+
   SDatabase *_db;
   SEntityWeakPointer _root;
   Options _options;
+  mutable XHash<const SPropertyContainer *, Rows *> _rows;
   };
 
 #endif // SDATABASEMODEL_H
@@ -156,12 +156,19 @@ void SEntity::removeConnectionObserver(SConnectionObserver *in)
 void SEntity::informDirtyObservers(SProperty *prop)
   {
   SProfileFunction
+  if(_observers.isEmpty())
+    {
+    return;
+    }
+
+  SDatabase *db = database();
+  SChangeBatch::Entry entry = SChangeBatch::Entry::dirtied(prop);
   foreach(const ObserverStruct &obs, _observers)
     {
     if(obs.mode == ObserverStruct::Dirty)
       {
       ((SDirtyObserver*)obs.observer)->onPropertyDirtied(prop);
-      database()->currentBlockObserverList() << obs.observer;
+      db->queueObserver(obs.observer, entry);
       }
     }
 
@@ -171,31 +178,39 @@ void SEntity::informDirtyObservers(SProperty *prop)
 void SEntity::informTreeObservers(const SChange *event)
   {
   SProfileFunction
-  foreach(const ObserverStruct &obs, _observers)
+  SDatabase *db = database();
+  SChangeBatch::Entry entry = SChangeBatch::Entry::fromChange(event);
+
+  // walked up the tree, rather than recursing, most entities have no observers at all.
+  for(SEntity *ent = this; ent; ent = ent->parentEntity())
     {
-    if(obs.mode == ObserverStruct::Tree)
+    foreach(const ObserverStruct &obs, ent->_observers)
       {
-      ((STreeObserver*)obs.observer)->onTreeChange(event);
-      database()->currentBlockObserverList() << obs.observer;
+      if(obs.mode == ObserverStruct::Tree)
+        {
+        ((STreeObserver*)obs.observer)->onTreeChange(event);
+        db->queueObserver(obs.observer, entry);
+        }
       }
     }
-
-  SEntity *parentEnt = parentEntity();
-  if(parentEnt)
-    {
-    parentEnt->informTreeObservers(event);
-    }
   }
 
 void SEntity::informConnectionObservers(const SChange *event)
   {
   SProfileFunction
+  if(_observers.isEmpty())
+    {
+    return;
+    }
+
+  SDatabase *db = database();
+  SChangeBatch::Entry entry = SChangeBatch::Entry::fromChange(event);
   foreach(const ObserverStruct &obs, _observers)
     {
     if(obs.mode == ObserverStruct::Connection)
       {
       ((SConnectionObserver*)obs.observer)->onConnectionChange(event);
-      database()->currentBlockObserverList() << obs.observer;
+      db->queueObserver(obs.observer, entry);
       }
     }
   }
@@ -17,6 +17,16 @@
 #define SProfileFunction XProfileFunction(ShiftCoreProfileScope)
 #define SProfileScopedBlock(mess) XProfileScopedBlock(ShiftCoreProfileScope, mess)
 
+// hint that [ptr] will be read soon, so walks over the tree wait on memory less.
+#if defined(Q_CC_GNU)
+#  define SPrefetch(ptr) __builtin_prefetch(ptr)
+#elif defined(Q_CC_MSVC)
+#  include <xmmintrin.h>
+#  define SPrefetch(ptr) _mm_prefetch((const char *)(ptr), _MM_HINT_T0)
+#else
+#  define SPrefetch(ptr)
+#endif
+
 class SEntity;
 class SProperty;
 class SObserver;
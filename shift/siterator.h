@@ -2,17 +2,74 @@
 #define SITERATOR_H
 
 #include "spropertycontainer.h"
+#include "sentity.h"
 
-#define S_ITERATOR_STACK_SIZE 8
+#define S_ITERATOR_STACK_SIZE 16
 
 class SHIFT_EXPORT SIterator
   {
 public:
+  // the properties still to visit in a tree walk, the next sibling of each container the walk has gone into. Held
+  // in place for shallow trees, deeper ones spill into a vector which is kept, so a walk doesn't allocate each step.
+  class SHIFT_EXPORT WalkStack
+    {
+  public:
+    enum
+      {
+      InlineSize = 8
+      };
+
+    WalkStack() : _size(0)
+      {
+      }
+
+    bool isEmpty() const { return _size == 0; }
+    void clear() { _size = 0; }
+
+    void push(SProperty *prop)
+      {
+      if(_size < InlineSize)
+        {
+        _inline[_size] = prop;
+        }
+      else if((xsize)_overflow.size() > _size - InlineSize)
+        {
+        _overflow[_size - InlineSize] = prop;
+        }
+      else
+        {
+        _overflow << prop;
+        }
+      ++_size;
+      }
+
+    SProperty *pop()
+      {
+      xAssert(_size);
+      --_size;
+      return _size < InlineSize ? _inline[_size] : _overflow[_size - InlineSize];
+      }
+
+  private:
+    SProperty *_inline[InlineSize];
+    XVector<SProperty *> _overflow;
+    xsize _size;
+    };
+
   class SHIFT_EXPORT DataCache
     {
   public:
+    enum
+      {
+      TypeCacheSize = 16
+      };
+
     DataCache(SProperty *input)
       {
+      for(xsize i=0; i<TypeCacheSize; ++i)
+        {
+        _types[i].from = 0;
+        }
       reset(input);
       }
 
@@ -28,17 +85,51 @@ public:
       return ptr[index];
       }
 
+    WalkStack &walk(xsize index)
+      {
+      xAssert(index < S_ITERATOR_STACK_SIZE);
+      return walks[index];
+      }
+
     void reset(SProperty *prop)
       {
       ptr[0] = prop;
       for(xsize i=1; i<S_ITERATOR_STACK_SIZE; ++i)
         {
         ptr[i] = 0;
+        walks[i].clear();
         }
       }
 
+    // castTo<T>(), remembering recent answers by type, as a scan meets the same few types over and over.
+    template <typename T> T *castTo(SProperty *prop)
+      {
+      return prop && inheritsFromType(prop->typeInformation(), T::staticTypeInformation()) ? static_cast<T *>(prop) : 0;
+      }
+
   private:
+    bool inheritsFromType(const SPropertyInformation *from, const SPropertyInformation *type)
+      {
+      TypeResult &result = _types[(((xsize)from ^ (xsize)type) >> 4) % TypeCacheSize];
+      if(result.from != from || result.type != type)
+        {
+        result.from = from;
+        result.type = type;
+        result.inherits = from->inheritsFromType(type);
+        }
+      return result.inherits;
+      }
+
+    struct TypeResult
+      {
+      const SPropertyInformation *from;
+      const SPropertyInformation *type;
+      bool inherits;
+      };
+
     SProperty *ptr[S_ITERATOR_STACK_SIZE];
+    WalkStack walks[S_ITERATOR_STACK_SIZE];
+    TypeResult _types[TypeCacheSize];
     };
 
   typedef SProperty *(*FilterFunction)(DataCache &previous);
@@ -61,6 +152,44 @@ public:
     return B<A<Terminate<0>, 1>::filter, 2>::filter;
     }
 
+  template<template<SIterator::FilterFunction Z, xsize INDEX1> class A,
+      template<SIterator::FilterFunction Y, xsize INDEX2> class B,
+      template<SIterator::FilterFunction X, xsize INDEX3> class C>
+      static SIterator::FilterFunction createFilter()
+    {
+    return C<B<A<Terminate<0>, 1>::filter, 2>::filter, 3>::filter;
+    }
+
+  template<template<SIterator::FilterFunction Z, xsize INDEX1> class A,
+      template<SIterator::FilterFunction Y, xsize INDEX2> class B,
+      template<SIterator::FilterFunction X, xsize INDEX3> class C,
+      template<SIterator::FilterFunction W, xsize INDEX4> class D>
+      static SIterator::FilterFunction createFilter()
+    {
+    return D<C<B<A<Terminate<0>, 1>::filter, 2>::filter, 3>::filter, 4>::filter;
+    }
+
+  // a container's first child and a property's next sibling for walking the tree. preGet() only does anything
+  // when the container is dirty, so it is only called then.
+  static SProperty *firstChild(const SPropertyContainer *cont)
+    {
+    if(cont->_flags.hasFlag(SProperty::Dirty))
+      {
+      return cont->firstChild();
+      }
+    return cont->_child;
+    }
+
+  static SProperty *nextSibling(const SProperty *prop)
+    {
+    const SPropertyContainer *parent = prop->_parent;
+    if(parent && parent->_flags.hasFlag(SProperty::Dirty))
+      {
+      return prop->nextSibling();
+      }
+    return prop->_nextSibling;
+    }
+
   // lambda support
   template <typename T> void each(T t)
     {
@@ -88,40 +217,44 @@ class ChildTree
 public:
     static inline SProperty *filter(SIterator::DataCache &cache)
     {
-    SProperty *previous = (SProperty *)cache.output(INDEX);
+    SProperty *previous = cache.output(INDEX);
+    SIterator::WalkStack &stack = cache.walk(INDEX);
     SProperty *ret = 0;
-    if(!previous)
+    if(previous)
       {
-      ret = CHILD(cache);
-      }
-    else
-      {
-      SPropertyContainer *cont = previous->castTo<SPropertyContainer>();
-      if(cont && cont->firstChild())
+      // the root of the walk is the input's output, its siblings aren't part of the tree.
+      SProperty *sibling = previous != cache.output(INDEX-1) ? SIterator::nextSibling(previous) : 0;
+
+      SPropertyContainer *cont = cache.castTo<SPropertyContainer>(previous);
+      SProperty *child = cont ? SIterator::firstChild(cont) : 0;
+      if(child)
         {
-        ret = cont->firstChild();
+        // come back to the sibling once the child's tree is done.
+        if(sibling)
+          {
+          stack.push(sibling);
+          SPrefetch(sibling);
+          }
+        SPrefetch(child);
+        ret = child;
         }
-      else if(previous != cache.output(INDEX-1) && previous->nextSibling())
+      else if(sibling)
         {
-        ret = previous->nextSibling();
+        SPrefetch(sibling);
+        ret = sibling;
         }
-      else
+      else if(!stack.isEmpty())
         {
-        // iterate up until we reach the start point or an unvisited sibling.
-        SProperty *parent = previous->parent();
-        while(parent && !ret && parent != cache.output(INDEX-1))
-          {
-          ret = parent->nextSibling();
-          parent = parent->parent();
-          }
-
-        if(!ret)
-          {
-          ret = CHILD(cache);
-          }
+        ret = stack.pop();
         }
       }
 
+    if(!ret)
+      {
+      stack.clear();
+      ret = CHILD(cache);
+      }
+
     cache.setOutput(INDEX, ret);
     return ret;
     }
@@ -136,22 +269,23 @@ public:
     SProperty *previous = (SProperty *)cache.output(INDEX);
     SProperty *ret = 0;
 
-    if(!previous || !previous->nextSibling())
+    if(previous)
+      {
+      ret = SIterator::nextSibling(previous);
+      }
+
+    if(!ret)
       {
       SProperty *prop = CHILD(cache);
       if(prop)
         {
-        SPropertyContainer *cont = prop->castTo<SPropertyContainer>();
+        SPropertyContainer *cont = cache.castTo<SPropertyContainer>(prop);
         if(cont)
           {
-          ret = cont->firstChild();
+          ret = SIterator::firstChild(cont);
           }
         }
       }
-    else
-      {
-      ret = previous->nextSibling();
-      }
 
     cache.setOutput(INDEX, ret);
     return ret;
@@ -167,22 +301,23 @@ public:
     SProperty *previous = (SProperty *)cache.output(INDEX);
     SProperty *ret = 0;
 
-    if(!previous || !previous->nextSibling())
+    if(previous)
+      {
+      ret = SIterator::nextSibling(previous);
+      }
+
+    if(!ret)
       {
       SProperty *prop = CHILD(cache);
       if(prop)
         {
-        SEntity *ent = prop->castTo<SEntity>();
+        SEntity *ent = cache.castTo<SEntity>(prop);
         if(ent)
           {
-          ret = ent->children.firstChild();
+          ret = SIterator::firstChild(&ent->children);
           }
         }
       }
-    else
-      {
-      ret = previous->nextSibling();
-      }
 
     cache.setOutput(INDEX, ret);
     return ret;
@@ -199,7 +334,7 @@ public:
       {
       SProperty *child = CHILD(cache);
 
-      while(child && !child->castTo<TYPE>())
+      while(child && !cache.castTo<TYPE>(child))
         {
         child = CHILD(cache);
         }
@@ -215,7 +350,7 @@ public:
       {
       SProperty *child = CHILD(cache);
 
-      while(child && child->castTo<TYPE>())
+      while(child && cache.castTo<TYPE>(child))
         {
         child = CHILD(cache);
         }
@@ -1,2 +1,67 @@
 #include "sobserver.h"
+#include "spropertycontainer.h"
 
+SChangeBatch::Entry SChangeBatch::Entry::dirtied(const SProperty *prop)
+  {
+  Entry entry;
+  entry.type = Dirtied;
+  entry.property = prop;
+  entry.from = 0;
+  entry.to = 0;
+  entry.index = X_SIZE_SENTINEL;
+  return entry;
+  }
+
+SChangeBatch::Entry SChangeBatch::Entry::fromChange(const SChange *change)
+  {
+  Entry entry;
+  entry.type = Other;
+  entry.property = 0;
+  entry.from = 0;
+  entry.to = 0;
+  entry.index = X_SIZE_SENTINEL;
+
+  const SPropertyContainer::TreeChange *tree = change->castTo<SPropertyContainer::TreeChange>();
+  if(tree)
+    {
+    entry.type = Tree;
+    entry.property = tree->property();
+    entry.from = tree->before();
+    entry.to = tree->after();
+    entry.index = tree->index();
+    return entry;
+    }
+
+  const SProperty::NameChange *name = change->castTo<SProperty::NameChange>();
+  if(name)
+    {
+    entry.type = Name;
+    entry.property = name->property();
+    return entry;
+    }
+
+  const SProperty::ConnectionChange *connection = change->castTo<SProperty::ConnectionChange>();
+  if(connection)
+    {
+    entry.type = Connection;
+    entry.property = connection->driven();
+    entry.from = connection->driver();
+    entry.to = connection->driven();
+    }
+
+  return entry;
+  }
+
+bool SChangeBatch::Entry::operator==(const Entry &other) const
+  {
+  return type == other.type && property == other.property && from == other.from && to == other.to && index == other.index;
+  }
+
+void SChangeBatch::append(const Entry &entry)
+  {
+  if(!_entries.isEmpty() && _entries.last() == entry)
+    {
+    return;
+    }
+  _entries << entry;
+  }
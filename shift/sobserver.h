@@ -6,12 +6,82 @@
 #include "sproperty.h"
 
 class SChange;
+class SDatabase;
 
-class SObserver
+// the changes an observer was informed of during a block, in the order they were made. Entries copy what they
+// need from the changes, so a batch stays valid once the block has ended, and can be read on another thread.
+class SHIFT_EXPORT SChangeBatch
   {
 public:
+  class Entry
+    {
+  public:
+    enum Type
+      {
+      Dirtied,
+      Tree,
+      Name,
+      Connection,
+      Other
+      };
+
+    Type type;
+    // the property dirtied, moved or renamed, or the driven end of a connection.
+    const SProperty *property;
+    // the containers a tree change moved the property from and to, or the driver and driven of a connection.
+    const SProperty *from;
+    const SProperty *to;
+    // where a tree change removed or inserted the property.
+    xsize index;
+
+    static Entry dirtied(const SProperty *prop);
+    static Entry fromChange(const SChange *change);
+
+    bool operator==(const Entry &other) const;
+    };
+
+  const XVector<Entry> &entries() const { return _entries; }
+  xsize size() const { return _entries.size(); }
+  bool isEmpty() const { return _entries.isEmpty(); }
+
+  // add [entry], unless it repeats the last entry, ie. a tree change heard from two entities.
+  void append(const Entry &entry);
+  void clear() { _entries.clear(); }
+
+private:
+  XVector<Entry> _entries;
+  };
+
+class SHIFT_EXPORT SObserver
+  {
+public:
+  enum Delivery
+    {
+    // actOnChanges is called as the block ends, without the changes.
+    Notify,
+    // the changes are collected, and passed to actOnBatch as the block ends.
+    Collect,
+    // as Collect, but actOnBatch is called on the database's observer thread, where only the batch may be
+    // read. Observers must wait for SDatabase::waitForObservers before they are destroyed.
+    CollectOnThread
+    };
+
+  SObserver(Delivery delivery = Notify) : _delivery(delivery), _queued(false) { }
   virtual ~SObserver() { }
+
+  Delivery delivery() const { return _delivery; }
+
   virtual void actOnChanges() { };
+  // called once each block this observer was informed in ends, by default calls actOnChanges().
+  virtual void actOnBatch(const SChangeBatch &) { actOnChanges(); }
+
+private:
+  Delivery _delivery;
+  // set while the observer is waiting for the current block to end, so it is only queued once.
+  bool _queued;
+  SChangeBatch _batch;
+
+  friend class SDatabase;
   };
 
 class SHIFT_EXPORT STreeObserver : public SObserver
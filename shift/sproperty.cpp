@@ -93,6 +93,10 @@ xsize SProperty::index() const
   if(parent())
     {
     parent()->preGet();
+    if(_instanceInfo->index() != X_SIZE_SENTINEL && _instanceInfo->index() >= parent()->_firstStaleIndex)
+      {
+      parent()->updateIndices();
+      }
     }
 
   return _instanceInfo->index();
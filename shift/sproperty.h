@@ -278,6 +278,7 @@ private:
   friend class SDatabase;
   friend class SPropertyContainer;
   friend class SProcessManager;
+  friend class SIterator;
   };
 
 #endif // SPROPERTY_H
@@ -21,10 +21,12 @@ void SPropertyArray::remove(SProperty *prop)
   SPropertyContainer::removeProperty(prop);
   }
 
+void SPropertyArray::remove(xsize index, xsize count)
+  {
+  removeProperties(index, count);
+  }
+
 void SPropertyArray::clear()
   {
-  while(firstChild())
-    {
-    remove(firstChild());
-    }
+  removeProperties(containedProperties(), size() - containedProperties());
   }
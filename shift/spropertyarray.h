@@ -22,11 +22,19 @@ public:
     return addProperty(info, X_SIZE_SENTINEL);
     }
 
+  // add [count] properties of type [info] at [index], or the end.
+  void add(const SPropertyInformation *info, xsize count, xsize index=X_SIZE_SENTINEL)
+    {
+    addProperties(info, count, index);
+    }
+
   SProperty *operator[](xsize i) { return at(i); }
   using SPropertyContainer::at;
   void clear();
 
   void remove(SProperty *);
+  // remove [count] properties from [index].
+  void remove(xsize index, xsize count);
   };
 
 template <typename T> class STypedPropertyArray : public SPropertyContainer
@@ -47,36 +55,21 @@ public:
   void resize(xsize s)
     {
     xsize sz = size();
-    xsize dif = s - sz;
-
-    if(dif > 0)
+    if(s > sz)
       {
-      for(xsize x=0; x<s; ++x)
-        {
-        addProperty(false, internalCreateHelper(T::Type, database()));
-        }
+      addProperties(T::staticTypeInformation(), s - sz);
       }
-    else if(dif < 0)
+    else if(s < sz)
       {
-      for(xsize x=s; x<sz; ++x)
-        {
-        // could be optimised lots...
-        removeProperty(at(x));
-        }
+      removeProperties(s, sz - s);
       }
     }
 
   T *operator[](xsize i) { return at(i); }
   T *at(xsize i)
     {
-    SProperty *c = firstChild();
-    while(c && i)
-      {
-      --i;
-      c = c->nextSibling();
-      }
-
-    return c;
+    SProperty *c = SPropertyContainer::at(i);
+    return c ? c->uncheckedCastTo<T>() : 0;
     }
   };
 
@@ -77,24 +77,11 @@ bool SPropertyContainer::TreeChange::apply(int mode)
   return true;
   }
 
-SPropertyContainer::SPropertyContainer() : SProperty(), _child(0), _containedProperties(0)
+SPropertyContainer::SPropertyContainer() : SProperty(), _child(0), _containedProperties(0),
+    _firstStaleIndex(X_SIZE_SENTINEL)
   {
   }
 
-xsize SPropertyContainer::size() const
-  {
-  preGet();
-  xsize s = 0;
-  SProperty *c = firstChild();
-  while(c)
-    {
-    s++;
-    c = c->nextSibling();
-    }
-
-  return s;
-  }
-
 const SProperty *SPropertyContainer::findChild(const QString &name) const
   {
   preGet();
@@ -124,16 +111,14 @@ SProperty *SPropertyContainer::findChild(const QString &name)
 bool SPropertyContainer::contains(SProperty *child) const
   {
   preGet();
-  SProperty *prop = _child;
-  while(prop)
+  if(child->_parent != this)
     {
-    if(child == prop)
-      {
-      return true;
-      }
-    prop = prop->_nextSibling;
+    return false;
     }
-  return false;
+
+  // removed properties still point at their old parent.
+  xsize index = child->index();
+  return index < (xsize)_children.size() && _children[index] == child;
   }
 
 SPropertyContainer::~SPropertyContainer()
@@ -163,6 +148,32 @@ SProperty *SPropertyContainer::addProperty(const SPropertyInformation *info, xsi
   return newProp;
   }
 
+void SPropertyContainer::addProperties(const SPropertyInformation *info, xsize count, xsize index)
+  {
+  SBlock b(database());
+
+  xsize position = xMin(index, (xsize)_children.size());
+  _children.reserve(_children.size() + count);
+  for(xsize i=0; i<count; ++i)
+    {
+    addProperty(info, position + i);
+    }
+  }
+
+void SPropertyContainer::removeProperties(xsize index, xsize count)
+  {
+  xAssert(index >= _containedProperties);
+  xAssert(index + count <= (xsize)_children.size());
+
+  SBlock b(database());
+
+  // from the back, so the properties still to go keep their indices.
+  for(xsize i=index+count; i>index; --i)
+    {
+    removeProperty(_children[i-1]);
+    }
+  }
+
 void SPropertyContainer::moveProperty(SPropertyContainer *c, SProperty *p)
   {
   xAssert(p->parent() == this);
@@ -259,58 +270,47 @@ SProperty *SPropertyContainer::loadProperty(SPropertyContainer *parent, SLoader
 
 void SPropertyContainer::internalInsertProperty(bool contained, SProperty *newProp, xsize index)
   {
-  xAssert(newProp->_parent == 0);
+  // a property moving from another container still points at it, but has no index there.
+  xAssert(newProp->_parent == 0 || newProp->_instanceInfo->index() == X_SIZE_SENTINEL);
   xAssert(newProp->_entity == 0);
   xAssert(newProp->_nextSibling == 0);
 
-  if(_child)
+  xsize position = xMin(index, (xsize)_children.size());
+  if(contained)
     {
-    xsize propIndex = 0;
-    SProperty *prop = _child;
-    while(prop)
-      {
-      if(index == (propIndex+1) || !prop->_nextSibling)
-        {
-        if(contained)
-          {
-          xAssert(_containedProperties == (propIndex+1));
-          _containedProperties++;
-          }
-        else
-          {
-          ((SProperty::InstanceInformation*)newProp->_instanceInfo)->_index = propIndex + 1;
-          }
-        // insert this prop into the list
-        newProp->_nextSibling = prop->_nextSibling;
-        prop->_nextSibling = newProp;
-
-        // set up state info
-        newProp->_parent = this;
-        newProp->_entity = 0;
-        newProp->_database = _database;
-        break;
-        }
-      propIndex++;
-      prop = prop->_nextSibling;
-      }
+    xAssert(position == (xsize)_children.size());
+    xAssert(_containedProperties == position);
+    _containedProperties++;
+    }
+  else
+    {
+    xAssert(position >= _containedProperties);
+    ((SProperty::InstanceInformation*)newProp->_instanceInfo)->_index = position;
+    }
+
+  _children.insert(position, newProp);
+  // the children after this have moved up, but still hold their old indices, from position on.
+  if(position + 1 < (xsize)_children.size())
+    {
+    _firstStaleIndex = xMin(_firstStaleIndex, position);
+    }
+
+  // keep the sibling list in step
+  newProp->_nextSibling = position + 1 < (xsize)_children.size() ? _children[position + 1] : 0;
+  if(position)
+    {
+    _children[position - 1]->_nextSibling = newProp;
     }
   else
     {
-    if(contained)
-      {
-      xAssert(_containedProperties == 0);
-      _containedProperties++;
-      }
-    else
-      {
-      ((SProperty::InstanceInformation*)newProp->_instanceInfo)->_index = 0;
-      }
     _child = newProp;
-    newProp->_parent = this;
-    newProp->_entity = 0;
-    newProp->_database = _database;
     }
 
+  // set up state info
+  newProp->_parent = this;
+  newProp->_entity = 0;
+  newProp->_database = _database;
+
   if(input() || _flags.hasFlag(ParentHasInput) || instanceInformation()->isComputed())
     {
     SProperty::ConnectionChange::setParentHasInputConnection(newProp);
@@ -326,61 +326,44 @@ void SPropertyContainer::internalRemoveProperty(SProperty *oldProp)
   {
   xAssert(oldProp->parent() == this);
 
-  if(oldProp == _child)
+  xsize position = oldProp->_instanceInfo->index();
+  if(position >= _firstStaleIndex)
     {
-    xAssert(_containedProperties == 0);
-
-    _child = _child->_nextSibling;
+    updateIndices();
+    position = oldProp->_instanceInfo->index();
+    }
+  xAssert(position >= _containedProperties);
+  xAssert(position < (xsize)_children.size() && _children[position] == oldProp);
 
-    oldProp->_parent = this;
-    oldProp->_entity = 0;
-    ((SProperty::InstanceInformation*)oldProp->_instanceInfo)->_index = X_SIZE_SENTINEL;
+  if(position)
+    {
+    _children[position - 1]->_nextSibling = oldProp->_nextSibling;
     }
   else
     {
-    xsize propIndex = 0;
-    SProperty *prop = _child;
-    while(prop)
-      {
-      if(oldProp == prop->_nextSibling)
-        {
-        xAssert(propIndex >= _containedProperties);
-
-        oldProp->_parent = this;
-        oldProp->_entity = 0;
-        ((SProperty::InstanceInformation*)oldProp->_instanceInfo)->_index = X_SIZE_SENTINEL;
-
-        prop->_nextSibling = oldProp->_nextSibling;
-        }
-      propIndex++;
-      prop = prop->_nextSibling;
-      }
+    _child = oldProp->_nextSibling;
     }
-
-  SProperty::ConnectionChange::clearParentHasInputConnection(oldProp);
-  SProperty::ConnectionChange::clearParentHasOutputConnection(oldProp);
-  }
-
-const SProperty *SPropertyContainer::at(xsize i) const
-  {
-  const SProperty *c = firstChild();
-  while(c && i)
+  _children.remove(position);
+  if(position < (xsize)_children.size())
     {
-    --i;
-    c = c->nextSibling();
+    _firstStaleIndex = xMin(_firstStaleIndex, position);
     }
 
-  return c;
+  // the parent is kept, so observers can still find the entity the property was removed from.
+  oldProp->_parent = this;
+  oldProp->_entity = 0;
+  oldProp->_nextSibling = 0;
+  ((SProperty::InstanceInformation*)oldProp->_instanceInfo)->_index = X_SIZE_SENTINEL;
+
+  SProperty::ConnectionChange::clearParentHasInputConnection(oldProp);
+  SProperty::ConnectionChange::clearParentHasOutputConnection(oldProp);
   }
 
-SProperty *SPropertyContainer::at(xsize i)
+void SPropertyContainer::updateIndices() const
   {
-  SProperty *c = firstChild();
-  while(c && i)
+  for(xsize i=_firstStaleIndex, s=_children.size(); i<s; ++i)
     {
-    --i;
-    c = c->nextSibling();
+    ((SProperty::InstanceInformation*)_children[i]->_instanceInfo)->_index = i;
     }
-
-  return c;
+  _firstStaleIndex = X_SIZE_SENTINEL;
   }
@@ -71,10 +71,12 @@ public:
 
   SProperty *firstChild() const { preGet(); return _child; }
 
+  // the children are kept in a vector as well as linked, so size(), at() and SProperty::index() don't walk.
+  xsize size() const { preGet(); return _children.size(); }
+
   const SProperty *findChild(const QString &name) const;
   SProperty *findChild(const QString &name);
 
-  xsize size() const;
   xsize containedProperties() const { return _containedProperties; }
 
   bool contains(SProperty *) const;
@@ -92,20 +94,29 @@ protected:
   void moveProperty(SPropertyContainer *newParent, SProperty *property);
   void removeProperty(SProperty *);
 
-  SProperty *at(xsize i);
-  const SProperty *at(xsize i) const;
+  // add [count] properties of type [info] from [index], or remove [count] from [index], in one block of changes.
+  void addProperties(const SPropertyInformation *info, xsize count, xsize index=X_SIZE_SENTINEL);
+  void removeProperties(xsize index, xsize count);
+
+  SProperty *at(xsize i) { preGet(); return i < (xsize)_children.size() ? _children[i] : 0; }
+  const SProperty *at(xsize i) const { preGet(); return i < (xsize)_children.size() ? _children[i] : 0; }
 
 private:
   SProperty *_child;
+  XVector<SProperty *> _children;
   xsize _containedProperties;
+  // dynamic children from here on have moved since their indices were set, they're fixed when next asked for.
+  mutable xsize _firstStaleIndex;
 
   void internalInsertProperty(bool contained, SProperty *, xsize index);
   void internalRemoveProperty(SProperty *);
+  void updateIndices() const;
 
   friend class TreeChange;
   friend class SEntity;
   friend class SProperty;
   friend class SDatabase;
+  friend class SIterator;
   };
 
 #endif // SPROPERTYCONTAINER_H